@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TopicHandler.h"
+#include "TopicHandlerRegistry.h"
+#include "ConfigLoader.h"
+#include "AudioPlayer.h"
+
+// Control messages are parsed from the payload bytes, so besides the members
+// the document holds a copy of every key and string
+#define AUDIO_CONTROL_CAPACITY (JSON_OBJECT_SIZE(3) + 48)
+
+// Streamed audio for the buzzer on emqx.topic.audio (see AudioPlayer).
+// Binary payloads are audio chunks (see AudioCodec.h); JSON payloads control the stream:
+//
+//   {"command": "start", "rate": 8000, "prefill_ms": 200}
+//   {"command": "end"}   // play out what is buffered, then stop
+//   {"command": "stop"}  // stop now
+//
+// Control and chunks share one topic, so they arrive in the order they were sent.
+class AudioStreamController : public TopicHandler
+{
+public:
+    bool isBinary() const override { return true; }
+    void handleBinary(const uint8_t *payload, size_t length) override;
+    const char *getTopic() const override;
+    size_t getDocumentCapacity() const override { return 0; }
+
+private:
+    void _handleControl(const uint8_t *payload, size_t length);
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TopicHandler.h"
+#include "TopicHandlerRegistry.h"
+#include "ConfigLoader.h"
+#include "CommandPipeline.h"
+#include "DeviceClock.h"
+
+// Most commands (after topic fan-out) a single batch may carry
+#ifndef BATCH_MAX_COMMANDS
+#define BATCH_MAX_COMMANDS 8
+#endif
+
+// How far ahead a batch may be scheduled
+#ifndef BATCH_MAX_AHEAD_MS
+#define BATCH_MAX_AHEAD_MS (24UL * 60 * 60 * 1000)
+#endif
+
+// Routes an array of commands for other handlers from one message:
+//
+//   {"at": 1760700000000,
+//    "commands": [{"topic": "esp32-mcp/control/led", "command": "on"},
+//                 {"topic": "esp32-mcp/control/buzzer", "command": "BEEP", "delay": 0},
+//                 {"topic": "esp32-mcp/control/led", "command": "off", "delay": 500}]}
+//
+// "at" (optional) is an epoch-ms start time and needs the SNTP clock; without
+// it the batch starts on arrival. "delay" is in ms relative to the start.
+// Every command is decoded before any is queued or prepared, so one invalid
+// command rejects the whole batch before it has staged anything. Batches
+// leave PIPELINE_SCHEDULE_RESERVE schedule slots to immediate commands; one
+// that does not fit is dropped whole on arrival. A batch with an "id" is acked
+// once all its commands have run, with the first command's start as its
+// actuation time; one that runs further ahead than ACK_MAX_WAIT_MS is acked
+// "queued" on arrival instead.
+// Handlers that stage data in prepareCommand()
+// (PLAY_SONG scores) keep only the latest, so send at most one per batch.
+class BatchController : public TopicHandler
+{
+public:
+    CommandStatus handleMessage(DynamicJsonDocument &doc) override;
+    const char *getTopic() const override;
+    size_t getDocumentCapacity() const override;
+};
\ No newline at end of file
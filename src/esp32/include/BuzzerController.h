@@ -4,16 +4,44 @@
 #include "TopicHandler.h"
 #include "ConfigLoader.h"
 #include "TopicHandlerRegistry.h"
+#include "SongSequencer.h"
+#include "CommandPipeline.h"
+#include "AudioPlayer.h"
+#include "TripleBuffer.h"
+#include "DeviceState.h"
+
+// Notes a PLAY_SONG score sent as MessagePack may hold; JSON scores are
+// streamed note by note and only bounded by SONG_MAX_NOTES
+#ifndef BUZZER_MSGPACK_NOTES
+#define BUZZER_MSGPACK_NOTES 16
+#endif
 
 class BuzzerController : public TopicHandler
 {
 public:
     void init() override;
-    void handleMessage(DynamicJsonDocument &doc) override;
+    const CommandSchema *getCommandSchema() const override;
+    bool prepareCommand(Command &cmd, JsonObjectConst doc) override;
+    uint32_t getCoalesceKey(const Command &cmd) const override;
+    CommandStatus handleCommand(const Command &cmd) override;
     const char *getTopic() const override;
+    size_t getDocumentCapacity() const override;
+    const char *getStreamField() const override { return "score"; }
+    bool streamElement(size_t index, JsonVariantConst element, JsonObjectConst header) override;
+    void streamEnd() override { _streamed = false; }
+    const char *getStateKey() const override { return "buzzer"; }
+    void reportState(JsonObject state) const override;
 
 private:
     void _turnOnBuzzer();
     void _turnOffBuzzer();
     void _beep(int duration);
+    void _playSong();
+    static void _onSoundEnd(void *arg);
+
+    TripleBuffer<SongScore> _scores; // compiled on the network task, played on the actuator task
+    SongPlayer _player;              // timer-driven playback engine
+    bool _streamed = false;          // the write buffer holds this message's streamed score
+    volatile uint8_t _mode = 0;      // BuzzerCommand that started the current sound
+    WheelTimer _endTimer{&BuzzerController::_onSoundEnd, this}; // end of the current beep or song
 };
@@ -1,19 +1,29 @@
 #pragma once
 
 #include <Arduino.h>
+#include <atomic>
 #include "TopicHandler.h"
 #include "TopicHandlerRegistry.h"
 #include "ConfigLoader.h"
+#include "LedEffects.h"
+#include "DeviceState.h"
 
 class LEDController : public TopicHandler
 {
 public:
     void init() override;
-    void handleMessage(DynamicJsonDocument &doc) override;
+    const CommandSchema *getCommandSchema() const override;
+    uint32_t getCoalesceKey(const Command &cmd) const override;
+    CommandStatus handleCommand(const Command &cmd) override;
     const char *getTopic() const override;
+    const char *getStateKey() const override { return "led"; }
+    void reportState(JsonObject state) const override;
 
 private:
-    void _turnOnLED();
-    void _turnOffLED();
-    void _setBrightness(int brightness);
+    bool _start(int channel, const LedEffect &effect);
+
+    LedFader _faders[LED_MAX_CHANNELS]; // one hardware-faded output per configured pin
+    // Type and level of the last effect started on each channel, packed into one
+    // word so reportState() on the network task never reads half an update
+    std::atomic<uint32_t> _reported[LED_MAX_CHANNELS] = {};
 };
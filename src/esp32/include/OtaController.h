@@ -0,0 +1,31 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TopicHandler.h"
+#include "TopicHandlerRegistry.h"
+#include "MqttOta.h"
+
+// Control messages are parsed from the payload bytes, so besides the five
+// members of a begin the document holds a copy of every key and string
+// (the sha256 alone is 65 bytes)
+#define OTA_CONTROL_CAPACITY (JSON_OBJECT_SIZE(5) + 128)
+
+// Firmware updates over MQTT on <emqx.topic.ota>/<client id> (see MqttOta).
+// Binary payloads are image chunks; JSON payloads control the transfer:
+//
+//   {"command": "begin", "size": 1048576, "sha256": "<64 hex digits>", "compression": "zlib", "nonce": 7}
+//   {"command": "abort"}
+//   {"command": "status"}
+//
+// Progress is published retained on <topic>/status.
+class OtaController : public TopicHandler
+{
+public:
+    bool isBinary() const override { return true; }
+    void handleBinary(const uint8_t *payload, size_t length) override;
+    const char *getTopic() const override;
+    size_t getDocumentCapacity() const override { return 0; }
+
+private:
+    void _handleControl(const uint8_t *payload, size_t length);
+};
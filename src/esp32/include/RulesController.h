@@ -0,0 +1,25 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TopicHandler.h"
+#include "TopicHandlerRegistry.h"
+#include "ConfigLoader.h"
+#include "RulesEngine.h"
+#include "DeviceState.h"
+
+// Manages the on-device rules (see RulesEngine):
+//
+//   {"command": "add", "name": "bright_beep", "when": {...}, "if": "...", "then": [...]}
+//   {"command": "remove", "name": "bright_beep"}
+//   {"command": "clear"}
+//
+// The installed rule names are reported in the device state.
+class RulesController : public TopicHandler
+{
+public:
+    CommandStatus handleMessage(DynamicJsonDocument &doc) override;
+    const char *getTopic() const override;
+    size_t getDocumentCapacity() const override;
+    const char *getStateKey() const override { return "rules"; }
+    void reportState(JsonObject state) const override;
+};
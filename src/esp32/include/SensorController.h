@@ -0,0 +1,32 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TopicHandler.h"
+#include "TopicHandlerRegistry.h"
+#include "ConfigLoader.h"
+#include "AdcSampler.h"
+#include "DeviceState.h"
+
+// Controls the analog sampling pipeline (see AdcSampler):
+//
+//   {"command": "start"} / {"command": "stop"}
+//   {"command": "set_rate", "sample_hz": 2000, "window_ms": 500}
+//   {"command": "set_threshold", "channel": 0, "high": 3000, "low": 2800}
+//   {"command": "clear_threshold", "channel": 0}
+//
+// Channels are indexes into esp32.sensor.pins. Aggregates are published to
+// emqx.topic.sensor once per window; the rate is reported in the device state.
+class SensorController : public TopicHandler
+{
+public:
+    void init() override;
+    const CommandSchema *getCommandSchema() const override;
+    uint32_t getCoalesceKey(const Command &cmd) const override;
+    CommandStatus handleCommand(const Command &cmd) override;
+    const char *getTopic() const override;
+    const char *getStateKey() const override { return "sensor"; }
+    void reportState(JsonObject state) const override;
+
+private:
+    bool _ready = false; // at least one pin could be sampled
+};
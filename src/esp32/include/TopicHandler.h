@@ -2,6 +2,20 @@
 #define TOPIC_HANDLER_H
 
 #include <ArduinoJson.h>
+#include "CommandSchema.h"
+
+// Outcome of a message, reported in its ack (see CommandAck)
+enum class CommandStatus : uint8_t
+{
+    Ok = 0,
+    Invalid = 1,    // rejected: malformed, unknown command or out-of-range field
+    Dropped = 2,    // lost to a full queue or schedule, or no outcome in time
+    NoHandler = 3,  // nothing subscribes to the topic
+    Duplicate = 4,  // its "id" was handled recently; nothing was done again
+    Failed = 5,     // the handler could not carry it out
+    Superseded = 6, // replaced by a newer command before it ran
+    Queued = 7,     // scheduled to run too far ahead to be acked when it runs
+};
 
 class TopicHandler {
 public:
@@ -11,14 +25,64 @@ public:
     // Virtual init method that can be overridden in derived classes, or can have a default implementation
     virtual void init() {}
 
-    // Pure virtual method to handle incoming messages; each derived class must implement this method
-    // The message is passed as a JSON document (DynamicJsonDocument type)
-    virtual void handleMessage(DynamicJsonDocument& doc) = 0;
+    // Handles raw incoming messages; used by handlers that do not declare a command schema
+    // The message is passed as a JSON document (DynamicJsonDocument type) and runs on the network task
+    virtual CommandStatus handleMessage(DynamicJsonDocument& doc) { return CommandStatus::Ok; }
+
+    // Binary handlers own their topic and get the payload bytes unparsed in handleBinary()
+    // Runs on the network task; the payload is only valid during the call
+    virtual bool isBinary() const { return false; }
+    virtual void handleBinary(const uint8_t* payload, size_t length) {}
+
+    // Name of a top-level array member to stream rather than decode: its elements go to
+    // streamElement() one at a time as the payload is parsed, and the document only holds
+    // an empty array in its place, so the array's length costs no memory. Under MQTT 5 such
+    // a payload may also exceed the packet buffer. Applies to JSON payloads on topics this
+    // handler has to itself; MessagePack is still decoded whole
+    virtual const char* getStreamField() const { return nullptr; }
+
+    // Called on the network task for each streamed element, in order, before the message
+    // is decoded; header holds the members that came before the array
+    // Return false to reject the message
+    virtual bool streamElement(size_t index, JsonVariantConst element, JsonObjectConst header) { return true; }
+
+    // Called once a streamed message is over: after its dispatch, or when its parse or
+    // decode failed or it was cut off. Drop per-message stream state here, so it never
+    // carries over to another message
+    virtual void streamEnd() {}
+
+    // Returns the handler's command schema, or nullptr to receive raw messages in handleMessage()
+    virtual const CommandSchema* getCommandSchema() const { return nullptr; }
+
+    // Called on the network task right after a command is decoded, while the document is valid
+    // Copy out anything handleCommand() needs that the schema only checks (e.g. arrays)
+    // Return false to drop the command
+    virtual bool prepareCommand(Command& cmd, JsonObjectConst doc) { return true; }
+
+    // Commands with the same non-zero key replace each other while they wait for
+    // the actuator, so only the latest runs; return 0 for commands that must all run
+    virtual uint32_t getCoalesceKey(const Command& cmd) const { return 0; }
+
+    // Handles a command decoded and validated against getCommandSchema()
+    // Runs on the actuator task; the message document is no longer available here
+    virtual CommandStatus handleCommand(const Command& cmd) { return CommandStatus::Ok; }
 
     // Pure virtual method to return the topic this handler processes
     // Each derived class must specify the topic it handles
     virtual const char* getTopic() const = 0;
 
+    // Key of this handler's section in the retained device state document, or nullptr for none
+    virtual const char* getStateKey() const { return nullptr; }
+
+    // Writes the handler's current state into its section of the state document
+    // Runs on the network task while handleCommand() may run on the actuator task:
+    // read only word-sized fields, and call DeviceState::notify() after changing them
+    virtual void reportState(JsonObject state) const {}
+
+    // JSON document capacity (bytes) needed to decode the largest message on this topic
+    // The shared message document is sized to the largest value across all handlers
+    virtual size_t getDocumentCapacity() const { return 512; }
+
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,412 @@
+#include "AdcSampler.h"
+#include <math.h>
+#include <driver/adc.h>
+#include <esp_adc_cal.h>
+#include <ArduinoJson.h>
+#include "ConfigLoader.h"
+#include "DeviceClock.h"
+#include "MQTTClient.h"
+#include "NetworkEvents.h"
+
+// Each conversion is one adc_digi_output_data_t
+#define SENSOR_RESULT_BYTES 4
+
+int AdcSampler::pins[SENSOR_MAX_CHANNELS];
+uint8_t AdcSampler::adcChannels[SENSOR_MAX_CHANNELS];
+uint8_t AdcSampler::channelCount = 0;
+AdcSampler::Settings AdcSampler::settings = {};
+portMUX_TYPE AdcSampler::lock = portMUX_INITIALIZER_UNLOCKED;
+TaskHandle_t AdcSampler::task = nullptr;
+volatile uint32_t AdcSampler::settingsVersion = 0;
+AdcSampler::Settings AdcSampler::active = {};
+AdcSampler::Accumulator AdcSampler::accumulators[SENSOR_MAX_CHANNELS];
+SensorWindow AdcSampler::window;
+bool AdcSampler::dmaRunning = false;
+SpscRing<SensorWindow, SENSOR_WINDOW_QUEUE> AdcSampler::windows(RingOverflow::DropOldest);
+
+static esp_adc_cal_characteristics_t calibration;
+
+bool AdcSampler::begin(const int *configPins, uint8_t count, uint32_t sampleHz, uint32_t windowMs)
+{
+    for (uint8_t i = 0; i < count && channelCount < SENSOR_MAX_CHANNELS; i++)
+    {
+        // Only ADC1 runs in DMA mode next to WiFi
+        int8_t channel = digitalPinToAnalogChannel(configPins[i]);
+        if (channel < 0 || channel >= SOC_ADC_CHANNEL_NUM(0))
+        {
+            LOG_WARN("⚠️ Sensor pin %d is not an ADC1 pin, ignored", configPins[i]);
+            continue;
+        }
+        pins[channelCount] = configPins[i];
+        adcChannels[channelCount] = channel;
+        channelCount++;
+    }
+    if (channelCount == 0)
+    {
+        return false;
+    }
+
+    esp_adc_cal_characterize(ADC_UNIT_1, ADC_ATTEN_DB_11, ADC_WIDTH_BIT_12, 1100, &calibration);
+    settings.sampleHz = _clampRate(sampleHz);
+    settings.windowMs = constrain(windowMs, (uint32_t)SENSOR_MIN_WINDOW_MS, (uint32_t)SENSOR_MAX_WINDOW_MS);
+    settings.running = true;
+    settingsVersion = 1;
+
+    xTaskCreatePinnedToCore(_task, "sensor", 4096, nullptr, SENSOR_TASK_PRIORITY, &task, SENSOR_TASK_CORE);
+    LOG_INFO("✅ Sampling %u channels at %luHz, %lums windows", (unsigned)channelCount,
+             (unsigned long)settings.sampleHz, (unsigned long)settings.windowMs);
+    return task != nullptr;
+}
+
+void AdcSampler::start()
+{
+    portENTER_CRITICAL(&lock);
+    settings.running = true;
+    portEXIT_CRITICAL(&lock);
+    _changed();
+}
+
+void AdcSampler::stop()
+{
+    portENTER_CRITICAL(&lock);
+    settings.running = false;
+    portEXIT_CRITICAL(&lock);
+    _changed();
+}
+
+void AdcSampler::setRate(uint32_t sampleHz, uint32_t windowMs)
+{
+    sampleHz = _clampRate(sampleHz);
+    portENTER_CRITICAL(&lock);
+    settings.sampleHz = sampleHz;
+    settings.windowMs = constrain(windowMs, (uint32_t)SENSOR_MIN_WINDOW_MS, (uint32_t)SENSOR_MAX_WINDOW_MS);
+    portEXIT_CRITICAL(&lock);
+    _changed();
+}
+
+void AdcSampler::setThreshold(uint8_t channel, uint16_t high, uint16_t low)
+{
+    if (channel >= channelCount)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    settings.thresholds[channel] = SensorThreshold{true, high, min(low, high)};
+    portEXIT_CRITICAL(&lock);
+    _changed();
+}
+
+void AdcSampler::clearThreshold(uint8_t channel)
+{
+    if (channel >= channelCount)
+    {
+        return;
+    }
+    portENTER_CRITICAL(&lock);
+    settings.thresholds[channel].enabled = false;
+    portEXIT_CRITICAL(&lock);
+    _changed();
+}
+
+void AdcSampler::_changed()
+{
+    portENTER_CRITICAL(&lock);
+    settingsVersion = settingsVersion + 1;
+    portEXIT_CRITICAL(&lock);
+    if (task)
+    {
+        xTaskNotifyGive(task);
+    }
+}
+
+void AdcSampler::loop()
+{
+    SensorWindow finished;
+    while (windows.pop(finished))
+    {
+        char payload[768];
+        size_t length = serialize(finished, payload, sizeof(payload));
+        if (length == 0 || !MQTTClient::getMQTTClient().publish(ConfigLoader::getConfig().sensor_topic,
+                                                                (const uint8_t *)payload, length))
+        {
+            LOG_WARN("⚠️ Sensor publish failed");
+        }
+    }
+}
+
+size_t AdcSampler::serialize(const SensorWindow &w, char *buffer, size_t size)
+{
+    StaticJsonDocument<JSON_OBJECT_SIZE(6) + JSON_ARRAY_SIZE(SENSOR_MAX_CHANNELS) +
+                       SENSOR_MAX_CHANNELS * JSON_OBJECT_SIZE(7) + JSON_ARRAY_SIZE(SENSOR_MAX_EVENTS) +
+                       SENSOR_MAX_EVENTS * JSON_OBJECT_SIZE(4)>
+        doc;
+
+    // Epoch ms once SNTP has synced, uptime ms before
+    uint64_t epochMs = DeviceClock::epochMs();
+    doc["t"] = epochMs ? epochMs - (millis() - w.startMs) : (uint64_t)w.startMs;
+    doc["ms"] = w.durationMs;
+
+    JsonArray channels = doc.createNestedArray("ch");
+    for (uint8_t i = 0; i < w.channelCount; i++)
+    {
+        const SensorSummary &s = w.channels[i];
+        JsonObject channel = channels.createNestedObject();
+        channel["pin"] = pins[i];
+        channel["n"] = s.count;
+        if (s.count)
+        {
+            channel["min"] = s.min;
+            channel["max"] = s.max;
+            channel["mean"] = s.mean;
+            channel["rms"] = s.rms;
+            channel["mv"] = esp_adc_cal_raw_to_voltage(s.mean, &calibration);
+        }
+    }
+
+    if (w.eventCount)
+    {
+        JsonArray events = doc.createNestedArray("events");
+        for (uint8_t i = 0; i < w.eventCount; i++)
+        {
+            const SensorEvent &e = w.events[i];
+            JsonObject event = events.createNestedObject();
+            event["pin"] = pins[e.channel];
+            event["dir"] = e.rising ? "up" : "down";
+            event["value"] = e.value;
+            event["at"] = e.offsetMs;
+        }
+    }
+    if (w.eventsMissed)
+    {
+        doc["missed"] = w.eventsMissed;
+    }
+    if (w.overruns)
+    {
+        doc["overruns"] = w.overruns;
+    }
+
+    if (doc.overflowed() || measureJson(doc) >= size)
+    {
+        return 0;
+    }
+    return serializeJson(doc, buffer, size);
+}
+
+void AdcSampler::_task(void *arg)
+{
+    static uint8_t frame[SENSOR_DMA_FRAME_BYTES];
+    uint32_t seenVersion = 0;
+
+    while (true)
+    {
+        // Take new settings between frames
+        if (settingsVersion != seenVersion)
+        {
+            Settings next;
+            portENTER_CRITICAL(&lock);
+            next = settings;
+            seenVersion = settingsVersion;
+            portEXIT_CRITICAL(&lock);
+
+            uint32_t now = millis();
+            bool restart = next.running != active.running || next.sampleHz != active.sampleHz;
+            if (restart || next.windowMs != active.windowMs)
+            {
+                // The current window ends where its rate or length changed
+                if (dmaRunning)
+                {
+                    _closeWindow(now);
+                }
+                window.startMs = now;
+            }
+            if (restart)
+            {
+                _stopDma();
+                if (next.running && !_startDma(next.sampleHz))
+                {
+                    next.running = false;
+                }
+            }
+            active = next;
+        }
+
+        if (!dmaRunning)
+        {
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        uint32_t length = 0;
+        esp_err_t err = adc_digi_read_bytes(frame, sizeof(frame), &length, 100);
+        uint32_t now = millis();
+        if (err == ESP_ERR_INVALID_STATE)
+        {
+            // The driver's buffer overflowed; what it returned is still valid
+            window.overruns++;
+        }
+        if (err == ESP_OK || err == ESP_ERR_INVALID_STATE)
+        {
+            _add(frame, length, now);
+        }
+        if (now - window.startMs >= active.windowMs)
+        {
+            _closeWindow(now);
+        }
+    }
+}
+
+void AdcSampler::_add(const uint8_t *data, uint32_t length, uint32_t now)
+{
+    uint16_t offsetMs = min(now - window.startMs, (uint32_t)UINT16_MAX);
+    for (uint32_t i = 0; i + SENSOR_RESULT_BYTES <= length; i += SENSOR_RESULT_BYTES)
+    {
+        const adc_digi_output_data_t *result = (const adc_digi_output_data_t *)&data[i];
+        if (result->type2.unit != 0)
+        {
+            continue;
+        }
+
+        // Few channels: a linear search beats a lookup table here
+        uint8_t c = 0;
+        while (c < channelCount && adcChannels[c] != result->type2.channel)
+        {
+            c++;
+        }
+        if (c == channelCount)
+        {
+            continue;
+        }
+
+        uint16_t value = result->type2.data;
+        Accumulator &a = accumulators[c];
+        if (a.count == 0 || value < a.min)
+        {
+            a.min = value;
+        }
+        if (a.count == 0 || value > a.max)
+        {
+            a.max = value;
+        }
+        a.count++;
+        a.sum += value;
+        a.sumSquares += (uint32_t)value * value;
+
+        const SensorThreshold &t = active.thresholds[c];
+        if (!t.enabled)
+        {
+            continue;
+        }
+        bool crossed = a.above ? value <= t.low : value >= t.high;
+        if (crossed)
+        {
+            a.above = !a.above;
+            if (window.eventCount < SENSOR_MAX_EVENTS)
+            {
+                window.events[window.eventCount++] = SensorEvent{c, a.above, value, offsetMs};
+            }
+            else
+            {
+                window.eventsMissed++;
+            }
+        }
+    }
+}
+
+void AdcSampler::_closeWindow(uint32_t now)
+{
+    window.durationMs = now - window.startMs;
+    window.channelCount = channelCount;
+    for (uint8_t c = 0; c < channelCount; c++)
+    {
+        Accumulator &a = accumulators[c];
+        SensorSummary &s = window.channels[c];
+        s.count = a.count;
+        s.min = a.min;
+        s.max = a.max;
+        s.mean = a.count ? (uint16_t)(a.sum / a.count) : 0;
+        s.rms = a.count ? (uint16_t)sqrtf((float)a.sumSquares / a.count) : 0;
+
+        // The threshold state carries over into the next window
+        bool above = a.above;
+        a = Accumulator{};
+        a.above = above;
+    }
+    windows.push(window);
+    NetworkEvents::wake();
+
+    window.startMs = now;
+    window.eventCount = 0;
+    window.eventsMissed = 0;
+    window.overruns = 0;
+}
+
+// The ADC controller has a minimum total rate, shared by the channels
+// actually sampled; below it every channel would quietly be sampled faster
+// than configured, so the configured or requested rate is raised instead
+uint32_t AdcSampler::_clampRate(uint32_t sampleHz)
+{
+    uint32_t minHz = (SOC_ADC_SAMPLE_FREQ_THRES_LOW + channelCount - 1) / channelCount;
+    uint32_t rate = constrain(sampleHz, max(minHz, (uint32_t)SENSOR_MIN_SAMPLE_HZ), (uint32_t)SENSOR_MAX_SAMPLE_HZ);
+    if (rate != sampleHz)
+    {
+        LOG_WARN("⚠️ Sample rate %luHz is out of range for %u channels, using %luHz", (unsigned long)sampleHz,
+                 (unsigned)channelCount, (unsigned long)rate);
+    }
+    return rate;
+}
+
+bool AdcSampler::_startDma(uint32_t sampleHz)
+{
+    adc_digi_init_config_t init = {};
+    init.max_store_buf_size = SENSOR_DMA_BUFFER_BYTES;
+    init.conv_num_each_intr = SENSOR_DMA_FRAME_BYTES;
+    for (uint8_t c = 0; c < channelCount; c++)
+    {
+        init.adc1_chan_mask |= BIT(adcChannels[c]);
+    }
+    if (adc_digi_initialize(&init) != ESP_OK)
+    {
+        LOG_ERROR("❌ ADC DMA init failed");
+        return false;
+    }
+
+    // One pattern entry per channel; the conversion rate is shared by all of them
+    adc_digi_pattern_config_t pattern[SENSOR_MAX_CHANNELS] = {};
+    for (uint8_t c = 0; c < channelCount; c++)
+    {
+        pattern[c].atten = ADC_ATTEN_DB_11;
+        pattern[c].channel = adcChannels[c];
+        pattern[c].unit = 0;
+        pattern[c].bit_width = SOC_ADC_DIGI_MAX_BITWIDTH;
+    }
+
+    adc_digi_configuration_t config = {};
+    config.conv_limit_en = false;
+    config.conv_limit_num = 250;
+    config.pattern_num = channelCount;
+    config.adc_pattern = pattern;
+    // _clampRate() keeps the total at or above the controller's minimum
+    config.sample_freq_hz = min(sampleHz * channelCount, (uint32_t)SOC_ADC_SAMPLE_FREQ_THRES_HIGH);
+    config.conv_mode = ADC_CONV_SINGLE_UNIT_1;
+    config.format = ADC_DIGI_OUTPUT_FORMAT_TYPE2;
+
+    if (adc_digi_controller_configure(&config) != ESP_OK || adc_digi_start() != ESP_OK)
+    {
+        LOG_ERROR("❌ ADC DMA start failed");
+        adc_digi_deinitialize();
+        return false;
+    }
+    dmaRunning = true;
+    return true;
+}
+
+void AdcSampler::_stopDma()
+{
+    if (!dmaRunning)
+    {
+        return;
+    }
+    adc_digi_stop();
+    adc_digi_deinitialize();
+    dmaRunning = false;
+}
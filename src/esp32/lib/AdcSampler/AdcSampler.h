@@ -0,0 +1,179 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "SpscRing.h"
+#include "Logger.h"
+
+// Analog inputs sampled together, each an ADC1 pin
+#ifndef SENSOR_MAX_CHANNELS
+#define SENSOR_MAX_CHANNELS 4
+#endif
+
+// Bytes the DMA hands over per interrupt (4 bytes per conversion)
+#ifndef SENSOR_DMA_FRAME_BYTES
+#define SENSOR_DMA_FRAME_BYTES 256
+#endif
+
+// Driver-side buffer between DMA and the sampler task
+#ifndef SENSOR_DMA_BUFFER_BYTES
+#define SENSOR_DMA_BUFFER_BYTES 2048
+#endif
+
+// Threshold crossings kept per window; later ones are only counted
+#ifndef SENSOR_MAX_EVENTS
+#define SENSOR_MAX_EVENTS 8
+#endif
+
+// Finished windows waiting for the network task; the oldest is dropped when full
+#ifndef SENSOR_WINDOW_QUEUE
+#define SENSOR_WINDOW_QUEUE 4
+#endif
+
+// Sampler task placement; it only drains DMA frames and adds them up
+#ifndef SENSOR_TASK_CORE
+#define SENSOR_TASK_CORE 1
+#endif
+#ifndef SENSOR_TASK_PRIORITY
+#define SENSOR_TASK_PRIORITY 2
+#endif
+
+// Accepted rates, per channel, and window lengths
+#define SENSOR_MIN_SAMPLE_HZ 10
+#define SENSOR_MAX_SAMPLE_HZ 20000
+#define SENSOR_MIN_WINDOW_MS 100
+#define SENSOR_MAX_WINDOW_MS 60000
+
+// Aggregate of one channel over one window, in raw 12-bit counts
+struct SensorSummary
+{
+    uint32_t count;
+    uint16_t min;
+    uint16_t max;
+    uint16_t mean;
+    uint16_t rms;
+};
+
+// A threshold crossing
+struct SensorEvent
+{
+    uint8_t channel;
+    bool rising;     // crossed the high mark upwards, or else the low mark downwards
+    uint16_t value;
+    uint16_t offsetMs; // from the window start, to DMA frame resolution
+};
+
+// One finished window: everything published for it
+struct SensorWindow
+{
+    uint32_t startMs;
+    uint32_t durationMs;
+    uint8_t channelCount;
+    uint8_t eventCount;
+    uint16_t eventsMissed; // crossings beyond SENSOR_MAX_EVENTS
+    uint32_t overruns;     // times the DMA buffer overflowed during the window
+    SensorSummary channels[SENSOR_MAX_CHANNELS];
+    SensorEvent events[SENSOR_MAX_EVENTS];
+};
+
+// Threshold with hysteresis: rising at >= high, falling again at <= low
+struct SensorThreshold
+{
+    bool enabled;
+    uint16_t high;
+    uint16_t low;
+};
+
+// Samples up to SENSOR_MAX_CHANNELS analog inputs with the ADC's continuous
+// (DMA) mode, so the CPU never waits on a conversion. A sampler task drains
+// the DMA frames and folds every sample into per-channel accumulators
+// (min/max/sum/sum of squares) and threshold state; nothing per sample is
+// stored. At the end of each window the summary goes into a fixed ring, and
+// the network task publishes it as one message per window.
+//
+// Settings change from any task; the sampler picks them up between frames
+// and restarts the DMA only when the rate changes.
+class AdcSampler
+{
+public:
+    /**
+     * Set up the channels, start the sampler task and begin sampling
+     * @param pins ADC1-capable GPIOs
+     * @return false if no pin could be used
+     */
+    static bool begin(const int *pins, uint8_t count, uint32_t sampleHz, uint32_t windowMs);
+
+    static void start();
+    static void stop();
+
+    /**
+     * @param sampleHz Samples per second on each channel, raised (with a warning)
+     *                 to the ADC controller's minimum shared by all channels
+     * @param windowMs Aggregation window, also the publish interval
+     */
+    static void setRate(uint32_t sampleHz, uint32_t windowMs);
+
+    static void setThreshold(uint8_t channel, uint16_t high, uint16_t low);
+    static void clearThreshold(uint8_t channel);
+
+    /**
+     * Publish finished windows; call from the network task while MQTT is connected
+     */
+    static void loop();
+
+    static bool isRunning() { return settings.running; }
+    static uint32_t getSampleHz() { return settings.sampleHz; }
+    static uint32_t getWindowMs() { return settings.windowMs; }
+    static uint8_t getChannelCount() { return channelCount; }
+    static int getPin(uint8_t channel) { return pins[channel]; }
+
+    /**
+     * Write a window as JSON
+     * @return Bytes written, 0 if the buffer is too small
+     */
+    static size_t serialize(const SensorWindow &window, char *buffer, size_t size);
+
+private:
+    struct Settings
+    {
+        bool running;
+        uint32_t sampleHz;
+        uint32_t windowMs;
+        SensorThreshold thresholds[SENSOR_MAX_CHANNELS];
+    };
+
+    struct Accumulator
+    {
+        uint32_t count;
+        uint16_t min;
+        uint16_t max;
+        uint64_t sum;
+        uint64_t sumSquares;
+        bool above;
+    };
+
+    static void _task(void *arg);
+    static void _changed();
+    static uint32_t _clampRate(uint32_t sampleHz);
+    static bool _startDma(uint32_t sampleHz);
+    static void _stopDma();
+    static void _add(const uint8_t *data, uint32_t length, uint32_t now);
+    static void _closeWindow(uint32_t now);
+
+    static int pins[SENSOR_MAX_CHANNELS];
+    static uint8_t adcChannels[SENSOR_MAX_CHANNELS];
+    static uint8_t channelCount;
+    static Settings settings; // written under the lock, from any task
+    static portMUX_TYPE lock;
+    static TaskHandle_t task;
+    static volatile uint32_t settingsVersion;
+
+    // Sampler task only
+    static Settings active;
+    static Accumulator accumulators[SENSOR_MAX_CHANNELS];
+    static SensorWindow window;
+    static bool dmaRunning;
+
+    static SpscRing<SensorWindow, SENSOR_WINDOW_QUEUE> windows;
+};
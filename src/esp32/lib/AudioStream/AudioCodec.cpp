@@ -0,0 +1,106 @@
+#include "AudioCodec.h"
+
+static const int16_t stepTable[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int8_t indexTable[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+bool audioParseChunk(const uint8_t *payload, size_t length, AudioChunk &chunk)
+{
+    if (length < AUDIO_CHUNK_HEADER_SIZE || payload[0] != 'A' || payload[1] != 'U' ||
+        payload[2] >= (uint8_t)AudioFormat::Count || payload[3] > 88)
+    {
+        return false;
+    }
+    chunk.format = (AudioFormat)payload[2];
+    chunk.stepIndex = payload[3];
+    chunk.seq = payload[4] | (payload[5] << 8);
+    chunk.predictor = (int16_t)(payload[6] | (payload[7] << 8));
+    chunk.data = payload + AUDIO_CHUNK_HEADER_SIZE;
+    chunk.length = length - AUDIO_CHUNK_HEADER_SIZE;
+    return chunk.format != AudioFormat::Pcm16 || chunk.length % 2 == 0;
+}
+
+size_t audioSampleCount(const AudioChunk &chunk)
+{
+    switch (chunk.format)
+    {
+    case AudioFormat::Pcm8:
+        return chunk.length;
+    case AudioFormat::Pcm16:
+        return chunk.length / 2;
+    case AudioFormat::ImaAdpcm:
+        return chunk.length * 2;
+    default:
+        return 0;
+    }
+}
+
+void AudioDecoder::begin(const AudioChunk &chunk)
+{
+    _chunk = chunk;
+    _sample = 0;
+    _count = audioSampleCount(chunk);
+    _predictor = chunk.predictor;
+    _stepIndex = chunk.stepIndex;
+}
+
+size_t AudioDecoder::decode(int16_t *out, size_t capacity)
+{
+    size_t n = 0;
+    const uint8_t *data = _chunk.data;
+    while (n < capacity && _sample < _count)
+    {
+        switch (_chunk.format)
+        {
+        case AudioFormat::Pcm8:
+            out[n] = (int16_t)((data[_sample] - 128) << 8);
+            break;
+        case AudioFormat::Pcm16:
+            out[n] = (int16_t)(data[2 * _sample] | (data[2 * _sample + 1] << 8));
+            break;
+        default:
+            out[n] = _adpcm(_sample & 1 ? data[_sample / 2] >> 4 : data[_sample / 2] & 0x0f);
+            break;
+        }
+        n++;
+        _sample++;
+    }
+    return n;
+}
+
+int16_t AudioDecoder::_adpcm(uint8_t nibble)
+{
+    int32_t step = stepTable[_stepIndex];
+    int32_t delta = step >> 3;
+    if (nibble & 4)
+    {
+        delta += step;
+    }
+    if (nibble & 2)
+    {
+        delta += step >> 1;
+    }
+    if (nibble & 1)
+    {
+        delta += step >> 2;
+    }
+    _predictor += nibble & 8 ? -delta : delta;
+    if (_predictor > INT16_MAX)
+    {
+        _predictor = INT16_MAX;
+    }
+    else if (_predictor < INT16_MIN)
+    {
+        _predictor = INT16_MIN;
+    }
+
+    int index = _stepIndex + indexTable[nibble & 7];
+    _stepIndex = index < 0 ? 0 : index > 88 ? 88 : index;
+    return (int16_t)_predictor;
+}
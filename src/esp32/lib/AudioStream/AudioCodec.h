@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Chunk header: "AU", format, ADPCM step index, sequence number (u16 LE),
+// ADPCM predictor (i16 LE); the samples follow
+#define AUDIO_CHUNK_HEADER_SIZE 8
+
+// Sample encodings a chunk can carry
+enum class AudioFormat : uint8_t
+{
+    Pcm8,     // unsigned 8-bit
+    Pcm16,    // signed 16-bit, little-endian
+    ImaAdpcm, // 4-bit IMA ADPCM, low nibble first
+    Count
+};
+
+struct AudioChunk
+{
+    AudioFormat format;
+    uint16_t seq;
+    int16_t predictor; // ADPCM decoder state at the first sample
+    uint8_t stepIndex;
+    const uint8_t *data;
+    size_t length;
+};
+
+/**
+ * Split a streamed chunk into header and samples
+ * @return false if the magic, format or length is wrong
+ */
+bool audioParseChunk(const uint8_t *payload, size_t length, AudioChunk &chunk);
+
+/**
+ * @return Number of samples the chunk decodes to
+ */
+size_t audioSampleCount(const AudioChunk &chunk);
+
+// Decodes a chunk piece by piece into 16-bit samples. Every ADPCM chunk
+// carries its own decoder state, so a lost chunk costs only its own samples.
+// Plain C++, so it runs the same on the ESP32 and on a host.
+class AudioDecoder
+{
+public:
+    void begin(const AudioChunk &chunk);
+
+    /**
+     * Decode the next samples of the chunk
+     * @return Samples written to out, 0 once the chunk is done
+     */
+    size_t decode(int16_t *out, size_t capacity);
+
+private:
+    int16_t _adpcm(uint8_t nibble);
+
+    AudioChunk _chunk = {};
+    size_t _sample = 0; // next sample of the chunk
+    size_t _count = 0;
+    int32_t _predictor = 0;
+    uint8_t _stepIndex = 0;
+};
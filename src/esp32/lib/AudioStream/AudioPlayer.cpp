@@ -0,0 +1,257 @@
+#include "AudioPlayer.h"
+#include <driver/i2s.h>
+#include "DeviceState.h"
+
+// Samples decoded per jitter buffer write
+#define AUDIO_DECODE_BLOCK 128
+
+int AudioPlayer::pin = -1;
+TaskHandle_t AudioPlayer::task = nullptr;
+volatile bool AudioPlayer::requested = false;
+volatile uint32_t AudioPlayer::rate = 8000;
+volatile uint32_t AudioPlayer::generation = 0;
+volatile bool AudioPlayer::stopPending = false;
+volatile uint32_t AudioPlayer::stopPosition = 0;
+volatile bool AudioPlayer::releasePending = false;
+volatile uint32_t AudioPlayer::releaseGeneration = 0;
+volatile uint32_t AudioPlayer::endedGeneration = 0;
+volatile bool AudioPlayer::outputOn = false;
+volatile bool AudioPlayer::pinTaken = false;
+AudioDecoder AudioPlayer::decoder;
+uint16_t AudioPlayer::nextSeq = 0;
+volatile uint32_t AudioPlayer::chunks = 0;
+volatile uint32_t AudioPlayer::lost = 0;
+volatile uint32_t AudioPlayer::invalid = 0;
+JitterBuffer<AUDIO_BUFFER_SAMPLES> AudioPlayer::buffer;
+
+void AudioPlayer::begin(int buzzerPin)
+{
+    pin = buzzerPin;
+    if (pin >= 0 && !task)
+    {
+        xTaskCreatePinnedToCore(_task, "audio", 3072, nullptr, AUDIO_TASK_PRIORITY, &task, AUDIO_TASK_CORE);
+    }
+}
+
+bool AudioPlayer::start(uint32_t sampleRate, uint32_t prefillMs)
+{
+    if (!task || sampleRate < AUDIO_MIN_RATE || sampleRate > AUDIO_MAX_RATE)
+    {
+        LOG_ERROR("❌ Audio: cannot start a %luHz stream", (unsigned long)sampleRate);
+        return false;
+    }
+
+    // Whatever an earlier stream left is dropped; this one starts clean
+    _requestStop();
+    buffer.setPrefill(min((uint64_t)sampleRate * prefillMs / 1000, (uint64_t)AUDIO_BUFFER_SAMPLES / 2));
+    rate = sampleRate;
+    nextSeq = 0;
+    generation = generation + 1;
+    requested = true;
+    xTaskNotifyGive(task);
+    DeviceState::notify();
+    LOG_INFO("🔊 Audio stream started: %luHz, %lums prefill", (unsigned long)sampleRate, (unsigned long)prefillMs);
+    return true;
+}
+
+void AudioPlayer::finish()
+{
+    buffer.finish();
+}
+
+void AudioPlayer::stop()
+{
+    _requestStop();
+    requested = false;
+    if (task)
+    {
+        xTaskNotifyGive(task);
+    }
+    DeviceState::notify();
+}
+
+void AudioPlayer::_requestStop()
+{
+    stopPosition = buffer.writePosition();
+    stopPending = true;
+}
+
+void AudioPlayer::feed(const uint8_t *payload, size_t length)
+{
+    AudioChunk chunk;
+    if (!isActive() || !audioParseChunk(payload, length, chunk))
+    {
+        invalid = invalid + 1;
+        return;
+    }
+
+    // Chunks behind the expected one are late duplicates; gaps ahead are losses
+    int16_t ahead = (int16_t)(chunk.seq - nextSeq);
+    if (ahead < 0)
+    {
+        invalid = invalid + 1;
+        return;
+    }
+    lost = lost + ahead;
+    nextSeq = chunk.seq + 1;
+    chunks = chunks + 1;
+
+    // A chunk that does not fit is dropped whole rather than cut short
+    if (!buffer.reserve(audioSampleCount(chunk)))
+    {
+        return;
+    }
+    int16_t block[AUDIO_DECODE_BLOCK];
+    decoder.begin(chunk);
+    size_t n;
+    while ((n = decoder.decode(block, AUDIO_DECODE_BLOCK)) > 0)
+    {
+        buffer.write(block, n);
+    }
+}
+
+bool AudioPlayer::release()
+{
+    if (!pinTaken)
+    {
+        return false;
+    }
+    // Only words are written here; the buffer and the stream state stay with
+    // the network and player tasks, which is what makes this safe from any task
+    pinTaken = false;
+    releaseGeneration = generation;
+    releasePending = true;
+    xTaskNotifyGive(task);
+    return true;
+}
+
+AudioStats AudioPlayer::getStats()
+{
+    return AudioStats{chunks, buffer.underruns(), buffer.overruns(), lost, invalid};
+}
+
+void AudioPlayer::_task(void *arg)
+{
+    static int16_t frame[AUDIO_FRAME_SAMPLES];
+    uint32_t openRate = 0;
+    uint32_t lastSoundMs = 0;
+
+    while (true)
+    {
+        if (stopPending)
+        {
+            stopPending = false;
+            buffer.discardTo(stopPosition);
+        }
+
+        // A stream started after the release is left to play
+        if (releasePending)
+        {
+            releasePending = false;
+            if (releaseGeneration == generation && endedGeneration != releaseGeneration)
+            {
+                buffer.discardTo(buffer.writePosition());
+                endedGeneration = releaseGeneration;
+                DeviceState::notify();
+            }
+        }
+
+        uint32_t current = generation;
+        if (!requested || current == endedGeneration)
+        {
+            if (outputOn)
+            {
+                _close();
+            }
+            ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+            continue;
+        }
+
+        // Reopening also takes the pin back from LEDC after a release()
+        if (!outputOn || openRate != rate || !pinTaken)
+        {
+            _close();
+            openRate = rate;
+            if (!_open(openRate))
+            {
+                endedGeneration = current;
+                DeviceState::notify();
+                continue;
+            }
+            lastSoundMs = millis();
+        }
+
+        bool finishing = buffer.isFinishing();
+        size_t n = buffer.read(frame, AUDIO_FRAME_SAMPLES);
+        uint32_t now = millis();
+        if (n > 0)
+        {
+            lastSoundMs = now;
+        }
+        // A finished stream ends once it has run dry, an abandoned one after a timeout
+        bool over = (finishing && !buffer.isFinishing()) || (n == 0 && now - lastSoundMs >= AUDIO_IDLE_STOP_MS);
+
+        // Blocks until a DMA buffer is free, which paces the loop at the sample rate
+        size_t written;
+        i2s_write(AUDIO_I2S_PORT, frame, sizeof(frame), &written, portMAX_DELAY);
+
+        if (over)
+        {
+            // Queue silence behind the last samples so they play before I2S closes
+            memset(frame, 0, sizeof(frame));
+            for (int i = 0; i < AUDIO_DMA_BUFFERS; i++)
+            {
+                i2s_write(AUDIO_I2S_PORT, frame, sizeof(frame), &written, portMAX_DELAY);
+            }
+            endedGeneration = current;
+            DeviceState::notify();
+            LOG_DEBUG("🔊 Audio stream ended");
+        }
+    }
+}
+
+bool AudioPlayer::_open(uint32_t sampleRate)
+{
+    i2s_config_t config = {};
+    config.mode = (i2s_mode_t)(I2S_MODE_MASTER | I2S_MODE_TX | I2S_MODE_PDM);
+    config.sample_rate = sampleRate;
+    config.bits_per_sample = I2S_BITS_PER_SAMPLE_16BIT;
+    config.channel_format = I2S_CHANNEL_FMT_ONLY_LEFT;
+    config.communication_format = I2S_COMM_FORMAT_STAND_I2S;
+    config.dma_buf_count = AUDIO_DMA_BUFFERS;
+    config.dma_buf_len = AUDIO_FRAME_SAMPLES;
+    config.tx_desc_auto_clear = true; // silence, not a repeated buffer, if the player falls behind
+
+    // Only the data line is routed: the piezo needs no PDM clock
+    i2s_pin_config_t pins = {};
+    pins.mck_io_num = I2S_PIN_NO_CHANGE;
+    pins.bck_io_num = I2S_PIN_NO_CHANGE;
+    pins.ws_io_num = I2S_PIN_NO_CHANGE;
+    pins.data_out_num = pin;
+    pins.data_in_num = I2S_PIN_NO_CHANGE;
+
+    if (i2s_driver_install(AUDIO_I2S_PORT, &config, 0, nullptr) != ESP_OK)
+    {
+        LOG_ERROR("❌ Audio: I2S PDM output not available");
+        return false;
+    }
+    if (i2s_set_pin(AUDIO_I2S_PORT, &pins) != ESP_OK)
+    {
+        LOG_ERROR("❌ Audio: cannot route I2S to pin %d", pin);
+        i2s_driver_uninstall(AUDIO_I2S_PORT);
+        return false;
+    }
+    outputOn = true;
+    pinTaken = true;
+    return true;
+}
+
+void AudioPlayer::_close()
+{
+    if (!outputOn)
+    {
+        return;
+    }
+    i2s_driver_uninstall(AUDIO_I2S_PORT);
+    outputOn = false;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "AudioCodec.h"
+#include "JitterBuffer.h"
+#include "Logger.h"
+
+// Jitter buffer size in samples (power of two); 8192 holds ~1s at 8kHz
+#ifndef AUDIO_BUFFER_SAMPLES
+#define AUDIO_BUFFER_SAMPLES 8192
+#endif
+
+// Samples per I2S DMA buffer, also what the player moves per i2s_write()
+#ifndef AUDIO_FRAME_SAMPLES
+#define AUDIO_FRAME_SAMPLES 256
+#endif
+
+// DMA buffers queued ahead of the output
+#ifndef AUDIO_DMA_BUFFERS
+#define AUDIO_DMA_BUFFERS 4
+#endif
+
+// Audio a stream buffers before playing, unless start says otherwise
+#ifndef AUDIO_DEFAULT_PREFILL_MS
+#define AUDIO_DEFAULT_PREFILL_MS 200
+#endif
+
+// A stream that has had nothing to play for this long is over
+#ifndef AUDIO_IDLE_STOP_MS
+#define AUDIO_IDLE_STOP_MS 2000
+#endif
+
+#ifndef AUDIO_I2S_PORT
+#define AUDIO_I2S_PORT I2S_NUM_0
+#endif
+
+// Player task placement; above the actuator so a long command cannot starve the DMA
+#ifndef AUDIO_TASK_CORE
+#define AUDIO_TASK_CORE 1
+#endif
+#ifndef AUDIO_TASK_PRIORITY
+#define AUDIO_TASK_PRIORITY 4
+#endif
+
+#define AUDIO_MIN_RATE 4000
+#define AUDIO_MAX_RATE 16000
+
+// Stream counters, cumulative since boot
+struct AudioStats
+{
+    uint32_t chunks;    // chunks accepted
+    uint32_t underruns; // the buffer ran dry mid-stream
+    uint32_t overruns;  // chunks dropped for lack of room
+    uint32_t lost;      // chunks missing from the sequence
+    uint32_t invalid;   // malformed chunks, or chunks with no stream started
+};
+
+// Plays streamed audio on the buzzer pin. Chunks (see AudioCodec.h) are
+// decoded on the network task into a JitterBuffer; a player task drains it
+// into I2S DMA buffers in PDM mode, so the pin carries a 1-bit
+// pulse-density stream that the piezo filters into the waveform. The DMA
+// paces playback, and the CPU touches each sample once per frame rather
+// than once per sample in an interrupt.
+//
+// start(), finish(), stop() and feed() belong to the network task. The
+// player takes the pin from LEDC when it starts; release() hands it back
+// from any task without waiting for the player.
+class AudioPlayer
+{
+public:
+    /**
+     * Start the player task
+     * @param pin Buzzer GPIO
+     */
+    static void begin(int pin);
+
+    /**
+     * Start a stream, replacing one that is playing; network task only
+     * @param rate Samples per second, AUDIO_MIN_RATE to AUDIO_MAX_RATE
+     * @param prefillMs Audio buffered before playback starts and after an underrun
+     */
+    static bool start(uint32_t rate, uint32_t prefillMs);
+
+    /**
+     * Play out what is buffered, then end the stream; network task only
+     */
+    static void finish();
+
+    /**
+     * End the stream now, dropping what is buffered; network task only
+     */
+    static void stop();
+
+    /**
+     * Decode one chunk into the jitter buffer; network task only
+     */
+    static void feed(const uint8_t *payload, size_t length);
+
+    /**
+     * End the stream from any task, without blocking: the player task drops
+     * what is buffered and closes I2S within a frame. The caller can route
+     * the pin back to LEDC at once; the GPIO matrix gives the pin to the last
+     * peripheral attached, and closing I2S leaves the routing alone
+     * @return true if the player had taken the pin since the last release()
+     */
+    static bool release();
+
+    /**
+     * @return true while a stream is started and not over
+     */
+    static bool isActive() { return requested && generation != endedGeneration; }
+
+    static uint32_t getRate() { return rate; }
+
+    static AudioStats getStats();
+
+private:
+    static void _task(void *arg);
+    static bool _open(uint32_t sampleRate);
+    static void _close();
+    static void _requestStop();
+
+    static int pin;
+    static TaskHandle_t task;
+
+    // Set by the controlling task, read by the player
+    static volatile bool requested;
+    static volatile uint32_t rate;
+    static volatile uint32_t generation;    // bumped by every start()
+    static volatile bool stopPending;
+    static volatile uint32_t stopPosition; // samples written before the stop are dropped
+
+    // Set by release(), from any task
+    static volatile bool releasePending;
+    static volatile uint32_t releaseGeneration; // stream to end
+
+    // Set by the player
+    static volatile uint32_t endedGeneration; // stream that ran out or finished
+    static volatile bool outputOn;
+    static volatile bool pinTaken;
+
+    // Network task only
+    static AudioDecoder decoder;
+    static uint16_t nextSeq;
+    static volatile uint32_t chunks;
+    static volatile uint32_t lost;
+    static volatile uint32_t invalid;
+
+    static JitterBuffer<AUDIO_BUFFER_SAMPLES> buffer;
+};
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Fixed-size sample ring between a producer that receives audio in bursts
+// (the network task) and a consumer that plays it at a steady rate.
+// Playback only starts once `prefill` samples are queued, and after an
+// underrun it waits for the prefill again, so network jitter up to the
+// prefill time is absorbed instead of heard as a stream of dropouts.
+// A write that does not fit is dropped whole (an overrun): the consumer's
+// position is never touched by the producer, which keeps it lock-free.
+// Plain C++ (std::atomic only), so it runs the same on the ESP32 and on a host.
+template <size_t N>
+class JitterBuffer
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "JitterBuffer size must be a power of two");
+
+public:
+    // Consumer side, or while the consumer is stopped
+    void setPrefill(size_t samples) { prefill.store(samples < N ? samples : N, std::memory_order_relaxed); }
+
+    // Producer side: whether `count` more samples fit; if not, that is an overrun
+    bool reserve(size_t count)
+    {
+        if (count > N - size())
+        {
+            overrunCount.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Producer side; returns false if the samples were dropped
+    bool write(const int16_t *samples, size_t count)
+    {
+        if (!reserve(count))
+        {
+            return false;
+        }
+        uint32_t h = head.load(std::memory_order_relaxed);
+        for (size_t i = 0; i < count; i++)
+        {
+            slots[(h + i) & (N - 1)] = samples[i];
+        }
+        head.store(h + count, std::memory_order_release);
+        return true;
+    }
+
+    // Producer side: nothing more follows, so play out what is queued without
+    // waiting for the prefill; running dry then is the end, not an underrun
+    void finish() { finishing.store(true, std::memory_order_release); }
+
+    // Producer side: position of the next write, for discardTo()
+    uint32_t writePosition() const { return head.load(std::memory_order_relaxed); }
+
+    // Consumer side: fills `out` completely, with silence where there is
+    // nothing to play; returns the number of real samples
+    size_t read(int16_t *out, size_t count)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        bool last = finishing.load(std::memory_order_acquire);
+        size_t queued = head.load(std::memory_order_acquire) - t;
+        if (!playing)
+        {
+            if (queued == 0 || (queued < prefill.load(std::memory_order_relaxed) && !last))
+            {
+                if (queued == 0 && last)
+                {
+                    finishing.store(false, std::memory_order_relaxed);
+                }
+                memset(out, 0, count * sizeof(int16_t));
+                return 0;
+            }
+            playing = true;
+        }
+
+        size_t n = queued < count ? queued : count;
+        for (size_t i = 0; i < n; i++)
+        {
+            out[i] = slots[(t + i) & (N - 1)];
+        }
+        tail.store(t + n, std::memory_order_release);
+        if (n < count)
+        {
+            memset(out + n, 0, (count - n) * sizeof(int16_t));
+            if (last)
+            {
+                finishing.store(false, std::memory_order_relaxed);
+            }
+            else
+            {
+                underrunCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            playing = false;
+        }
+        return n;
+    }
+
+    // Consumer side: drop everything written before `position`
+    void discardTo(uint32_t position)
+    {
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        if ((int32_t)(position - t) > 0)
+        {
+            tail.store(position, std::memory_order_release);
+        }
+        finishing.store(false, std::memory_order_relaxed);
+        playing = false;
+    }
+
+    // Queued samples (approximate while the other side is running)
+    size_t size() const { return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire); }
+
+    static constexpr size_t capacity() { return N; }
+
+    bool isPlaying() const { return playing; }
+    bool isFinishing() const { return finishing.load(std::memory_order_acquire); }
+    uint32_t underruns() const { return underrunCount.load(std::memory_order_relaxed); }
+    uint32_t overruns() const { return overrunCount.load(std::memory_order_relaxed); }
+
+private:
+    int16_t slots[N];
+    std::atomic<uint32_t> head{0}; // next sample to write, only advanced by the producer
+    std::atomic<uint32_t> tail{0}; // next sample to read, only advanced by the consumer
+    std::atomic<size_t> prefill{0};
+    std::atomic<uint32_t> underrunCount{0};
+    std::atomic<uint32_t> overrunCount{0};
+    std::atomic<bool> finishing{false};
+    bool playing = false; // consumer only
+};
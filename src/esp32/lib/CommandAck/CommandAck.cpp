@@ -0,0 +1,255 @@
+#include "CommandAck.h"
+#include "ConfigLoader.h"
+#include "DeviceClock.h"
+#include "MQTTClient.h"
+
+CommandAck::Slot CommandAck::slots[ACK_SLOTS] = {};
+SpscRing<CommandAck::Outcome, 32> CommandAck::outcomes;
+CommandAck::Entry CommandAck::history[ACK_HISTORY] = {};
+uint8_t CommandAck::historyHead = 0;
+uint8_t CommandAck::historyCount = 0;
+uint16_t CommandAck::generation = 0;
+uint16_t CommandAck::handlerAck = 0;
+bool CommandAck::adopted = false;
+bool CommandAck::dirty = false;
+CommandAckStats CommandAck::stats = {};
+CommandAck::AckDocument CommandAck::doc;
+char CommandAck::payload[ACK_PAYLOAD_SIZE];
+
+static_assert(ACK_SLOTS * 2 <= 0xFFFF, "handles carry a generation above the slot index");
+static_assert(ACK_MAX_WAIT_MS >= ACK_TIMEOUT_MS && ACK_MAX_WAIT_MS <= 60UL * 60 * 1000,
+              "slot timeouts are measured in micros()");
+
+uint16_t CommandAck::open(JsonVariantConst id, uint32_t rxUs)
+{
+    if (ConfigLoader::getConfig().ack_topic[0] == '\0')
+    {
+        return 0;
+    }
+
+    for (uint16_t i = 0; i < ACK_SLOTS; i++)
+    {
+        Slot &slot = slots[i];
+        if (slot.handle)
+        {
+            continue;
+        }
+        // The id is kept as JSON text, so it is echoed back with its type
+        size_t length = measureJson(id);
+        if (length >= sizeof(slot.id))
+        {
+            stats.untracked++;
+            return 0;
+        }
+        serializeJson(id, slot.id, sizeof(slot.id));
+
+        // A generation above the index, so a late outcome for a slot that
+        // expired and was reused is recognized and ignored
+        if (++generation >= 0xFFFF / ACK_SLOTS)
+        {
+            generation = 1;
+        }
+        slot.handle = generation * ACK_SLOTS + i;
+        slot.pending = 1;
+        slot.timeoutMs = ACK_TIMEOUT_MS;
+        slot.status = CommandStatus::Ok;
+        slot.rxUs = rxUs;
+        slot.startUs = 0;
+        slot.runUs = 0;
+        return slot.handle;
+    }
+    stats.untracked++;
+    return 0;
+}
+
+void CommandAck::expect(uint16_t ack)
+{
+    Slot &slot = slots[ack % ACK_SLOTS];
+    if (ack && slot.handle == ack)
+    {
+        slot.pending++;
+    }
+}
+
+void CommandAck::complete(uint16_t ack, CommandStatus status, uint32_t startUs, uint32_t runUs)
+{
+    if (!ack)
+    {
+        return;
+    }
+    // A lost outcome only delays the ack until it expires
+    outcomes.push(Outcome{ack, status, startUs, runUs});
+    NetworkEvents::wake();
+}
+
+void CommandAck::record(uint16_t ack, CommandStatus status, uint32_t startUs, uint32_t runUs)
+{
+    if (ack)
+    {
+        _apply(Outcome{ack, status, startUs, runUs});
+    }
+}
+
+void CommandAck::beginHandler(uint16_t ack)
+{
+    handlerAck = ack;
+    adopted = false;
+}
+
+bool CommandAck::endHandler()
+{
+    handlerAck = 0;
+    return adopted;
+}
+
+uint16_t CommandAck::adopt(uint32_t aheadMs)
+{
+    Slot &slot = slots[handlerAck % ACK_SLOTS];
+    if (!handlerAck || slot.handle != handlerAck || aheadMs > ACK_MAX_WAIT_MS - ACK_TIMEOUT_MS)
+    {
+        return 0;
+    }
+    // Time enough for the last command to come due, then the usual margin
+    slot.timeoutMs = max(slot.timeoutMs, aheadMs + ACK_TIMEOUT_MS);
+    adopted = true;
+    return handlerAck;
+}
+
+void CommandAck::_apply(const Outcome &outcome)
+{
+    Slot &slot = slots[outcome.ack % ACK_SLOTS];
+    if (slot.handle != outcome.ack)
+    {
+        return;
+    }
+    // The first failure is the one reported
+    if (slot.status == CommandStatus::Ok)
+    {
+        slot.status = outcome.status;
+    }
+    if (outcome.startUs)
+    {
+        if (!slot.startUs)
+        {
+            slot.startUs = outcome.startUs;
+        }
+        slot.runUs += outcome.runUs;
+    }
+    if (--slot.pending == 0)
+    {
+        _finish(slot);
+    }
+}
+
+// Turn a slot into a history entry; device times become epoch times here, from one clock reading
+void CommandAck::_finish(Slot &slot)
+{
+    Entry &entry = history[historyHead];
+    historyHead = (historyHead + 1) % ACK_HISTORY;
+    if (historyCount < ACK_HISTORY)
+    {
+        historyCount++;
+    }
+
+    memcpy(entry.id, slot.id, sizeof(entry.id));
+    entry.status = slot.status;
+    entry.ran = slot.startUs != 0;
+    entry.queueUs = entry.ran ? slot.startUs - slot.rxUs : 0;
+    entry.runUs = slot.runUs;
+
+    uint64_t nowMs = DeviceClock::epochMs();
+    uint32_t nowUs = micros();
+    entry.rxMs = nowMs ? nowMs - (nowUs - slot.rxUs) / 1000 : 0;
+    entry.startMs = nowMs && entry.ran ? nowMs - (nowUs - slot.startUs) / 1000 : 0;
+
+    slot.handle = 0;
+    stats.acked++;
+    dirty = true;
+}
+
+void CommandAck::loop()
+{
+    Outcome outcome;
+    while (outcomes.pop(outcome))
+    {
+        _apply(outcome);
+    }
+
+    uint32_t nowUs = micros();
+    for (Slot &slot : slots)
+    {
+        if (slot.handle && nowUs - slot.rxUs >= slot.timeoutMs * 1000u)
+        {
+            if (slot.status == CommandStatus::Ok)
+            {
+                slot.status = CommandStatus::Dropped;
+            }
+            stats.expired++;
+            _finish(slot);
+        }
+    }
+
+    if (!dirty)
+    {
+        return;
+    }
+
+    size_t length = serialize(payload, sizeof(payload));
+    if (length == 0)
+    {
+        LOG_WARN("⚠️ Ack document too large, not published");
+        dirty = false;
+        return;
+    }
+
+    char topic[CONFIG_STRING_SIZE + 32];
+    snprintf(topic, sizeof(topic), "%s/%s", ConfigLoader::getConfig().ack_topic, MQTTClient::getClientId());
+    if (!MQTTClient::getMQTTClient().publish(topic, (const uint8_t *)payload, length, true))
+    {
+        LOG_WARN("⚠️ Ack publish failed");
+        return;
+    }
+    dirty = false;
+    stats.published++;
+}
+
+size_t CommandAck::serialize(char *buffer, size_t size)
+{
+    doc.clear();
+    JsonArray acks = doc.createNestedArray("acks");
+    size_t length = measureJson(doc);
+    for (uint8_t i = 1; i <= historyCount; i++)
+    {
+        const Entry &entry = history[(historyHead + ACK_HISTORY - i) % ACK_HISTORY];
+        JsonObject ack = acks.createNestedObject();
+        ack["id"] = serialized((const char *)entry.id);
+        ack["status"] = (uint8_t)entry.status;
+        if (entry.rxMs)
+        {
+            ack["rx"] = entry.rxMs;
+        }
+        if (entry.ran)
+        {
+            if (entry.startMs)
+            {
+                ack["act"] = entry.startMs;
+            }
+            ack["queue_us"] = entry.queueUs;
+            ack["run_us"] = entry.runUs;
+        }
+
+        // The oldest acks give way when the document would not fit
+        length += measureJson(ack) + (i > 1);
+        if (length >= size)
+        {
+            acks.remove(acks.size() - 1);
+            break;
+        }
+    }
+
+    if (doc.overflowed() || measureJson(doc) >= size)
+    {
+        return 0;
+    }
+    return serializeJson(doc, buffer, size);
+}
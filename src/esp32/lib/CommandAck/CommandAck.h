@@ -0,0 +1,175 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "TopicHandler.h"
+#include "SpscRing.h"
+#include "NetworkEvents.h"
+#include "Logger.h"
+
+// Messages that can be waiting for their outcome at once
+#ifndef ACK_SLOTS
+#define ACK_SLOTS 16
+#endif
+
+// Finished acks kept in the retained document, newest first. A client that
+// polls the document misses an ack once more than this many finish between
+// two of its reads, so keep it well above the command rate times the poll period
+#ifndef ACK_HISTORY
+#define ACK_HISTORY 32
+#endif
+
+// A message whose commands have not all reported by then is acked as dropped;
+// a command lost to a full queue never reports
+#ifndef ACK_TIMEOUT_MS
+#define ACK_TIMEOUT_MS 10000
+#endif
+
+// Longest a message whose commands are scheduled ahead can wait for its ack;
+// micros() wraps after 71 minutes
+#ifndef ACK_MAX_WAIT_MS
+#define ACK_MAX_WAIT_MS (5UL * 60 * 1000)
+#endif
+
+// Longest "id" that is acked, as JSON text (a string's quotes included)
+#ifndef ACK_ID_SIZE
+#define ACK_ID_SIZE 48
+#endif
+
+// Size of the serialized ack document; it must fit the MQTT packet buffer,
+// and the oldest acks are left out when they do not fit
+#ifndef ACK_PAYLOAD_SIZE
+#define ACK_PAYLOAD_SIZE 3584
+#endif
+
+// Ack counters
+struct CommandAckStats
+{
+    uint32_t published; // ack documents sent
+    uint32_t acked;     // messages acked
+    uint32_t untracked; // messages with an "id" but no ack (id too long, or every slot busy)
+    uint32_t expired;   // messages acked as dropped after ACK_TIMEOUT_MS
+};
+
+// Acknowledges every message that carries an "id" (its correlation ID) once
+// all the commands it produced have run, with a CommandStatus, when it
+// arrived and when its handler ran. The network task opens the ack while it
+// dispatches the message; the actuator task reports each command's outcome
+// through a ring, so the slots themselves belong to the network task. Acks go
+// out as one retained document on <ack topic>/<client id> holding the last
+// ACK_HISTORY of them, which a client can read back through the broker's API
+// without subscribing.
+class CommandAck
+{
+public:
+    /**
+     * Start tracking a message (network task). The dispatch itself counts as
+     * one outcome: report it with record() once every command is handed on.
+     * @param id The message's "id"
+     * @param rxUs micros() when the message arrived
+     * @return Handle for the other calls, 0 if the message is not acked
+     */
+    static uint16_t open(JsonVariantConst id, uint32_t rxUs);
+
+    /**
+     * Wait for one more outcome; call before handing a command on (network task)
+     */
+    static void expect(uint16_t ack);
+
+    /**
+     * Report an outcome from the actuator task
+     * @param startUs micros() when the handler started, 0 if it never ran
+     * @param runUs How long the handler ran
+     */
+    static void complete(uint16_t ack, CommandStatus status, uint32_t startUs, uint32_t runUs);
+
+    /**
+     * Report an outcome from the network task: a raw handler, a command that
+     * was never queued, or the dispatch itself
+     */
+    static void record(uint16_t ack, CommandStatus status, uint32_t startUs = 0, uint32_t runUs = 0);
+
+    /**
+     * Bracket a raw handler's handleMessage() (network task)
+     * @return from endHandler(): true if the handler adopted the ack
+     */
+    static void beginHandler(uint16_t ack);
+    static bool endHandler();
+
+    /**
+     * For a raw handler that queues commands of its own: ack the message when
+     * those have run rather than when the handler returns; each queued command
+     * counts as one outcome (see CommandPipeline::submitBatch)
+     * @param aheadMs How long after now the last command is due
+     * @return Handle to queue the commands with, 0 if the message is not acked
+     *         or cannot be tracked that long (ACK_MAX_WAIT_MS)
+     */
+    static uint16_t adopt(uint32_t aheadMs);
+
+    /**
+     * Publish finished acks; call from the network task while MQTT is connected
+     */
+    static void loop();
+
+    /**
+     * Write the ack document, newest acks first, as many as fit
+     * @return Bytes written, 0 if the buffer is too small
+     */
+    static size_t serialize(char *buffer, size_t size);
+
+    static const CommandAckStats &getStats() { return stats; }
+
+private:
+    // A message waiting for its outcomes
+    struct Slot
+    {
+        uint16_t handle; // 0 = free
+        uint8_t pending; // outcomes still to come
+        uint32_t timeoutMs; // from rxUs
+        CommandStatus status;
+        uint32_t rxUs;
+        uint32_t startUs; // first handler start, 0 if none ran
+        uint32_t runUs;   // handler run time, summed over commands
+        char id[ACK_ID_SIZE];
+    };
+
+    // An outcome reported by the actuator task
+    struct Outcome
+    {
+        uint16_t ack;
+        CommandStatus status;
+        uint32_t startUs;
+        uint32_t runUs;
+    };
+
+    // A finished ack, as published
+    struct Entry
+    {
+        char id[ACK_ID_SIZE];
+        CommandStatus status;
+        bool ran;
+        uint64_t rxMs;    // epoch ms, 0 if the clock is not synced
+        uint64_t startMs; // epoch ms
+        uint32_t queueUs; // arrival to handler start
+        uint32_t runUs;
+    };
+
+    typedef StaticJsonDocument<JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(ACK_HISTORY) + ACK_HISTORY * JSON_OBJECT_SIZE(6)>
+        AckDocument;
+
+    static void _apply(const Outcome &outcome);
+    static void _finish(Slot &slot);
+
+    static Slot slots[ACK_SLOTS];
+    static SpscRing<Outcome, 32> outcomes; // actuator -> network
+    static Entry history[ACK_HISTORY];     // ring, newest at historyHead - 1
+    static uint8_t historyHead;
+    static uint8_t historyCount;
+    static uint16_t generation;
+    static uint16_t handlerAck; // ack of the raw handler running, see beginHandler()
+    static bool adopted;
+    static bool dirty;
+    static CommandAckStats stats;
+    static AckDocument doc;                // for serialize(), kept off the network task's stack
+    static char payload[ACK_PAYLOAD_SIZE];
+};
@@ -0,0 +1,191 @@
+#include "CommandPipeline.h"
+#include "RulesEngine.h"
+
+SpscRing<PendingCommand, PIPELINE_QUEUE_DEPTH> CommandPipeline::queue(PIPELINE_OVERFLOW_POLICY);
+CommandScheduler CommandPipeline::schedule;
+TimerWheel CommandPipeline::timers;
+TaskHandle_t CommandPipeline::actuatorTask = nullptr;
+volatile uint32_t CommandPipeline::submitted = 0;
+volatile uint32_t CommandPipeline::executed = 0;
+volatile uint32_t CommandPipeline::scheduleDropped = 0;
+volatile uint16_t CommandPipeline::scheduled = 0;
+volatile uint32_t CommandPipeline::coalesced = 0;
+
+void CommandPipeline::begin(void (*networkLoop)())
+{
+    // Actuator first, so the network task never submits before it exists
+    xTaskCreatePinnedToCore(_actuatorTask, "actuator", 4096, nullptr, 3, &actuatorTask, PIPELINE_ACTUATOR_CORE);
+    xTaskCreatePinnedToCore(_networkTask, "network", 8192, (void *)networkLoop, 2, nullptr, PIPELINE_NETWORK_CORE);
+    LOG_INFO("✅ Pipeline started (network core %d, actuator core %d)", PIPELINE_NETWORK_CORE, PIPELINE_ACTUATOR_CORE);
+}
+
+bool CommandPipeline::submit(TopicHandler *handler, const Command &cmd, uint16_t ack)
+{
+    CommandAck::expect(ack);
+    if (!actuatorTask)
+    {
+        uint32_t startUs = micros();
+        CommandStatus status = _execute(handler, cmd);
+        CommandAck::record(ack, status, startUs, micros() - startUs);
+        return true;
+    }
+
+    submitted = submitted + 1;
+    bool queued = queue.push(PendingCommand{handler, cmd, (uint32_t)millis(), (uint32_t)micros(), false,
+                                            handler->getCoalesceKey(cmd), ack});
+    if (!queued)
+    {
+        LOG_WARN("⚠️ Command queue full, command dropped");
+        CommandAck::record(ack, CommandStatus::Dropped);
+    }
+    xTaskNotifyGive(actuatorTask);
+    return queued;
+}
+
+bool CommandPipeline::submitBatch(const PendingCommand *batch, size_t count)
+{
+    if (!actuatorTask)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            CommandAck::expect(batch[i].ack);
+            uint32_t startUs = micros();
+            CommandStatus status = _execute(batch[i].handler, batch[i].cmd);
+            CommandAck::record(batch[i].ack, status, startUs, micros() - startUs);
+        }
+        return true;
+    }
+
+    // Check room up front: a partly queued batch would hold the actuator
+    // waiting for its last command. Batches never take the reserved slots,
+    // so a schedule full of delayed batch commands cannot drop immediate ones.
+    size_t queued = queue.size();
+    if (count > queue.capacity() - queued ||
+        queued + scheduled + count > PIPELINE_SCHEDULE_DEPTH - PIPELINE_SCHEDULE_RESERVE)
+    {
+        LOG_WARN("⚠️ No room for a batch of %u commands, batch dropped", (unsigned)count);
+        return false;
+    }
+
+    uint32_t nowMs = millis();
+    for (size_t i = 0; i < count; i++)
+    {
+        PendingCommand pending = batch[i];
+        pending.queuedUs = (int32_t)(pending.dueMs - nowMs) > 0 ? 0 : micros();
+        pending.more = i + 1 < count;
+        CommandAck::expect(pending.ack);
+        queue.push(pending);
+    }
+    submitted = submitted + count;
+    xTaskNotifyGive(actuatorTask);
+    return true;
+}
+
+void CommandPipeline::startTimer(WheelTimer &timer, uint32_t delayMs)
+{
+    timers.schedule(timer, millis(), delayMs);
+}
+
+bool CommandPipeline::stopTimer(WheelTimer &timer)
+{
+    return timers.cancel(timer);
+}
+
+PipelineStats CommandPipeline::getStats()
+{
+    PipelineStats stats;
+    stats.submitted = submitted;
+    stats.executed = executed;
+    stats.dropped = queue.dropped() + scheduleDropped;
+    stats.depth = queue.size();
+    stats.highWaterMark = queue.highWaterMark();
+    stats.scheduled = scheduled;
+    stats.coalesced = coalesced;
+    return stats;
+}
+
+void CommandPipeline::_networkTask(void *arg)
+{
+    auto networkLoop = reinterpret_cast<void (*)()>(arg);
+    while (true)
+    {
+        networkLoop();
+    }
+}
+
+void CommandPipeline::_actuatorTask(void *arg)
+{
+    PendingCommand pending;
+    bool batchOpen = false;
+    while (true)
+    {
+        // Sleep until a command arrives, the earliest scheduled one is due or a timer fires
+        uint32_t nowMs = millis();
+        uint32_t waitMs;
+        uint32_t timerMs;
+        if (batchOpen || !schedule.nextDue(nowMs, waitMs))
+        {
+            waitMs = UINT32_MAX;
+        }
+        if (timers.nextDue(nowMs, timerMs) && timerMs < waitMs)
+        {
+            waitMs = timerMs;
+        }
+        TickType_t wait = portMAX_DELAY;
+        if (waitMs != UINT32_MAX)
+        {
+            wait = (waitMs + portTICK_PERIOD_MS - 1) / portTICK_PERIOD_MS;
+        }
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        while (queue.pop(pending))
+        {
+            batchOpen = pending.more;
+
+            // A newer command supersedes a same-key one that has not run yet
+            PendingCommand replaced;
+            if (pending.coalesceKey && schedule.remove(pending.handler, pending.coalesceKey, replaced))
+            {
+                coalesced = coalesced + 1;
+                CommandAck::complete(replaced.ack, CommandStatus::Superseded, 0, 0);
+            }
+            if (!schedule.push(pending))
+            {
+                scheduleDropped = scheduleDropped + 1;
+                LOG_WARN("⚠️ Command schedule full, command dropped");
+                CommandAck::complete(pending.ack, CommandStatus::Dropped, 0, 0);
+            }
+        }
+
+        // The rest of a batch is still being queued; run nothing until it is all here
+        if (!batchOpen)
+        {
+            uint32_t now = millis();
+            while (schedule.popDue(now, pending))
+            {
+                TELEMETRY_START(commandStart);
+                if (pending.queuedUs)
+                {
+                    TELEMETRY_RECORD(Metric::Queue, pending.queuedUs);
+                }
+                uint32_t startUs = micros();
+                CommandStatus status = _execute(pending.handler, pending.cmd);
+                CommandAck::complete(pending.ack, status, startUs, micros() - startUs);
+                TELEMETRY_RECORD(Metric::Command, commandStart);
+                executed = executed + 1;
+            }
+        }
+        // Timers run even while a batch is incomplete; they are not part of it
+        timers.advance(millis());
+        scheduled = schedule.size();
+    }
+}
+
+// Run a command, then whatever local rules it triggers
+// The status is the handler's; what the rules do is not part of it
+CommandStatus CommandPipeline::_execute(TopicHandler *handler, const Command &cmd)
+{
+    CommandStatus status = handler->handleCommand(cmd);
+    RulesEngine::onCommand(handler, cmd);
+    return status;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <Arduino.h>
+#include "TopicHandler.h"
+#include "SpscRing.h"
+#include "CommandScheduler.h"
+#include "TimerWheel.h"
+#include "CommandAck.h"
+#include "Telemetry.h"
+#include "Logger.h"
+
+// Depth of the network -> actuator command ring (power of two)
+#ifndef PIPELINE_QUEUE_DEPTH
+#define PIPELINE_QUEUE_DEPTH 16
+#endif
+
+// When the actuator falls behind, the newest command usually matters most
+#ifndef PIPELINE_OVERFLOW_POLICY
+#define PIPELINE_OVERFLOW_POLICY RingOverflow::DropOldest
+#endif
+
+#if CONFIG_FREERTOS_UNICORE
+#define PIPELINE_NETWORK_CORE 0
+#define PIPELINE_ACTUATOR_CORE 0
+#else
+#define PIPELINE_NETWORK_CORE 0  // same core as the WiFi/lwIP tasks
+#define PIPELINE_ACTUATOR_CORE 1
+#endif
+
+// Pipeline counters
+struct PipelineStats
+{
+    uint32_t submitted;     // commands handed to the ring
+    uint32_t executed;      // commands run by the actuator task
+    uint32_t dropped;       // commands lost to the overflow policy or a full schedule
+    uint16_t depth;         // commands currently queued
+    uint16_t highWaterMark; // deepest the queue has been
+    uint16_t scheduled;     // commands waiting for their due time
+    uint32_t coalesced;     // commands replaced by a newer one with the same coalesce key
+};
+
+class CommandPipeline
+{
+public:
+    /**
+     * Start the pipeline: a network task pinned to PIPELINE_NETWORK_CORE that
+     * runs networkLoop() forever (socket I/O and decoding), and an actuator
+     * task pinned to PIPELINE_ACTUATOR_CORE that executes decoded commands
+     * @param networkLoop One iteration of the network work (OTA, WiFi, MQTT)
+     */
+    static void begin(void (*networkLoop)());
+
+    /**
+     * Queue a decoded command for the actuator task (call from the network task)
+     * Before begin() the command is executed immediately on the caller
+     * @param ack CommandAck handle of the message; its outcome is reported there
+     * @return false if the command was dropped
+     */
+    static bool submit(TopicHandler *handler, const Command &cmd, uint16_t ack = 0);
+
+    /**
+     * Queue a batch of commands, each with its own dueMs (call from the network task)
+     * The actuator schedules the whole batch before running any of it, so
+     * commands due at the same time execute back to back. The batch is
+     * rejected as a whole if the queue or the schedule cannot take it.
+     * Each command's outcome is reported to its ack handle, as with submit()
+     * Before begin() the commands run immediately, in order, ignoring dueMs
+     * @return false if the batch was rejected
+     */
+    static bool submitBatch(const PendingCommand *batch, size_t count);
+
+    /**
+     * Run a timer's callback on the actuator task after delayMs, or move it
+     * if it is already pending. Call from the actuator task (handleCommand or
+     * a timer callback), so callbacks never race command execution.
+     */
+    static void startTimer(WheelTimer &timer, uint32_t delayMs);
+
+    /**
+     * Stop a timer before it fires (call from the actuator task)
+     * @return true if it was pending
+     */
+    static bool stopTimer(WheelTimer &timer);
+
+    /**
+     * @return Current pipeline counters
+     */
+    static PipelineStats getStats();
+
+private:
+    static void _networkTask(void *arg);
+    static void _actuatorTask(void *arg);
+    static CommandStatus _execute(TopicHandler *handler, const Command &cmd);
+
+    static SpscRing<PendingCommand, PIPELINE_QUEUE_DEPTH> queue;
+    static CommandScheduler schedule; // owned by the actuator task
+    static TimerWheel timers;         // owned by the actuator task
+    static TaskHandle_t actuatorTask;
+    static volatile uint32_t submitted;
+    static volatile uint32_t executed;
+    static volatile uint32_t scheduleDropped;
+    static volatile uint16_t scheduled;
+    static volatile uint32_t coalesced;
+};
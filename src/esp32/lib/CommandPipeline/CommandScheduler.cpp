@@ -0,0 +1,105 @@
+#include "CommandScheduler.h"
+#include <utility>
+
+bool CommandScheduler::push(const PendingCommand &pending)
+{
+    if (count >= PIPELINE_SCHEDULE_DEPTH)
+    {
+        return false;
+    }
+    entries[count] = Entry{pending, nextSeq++};
+    siftUp(count++);
+    return true;
+}
+
+bool CommandScheduler::popDue(uint32_t now, PendingCommand &out)
+{
+    if (count == 0 || (int32_t)(entries[0].pending.dueMs - now) > 0)
+    {
+        return false;
+    }
+    out = entries[0].pending;
+    entries[0] = entries[--count];
+    siftDown(0);
+    return true;
+}
+
+bool CommandScheduler::remove(const TopicHandler *handler, uint32_t coalesceKey, PendingCommand &removed)
+{
+    // Same-key commands replace each other, so there is at most one to find
+    for (size_t i = 0; i < count; i++)
+    {
+        const PendingCommand &pending = entries[i].pending;
+        if (pending.coalesceKey == coalesceKey && pending.handler == handler)
+        {
+            removed = pending;
+            entries[i] = entries[--count];
+            if (i < count)
+            {
+                siftDown(i);
+                siftUp(i);
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+bool CommandScheduler::nextDue(uint32_t now, uint32_t &waitMs) const
+{
+    if (count == 0)
+    {
+        return false;
+    }
+    int32_t left = (int32_t)(entries[0].pending.dueMs - now);
+    waitMs = left > 0 ? left : 0;
+    return true;
+}
+
+bool CommandScheduler::before(const Entry &a, const Entry &b)
+{
+    int32_t diff = (int32_t)(a.pending.dueMs - b.pending.dueMs);
+    if (diff != 0)
+    {
+        return diff < 0;
+    }
+    return (int32_t)(a.seq - b.seq) < 0;
+}
+
+void CommandScheduler::siftUp(size_t i)
+{
+    while (i > 0)
+    {
+        size_t parent = (i - 1) / 2;
+        if (!before(entries[i], entries[parent]))
+        {
+            break;
+        }
+        std::swap(entries[i], entries[parent]);
+        i = parent;
+    }
+}
+
+void CommandScheduler::siftDown(size_t i)
+{
+    while (true)
+    {
+        size_t first = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < count && before(entries[left], entries[first]))
+        {
+            first = left;
+        }
+        if (right < count && before(entries[right], entries[first]))
+        {
+            first = right;
+        }
+        if (first == i)
+        {
+            return;
+        }
+        std::swap(entries[i], entries[first]);
+        i = first;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "TopicHandler.h"
+
+// Commands the actuator can hold back for a later due time
+#ifndef PIPELINE_SCHEDULE_DEPTH
+#define PIPELINE_SCHEDULE_DEPTH 32
+#endif
+
+// Schedule slots batches leave free, so commands that run at once still fit
+// while a batch waits on long delays
+#ifndef PIPELINE_SCHEDULE_RESERVE
+#define PIPELINE_SCHEDULE_RESERVE 8
+#endif
+
+static_assert(PIPELINE_SCHEDULE_RESERVE < PIPELINE_SCHEDULE_DEPTH, "PIPELINE_SCHEDULE_RESERVE must leave room for batches");
+
+// A decoded command waiting for the actuator task
+struct PendingCommand
+{
+    TopicHandler *handler;
+    Command cmd;
+    uint32_t dueMs;    // millis() at which to execute
+    uint32_t queuedUs; // micros() when queued, 0 if scheduled ahead (for telemetry)
+    bool more;      // another command of the same batch follows in the queue
+    uint32_t coalesceKey; // TopicHandler::getCoalesceKey(), 0 for batched commands
+    uint16_t ack;         // CommandAck handle of the message, 0 if it is not acked
+};
+
+// Fixed-capacity min-heap of pending commands ordered by due time.
+// Commands due at the same time run in the order they were pushed.
+// Due times are compared wrap-safe, so they must lie within ~24 days of
+// each other. Only the actuator task touches it, so there is no locking.
+class CommandScheduler
+{
+public:
+    // Returns false if the schedule is full
+    bool push(const PendingCommand &pending);
+
+    // Pops the earliest command if it is due at `now`
+    bool popDue(uint32_t now, PendingCommand &out);
+
+    // Removes the pending command of `handler` with this coalesce key, if any
+    // Returns true if one was removed, and the command in `removed`
+    bool remove(const TopicHandler *handler, uint32_t coalesceKey, PendingCommand &removed);
+
+    // Milliseconds until the earliest command is due (0 if overdue)
+    // Returns false if the schedule is empty
+    bool nextDue(uint32_t now, uint32_t &waitMs) const;
+
+    size_t size() const { return count; }
+
+private:
+    struct Entry
+    {
+        PendingCommand pending;
+        uint32_t seq;
+    };
+
+    static bool before(const Entry &a, const Entry &b);
+    void siftUp(size_t i);
+    void siftDown(size_t i);
+
+    Entry entries[PIPELINE_SCHEDULE_DEPTH];
+    size_t count = 0;
+    uint32_t nextSeq = 0;
+};
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+// Message IDs remembered for duplicate detection
+#ifndef PIPELINE_RECENT_IDS
+#define PIPELINE_RECENT_IDS 32
+#endif
+
+// Fixed-size cache of recently handled message IDs.
+// IDs are stored as 32-bit hashes of topic + id; once full, the oldest is
+// forgotten. A lookup is a linear scan, which at this size is a handful of
+// cache lines. Only the network task touches it, so there is no locking.
+class RecentIds
+{
+public:
+    // Hash of a message's "id" on a topic; never 0. Ids other than strings and
+    // integers (floats, arrays, objects) are hashed as their serialized JSON
+    static uint32_t hash(const char *topic, JsonVariantConst id)
+    {
+        uint32_t h = fnv1a(topic, strlen(topic), 2166136261u);
+        if (id.is<const char *>())
+        {
+            const char *s = id.as<const char *>();
+            h = fnv1a(s, strlen(s), h ^ 's');
+        }
+        else if (id.is<int64_t>())
+        {
+            int64_t n = id.as<int64_t>();
+            h = fnv1a(&n, sizeof(n), h ^ 'n');
+        }
+        else
+        {
+            HashWriter writer{h ^ 'j'};
+            serializeJson(id, writer);
+            h = writer.h;
+        }
+        return h ? h : 1;
+    }
+
+    bool contains(uint32_t idHash) const
+    {
+        for (size_t i = 0; i < PIPELINE_RECENT_IDS; i++)
+        {
+            if (ids[i] == idHash)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void add(uint32_t idHash)
+    {
+        ids[next] = idHash;
+        next = (next + 1) % PIPELINE_RECENT_IDS;
+    }
+
+private:
+    // ArduinoJson writer that hashes the output instead of storing it
+    struct HashWriter
+    {
+        uint32_t h;
+
+        size_t write(uint8_t c)
+        {
+            h = fnv1a(&c, 1, h);
+            return 1;
+        }
+
+        size_t write(const uint8_t *s, size_t n)
+        {
+            h = fnv1a(s, n, h);
+            return n;
+        }
+    };
+
+    static uint32_t fnv1a(const void *data, size_t length, uint32_t h)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < length; i++)
+        {
+            h = (h ^ bytes[i]) * 16777619u;
+        }
+        return h;
+    }
+
+    uint32_t ids[PIPELINE_RECENT_IDS] = {}; // 0 = empty slot
+    size_t next = 0;
+};
@@ -0,0 +1,215 @@
+#include "TimerWheel.h"
+
+static_assert(TIMER_WHEEL_BITS >= 1 && TIMER_WHEEL_BITS <= 6, "slot occupancy is a 64-bit mask");
+static_assert(TIMER_WHEEL_BITS * TIMER_WHEEL_LEVELS < 32, "the wheel must span less than the 32-bit clock");
+
+#define SLOT_MASK (TIMER_WHEEL_SLOTS - 1)
+
+// Ticks covered by one slot of a level (64^level)
+static inline uint32_t slotSpan(int level)
+{
+    return 1u << (level * TIMER_WHEEL_BITS);
+}
+
+// Occupancy bits rotated so that bit 0 is slot `by`
+static inline uint64_t rotateSlots(uint64_t bits, uint32_t by)
+{
+    if (by == 0)
+    {
+        return bits;
+    }
+    return ((bits >> by) | (bits << (TIMER_WHEEL_SLOTS - by))) & (~0ull >> (64 - TIMER_WHEEL_SLOTS));
+}
+
+TimerWheel::TimerWheel()
+{
+    for (auto &level : _slots)
+    {
+        for (TimerLink &slot : level)
+        {
+            slot.prev = slot.next = &slot;
+        }
+    }
+}
+
+void TimerWheel::schedule(WheelTimer &timer, uint32_t nowMs, uint32_t delayMs)
+{
+    cancel(timer);
+
+    // An empty wheel can move its clock freely, which keeps deltas small. Right
+    // after advance(nowMs) the clock is one tick ahead; that is left alone, so a
+    // callback rescheduling itself with no delay runs on the next tick, not again now.
+    if (_count == 0 && _clock - nowMs != 1)
+    {
+        _clock = nowMs;
+    }
+    timer._dueMs = nowMs + delayMs;
+    _file(timer);
+    _count++;
+}
+
+bool TimerWheel::cancel(WheelTimer &timer)
+{
+    if (!timer.isPending())
+    {
+        return false;
+    }
+    _unlink(timer);
+
+    uint32_t level = timer._slot / TIMER_WHEEL_SLOTS;
+    uint32_t slot = timer._slot % TIMER_WHEEL_SLOTS;
+    if (_slots[level][slot].next == &_slots[level][slot])
+    {
+        _occupied[level] &= ~(1ull << slot);
+    }
+    _count--;
+    return true;
+}
+
+void TimerWheel::advance(uint32_t nowMs)
+{
+    while ((int32_t)(nowMs - _clock) >= 0)
+    {
+        // Ticks with nothing to expire or cascade are skipped, not walked
+        uint32_t next = _count ? _nextEvent() : nowMs + 1;
+        if ((int32_t)(next - nowMs) > 0)
+        {
+            _clock = nowMs + 1;
+            return;
+        }
+        _clock = next;
+
+        // Bring the timers of the higher-level slots that start here down a level,
+        // while the clock still points at this tick
+        uint32_t tick = _clock;
+        uint32_t index = tick & SLOT_MASK;
+        for (int level = 1; index == 0 && level < TIMER_WHEEL_LEVELS; level++)
+        {
+            index = (tick >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+            _cascade(level, index);
+        }
+
+        // Timers the callbacks schedule from here on land at the next tick or later
+        _clock = tick + 1;
+        _expire(tick & SLOT_MASK);
+    }
+}
+
+bool TimerWheel::nextDue(uint32_t nowMs, uint32_t &waitMs) const
+{
+    if (_count == 0)
+    {
+        return false;
+    }
+    int32_t left = (int32_t)(_nextEvent() - nowMs);
+    waitMs = left > 0 ? left : 0;
+    return true;
+}
+
+// Put a timer in the slot of the lowest level that reaches its due time
+void TimerWheel::_file(WheelTimer &timer)
+{
+    int32_t delta = (int32_t)(timer._dueMs - _clock);
+    uint32_t due = delta < 0 ? _clock : timer._dueMs;
+    uint32_t ahead = delta < 0 ? 0 : delta;
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && ahead >= slotSpan(level + 1))
+    {
+        level++;
+    }
+    // Beyond the top level: wait in its furthest slot and be re-filed from there
+    if (level == TIMER_WHEEL_LEVELS - 1 && ahead >= slotSpan(TIMER_WHEEL_LEVELS) - 1)
+    {
+        due = _clock + slotSpan(TIMER_WHEEL_LEVELS) - 1;
+    }
+
+    uint32_t slot = (due >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+    TimerLink &head = _slots[level][slot];
+    timer.prev = head.prev;
+    timer.next = &head;
+    head.prev->next = &timer;
+    head.prev = &timer;
+    timer._slot = level * TIMER_WHEEL_SLOTS + slot;
+    _occupied[level] |= 1ull << slot;
+}
+
+void TimerWheel::_unlink(TimerLink &link)
+{
+    link.prev->next = link.next;
+    link.next->prev = link.prev;
+    link.prev = link.next = nullptr;
+}
+
+// Move the timers of a slot to a local list head and mark the slot empty
+void TimerWheel::_detach(int level, uint32_t slot, TimerLink &into)
+{
+    TimerLink &head = _slots[level][slot];
+    if (head.next == &head)
+    {
+        into.prev = into.next = &into;
+        return;
+    }
+    into.next = head.next;
+    into.prev = head.prev;
+    into.next->prev = &into;
+    into.prev->next = &into;
+    head.prev = head.next = &head;
+    _occupied[level] &= ~(1ull << slot);
+}
+
+// Re-file every timer of a slot; they land on lower levels (or, if parked
+// beyond the top level, in a later top-level slot)
+void TimerWheel::_cascade(int level, uint32_t slot)
+{
+    TimerLink moving;
+    _detach(level, slot, moving);
+    while (moving.next != &moving)
+    {
+        WheelTimer &timer = static_cast<WheelTimer &>(*moving.next);
+        _unlink(timer);
+        _file(timer);
+    }
+}
+
+void TimerWheel::_expire(uint32_t slot)
+{
+    // Detach the slot first: callbacks may schedule into it or cancel timers still in it
+    TimerLink due;
+    _detach(0, slot, due);
+    while (due.next != &due)
+    {
+        WheelTimer &timer = static_cast<WheelTimer &>(*due.next);
+        _unlink(timer);
+        _count--;
+        timer._callback(timer._arg);
+    }
+}
+
+// First tick from the clock on where a level-0 slot is due or an occupied slot cascades
+uint32_t TimerWheel::_nextEvent() const
+{
+    uint32_t best = UINT32_MAX;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+    {
+        if (!_occupied[level])
+        {
+            continue;
+        }
+        uint32_t span = slotSpan(level);
+        uint32_t index = (_clock >> (level * TIMER_WHEEL_BITS)) & SLOT_MASK;
+
+        // A higher-level slot cascades at the start of its block, so the current
+        // one is still ahead only while the clock sits on that start
+        bool current = level == 0 || (_clock & (span - 1)) == 0;
+        uint32_t first = current ? index : (index + 1) & SLOT_MASK;
+        uint32_t blocks = __builtin_ctzll(rotateSlots(_occupied[level], first)) + (current ? 0 : 1);
+
+        uint32_t ahead = (_clock & ~(span - 1)) + blocks * span - _clock;
+        if (ahead < best)
+        {
+            best = ahead;
+        }
+    }
+    return _clock + best;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Wheel geometry: TIMER_WHEEL_LEVELS levels of 2^TIMER_WHEEL_BITS slots with
+// a 1ms tick. Level n holds timers due within 64^(n+1) ms (about 4.6 hours
+// for 4 levels); later ones park in the top level and are re-filed when it
+// cascades.
+#ifndef TIMER_WHEEL_BITS
+#define TIMER_WHEEL_BITS 6
+#endif
+
+#ifndef TIMER_WHEEL_LEVELS
+#define TIMER_WHEEL_LEVELS 4
+#endif
+
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+
+// Doubly linked list node; a slot is an empty node that points to itself
+struct TimerLink
+{
+    TimerLink *prev = nullptr;
+    TimerLink *next = nullptr;
+};
+
+// A callback a TimerWheel can run later. The owner keeps it alive (usually
+// as a member) for as long as it may be pending, so the wheel never allocates.
+class WheelTimer : private TimerLink
+{
+public:
+    typedef void (*Callback)(void *arg);
+
+    WheelTimer(Callback callback, void *arg) : _callback(callback), _arg(arg) {}
+    WheelTimer(const WheelTimer &) = delete;
+    WheelTimer &operator=(const WheelTimer &) = delete;
+
+    bool isPending() const { return next != nullptr; }
+
+    // When the timer fires (valid while pending)
+    uint32_t dueMs() const { return _dueMs; }
+
+private:
+    friend class TimerWheel;
+
+    Callback _callback;
+    void *_arg;
+    uint32_t _dueMs = 0;
+    uint16_t _slot = 0; // level * TIMER_WHEEL_SLOTS + slot
+};
+
+// Hierarchical timer wheel: schedule, reschedule and cancel are O(1), and
+// advancing skips straight to the next tick that has work. Time is whatever
+// millisecond clock the caller passes in, so it runs the same on a host with
+// a virtual clock. Not thread-safe: one task owns it and runs the callbacks.
+class TimerWheel
+{
+public:
+    TimerWheel();
+
+    /**
+     * Schedule a timer, or move it if it is already pending
+     * @param timer Timer to run, must stay alive until it fires or is cancelled
+     * @param nowMs Current time
+     * @param delayMs Delay from nowMs (under ~24 days); 0 runs it on the next advance()
+     */
+    void schedule(WheelTimer &timer, uint32_t nowMs, uint32_t delayMs);
+
+    /**
+     * Stop a timer from firing (safe to call when it is not pending)
+     * @return true if it was pending
+     */
+    bool cancel(WheelTimer &timer);
+
+    /**
+     * Run every timer due at or before nowMs, in due order. Callbacks may
+     * schedule and cancel timers, including the one that is running.
+     * @param nowMs Current time, must not go backwards
+     */
+    void advance(uint32_t nowMs);
+
+    /**
+     * Milliseconds until advance() next has work (0 if overdue)
+     * @return false if no timer is pending
+     */
+    bool nextDue(uint32_t nowMs, uint32_t &waitMs) const;
+
+    size_t size() const { return _count; }
+
+private:
+    void _file(WheelTimer &timer);
+    static void _unlink(TimerLink &link);
+    void _detach(int level, uint32_t slot, TimerLink &into);
+    void _cascade(int level, uint32_t slot);
+    void _expire(uint32_t slot);
+    uint32_t _nextEvent() const;
+
+    TimerLink _slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t _occupied[TIMER_WHEEL_LEVELS] = {}; // bit per non-empty slot
+    uint32_t _clock = 0;                         // next tick to process
+    size_t _count = 0;
+};
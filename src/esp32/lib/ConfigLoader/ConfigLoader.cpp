@@ -2,99 +2,309 @@
 
 Config ConfigLoader::config;
 
+// NVS namespace and keys of the snapshot
+static const char *snapshotNamespace = "config";
+static const char *snapshotHeaderKey = "hdr";
+static const char *snapshotBodyKey = "cfg";
+static const uint32_t snapshotMagic = 0x43464731; // "CFG1"
+
+// FNV-1a, used for both the source hash and the snapshot checksum
+static uint32_t fnv1a(const uint8_t *data, size_t length, uint32_t hash = 2166136261u)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Hashes the file in small chunks, without parsing or buffering it
+static uint32_t hashFile(File &file)
+{
+    uint8_t chunk[256];
+    uint32_t hash = 2166136261u;
+    size_t n;
+    while ((n = file.read(chunk, sizeof(chunk))) > 0)
+    {
+        hash = fnv1a(chunk, n, hash);
+    }
+    return hash;
+}
+
+// Copies a string setting into a fixed field; fails if it does not fit
+static bool copyField(char *dest, size_t size, JsonVariantConst value, const char *fallback, const char *name)
+{
+    if (strlcpy(dest, value | fallback, size) >= size)
+    {
+        LOG_ERROR("❌ Config %s is too long (max %u characters)", name, (unsigned)(size - 1));
+        return false;
+    }
+    return true;
+}
+
+#define COPY_FIELD(field, value, fallback, name) copyField(config.field, sizeof(config.field), value, fallback, name)
+
 bool ConfigLoader::loadConfig(const char *filename)
 {
-    // remount LittleFS to ensure we can read the config file
-    LittleFS.end();
+    // begin() is a no-op if setup() already mounted it
     if (!LittleFS.begin(false))
     { // false = do not format
-        Serial.println("❌ Failed to mount LittleFS");
+        LOG_ERROR("❌ Failed to mount LittleFS");
         return false;
     }
 
     File file = LittleFS.open(filename, "r");
     if (!file)
     {
-        Serial.printf("❌ Failed to open config file: %s\n", filename);
+        LOG_ERROR("❌ Failed to open config file: %s", filename);
         return false;
     }
 
     if (file.size() == 0)
     {
-        Serial.println("❌ Config file is empty!");
+        LOG_ERROR("❌ Config file is empty!");
         file.close();
         return false;
     }
 
+    // Fast path: the snapshot still matches config.json
+    uint32_t sourceHash = hashFile(file);
+    if (_loadSnapshot(sourceHash))
+    {
+        file.close();
+        LOG_INFO("⚡ Config loaded from snapshot");
+        _print();
+        return true;
+    }
+
+    file.seek(0);
+    bool parsed = _parseJson(file);
+    file.close();
+    if (!parsed || !_validate())
+    {
+        return false;
+    }
+
+    _saveSnapshot(sourceHash);
+    _print();
+    return true;
+}
+
+bool ConfigLoader::_parseJson(File &file)
+{
     DynamicJsonDocument doc(4096);
     DeserializationError error = deserializeJson(doc, file);
-    file.close();
 
     if (error)
     {
-        Serial.print("❌ Failed to parse config file: ");
-        Serial.println(error.c_str());
+        LOG_ERROR("❌ Failed to parse config file: %s", error.c_str());
         return false;
     }
 
+    JsonObjectConst root = doc.as<JsonObjectConst>();
+    memset(&config, 0, sizeof(config));
+    bool ok = true;
+
     // ====== WiFi ======
-    config.wifi_ssid = doc["wifi"]["ssid"] | "";
-    config.wifi_password = doc["wifi"]["password"] | "";
+    ok &= COPY_FIELD(wifi_ssid, root["wifi"]["ssid"], "", "wifi.ssid");
+    ok &= COPY_FIELD(wifi_password, root["wifi"]["password"], "", "wifi.password");
 
     // ====== EMQX ======
-    config.mqtt_broker = doc["emqx"]["broker"] | "";
-    config.mqtt_username = doc["emqx"]["auth"]["username"] | "";
-    config.mqtt_password = doc["emqx"]["auth"]["password"] | "";
-    config.mqtt_port = doc["emqx"]["port"]["tls/ssl"] | 8883;
-    config.ca_cert = doc["emqx"]["ca_cert"] | "";
+    ok &= COPY_FIELD(mqtt_broker, root["emqx"]["broker"], "", "emqx.broker");
+    ok &= COPY_FIELD(mqtt_username, root["emqx"]["auth"]["username"], "", "emqx.auth.username");
+    ok &= COPY_FIELD(mqtt_password, root["emqx"]["auth"]["password"], "", "emqx.auth.password");
+    config.mqtt_port = root["emqx"]["port"]["tls/ssl"] | 8883;
+    config.mqtt_max_packet = root["emqx"]["max_packet_size"] | 0;
+    ok &= COPY_FIELD(ca_cert, root["emqx"]["ca_cert"], "", "emqx.ca_cert");
 
     // ====== LED ======
-    config.led_pin = doc["esp32"]["led"]["pin"] | -1;
-    config.led_control_topic = doc["emqx"]["topic"]["led_control"] | "esp32-mcp/control/led";
+    // "pins" lists every LED channel; a single "pin" is still accepted
+    JsonArrayConst ledPins = root["esp32"]["led"]["pins"];
+    if (ledPins.isNull())
+    {
+        int pin = root["esp32"]["led"]["pin"] | -1;
+        if (pin >= 0)
+        {
+            config.led_pins[config.led_count++] = pin;
+        }
+    }
+    for (JsonVariantConst pin : ledPins)
+    {
+        if (config.led_count == CONFIG_MAX_LEDS)
+        {
+            LOG_WARN("⚠️ Only %d LED pins are supported, the rest are ignored", CONFIG_MAX_LEDS);
+            break;
+        }
+        config.led_pins[config.led_count++] = pin | -1;
+    }
+    ok &= COPY_FIELD(led_control_topic, root["emqx"]["topic"]["led_control"], "esp32-mcp/control/led", "emqx.topic.led_control");
 
     // ====== Buzzer ======
-    config.buzzer_pin = doc["esp32"]["buzzer"]["pin"] | -1;
-    config.buzzer_control_topic = doc["emqx"]["topic"]["buzzer_control"] | "esp32-mcp/control/buzzer";
+    config.buzzer_pin = root["esp32"]["buzzer"]["pin"] | -1;
+    ok &= COPY_FIELD(buzzer_control_topic, root["emqx"]["topic"]["buzzer_control"], "esp32-mcp/control/buzzer", "emqx.topic.buzzer_control");
+    ok &= COPY_FIELD(audio_topic, root["emqx"]["topic"]["audio"], "esp32-mcp/control/buzzer/audio", "emqx.topic.audio");
+
+    // ====== Batches ======
+    ok &= COPY_FIELD(batch_control_topic, root["emqx"]["topic"]["batch_control"], "esp32-mcp/control/batch", "emqx.topic.batch_control");
 
-    // ====== Validation ======
+    // ====== Rules ======
+    ok &= COPY_FIELD(rules_control_topic, root["emqx"]["topic"]["rules_control"], "esp32-mcp/control/rules", "emqx.topic.rules_control");
+
+    // ====== Sensors ======
+    for (JsonVariantConst pin : root["esp32"]["sensor"]["pins"].as<JsonArrayConst>())
+    {
+        if (config.sensor_count == CONFIG_MAX_SENSORS)
+        {
+            LOG_WARN("⚠️ Only %d sensor pins are supported, the rest are ignored", CONFIG_MAX_SENSORS);
+            break;
+        }
+        config.sensor_pins[config.sensor_count++] = pin | -1;
+    }
+    config.sensor_sample_hz = root["esp32"]["sensor"]["sample_hz"] | 1000;  // per pin
+    config.sensor_window_ms = root["esp32"]["sensor"]["window_ms"] | 1000; // one publish per window
+    ok &= COPY_FIELD(sensor_control_topic, root["emqx"]["topic"]["sensor_control"], "esp32-mcp/control/sensor", "emqx.topic.sensor_control");
+    ok &= COPY_FIELD(sensor_topic, root["emqx"]["topic"]["sensor"], "esp32-mcp/status/sensor", "emqx.topic.sensor");
+    ok &= COPY_FIELD(ntp_server, root["ntp"]["server"], "pool.ntp.org", "ntp.server");
+
+    // ====== Telemetry ======
+    ok &= COPY_FIELD(telemetry_topic, root["emqx"]["topic"]["telemetry"], "esp32-mcp/status/telemetry", "emqx.topic.telemetry");
+    config.telemetry_interval_s = root["telemetry"]["interval_s"] | 60; // 0 = do not publish
+
+    // ====== Device state ======
+    ok &= COPY_FIELD(state_topic, root["emqx"]["topic"]["state"], "esp32-mcp/status/state", "emqx.topic.state");
+
+    // ====== Log mirror ======
+    ok &= COPY_FIELD(log_topic, root["emqx"]["topic"]["log"], "esp32-mcp/status/log", "emqx.topic.log"); // "" = Serial only
+    ok &= COPY_FIELD(ack_topic, root["emqx"]["topic"]["ack"], "esp32-mcp/status/ack", "emqx.topic.ack"); // "" = no acks
+
+    // ====== Firmware updates ======
+    ok &= COPY_FIELD(ota_topic, root["emqx"]["topic"]["ota"], "esp32-mcp/ota", "emqx.topic.ota");
+
+    return ok;
+}
+
+bool ConfigLoader::_validate()
+{
     bool configValid = true;
 
-    if (config.wifi_ssid.isEmpty())
+    if (config.wifi_ssid[0] == '\0')
     {
-        Serial.println("❌ WiFi SSID is required");
+        LOG_ERROR("❌ WiFi SSID is required");
         configValid = false;
     }
 
-    if (config.mqtt_broker.isEmpty())
+    if (config.mqtt_broker[0] == '\0')
     {
-        Serial.println("❌ MQTT broker is required");
+        LOG_ERROR("❌ MQTT broker is required");
         configValid = false;
     }
 
-    if (config.led_pin < 0)
+    for (uint8_t i = 0; i < config.led_count; i++)
     {
-        Serial.println("⚠️ LED pin not configured");
+        if (config.led_pins[i] < 0)
+        {
+            LOG_ERROR("❌ LED pin %d is not a number", i);
+            configValid = false;
+        }
+    }
+
+    if (config.led_count == 0)
+    {
+        LOG_WARN("⚠️ LED pin not configured");
     }
 
     if (config.buzzer_pin < 0)
     {
-        Serial.println("⚠️ Buzzer pin not configured");
+        LOG_WARN("⚠️ Buzzer pin not configured");
+    }
+
+    for (uint8_t i = 0; i < config.sensor_count; i++)
+    {
+        if (config.sensor_pins[i] < 0)
+        {
+            LOG_ERROR("❌ Sensor pin %d is not a number", i);
+            configValid = false;
+        }
     }
 
-    if (!configValid)
+    return configValid;
+}
+
+bool ConfigLoader::_loadSnapshot(uint32_t sourceHash)
+{
+    Preferences prefs;
+    if (!prefs.begin(snapshotNamespace, true))
     {
         return false;
     }
 
-    // ====== Print ======
-    Serial.println("✅ Config loaded:");
-    Serial.printf("  WiFi: %s / %s\n", config.wifi_ssid.c_str(), config.wifi_password.c_str());
-    Serial.printf("  MQTT: %s:%d (user=%s)\n", config.mqtt_broker.c_str(), config.mqtt_port, config.mqtt_username.c_str());
-    Serial.printf("  LED Pin: %d, Topic: %s\n", config.led_pin, config.led_control_topic.c_str());
-    Serial.printf("  Buzzer Pin: %d, Topic: %s\n", config.buzzer_pin, config.buzzer_control_topic.c_str());
+    ConfigSnapshotHeader header;
+    bool valid = prefs.getBytes(snapshotHeaderKey, &header, sizeof(header)) == sizeof(header) &&
+                 header.magic == snapshotMagic && header.version == CONFIG_SNAPSHOT_VERSION &&
+                 header.size == sizeof(Config) && header.sourceHash == sourceHash &&
+                 prefs.getBytes(snapshotBodyKey, &config, sizeof(config)) == sizeof(config) &&
+                 fnv1a((const uint8_t *)&config, sizeof(config)) == header.checksum;
+    prefs.end();
+    return valid;
+}
 
-    Serial.println("Configuration loaded successfully");
-    return true;
+void ConfigLoader::_saveSnapshot(uint32_t sourceHash)
+{
+    Preferences prefs;
+    if (!prefs.begin(snapshotNamespace, false))
+    {
+        LOG_WARN("⚠️ Could not open NVS, config snapshot not saved");
+        return;
+    }
+
+    ConfigSnapshotHeader header = {snapshotMagic, CONFIG_SNAPSHOT_VERSION, sizeof(Config), sourceHash,
+                                   fnv1a((const uint8_t *)&config, sizeof(config))};
+
+    // Body first: the header is what makes a snapshot valid
+    prefs.remove(snapshotHeaderKey);
+    bool saved = prefs.putBytes(snapshotBodyKey, &config, sizeof(config)) == sizeof(config) &&
+                 prefs.putBytes(snapshotHeaderKey, &header, sizeof(header)) == sizeof(header);
+    prefs.end();
+    if (saved)
+    {
+        LOG_INFO("💾 Config snapshot saved");
+    }
+    else
+    {
+        LOG_WARN("⚠️ Config snapshot not saved");
+    }
+}
+
+void ConfigLoader::_print()
+{
+    LOG_INFO("✅ Config loaded:");
+    LOG_INFO("  WiFi: %s / %s", config.wifi_ssid, config.wifi_password);
+    LOG_INFO("  MQTT: %s:%d (user=%s)", config.mqtt_broker, config.mqtt_port, config.mqtt_username);
+    LOG_INFO("  MQTT max packet: %lu", (unsigned long)config.mqtt_max_packet);
+    char pins[CONFIG_MAX_LEDS * 4 + 1] = "";
+    for (uint8_t i = 0; i < config.led_count; i++)
+    {
+        snprintf(pins + strlen(pins), sizeof(pins) - strlen(pins), " %d", config.led_pins[i]);
+    }
+    LOG_INFO("  LED Pins:%s, Topic: %s", pins, config.led_control_topic);
+    LOG_INFO("  Buzzer Pin: %d, Topic: %s, Audio: %s", config.buzzer_pin, config.buzzer_control_topic, config.audio_topic);
+    LOG_INFO("  Batch Topic: %s, NTP: %s", config.batch_control_topic, config.ntp_server);
+    LOG_INFO("  Rules Topic: %s", config.rules_control_topic);
+    char sensorPins[CONFIG_MAX_SENSORS * 4 + 1] = "";
+    for (uint8_t i = 0; i < config.sensor_count; i++)
+    {
+        snprintf(sensorPins + strlen(sensorPins), sizeof(sensorPins) - strlen(sensorPins), " %d", config.sensor_pins[i]);
+    }
+    LOG_INFO("  Sensor Pins:%s, %luHz, %lums windows, Topics: %s -> %s", config.sensor_count ? sensorPins : " (none)",
+             (unsigned long)config.sensor_sample_hz, (unsigned long)config.sensor_window_ms,
+             config.sensor_control_topic, config.sensor_topic);
+    LOG_INFO("  Telemetry: %s every %us", config.telemetry_topic, (unsigned)config.telemetry_interval_s);
+    LOG_INFO("  State Topic: %s/<client id>", config.state_topic);
+    LOG_INFO("  Log Topic: %s", config.log_topic[0] ? config.log_topic : "(disabled)");
+    LOG_INFO("  Ack Topic: %s", config.ack_topic[0] ? config.ack_topic : "(disabled)");
+    LOG_INFO("  OTA Topic: %s/<client id>", config.ota_topic);
+
+    LOG_INFO("Configuration loaded successfully");
 }
 
 Config &ConfigLoader::getConfig()
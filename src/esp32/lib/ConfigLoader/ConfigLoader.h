@@ -4,27 +4,86 @@
 #include <FS.h>
 #include <LittleFS.h>
 #include <ArduinoJson.h>
+#include <Preferences.h>
+#include "Logger.h"
+
+// Field sizes, including the terminating NUL
+#ifndef CONFIG_STRING_SIZE
+#define CONFIG_STRING_SIZE 128 // broker, credentials, topics, NTP server
+#endif
+#ifndef CONFIG_CA_CERT_SIZE
+#define CONFIG_CA_CERT_SIZE 2048 // PEM
+#endif
+
+// LED outputs, one per LEDC fade channel
+#ifndef CONFIG_MAX_LEDS
+#define CONFIG_MAX_LEDS 4
+#endif
+
+// Analog inputs sampled by AdcSampler
+#ifndef CONFIG_MAX_SENSORS
+#define CONFIG_MAX_SENSORS 4
+#endif
+
+// Bump when the meaning of a Config field changes; layout changes are caught by size
+#define CONFIG_SNAPSHOT_VERSION 1
 
 // Configuration structure
+// Plain fixed-size fields, so the whole struct can be snapshotted as one blob
 struct Config {
-    String wifi_ssid;
-    String wifi_password;
-    String mqtt_broker;
-    String mqtt_username;
-    String mqtt_password;
+    char wifi_ssid[33];
+    char wifi_password[65];
+    char mqtt_broker[CONFIG_STRING_SIZE];
+    char mqtt_username[CONFIG_STRING_SIZE];
+    char mqtt_password[CONFIG_STRING_SIZE];
     int mqtt_port;
-    String ca_cert;
-    int led_pin;
-    String led_control_topic;
+    uint32_t mqtt_max_packet; // MQTT packet buffer in bytes; 0 = MQTT_PACKET_BUFFER_SIZE
+    char ca_cert[CONFIG_CA_CERT_SIZE];
+    int led_pins[CONFIG_MAX_LEDS];
+    uint8_t led_count;
+    char led_control_topic[CONFIG_STRING_SIZE];
     int buzzer_pin;
-    String buzzer_control_topic;
+    char buzzer_control_topic[CONFIG_STRING_SIZE];
+    char audio_topic[CONFIG_STRING_SIZE];
+    char batch_control_topic[CONFIG_STRING_SIZE];
+    char rules_control_topic[CONFIG_STRING_SIZE];
+    int sensor_pins[CONFIG_MAX_SENSORS];
+    uint8_t sensor_count;
+    uint32_t sensor_sample_hz;
+    uint32_t sensor_window_ms;
+    char sensor_control_topic[CONFIG_STRING_SIZE];
+    char sensor_topic[CONFIG_STRING_SIZE];
+    char ntp_server[CONFIG_STRING_SIZE];
+    char telemetry_topic[CONFIG_STRING_SIZE];
+    uint32_t telemetry_interval_s;
+    char state_topic[CONFIG_STRING_SIZE];
+    char log_topic[CONFIG_STRING_SIZE];
+    char ack_topic[CONFIG_STRING_SIZE];
+    char ota_topic[CONFIG_STRING_SIZE];
+};
+
+// Identifies the config.json a snapshot was built from
+struct ConfigSnapshotHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;       // sizeof(Config)
+    uint32_t sourceHash; // FNV-1a of config.json
+    uint32_t checksum;   // FNV-1a of the Config blob
 };
 
 class ConfigLoader {
 public:
+    // Loads the config: from the NVS snapshot when config.json is unchanged,
+    // otherwise by parsing config.json and refreshing the snapshot
     static bool loadConfig(const char* filename = "/config.json");
     static Config& getConfig();
 
 private:
+    static bool _parseJson(File& file);
+    static bool _validate();
+    static bool _loadSnapshot(uint32_t sourceHash);
+    static void _saveSnapshot(uint32_t sourceHash);
+    static void _print();
+
     static Config config;
 };
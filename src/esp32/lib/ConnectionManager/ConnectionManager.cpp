@@ -0,0 +1,177 @@
+#include "ConnectionManager.h"
+
+ConnectionState ConnectionManager::state = ConnectionState::WiFiConnecting;
+uint32_t ConnectionManager::enteredAt[(uint8_t)ConnectionState::Count] = {};
+uint32_t ConnectionManager::retryAt = 0;
+uint32_t ConnectionManager::outageStart = 0;
+uint8_t ConnectionManager::attempt = 0;
+bool ConnectionManager::everConnected = false;
+ConnectionStats ConnectionManager::stats = {};
+
+void ConnectionManager::begin()
+{
+    uint32_t now = millis();
+    outageStart = now;
+    if (WiFiManager::begin())
+    {
+        _enter(ConnectionState::WiFiConnecting, now);
+    }
+    else
+    {
+        _fail(ConnectionState::WiFiBackoff, now);
+    }
+}
+
+void ConnectionManager::loop()
+{
+    uint32_t now = millis();
+
+    switch (state)
+    {
+    case ConnectionState::WiFiConnecting:
+        if (WiFiManager::isConnected())
+        {
+            LOG_INFO("✅ WiFi connected, IP address: %s", WiFi.localIP().toString().c_str());
+            DeviceClock::begin(ConfigLoader::getConfig().ntp_server);
+            _enter(ConnectionState::TLSConnecting, now);
+        }
+        else if (now - enteredAt[(uint8_t)state] >= CONN_WIFI_TIMEOUT_MS)
+        {
+            LOG_ERROR("❌ WiFi connection timed out");
+            _fail(ConnectionState::WiFiBackoff, now);
+        }
+        break;
+
+    case ConnectionState::WiFiBackoff:
+        if ((int32_t)(now - retryAt) >= 0)
+        {
+            WiFiManager::reconnect();
+            _enter(ConnectionState::WiFiConnecting, now);
+        }
+        break;
+
+    case ConnectionState::TLSConnecting:
+        if (!WiFiManager::isConnected())
+        {
+            _enter(ConnectionState::WiFiConnecting, now);
+        }
+        else if (MQTTClient::connectTransport())
+        {
+            _enter(ConnectionState::MQTTConnecting, millis());
+        }
+        else
+        {
+            _fail(ConnectionState::MQTTBackoff, millis());
+        }
+        break;
+
+    case ConnectionState::MQTTConnecting:
+        if (MQTTClient::connectToMQTT())
+        {
+            _connected(millis());
+        }
+        else
+        {
+            _fail(ConnectionState::MQTTBackoff, millis());
+        }
+        break;
+
+    case ConnectionState::MQTTBackoff:
+        if (!WiFiManager::isConnected())
+        {
+            WiFiManager::reconnect();
+            _enter(ConnectionState::WiFiConnecting, now);
+        }
+        else if ((int32_t)(now - retryAt) >= 0)
+        {
+            _enter(ConnectionState::TLSConnecting, now);
+        }
+        break;
+
+    case ConnectionState::Connected:
+        if (!WiFiManager::isConnected())
+        {
+            _linkLost(now);
+            WiFiManager::reconnect();
+            _enter(ConnectionState::WiFiConnecting, now);
+        }
+        else if (!MQTTClient::getMQTTClient().connected())
+        {
+            _linkLost(now);
+            LOG_WARN("⚠️ MQTT connection lost, rc=%d", MQTTClient::getMQTTClient().state());
+            _enter(ConnectionState::TLSConnecting, now);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+const char *ConnectionManager::stateName(ConnectionState s)
+{
+    switch (s)
+    {
+    case ConnectionState::WiFiConnecting:
+        return "wifi_connecting";
+    case ConnectionState::WiFiBackoff:
+        return "wifi_backoff";
+    case ConnectionState::TLSConnecting:
+        return "tls_connecting";
+    case ConnectionState::MQTTConnecting:
+        return "mqtt_connecting";
+    case ConnectionState::MQTTBackoff:
+        return "mqtt_backoff";
+    case ConnectionState::Connected:
+        return "connected";
+    default:
+        return "unknown";
+    }
+}
+
+void ConnectionManager::_enter(ConnectionState next, uint32_t now)
+{
+    state = next;
+    enteredAt[(uint8_t)next] = now;
+}
+
+void ConnectionManager::_fail(ConnectionState backoffState, uint32_t now)
+{
+    stats.failedAttempts++;
+
+    // Exponential backoff with "equal jitter": half fixed, half random, so a
+    // fleet that lost the broker together does not retry in lockstep
+    uint32_t delayMs = CONN_BACKOFF_BASE_MS << min(attempt, (uint8_t)16);
+    delayMs = min(delayMs, (uint32_t)CONN_BACKOFF_MAX_MS);
+    delayMs = delayMs / 2 + random(delayMs / 2 + 1);
+    if (attempt < UINT8_MAX)
+    {
+        attempt++;
+    }
+
+    retryAt = now + delayMs;
+    LOG_INFO("⏳ Retrying in %lums (attempt %d)", (unsigned long)delayMs, attempt);
+    _enter(backoffState, now);
+}
+
+void ConnectionManager::_linkLost(uint32_t now)
+{
+    outageStart = now;
+    attempt = 0;
+}
+
+void ConnectionManager::_connected(uint32_t now)
+{
+    uint32_t outage = now - outageStart;
+    stats.lastReconnectMs = outage;
+    if (everConnected)
+    {
+        stats.reconnects++;
+        stats.maxReconnectMs = max(stats.maxReconnectMs, outage);
+        stats.totalOutageMs += outage;
+        LOG_INFO("✅ Reconnected after %lums", (unsigned long)outage);
+    }
+    everConnected = true;
+    attempt = 0;
+    _enter(ConnectionState::Connected, now);
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <Arduino.h>
+#include "WiFiManager.h"
+#include "MQTTClient.h"
+#include "DeviceClock.h"
+#include "Logger.h"
+
+// Time allowed for WiFi association before backing off
+#ifndef CONN_WIFI_TIMEOUT_MS
+#define CONN_WIFI_TIMEOUT_MS 15000
+#endif
+
+// First retry delay; doubles on every consecutive failure
+#ifndef CONN_BACKOFF_BASE_MS
+#define CONN_BACKOFF_BASE_MS 1000
+#endif
+
+// Upper bound of the retry delay
+#ifndef CONN_BACKOFF_MAX_MS
+#define CONN_BACKOFF_MAX_MS 60000
+#endif
+
+// Connection states, in the order they are normally visited
+enum class ConnectionState : uint8_t
+{
+    WiFiConnecting, // waiting for association and an IP address
+    WiFiBackoff,    // waiting before the next WiFi attempt
+    TLSConnecting,  // TCP connect and TLS handshake with the broker
+    MQTTConnecting, // MQTT CONNECT/CONNACK and subscriptions
+    MQTTBackoff,    // waiting before the next broker attempt
+    Connected,
+    Count
+};
+
+// Reconnect metrics
+struct ConnectionStats
+{
+    uint32_t reconnects;       // successful connections after a loss (the first connect excluded)
+    uint32_t failedAttempts;   // WiFi timeouts and TLS/MQTT failures
+    uint32_t lastReconnectMs;  // link loss (or boot) -> MQTT connected
+    uint32_t maxReconnectMs;
+    uint32_t totalOutageMs;    // sum of all completed outages
+};
+
+// Drives WiFi, TLS and MQTT connection management as a state machine.
+// loop() returns immediately in every state; retries wait in a backoff state
+// instead of delay(), so OTA and the rest of the network loop keep running.
+// The TLS handshake and CONNACK wait are still single blocking calls, bounded
+// by MQTT_TLS_HANDSHAKE_TIMEOUT_S and MQTT_SOCKET_TIMEOUT_S.
+class ConnectionManager
+{
+public:
+    /**
+     * Start connecting (call once after MQTTClient::init())
+     */
+    static void begin();
+
+    /**
+     * Advance the state machine; call on every pass of the network loop
+     */
+    static void loop();
+
+    static bool isConnected() { return state == ConnectionState::Connected; }
+    static ConnectionState getState() { return state; }
+    static const char *stateName(ConnectionState s);
+
+    /**
+     * @return millis() at which the state was last entered
+     */
+    static uint32_t getStateEnteredAt(ConnectionState s) { return enteredAt[(uint8_t)s]; }
+
+    static const ConnectionStats &getStats() { return stats; }
+
+private:
+    static void _enter(ConnectionState next, uint32_t now);
+    static void _fail(ConnectionState backoffState, uint32_t now);
+    static void _linkLost(uint32_t now);
+    static void _connected(uint32_t now);
+
+    static ConnectionState state;
+    static uint32_t enteredAt[(uint8_t)ConnectionState::Count];
+    static uint32_t retryAt;
+    static uint32_t outageStart;
+    static uint8_t attempt;      // consecutive failures, drives the backoff
+    static bool everConnected;
+    static ConnectionStats stats;
+};
@@ -0,0 +1,43 @@
+#include "DeviceClock.h"
+
+bool DeviceClock::started = false;
+
+void DeviceClock::begin(const char *server)
+{
+    if (started)
+    {
+        return;
+    }
+    started = true;
+
+    // UTC, no DST: timestamps on the wire are epoch based
+    configTime(0, 0, server);
+    LOG_INFO("🕒 SNTP started (%s)", server);
+}
+
+bool DeviceClock::isSynced()
+{
+    return time(nullptr) > CLOCK_VALID_AFTER_S;
+}
+
+uint64_t DeviceClock::epochMs()
+{
+    if (!isSynced())
+    {
+        return 0;
+    }
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+bool DeviceClock::msUntil(uint64_t target, int64_t &deltaMs)
+{
+    uint64_t now = epochMs();
+    if (now == 0)
+    {
+        return false;
+    }
+    deltaMs = (int64_t)(target - now);
+    return true;
+}
\ No newline at end of file
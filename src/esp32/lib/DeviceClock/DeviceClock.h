@@ -0,0 +1,44 @@
+#pragma once
+
+#include <Arduino.h>
+#include <time.h>
+#include <sys/time.h>
+#include "Logger.h"
+
+// Wall-clock times before this are treated as "not synced yet" (2023-11-14)
+#ifndef CLOCK_VALID_AFTER_S
+#define CLOCK_VALID_AFTER_S 1700000000
+#endif
+
+// SNTP-synced wall clock, used to turn absolute command timestamps into
+// millis() deadlines. The clock is kept in UTC; timestamps are epoch ms.
+class DeviceClock
+{
+public:
+    /**
+     * Start SNTP (call once the network is up; later calls are ignored)
+     * @param server NTP server host name
+     */
+    static void begin(const char *server);
+
+    /**
+     * @return true once the clock has been set by SNTP
+     */
+    static bool isSynced();
+
+    /**
+     * @return Milliseconds since the Unix epoch, or 0 if not synced
+     */
+    static uint64_t epochMs();
+
+    /**
+     * Time left until an epoch timestamp
+     * @param target Time in ms since the Unix epoch
+     * @param deltaMs Milliseconds from now (negative if already past)
+     * @return false if the clock is not synced
+     */
+    static bool msUntil(uint64_t target, int64_t &deltaMs);
+
+private:
+    static bool started;
+};
\ No newline at end of file
@@ -0,0 +1,78 @@
+#include "DeviceState.h"
+#include "ConfigLoader.h"
+#include "MQTTClient.h"
+#include "TopicHandlerRegistry.h"
+
+// Starts dirty, so the first connection publishes the boot state
+std::atomic<bool> DeviceState::dirty{true};
+std::atomic<uint32_t> DeviceState::notifications{0};
+uint32_t DeviceState::publishes = 0;
+uint32_t DeviceState::lastPublish = 0;
+uint32_t DeviceState::lastCheck = 0;
+char DeviceState::lastPayload[STATE_PAYLOAD_SIZE];
+size_t DeviceState::lastLength = 0;
+
+void DeviceState::loop()
+{
+    uint32_t now = millis();
+    if (publishes && now - lastPublish < STATE_PUBLISH_INTERVAL_MS)
+    {
+        return;
+    }
+    if (!dirty.load(std::memory_order_acquire) && now - lastCheck < STATE_POLL_INTERVAL_MS)
+    {
+        return;
+    }
+
+    // Clear before reading: a change made while serializing marks it dirty again
+    bool wasDirty = dirty.exchange(false, std::memory_order_acq_rel);
+    lastCheck = now;
+
+    char payload[STATE_PAYLOAD_SIZE];
+    size_t length = serialize(payload, sizeof(payload));
+    if (length == 0)
+    {
+        LOG_WARN("⚠️ State document too large, not published");
+        return;
+    }
+    if (length == lastLength && memcmp(payload, lastPayload, length) == 0)
+    {
+        return;
+    }
+
+    char topic[CONFIG_STRING_SIZE + 32];
+    snprintf(topic, sizeof(topic), "%s/%s", ConfigLoader::getConfig().state_topic, MQTTClient::getClientId());
+    if (!MQTTClient::getMQTTClient().publish(topic, (const uint8_t *)payload, length, true))
+    {
+        LOG_WARN("⚠️ State publish failed");
+        if (wasDirty)
+        {
+            dirty.store(true, std::memory_order_release);
+        }
+        return;
+    }
+
+    memcpy(lastPayload, payload, length);
+    lastLength = length;
+    lastPublish = now;
+    publishes++;
+}
+
+size_t DeviceState::serialize(char *buffer, size_t size)
+{
+    StaticJsonDocument<STATE_PAYLOAD_SIZE> doc;
+    for (TopicHandler *handler : TopicHandlerRegistry::getAllHandlers())
+    {
+        const char *key = handler->getStateKey();
+        if (key)
+        {
+            handler->reportState(doc.createNestedObject(key));
+        }
+    }
+
+    if (doc.overflowed() || measureJson(doc) >= size)
+    {
+        return 0;
+    }
+    return serializeJson(doc, buffer, size);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include "NetworkEvents.h"
+#include "Logger.h"
+
+// Minimum spacing of two state publishes; changes in between are merged
+#ifndef STATE_PUBLISH_INTERVAL_MS
+#define STATE_PUBLISH_INTERVAL_MS 250
+#endif
+
+// The state is also re-checked this often without a notify(), which catches
+// changes nobody announces (a beep or a blink sequence running out)
+#ifndef STATE_POLL_INTERVAL_MS
+#define STATE_POLL_INTERVAL_MS 1000
+#endif
+
+// Size of the serialized state document
+#ifndef STATE_PAYLOAD_SIZE
+#define STATE_PAYLOAD_SIZE 512
+#endif
+
+// Publish counters
+struct DeviceStateStats
+{
+    uint32_t notifications; // notify() calls
+    uint32_t publishes;     // retained state documents sent
+};
+
+// Publishes the handlers' state as one retained document on
+// <state topic>/<client id>. Changes are coalesced: notify() only marks the
+// state dirty, and loop() publishes at most once per STATE_PUBLISH_INTERVAL_MS,
+// and only when the document differs from the last one sent.
+class DeviceState
+{
+public:
+    /**
+     * Mark the state as changed; callable from any task
+     */
+    static void notify()
+    {
+        dirty.store(true, std::memory_order_release);
+        notifications.fetch_add(1, std::memory_order_relaxed);
+        NetworkEvents::wake();
+    }
+
+    /**
+     * Publish the state if it changed; call from the network task while MQTT is connected
+     */
+    static void loop();
+
+    /**
+     * Write the state document (every handler with a state key)
+     * @return Bytes written, 0 if the buffer is too small
+     */
+    static size_t serialize(char *buffer, size_t size);
+
+    static DeviceStateStats getStats() { return DeviceStateStats{notifications.load(), publishes}; }
+
+private:
+    static std::atomic<bool> dirty;
+    static std::atomic<uint32_t> notifications;
+    static uint32_t publishes;
+    static uint32_t lastPublish;
+    static uint32_t lastCheck;
+    static char lastPayload[STATE_PAYLOAD_SIZE];
+    static size_t lastLength;
+};
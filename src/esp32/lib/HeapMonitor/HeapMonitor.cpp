@@ -0,0 +1,106 @@
+#include "HeapMonitor.h"
+
+#ifdef HEAP_MONITOR_WRAP_MALLOC
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static volatile TaskHandle_t scopeTask = nullptr;
+static volatile uint32_t scopeAllocations = 0;
+static volatile uint32_t scopeBytes = 0;
+
+// Only allocations from the task that opened the scope are counted, so
+// WiFi/lwIP activity on other tasks does not pollute the numbers
+static inline void countAllocation(size_t size)
+{
+    if (scopeTask && scopeTask == xTaskGetCurrentTaskHandle())
+    {
+        scopeAllocations = scopeAllocations + 1;
+        scopeBytes = scopeBytes + size;
+    }
+}
+
+extern "C"
+{
+    void *__real_malloc(size_t size);
+    void *__real_calloc(size_t n, size_t size);
+    void *__real_realloc(void *ptr, size_t size);
+
+    void *__wrap_malloc(size_t size)
+    {
+        countAllocation(size);
+        return __real_malloc(size);
+    }
+
+    void *__wrap_calloc(size_t n, size_t size)
+    {
+        countAllocation(n * size);
+        return __real_calloc(n, size);
+    }
+
+    void *__wrap_realloc(void *ptr, size_t size)
+    {
+        countAllocation(size);
+        return __real_realloc(ptr, size);
+    }
+}
+
+#ifndef ARDUINO
+// On the host libstdc++ is a shared library, so its operator new does not go
+// through the wrapped malloc; route it through here instead
+#include <new>
+
+void *operator new(size_t size)
+{
+    void *p = malloc(size);
+    if (!p)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+    free(p);
+}
+#endif
+
+void HeapMonitor::beginScope()
+{
+    scopeAllocations = 0;
+    scopeBytes = 0;
+    scopeTask = xTaskGetCurrentTaskHandle();
+}
+
+HeapScope HeapMonitor::endScope()
+{
+    scopeTask = nullptr;
+    return HeapScope{scopeAllocations, scopeBytes};
+}
+
+bool HeapMonitor::isEnabled()
+{
+    return true;
+}
+
+#else
+
+void HeapMonitor::beginScope() {}
+
+HeapScope HeapMonitor::endScope()
+{
+    return HeapScope{0, 0};
+}
+
+bool HeapMonitor::isEnabled()
+{
+    return false;
+}
+
+#endif
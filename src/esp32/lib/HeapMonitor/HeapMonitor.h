@@ -0,0 +1,36 @@
+#pragma once
+
+#include <Arduino.h>
+
+// Heap activity of one scope
+struct HeapScope
+{
+    uint32_t allocations; // malloc/calloc/realloc calls
+    uint32_t bytes;       // bytes requested by those calls (upper bound of heap growth)
+};
+
+// Counts heap allocations made by one task inside a scope.
+//
+// Counting needs the malloc family to be wrapped at link time: build with
+// -DHEAP_MONITOR_WRAP_MALLOC -Wl,--wrap=malloc -Wl,--wrap=calloc -Wl,--wrap=realloc
+// (see the *-heapstats and native environments in platformio.ini). Without it
+// every scope reports zero and isEnabled() returns false.
+class HeapMonitor
+{
+public:
+    /**
+     * Start counting allocations made by the calling task
+     */
+    static void beginScope();
+
+    /**
+     * Stop counting
+     * @return Allocations and bytes requested since beginScope()
+     */
+    static HeapScope endScope();
+
+    /**
+     * @return true if the allocator is wrapped and counts are meaningful
+     */
+    static bool isEnabled();
+};
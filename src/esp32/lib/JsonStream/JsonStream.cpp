@@ -0,0 +1,141 @@
+#include "JsonStream.h"
+#include <string.h>
+
+// Nesting of the streamed array's elements: the root object, then the array
+static constexpr uint8_t elementDepth = 2;
+
+void JsonStream::begin(JsonDocument &doc, const char *field, JsonElementCallback callback, void *context)
+{
+    _doc = &doc;
+    _doc->clear();
+    _field = field;
+    _callback = callback;
+    _context = context;
+    _error = JsonStreamError::None;
+    _depth = 0;
+    _streaming = false;
+    _elements = 0;
+    _key[0] = '\0';
+    _tokenizer.begin(&JsonStream::_onToken, this);
+}
+
+bool JsonStream::feed(const uint8_t *data, size_t length)
+{
+    return _tokenizer.feed(data, length);
+}
+
+bool JsonStream::end()
+{
+    return _tokenizer.end();
+}
+
+bool JsonStream::_onToken(void *context, JsonToken token, char *text, size_t length)
+{
+    return static_cast<JsonStream *>(context)->_token(token, text, length);
+}
+
+bool JsonStream::_token(JsonToken token, char *text, size_t length)
+{
+    if (token == JsonToken::Key)
+    {
+        memcpy(_key, text, length + 1);
+        return true;
+    }
+    if (token == JsonToken::EndObject || token == JsonToken::EndArray)
+    {
+        _depth--;
+        if (_streaming && _depth == elementDepth - 1)
+        {
+            _streaming = false; // the end of the streamed array
+            return true;
+        }
+        return _streaming && _depth == elementDepth ? _element() : true;
+    }
+    if (_depth == 0 && token != JsonToken::BeginObject)
+    {
+        return _fail(JsonStreamError::Syntax); // commands are objects
+    }
+
+    // The streamed array: the document only gets an empty one
+    bool streamed = !_streaming && _depth == elementDepth - 1 && token == JsonToken::BeginArray &&
+                    strcmp(_key, _field) == 0;
+
+    JsonVariant slot = _slot();
+    switch (token)
+    {
+    case JsonToken::BeginObject:
+        slot.to<JsonObject>();
+        break;
+    case JsonToken::BeginArray:
+        slot.to<JsonArray>();
+        break;
+    case JsonToken::String:
+        slot.set(text); // char*, so ArduinoJson copies it
+        break;
+    case JsonToken::Number:
+    {
+        // Same integer/float rules as deserializeJson()
+        StaticJsonDocument<16> number;
+        deserializeJson(number, text, length);
+        slot.set(number.as<JsonVariantConst>());
+        break;
+    }
+    case JsonToken::True:
+    case JsonToken::False:
+        slot.set(token == JsonToken::True);
+        break;
+    default:
+        break;
+    }
+
+    if ((_streaming ? _elementDoc.overflowed() : _doc->overflowed()))
+    {
+        return _fail(JsonStreamError::NoMemory);
+    }
+
+    if (token == JsonToken::BeginObject || token == JsonToken::BeginArray)
+    {
+        _stack[_depth++] = slot;
+        _streaming |= streamed;
+        return true;
+    }
+    // A scalar element is complete at once
+    return _streaming && _depth == elementDepth ? _element() : true;
+}
+
+// Where the next value goes: a new element, the root, or the innermost open container
+JsonVariant JsonStream::_slot()
+{
+    if (_streaming && _depth == elementDepth)
+    {
+        return _elementDoc.to<JsonVariant>();
+    }
+    if (_depth == 0)
+    {
+        return _doc->to<JsonVariant>();
+    }
+    JsonVariant parent = _stack[_depth - 1];
+    if (parent.is<JsonArray>())
+    {
+        return parent.as<JsonArray>().add();
+    }
+    return parent[_key].to<JsonVariant>(); // a char array key is copied
+}
+
+bool JsonStream::_element()
+{
+    if (!_callback(_context, _elements++, _elementDoc.as<JsonVariantConst>(), _doc->as<JsonObjectConst>()))
+    {
+        return _fail(JsonStreamError::Rejected);
+    }
+    return true;
+}
+
+bool JsonStream::_fail(JsonStreamError error)
+{
+    if (_error == JsonStreamError::None)
+    {
+        _error = error;
+    }
+    return false;
+}
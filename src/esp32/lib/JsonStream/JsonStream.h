@@ -0,0 +1,71 @@
+#pragma once
+
+#include <ArduinoJson.h>
+#include "JsonTokenizer.h"
+
+// Capacity of the document one streamed element is built in
+#ifndef JSON_STREAM_ELEMENT_CAPACITY
+#define JSON_STREAM_ELEMENT_CAPACITY 256
+#endif
+
+// Receives each element of the streamed array, in order; header holds the
+// members that came before the array. Return false to stop the parse.
+typedef bool (*JsonElementCallback)(void *context, size_t index, JsonVariantConst element, JsonObjectConst header);
+
+// Parses a JSON object into a document as the payload arrives, except for one
+// top-level array member: its elements are built one at a time and handed to
+// a callback, and the document only gets an empty array in its place. Memory
+// is the document, one element and one token, however long the array is.
+// Strings are copied into the documents, unlike the zero-copy parse of a
+// whole payload.
+class JsonStream
+{
+public:
+    /**
+     * Start a new payload
+     * @param doc Receives the object, minus the streamed array's elements
+     * @param field Name of the top-level array to stream
+     * @param callback Called for each element of that array
+     */
+    void begin(JsonDocument &doc, const char *field, JsonElementCallback callback, void *context);
+
+    /**
+     * Parse the next part of the payload
+     * @return false once an error occurred (see error())
+     */
+    bool feed(const uint8_t *data, size_t length);
+
+    /**
+     * Finish the payload
+     * @return true if it was one complete JSON object and everything fit
+     */
+    bool end();
+
+    JsonStreamError error() const { return _error != JsonStreamError::None ? _error : _tokenizer.error(); }
+
+    /**
+     * @return Elements of the streamed array handed on so far
+     */
+    size_t elements() const { return _elements; }
+
+private:
+    static bool _onToken(void *context, JsonToken token, char *text, size_t length);
+    bool _token(JsonToken token, char *text, size_t length);
+    JsonVariant _slot();
+    bool _element();
+    bool _fail(JsonStreamError error);
+
+    JsonTokenizer _tokenizer;
+    JsonDocument *_doc = nullptr;
+    StaticJsonDocument<JSON_STREAM_ELEMENT_CAPACITY> _elementDoc;
+    const char *_field = nullptr;
+    JsonElementCallback _callback = nullptr;
+    void *_context = nullptr;
+    JsonStreamError _error = JsonStreamError::None;
+
+    JsonVariant _stack[JSON_STREAM_MAX_DEPTH]; // open containers, outermost first
+    uint8_t _depth = 0;
+    bool _streaming = false; // inside the streamed array
+    size_t _elements = 0;
+    char _key[JSON_STREAM_TOKEN_SIZE]; // name of the member whose value comes next
+};
@@ -0,0 +1,482 @@
+#include "JsonTokenizer.h"
+#include <string.h>
+
+static_assert(JSON_STREAM_MAX_DEPTH <= 32, "the nesting kinds are kept in one 32-bit mask");
+
+static bool isDigit(uint8_t c)
+{
+    return c >= '0' && c <= '9';
+}
+
+// Full JSON number grammar: no leading zeros, '+' or bare '.'
+static bool isValidNumber(const char *s)
+{
+    if (*s == '-')
+    {
+        s++;
+    }
+    if (*s == '0')
+    {
+        s++;
+    }
+    else if (isDigit(*s))
+    {
+        while (isDigit(*s))
+        {
+            s++;
+        }
+    }
+    else
+    {
+        return false;
+    }
+    if (*s == '.')
+    {
+        s++;
+        if (!isDigit(*s))
+        {
+            return false;
+        }
+        while (isDigit(*s))
+        {
+            s++;
+        }
+    }
+    if (*s == 'e' || *s == 'E')
+    {
+        s++;
+        if (*s == '+' || *s == '-')
+        {
+            s++;
+        }
+        if (!isDigit(*s))
+        {
+            return false;
+        }
+        while (isDigit(*s))
+        {
+            s++;
+        }
+    }
+    return *s == '\0';
+}
+
+void JsonTokenizer::begin(JsonTokenCallback callback, void *context)
+{
+    _callback = callback;
+    _context = context;
+    _error = JsonStreamError::None;
+    _expect = Expect::Value;
+    _lexeme = Lexeme::None;
+    _objects = 0;
+    _depth = 0;
+    _length = 0;
+    _highSurrogate = 0;
+}
+
+bool JsonTokenizer::feed(const uint8_t *data, size_t length)
+{
+    for (size_t i = 0; i < length && _error == JsonStreamError::None; i++)
+    {
+        _byte(data[i]);
+    }
+    return _error == JsonStreamError::None;
+}
+
+bool JsonTokenizer::end()
+{
+    if (_error == JsonStreamError::None)
+    {
+        _flush();
+    }
+    if (_error == JsonStreamError::None && (_expect != Expect::Done || _lexeme != Lexeme::None))
+    {
+        _fail(JsonStreamError::Incomplete);
+    }
+    return _error == JsonStreamError::None;
+}
+
+const char *JsonTokenizer::errorString(JsonStreamError error)
+{
+    switch (error)
+    {
+    case JsonStreamError::None:
+        return "Ok";
+    case JsonStreamError::Syntax:
+        return "InvalidInput";
+    case JsonStreamError::TooDeep:
+        return "TooDeep";
+    case JsonStreamError::TooLong:
+        return "TokenTooLong";
+    case JsonStreamError::Incomplete:
+        return "IncompleteInput";
+    case JsonStreamError::Rejected:
+        return "Rejected";
+    case JsonStreamError::NoMemory:
+        return "NoMemory";
+    }
+    return "Unknown";
+}
+
+void JsonTokenizer::_byte(uint8_t c)
+{
+    switch (_lexeme)
+    {
+    case Lexeme::String:
+        // The low half of a surrogate pair must follow the high half at once
+        if (_highSurrogate && c != '\\')
+        {
+            _fail(JsonStreamError::Syntax);
+        }
+        else if (c == '"')
+        {
+            _lexeme = Lexeme::None;
+            if (_isKey)
+            {
+                _emit(JsonToken::Key);
+                _expect = Expect::Colon;
+            }
+            else
+            {
+                _emit(JsonToken::String);
+                _afterValue();
+            }
+        }
+        else if (c == '\\')
+        {
+            _lexeme = Lexeme::Escape;
+        }
+        else if (c < 0x20)
+        {
+            _fail(JsonStreamError::Syntax);
+        }
+        else
+        {
+            _append(c);
+        }
+        return;
+
+    case Lexeme::Escape:
+    {
+        static const char escapes[] = "\"\"\\\\//b\bf\fn\nr\rt\t";
+        _lexeme = Lexeme::String;
+        if (c == 'u')
+        {
+            _lexeme = Lexeme::Unicode;
+            _unit = 0;
+            _hexDigits = 0;
+            return;
+        }
+        const char *e = _highSurrogate ? nullptr : (const char *)memchr(escapes, c, sizeof(escapes) - 1);
+        // Only the even positions hold escape letters
+        if (!e || (e - escapes) % 2)
+        {
+            _fail(JsonStreamError::Syntax);
+            return;
+        }
+        _append(e[1]);
+        return;
+    }
+
+    case Lexeme::Unicode:
+    {
+        uint8_t digit;
+        if (isDigit(c))
+            digit = c - '0';
+        else if (c >= 'a' && c <= 'f')
+            digit = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F')
+            digit = c - 'A' + 10;
+        else
+        {
+            _fail(JsonStreamError::Syntax);
+            return;
+        }
+        _unit = (_unit << 4) | digit;
+        if (++_hexDigits == 4)
+        {
+            _lexeme = Lexeme::String;
+            _escapedUnit(_unit);
+        }
+        return;
+    }
+
+    case Lexeme::Number:
+        if (isDigit(c) || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E')
+        {
+            _append(c);
+            return;
+        }
+        _flush();
+        break; // c ends the number and is read as structure below
+
+    case Lexeme::Literal:
+        if (c >= 'a' && c <= 'z')
+        {
+            _append(c);
+            return;
+        }
+        _flush();
+        break;
+
+    case Lexeme::None:
+        break;
+    }
+
+    if (_error != JsonStreamError::None || c == ' ' || c == '\t' || c == '\n' || c == '\r')
+    {
+        return;
+    }
+
+    bool inObject = _depth && (_objects & (1u << (_depth - 1)));
+    switch (_expect)
+    {
+    case Expect::FirstValue:
+        if (c == ']')
+        {
+            _close(false);
+            return;
+        }
+        _startValue(c);
+        return;
+    case Expect::Value:
+        _startValue(c);
+        return;
+    case Expect::FirstKey:
+        if (c == '}')
+        {
+            _close(true);
+            return;
+        }
+        // fall through
+    case Expect::Key:
+        if (c != '"')
+        {
+            _fail(JsonStreamError::Syntax);
+            return;
+        }
+        _lexeme = Lexeme::String;
+        _isKey = true;
+        _length = 0;
+        return;
+    case Expect::Colon:
+        if (c != ':')
+        {
+            _fail(JsonStreamError::Syntax);
+            return;
+        }
+        _expect = Expect::Value;
+        return;
+    case Expect::CommaOrEnd:
+        if (c == ',')
+        {
+            _expect = inObject ? Expect::Key : Expect::Value;
+        }
+        else if (c == (inObject ? '}' : ']'))
+        {
+            _close(inObject);
+        }
+        else
+        {
+            _fail(JsonStreamError::Syntax);
+        }
+        return;
+    case Expect::Done:
+        // Some publishers send the C string terminator along
+        if (c != '\0')
+        {
+            _fail(JsonStreamError::Syntax);
+        }
+        return;
+    }
+}
+
+void JsonTokenizer::_startValue(uint8_t c)
+{
+    _length = 0;
+    if (c == '{' || c == '[')
+    {
+        _open(c == '{');
+    }
+    else if (c == '"')
+    {
+        _lexeme = Lexeme::String;
+        _isKey = false;
+    }
+    else if (c == '-' || isDigit(c))
+    {
+        _lexeme = Lexeme::Number;
+        _append(c);
+    }
+    else if (c >= 'a' && c <= 'z')
+    {
+        _lexeme = Lexeme::Literal;
+        _append(c);
+    }
+    else
+    {
+        _fail(JsonStreamError::Syntax);
+    }
+}
+
+void JsonTokenizer::_open(bool object)
+{
+    if (_depth == JSON_STREAM_MAX_DEPTH)
+    {
+        _fail(JsonStreamError::TooDeep);
+        return;
+    }
+    if (object)
+    {
+        _objects |= 1u << _depth;
+    }
+    else
+    {
+        _objects &= ~(1u << _depth);
+    }
+    _depth++;
+    _expect = object ? Expect::FirstKey : Expect::FirstValue;
+    _emit(object ? JsonToken::BeginObject : JsonToken::BeginArray);
+}
+
+void JsonTokenizer::_close(bool object)
+{
+    _depth--;
+    _length = 0;
+    _emit(object ? JsonToken::EndObject : JsonToken::EndArray);
+    _afterValue();
+}
+
+void JsonTokenizer::_afterValue()
+{
+    _expect = _depth ? Expect::CommaOrEnd : Expect::Done;
+}
+
+void JsonTokenizer::_append(uint8_t c)
+{
+    if (_length + 1 >= sizeof(_token))
+    {
+        _fail(JsonStreamError::TooLong);
+        return;
+    }
+    _token[_length++] = c;
+}
+
+void JsonTokenizer::_appendCodepoint(uint32_t codepoint)
+{
+    if (codepoint < 0x80)
+    {
+        _append(codepoint);
+    }
+    else if (codepoint < 0x800)
+    {
+        _append(0xC0 | (codepoint >> 6));
+        _append(0x80 | (codepoint & 0x3F));
+    }
+    else if (codepoint < 0x10000)
+    {
+        _append(0xE0 | (codepoint >> 12));
+        _append(0x80 | ((codepoint >> 6) & 0x3F));
+        _append(0x80 | (codepoint & 0x3F));
+    }
+    else
+    {
+        _append(0xF0 | (codepoint >> 18));
+        _append(0x80 | ((codepoint >> 12) & 0x3F));
+        _append(0x80 | ((codepoint >> 6) & 0x3F));
+        _append(0x80 | (codepoint & 0x3F));
+    }
+}
+
+// A \uXXXX escape: characters beyond the BMP come as a surrogate pair
+void JsonTokenizer::_escapedUnit(uint16_t unit)
+{
+    bool high = unit >= 0xD800 && unit < 0xDC00;
+    bool low = unit >= 0xDC00 && unit < 0xE000;
+    if (_highSurrogate)
+    {
+        if (!low)
+        {
+            _fail(JsonStreamError::Syntax);
+            return;
+        }
+        _appendCodepoint(0x10000 + ((uint32_t)(_highSurrogate - 0xD800) << 10) + (unit - 0xDC00));
+        _highSurrogate = 0;
+    }
+    else if (high)
+    {
+        _highSurrogate = unit;
+    }
+    else if (low)
+    {
+        _fail(JsonStreamError::Syntax);
+    }
+    else
+    {
+        _appendCodepoint(unit);
+    }
+}
+
+// End a number or literal, which have no closing character of their own
+void JsonTokenizer::_flush()
+{
+    Lexeme lexeme = _lexeme;
+    if (lexeme != Lexeme::Number && lexeme != Lexeme::Literal)
+    {
+        return;
+    }
+    _lexeme = Lexeme::None;
+    _token[_length] = '\0';
+
+    if (lexeme == Lexeme::Number)
+    {
+        if (!isValidNumber(_token))
+        {
+            _fail(JsonStreamError::Syntax);
+            return;
+        }
+        _emit(JsonToken::Number);
+    }
+    else if (strcmp(_token, "true") == 0)
+    {
+        _length = 0;
+        _emit(JsonToken::True);
+    }
+    else if (strcmp(_token, "false") == 0)
+    {
+        _length = 0;
+        _emit(JsonToken::False);
+    }
+    else if (strcmp(_token, "null") == 0)
+    {
+        _length = 0;
+        _emit(JsonToken::Null);
+    }
+    else
+    {
+        _fail(JsonStreamError::Syntax);
+        return;
+    }
+    _afterValue();
+}
+
+void JsonTokenizer::_emit(JsonToken token)
+{
+    if (_error != JsonStreamError::None)
+    {
+        return;
+    }
+    _token[_length] = '\0';
+    if (!_callback(_context, token, _token, _length))
+    {
+        _fail(JsonStreamError::Rejected);
+    }
+}
+
+void JsonTokenizer::_fail(JsonStreamError error)
+{
+    if (_error == JsonStreamError::None)
+    {
+        _error = error;
+    }
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest string, member name or number the tokenizer holds, terminator included
+#ifndef JSON_STREAM_TOKEN_SIZE
+#define JSON_STREAM_TOKEN_SIZE 64
+#endif
+
+// Deepest nesting of objects and arrays
+#ifndef JSON_STREAM_MAX_DEPTH
+#define JSON_STREAM_MAX_DEPTH 8
+#endif
+
+enum class JsonToken : uint8_t
+{
+    BeginObject,
+    EndObject,
+    BeginArray,
+    EndArray,
+    Key, // member name; its value follows
+    String,
+    Number,
+    True,
+    False,
+    Null,
+};
+
+enum class JsonStreamError : uint8_t
+{
+    None,
+    Syntax,
+    TooDeep,    // nested deeper than JSON_STREAM_MAX_DEPTH
+    TooLong,    // a string or number longer than JSON_STREAM_TOKEN_SIZE
+    Incomplete, // the input ended inside the document
+    Rejected,   // the receiver stopped the parse
+    NoMemory,   // the receiver's document is full
+};
+
+// Receives each token. text is the unescaped string, member name or number,
+// null-terminated and only valid during the call; it is empty for brackets
+// and literals. Return false to stop the parse.
+typedef bool (*JsonTokenCallback)(void *context, JsonToken token, char *text, size_t length);
+
+// Splits JSON into tokens as bytes arrive, however the input is chunked, down
+// to one byte at a time. Only the current token is held, so memory does not
+// grow with the document.
+class JsonTokenizer
+{
+public:
+    /**
+     * Start a new document
+     */
+    void begin(JsonTokenCallback callback, void *context);
+
+    /**
+     * Tokenize the next part of the document
+     * @return false once an error occurred (see error()); later calls do nothing
+     */
+    bool feed(const uint8_t *data, size_t length);
+
+    /**
+     * Finish the document, flushing a number or literal at the very end
+     * @return true if exactly one complete value was read
+     */
+    bool end();
+
+    JsonStreamError error() const { return _error; }
+
+    static const char *errorString(JsonStreamError error);
+
+private:
+    // What the next structural character may be
+    enum class Expect : uint8_t
+    {
+        Value,
+        FirstValue, // after '[': a value or ']'
+        FirstKey,   // after '{': a member name or '}'
+        Key,
+        Colon,
+        CommaOrEnd,
+        Done,
+    };
+
+    // Token being read across calls
+    enum class Lexeme : uint8_t
+    {
+        None,
+        String,
+        Escape,  // after a backslash
+        Unicode, // inside \uXXXX
+        Number,
+        Literal, // true, false or null
+    };
+
+    void _byte(uint8_t c);
+    void _startValue(uint8_t c);
+    void _open(bool object);
+    void _close(bool object);
+    void _afterValue();
+    void _append(uint8_t c);
+    void _appendCodepoint(uint32_t codepoint);
+    void _escapedUnit(uint16_t unit);
+    void _flush();
+    void _emit(JsonToken token);
+    void _fail(JsonStreamError error);
+
+    JsonTokenCallback _callback = nullptr;
+    void *_context = nullptr;
+    JsonStreamError _error = JsonStreamError::None;
+
+    Expect _expect = Expect::Value;
+    Lexeme _lexeme = Lexeme::None;
+    bool _isKey = false;
+    uint32_t _objects = 0; // bit n is set when nesting level n is an object
+    uint8_t _depth = 0;
+
+    char _token[JSON_STREAM_TOKEN_SIZE];
+    size_t _length = 0;
+    uint16_t _unit = 0;          // \uXXXX being read
+    uint8_t _hexDigits = 0;
+    uint16_t _highSurrogate = 0; // first half of a pair, waiting for the second
+};
@@ -0,0 +1,239 @@
+#include "LedEffects.h"
+#include <math.h>
+#include <driver/ledc.h>
+
+uint16_t ledGammaDuty(float level)
+{
+    if (level <= 0)
+    {
+        return 0;
+    }
+    if (level >= 255)
+    {
+        return LED_DUTY_MAX;
+    }
+    return (uint16_t)(powf(level / 255.0f, LED_GAMMA) * LED_DUTY_MAX + 0.5f);
+}
+
+// ====== LedEffectGenerator ======
+
+void LedEffectGenerator::reset(const LedEffect &e, float fromLevel)
+{
+    effect = e;
+    current = fromLevel;
+    phase = 0;
+    cycle = 0;
+    done = false;
+    segments = 0;
+
+    switch (effect.type)
+    {
+    case LedEffectType::Solid:
+        _ramp(effect.level, 0);
+        break;
+    case LedEffectType::Fade:
+        _ramp(effect.level, effect.timeMs);
+        break;
+    case LedEffectType::Breathe:
+        // The first rise starts wherever the output is
+        _ramp(effect.level, effect.timeMs / 2);
+        break;
+    case LedEffectType::Blink:
+        break;
+    }
+}
+
+void LedEffectGenerator::_ramp(float to, uint32_t ms)
+{
+    rampFrom = current;
+    rampTo = to;
+    rampMs = ms;
+    segment = 0;
+    segments = ms == 0 ? 1 : max((uint32_t)LED_RAMP_SEGMENTS, (ms + LED_SEGMENT_MAX_MS - 1) / LED_SEGMENT_MAX_MS);
+}
+
+bool LedEffectGenerator::next(LedKeyframe &out)
+{
+    if (done)
+    {
+        return false;
+    }
+
+    if (effect.type == LedEffectType::Blink)
+    {
+        if (effect.cycles && cycle >= effect.cycles)
+        {
+            done = true;
+            return false;
+        }
+        bool on = phase == 0;
+        current = on ? effect.level : 0;
+        out = {ledGammaDuty(current), 0, on ? effect.timeMs : effect.offMs};
+        phase ^= 1;
+        if (!on)
+        {
+            cycle++;
+        }
+        return true;
+    }
+
+    if (segment == segments)
+    {
+        // Current ramp finished: only Breathe goes on
+        if (effect.type != LedEffectType::Breathe)
+        {
+            done = true;
+            return false;
+        }
+        if (phase == 1)
+        {
+            cycle++;
+            if (effect.cycles && cycle >= effect.cycles)
+            {
+                done = true;
+                return false;
+            }
+        }
+        phase ^= 1;
+        _ramp(phase ? effect.low : effect.level, effect.timeMs / 2);
+    }
+
+    // Segment boundaries come from the total, so rounding never accumulates
+    segment++;
+    current = rampFrom + (rampTo - rampFrom) * segment / segments;
+    uint32_t startMs = (uint64_t)rampMs * (segment - 1) / segments;
+    uint32_t endMs = (uint64_t)rampMs * segment / segments;
+    out = {ledGammaDuty(current), endMs - startMs, 0};
+    return true;
+}
+
+// ====== LedFader ======
+
+// Arduino numbers LEDC channels across speed modes, 8 per mode
+static inline ledc_mode_t ledcMode(uint8_t channel)
+{
+    return (ledc_mode_t)(channel / 8);
+}
+
+static inline ledc_channel_t ledcChannel(uint8_t channel)
+{
+    return (ledc_channel_t)(channel % 8);
+}
+
+bool LedFader::begin(int pin, uint8_t channel)
+{
+    _pin = pin;
+    _channel = channel;
+    if (_pin < 0)
+    {
+        return false;
+    }
+
+    // The fade service is shared by every channel
+    static bool fadeInstalled = false;
+    if (!fadeInstalled)
+    {
+        fadeInstalled = ledc_fade_func_install(0) == ESP_OK;
+    }
+
+    ledcSetup(_channel, LED_PWM_FREQ, LED_PWM_BITS);
+    ledcAttachPin(_pin, _channel);
+    ledcWrite(_channel, 0);
+
+    if (!_timer)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = &LedFader::_onTimer;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "led";
+        esp_timer_create(&args, &_timer);
+    }
+    return _timer != nullptr;
+}
+
+void LedFader::start(const LedEffect &effect)
+{
+    if (_pin < 0 || !_timer)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&_lock);
+    _pending = effect;
+    _hasPending = true;
+    int64_t waitUs = _fadeEndUs - esp_timer_get_time();
+    portEXIT_CRITICAL(&_lock);
+
+    // A fade in progress cannot be retargeted, so take over when it ends. If
+    // the callback re-armed the timer in between, replace its wake-up too.
+    uint64_t timeoutUs = waitUs > 0 ? waitUs : 0;
+    esp_timer_stop(_timer);
+    if (esp_timer_start_once(_timer, timeoutUs) != ESP_OK)
+    {
+        esp_timer_stop(_timer);
+        esp_timer_start_once(_timer, timeoutUs);
+    }
+}
+
+void LedFader::_onTimer(void *arg)
+{
+    static_cast<LedFader *>(arg)->_advance();
+}
+
+void LedFader::_advance()
+{
+    LedKeyframe k;
+    bool more;
+
+    portENTER_CRITICAL(&_lock);
+    if (_hasPending)
+    {
+        _generator.reset(_pending, _generator.level());
+        _hasPending = false;
+        _running = true;
+    }
+    more = _running && _generator.next(k);
+    if (more)
+    {
+        _fadeEndUs = esp_timer_get_time() + (int64_t)k.fadeMs * 1000;
+    }
+    else
+    {
+        _running = false;
+    }
+    portEXIT_CRITICAL(&_lock);
+
+    if (!more)
+    {
+        return;
+    }
+    _apply(k);
+
+    // A final keyframe with nothing to hold needs no wake-up
+    uint32_t stepMs = k.fadeMs + k.holdMs;
+    if (stepMs > 0)
+    {
+        esp_timer_start_once(_timer, (uint64_t)stepMs * 1000);
+    }
+    else
+    {
+        _advance();
+    }
+}
+
+void LedFader::_apply(const LedKeyframe &k)
+{
+    ledc_mode_t mode = ledcMode(_channel);
+    ledc_channel_t channel = ledcChannel(_channel);
+    if (k.fadeMs == 0)
+    {
+        ledc_set_duty(mode, channel, k.duty);
+        ledc_update_duty(mode, channel);
+    }
+    else
+    {
+        ledc_set_fade_with_time(mode, channel, k.duty, k.fadeMs);
+        ledc_fade_start(mode, channel, LEDC_FADE_NO_WAIT);
+    }
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+// LED outputs driven by the engine
+#ifndef LED_MAX_CHANNELS
+#define LED_MAX_CHANNELS 4
+#endif
+
+// LEDC channels 4-7 run on LEDC timers 2 and 3, which the buzzer
+// (channel 2, timer 1) never retunes
+#ifndef LED_LEDC_FIRST_CHANNEL
+#define LED_LEDC_FIRST_CHANNEL 4
+#endif
+
+#ifndef LED_PWM_FREQ
+#define LED_PWM_FREQ 5000
+#endif
+
+#define LED_PWM_BITS 13
+#define LED_DUTY_MAX ((1 << LED_PWM_BITS) - 1)
+
+// Perceived brightness -> duty exponent
+#ifndef LED_GAMMA
+#define LED_GAMMA 2.2f
+#endif
+
+// A hardware fade is linear in duty, so gamma-corrected ramps are split into
+// linear segments: at least LED_RAMP_SEGMENTS, none longer than LED_SEGMENT_MAX_MS
+// (which also bounds how long a new effect waits for a running fade to end)
+#ifndef LED_RAMP_SEGMENTS
+#define LED_RAMP_SEGMENTS 8
+#endif
+
+#ifndef LED_SEGMENT_MAX_MS
+#define LED_SEGMENT_MAX_MS 200
+#endif
+
+enum class LedEffectType : uint8_t
+{
+    Solid,   // jump to level
+    Fade,    // ramp to level over timeMs
+    Breathe, // ramp between low and level, timeMs per full period
+    Blink,   // level for timeMs, off for offMs
+};
+
+// An effect request; levels are perceived brightness 0-255
+struct LedEffect
+{
+    LedEffectType type;
+    uint8_t level;
+    uint8_t low;
+    uint32_t timeMs;
+    uint32_t offMs;
+    uint16_t cycles; // Breathe/Blink repetitions, 0 = forever
+};
+
+// One hardware step: fade linearly to duty over fadeMs, then hold for holdMs
+struct LedKeyframe
+{
+    uint16_t duty;
+    uint32_t fadeMs;
+    uint32_t holdMs;
+};
+
+// Gamma-corrected LEDC duty of a perceived brightness (0-255, fractions allowed)
+uint16_t ledGammaDuty(float level);
+
+// Turns an effect into duty keyframes; has no hardware dependency
+class LedEffectGenerator
+{
+public:
+    /**
+     * Start an effect
+     * @param effect What to play
+     * @param fromLevel Current perceived level, where ramps start
+     */
+    void reset(const LedEffect &effect, float fromLevel);
+
+    /**
+     * Produce the next keyframe
+     * @return false once the effect has ended (out is left untouched)
+     */
+    bool next(LedKeyframe &out);
+
+    // Perceived level reached at the end of the last keyframe
+    float level() const { return current; }
+
+private:
+    void _ramp(float to, uint32_t ms);
+
+    LedEffect effect = {};
+    float current = 0;
+    float rampFrom = 0;
+    float rampTo = 0;
+    uint32_t rampMs = 0;
+    uint16_t segment = 0;
+    uint16_t segments = 0;
+    uint8_t phase = 0; // Breathe: 0 rising, 1 falling; Blink: 0 on, 1 off
+    uint16_t cycle = 0;
+    bool done = true;
+};
+
+// Plays effects on one LEDC channel with the hardware fade unit. The CPU only
+// steps in at keyframe boundaries, from an esp_timer; every LEDC call happens
+// on the esp_timer task, so effects can be replaced from any task.
+class LedFader
+{
+public:
+    /**
+     * Attach the pin to an LEDC channel
+     */
+    bool begin(int pin, uint8_t channel);
+
+    /**
+     * Replace the running effect; the new one starts as soon as the current
+     * fade segment ends (immediately if the output is holding)
+     */
+    void start(const LedEffect &effect);
+
+    bool isAttached() const { return _pin >= 0; }
+    bool isRunning() const { return _running; }
+
+private:
+    static void _onTimer(void *arg);
+    void _advance();
+    void _apply(const LedKeyframe &k);
+
+    int _pin = -1;
+    uint8_t _channel = 0;
+    esp_timer_handle_t _timer = nullptr;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+    LedEffectGenerator _generator;
+    LedEffect _pending = {};
+    bool _hasPending = false;
+    int64_t _fadeEndUs = 0;
+    volatile bool _running = false;
+};
@@ -0,0 +1,131 @@
+#include "Logger.h"
+#include <stdarg.h>
+#include "ConfigLoader.h"
+#include "MQTTClient.h"
+
+static_assert((LOG_RING_SLOTS & (LOG_RING_SLOTS - 1)) == 0, "LOG_RING_SLOTS must be a power of two");
+
+static constexpr uint32_t slotMask = LOG_RING_SLOTS - 1;
+static inline char levelTag(uint8_t level)
+{
+    return level <= LOG_LEVEL_DEBUG ? "-EWID"[level] : '?';
+}
+
+// Slot i is free for the write at position p when seq == p, holds that line
+// when seq == p + 1, and is free for p + LOG_RING_SLOTS once drained. seq is
+// stored minus the slot index so the zero-initialized ring is already valid
+// and write() works before begin().
+Logger::Slot Logger::slots[LOG_RING_SLOTS];
+std::atomic<uint32_t> Logger::writePos{0};
+uint32_t Logger::readPos = 0;
+std::atomic<uint32_t> Logger::dropped{0};
+SpscRing<LogLine, LOG_MQTT_QUEUE_SLOTS> Logger::mqttQueue(RingOverflow::DropOldest);
+
+void Logger::begin()
+{
+    xTaskCreatePinnedToCore(_drainTask, "log", 3072, nullptr, 1, nullptr, tskNO_AFFINITY);
+}
+
+void Logger::write(uint8_t level, const char *format, ...)
+{
+    // Claim a slot
+    uint32_t pos = writePos.load(std::memory_order_relaxed);
+    Slot *slot;
+    while (true)
+    {
+        slot = &slots[pos & slotMask];
+        int32_t diff = (int32_t)(slot->seq.load(std::memory_order_acquire) + (pos & slotMask) - pos);
+        if (diff == 0)
+        {
+            if (writePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            pos = writePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // Format straight into it, then hand it to the drain task
+    LogLine &line = slot->line;
+    line.ms = millis();
+    line.level = level;
+    va_list args;
+    va_start(args, format);
+    int length = vsnprintf(line.text, sizeof(line.text), format, args);
+    va_end(args);
+    line.length = length < 0 ? 0 : min(length, (int)sizeof(line.text) - 1);
+    slot->seq.store(pos + 1 - (pos & slotMask), std::memory_order_release);
+}
+
+bool Logger::pop(LogLine &line)
+{
+    Slot &slot = slots[readPos & slotMask];
+    if (slot.seq.load(std::memory_order_acquire) + (readPos & slotMask) != readPos + 1)
+    {
+        return false;
+    }
+    line = slot.line;
+    slot.seq.store(readPos + LOG_RING_SLOTS - (readPos & slotMask), std::memory_order_release);
+    readPos++;
+    return true;
+}
+
+void Logger::_drainTask(void *arg)
+{
+    LogLine line;
+    uint32_t reportedDrops = 0;
+    char prefix[24];
+    while (true)
+    {
+        while (pop(line))
+        {
+            int n = snprintf(prefix, sizeof(prefix), "%lu.%03lu %c ", (unsigned long)(line.ms / 1000),
+                             (unsigned long)(line.ms % 1000), levelTag(line.level));
+            Serial.write((const uint8_t *)prefix, n);
+            Serial.write((const uint8_t *)line.text, line.length);
+            Serial.write((uint8_t)'\n');
+
+            if (line.level <= LOG_MQTT_LEVEL)
+            {
+                mqttQueue.push(line);
+            }
+        }
+
+        uint32_t drops = getDropped();
+        if (drops != reportedDrops)
+        {
+            Serial.printf("⚠️ %lu log lines dropped\n", (unsigned long)(drops - reportedDrops));
+            reportedDrops = drops;
+        }
+        vTaskDelay(pdMS_TO_TICKS(LOG_DRAIN_INTERVAL_MS));
+    }
+}
+
+void Logger::loop()
+{
+    const char *topic = ConfigLoader::getConfig().log_topic;
+    LogLine line;
+    if (topic[0] == '\0')
+    {
+        while (mqttQueue.pop(line))
+        {
+        }
+        return;
+    }
+
+    // Failures are not logged: they would only queue more lines for this topic
+    while (mqttQueue.pop(line))
+    {
+        char payload[LOG_LINE_SIZE + 16];
+        int n = snprintf(payload, sizeof(payload), "%c %.*s", levelTag(line.level), line.length, line.text);
+        MQTTClient::getMQTTClient().publish(topic, (const uint8_t *)payload, min(n, (int)sizeof(payload) - 1));
+    }
+}
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <Arduino.h>
+#include <atomic>
+#include "SpscRing.h"
+
+// Log levels; a call above LOG_COMPILE_LEVEL is compiled out entirely
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Lines at or above this severity are also published to the log topic
+#ifndef LOG_MQTT_LEVEL
+#define LOG_MQTT_LEVEL LOG_LEVEL_WARN
+#endif
+
+// Text bytes kept per line; longer lines are truncated
+#ifndef LOG_LINE_SIZE
+#define LOG_LINE_SIZE 120
+#endif
+
+// Lines buffered between the writers and the drain task (power of two)
+#ifndef LOG_RING_SLOTS
+#define LOG_RING_SLOTS 32
+#endif
+
+// Lines waiting for the network task to publish them (power of two)
+#ifndef LOG_MQTT_QUEUE_SLOTS
+#define LOG_MQTT_QUEUE_SLOTS 8
+#endif
+
+// How often the drain task wakes up to empty the ring
+#ifndef LOG_DRAIN_INTERVAL_MS
+#define LOG_DRAIN_INTERVAL_MS 20
+#endif
+
+// One formatted log line
+struct LogLine
+{
+    uint32_t ms;
+    uint8_t level;
+    uint8_t length;
+    char text[LOG_LINE_SIZE];
+};
+
+// Leveled logger that never blocks the caller on the UART.
+//
+// write() formats into a slot of a lock-free multi-producer ring (any task,
+// not ISRs) and returns; a low-priority task drains the ring to Serial and
+// queues severe lines for loop(), which publishes them to the log topic from
+// the network task. When the ring is full new lines are dropped and counted.
+class Logger
+{
+public:
+    /**
+     * Start the drain task; lines written before this are kept until the ring fills
+     */
+    static void begin();
+
+    /**
+     * Format and queue a line; use the LOG_* macros so disabled levels cost nothing
+     * @param level LOG_LEVEL_ERROR..LOG_LEVEL_DEBUG
+     */
+    static void write(uint8_t level, const char *format, ...) __attribute__((format(printf, 2, 3)));
+
+    /**
+     * Publish queued lines to the log topic
+     * Call from the network task while MQTT is connected
+     */
+    static void loop();
+
+    /**
+     * @return Lines lost because the ring was full
+     */
+    static uint32_t getDropped() { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    // A ring slot; seq tells producers and the consumer who owns it
+    struct Slot
+    {
+        std::atomic<uint32_t> seq;
+        LogLine line;
+    };
+
+    static bool pop(LogLine &line);
+    static void _drainTask(void *arg);
+
+    static Slot slots[LOG_RING_SLOTS];
+    static std::atomic<uint32_t> writePos;
+    static uint32_t readPos; // drain task only
+    static std::atomic<uint32_t> dropped;
+    static SpscRing<LogLine, LOG_MQTT_QUEUE_SLOTS> mqttQueue;
+};
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_ERROR(...) Logger::write(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define LOG_ERROR(...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_WARN
+#define LOG_WARN(...) Logger::write(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define LOG_WARN(...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_INFO
+#define LOG_INFO(...) Logger::write(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define LOG_INFO(...) do {} while (0)
+#endif
+
+#if LOG_COMPILE_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(...) Logger::write(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define LOG_DEBUG(...) do {} while (0)
+#endif
@@ -1,8 +1,15 @@
 #include "MQTTClient.h"
 
 // Define static members
-WiFiClientSecure MQTTClient::wifiClient;
-PubSubClient MQTTClient::mqttClient(MQTTClient::wifiClient);
+TlsClient MQTTClient::tlsClient;
+MqttBackend MQTTClient::mqttClient(MQTTClient::tlsClient);
+DynamicJsonDocument *MQTTClient::messageDoc = nullptr;
+MQTTMessageStats MQTTClient::messageStats = {};
+RecentIds MQTTClient::recentIds;
+JsonStream MQTTClient::jsonStream;
+TopicHandler *MQTTClient::streamOwner = nullptr;
+uint32_t MQTTClient::streamRxUs = 0;
+char MQTTClient::clientId[32] = "";
 
 /**
  * MQTT message callback
@@ -10,32 +17,242 @@ PubSubClient MQTTClient::mqttClient(MQTTClient::wifiClient);
  */
 void MQTTClient::mqttCallback(char *topic, byte *payload, unsigned int length)
 {
-    Serial.printf("Message arrived [%s]: ", topic);
-    for (unsigned int i = 0; i < length; i++)
+    uint32_t rxUs = micros();
+    _endStream(); // a chunked message cut off by a disconnect
+
+    // Every handler subscribed to the topic (exact or wildcard)
+    TopicHandler *handlers[TOPIC_MAX_HANDLERS_PER_MESSAGE];
+    size_t count = TopicHandlerRegistry::getHandlersForTopic(topic, handlers, TOPIC_MAX_HANDLERS_PER_MESSAGE);
+
+    // A binary handler owns its topic and takes the payload unparsed
+    if (count > 0 && handlers[0]->isBinary())
     {
-        Serial.print((char)payload[i]);
+        handlers[0]->handleBinary(payload, length);
+        return;
     }
-    Serial.println();
 
-    // Parse JSON message
-    DynamicJsonDocument doc(4096);
-    DeserializationError error = deserializeJson(doc, payload, length);
-    if (error)
+    bool msgpack = isMsgPack(payload, length);
+
+    // The payload is only echoed at debug level, and truncated to one log line
+    if (msgpack)
+    {
+        LOG_DEBUG("Message arrived [%s]: <%u bytes MessagePack>", topic, length);
+    }
+    else
     {
-        Serial.print("deserializeJson() failed: ");
-        Serial.println(error.c_str());
+        LOG_DEBUG("Message arrived [%s]: %.*s", topic, (int)min(length, (unsigned int)LOG_LINE_SIZE), (const char *)payload);
+    }
+
+    if (!messageDoc)
+    {
+        LOG_ERROR("❌ Message document not allocated, call init() first");
         return;
     }
 
-    // Dispatch to the corresponding handler
-    TopicHandler *handler = TopicHandlerRegistry::getHandlerForTopic(topic);
-    if (handler)
+    HeapMonitor::beginScope();
+
+    // Parse the message into the reusable arena (deserialization clears it first)
+    // MessagePack and JSON decode into the same document, so handlers see no difference;
+    // a streaming handler's array bypasses the document
+    TopicHandler *streamer = _streamHandler(handlers, count, payload, length);
+    const char *parser = streamer ? "JsonStream" : msgpack ? "deserializeMsgPack()" : "deserializeJson()";
+    const char *error = nullptr;
+    if (streamer)
     {
-        handler->handleMessage(doc);
+        streamOwner = streamer;
+        jsonStream.begin(*messageDoc, streamer->getStreamField(), _streamElement, streamer);
+        if (!jsonStream.feed(payload, length) || !jsonStream.end())
+        {
+            error = JsonTokenizer::errorString(jsonStream.error());
+        }
     }
     else
     {
-        Serial.println("No handler found for topic");
+        DeserializationError result = msgpack ? deserializeMsgPack(*messageDoc, payload, length)
+                                              : deserializeJson(*messageDoc, payload, length);
+        error = result ? result.c_str() : nullptr;
+    }
+    if (error)
+    {
+        _endStream();
+        HeapMonitor::endScope();
+        messageStats.decodeErrors++;
+        LOG_ERROR("%s failed on [%s]: %s", parser, topic, error);
+        return;
+    }
+    if (msgpack)
+    {
+        messageStats.msgpackMessages++;
+    }
+    if (streamer)
+    {
+        messageStats.streamedMessages++;
+    }
+
+    _dispatch(topic, handlers, count, rxUs);
+    _endStream();
+}
+
+// MQTT 5 hands over a message larger than the packet buffer chunk by chunk;
+// the parser keeps its state between chunks
+bool MQTTClient::mqttStreamCallback(char *topic, const uint8_t *data, size_t length, size_t offset, size_t total)
+{
+    TopicHandler *handlers[TOPIC_MAX_HANDLERS_PER_MESSAGE];
+    size_t count = 0;
+    bool last = offset + length == total;
+    if (offset == 0 || last)
+    {
+        count = TopicHandlerRegistry::getHandlersForTopic(topic, handlers, TOPIC_MAX_HANDLERS_PER_MESSAGE);
+    }
+
+    if (offset == 0)
+    {
+        _endStream();
+        TopicHandler *streamer = _streamHandler(handlers, count, data, length);
+        if (!streamer || !messageDoc)
+        {
+            LOG_WARN("⚠️ %u-byte message on [%s] exceeds the packet buffer, dropped", (unsigned)total, topic);
+            return false;
+        }
+        LOG_DEBUG("Message arrived [%s]: <%u bytes in chunks>", topic, (unsigned)total);
+        streamRxUs = micros();
+        HeapMonitor::beginScope();
+        streamOwner = streamer;
+        jsonStream.begin(*messageDoc, streamer->getStreamField(), _streamElement, streamer);
+    }
+
+    if (!jsonStream.feed(data, length) || (last && !jsonStream.end()))
+    {
+        _endStream();
+        HeapMonitor::endScope();
+        messageStats.decodeErrors++;
+        LOG_ERROR("JsonStream failed on [%s] at byte %u: %s", topic, (unsigned)offset,
+                  JsonTokenizer::errorString(jsonStream.error()));
+        return false;
+    }
+    if (last)
+    {
+        messageStats.streamedMessages++;
+        messageStats.chunkedMessages++;
+        _dispatch(topic, handlers, count, streamRxUs);
+        _endStream();
+    }
+    return true;
+}
+
+// The one handler on the topic, if it streams an array and the payload is JSON
+TopicHandler *MQTTClient::_streamHandler(TopicHandler **handlers, size_t count, const byte *payload, size_t length)
+{
+    if (count != 1 || !handlers[0]->getStreamField() || isMsgPack(payload, length))
+    {
+        return nullptr;
+    }
+    return handlers[0];
+}
+
+// Tell the handler its streamed message is over, whatever became of it
+void MQTTClient::_endStream()
+{
+    if (streamOwner)
+    {
+        streamOwner->streamEnd();
+        streamOwner = nullptr;
+    }
+}
+
+bool MQTTClient::_streamElement(void *context, size_t index, JsonVariantConst element, JsonObjectConst header)
+{
+    return static_cast<TopicHandler *>(context)->streamElement(index, element, header);
+}
+
+// Hand a parsed message to its handlers; closes the heap scope opened before parsing
+void MQTTClient::_dispatch(char *topic, TopicHandler **handlers, size_t count, uint32_t rxUs)
+{
+    // The "id" is also the correlation ID of the message's ack
+    JsonVariantConst id = (*messageDoc)["id"];
+    uint16_t ack = id.isNull() ? 0 : CommandAck::open(id, rxUs);
+
+    // A message carrying an "id" that was already handled is a retry: drop it
+    uint32_t idHash = id.isNull() ? 0 : RecentIds::hash(topic, id);
+    if (idHash && recentIds.contains(idHash))
+    {
+        messageStats.duplicates++;
+        LOG_DEBUG("Duplicate message dropped [%s]", topic);
+        CommandAck::record(ack, CommandStatus::Duplicate);
+        HeapMonitor::endScope();
+        return;
+    }
+
+    // Dispatch to every handler
+    bool accepted = false;
+    CommandStatus dispatch = CommandStatus::Ok;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!handlers[i]->getCommandSchema())
+        {
+            // Raw handlers need the document, which is only valid here
+            CommandAck::expect(ack);
+            CommandAck::beginHandler(ack);
+            uint32_t startUs = micros();
+            CommandStatus status = handlers[i]->handleMessage(*messageDoc);
+            uint32_t runUs = micros() - startUs;
+            // A handler that queued commands (a batch) is not what actuates: the
+            // commands report their own timing, or none if they run later
+            if (CommandAck::endHandler() || status == CommandStatus::Queued)
+            {
+                startUs = runUs = 0;
+            }
+            CommandAck::record(ack, status, startUs, runUs);
+            accepted = true;
+            continue;
+        }
+
+        Command cmd;
+        if (TopicHandlerRegistry::decode(handlers[i], messageDoc->as<JsonObjectConst>(), cmd))
+        {
+            accepted |= CommandPipeline::submit(handlers[i], cmd, ack);
+        }
+        else
+        {
+            dispatch = CommandStatus::Invalid;
+        }
+    }
+    if (count == 0)
+    {
+        LOG_INFO("No handler found for topic");
+        dispatch = CommandStatus::NoHandler;
+    }
+    // The ack goes out once the queued commands have run
+    CommandAck::record(ack, dispatch);
+
+    // Only remember IDs of messages that got through, so a retry of a dropped one still runs
+    if (idHash && accepted)
+    {
+        recentIds.add(idHash);
+    }
+
+    HeapScope heap = HeapMonitor::endScope();
+    messageStats.messages++;
+    messageStats.allocations += heap.allocations;
+    messageStats.lastAllocations = heap.allocations;
+    messageStats.maxAllocations = max(messageStats.maxAllocations, heap.allocations);
+    messageStats.lastHeapBytes = heap.bytes;
+    messageStats.maxHeapBytes = max(messageStats.maxHeapBytes, heap.bytes);
+
+    TELEMETRY_RECORD(Metric::Dispatch, rxUs);
+}
+
+/**
+ * Keep the MQTT client running: keep-alive and incoming packets
+ */
+void MQTTClient::loop()
+{
+    // The client reads one packet per call; the socket watcher cannot see
+    // what TLS has already pulled in, so drain that here
+    uint8_t packets = 1;
+    while (mqttClient.loop() && packets < MQTT_LOOP_MAX_PACKETS && tlsClient.hasBufferedInput())
+    {
+        packets++;
     }
 }
 
@@ -46,87 +263,150 @@ void MQTTClient::mqttCallback(char *topic, byte *payload, unsigned int length)
 void MQTTClient::init()
 {
     const auto &cfg = ConfigLoader::getConfig();
-    wifiClient.setCACert(cfg.ca_cert.c_str());
-    mqttClient.setServer(cfg.mqtt_broker.c_str(), cfg.mqtt_port);
+    tlsClient.setCACert(cfg.ca_cert);
+    tlsClient.setHandshakeTimeout(MQTT_TLS_HANDSHAKE_TIMEOUT_S);
+    mqttClient.setServer(cfg.mqtt_broker, cfg.mqtt_port);
     mqttClient.setKeepAlive(60);
+    mqttClient.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+    // The config can only raise the buffer: OTA chunks are sized for MQTT_PACKET_BUFFER_SIZE
+    mqttClient.setBufferSize(max(cfg.mqtt_max_packet, (uint32_t)MQTT_PACKET_BUFFER_SIZE));
     mqttClient.setCallback(mqttCallback);
+#if MQTT_PROTOCOL_VERSION == 5
+    mqttClient.setStreamCallback(mqttStreamCallback);
+#endif
+
+    // Allocate the message document once, sized for the most demanding handler,
+    // so the per-message path never touches the heap
+    if (!messageDoc)
+    {
+        size_t capacity = 0;
+        for (auto h : TopicHandlerRegistry::getAllHandlers())
+        {
+            capacity = max(capacity, h->getDocumentCapacity());
+        }
+        capacity = min(capacity, (size_t)MQTT_DOCUMENT_CAPACITY_MAX);
+        messageDoc = new DynamicJsonDocument(capacity);
+        LOG_INFO("📦 Message document: %u bytes", (unsigned)messageDoc->capacity());
+    }
+}
+
+/**
+ * Open the TCP connection and run the TLS handshake with the broker
+ * The MQTT client reuses an already connected transport in connect()
+ */
+bool MQTTClient::connectTransport()
+{
+    if (tlsClient.connected())
+        return true;
+
+    if (WiFi.status() != WL_CONNECTED)
+    {
+        LOG_ERROR("❌ WiFi not connected, cannot connect to MQTT");
+        return false;
+    }
+
+    const auto &cfg = ConfigLoader::getConfig();
+    LOG_INFO("🔐 TLS connect to %s:%d...", cfg.mqtt_broker, cfg.mqtt_port);
+    if (!tlsClient.connect(cfg.mqtt_broker, cfg.mqtt_port))
+    {
+        char err[64];
+        tlsClient.lastError(err, sizeof(err));
+        LOG_ERROR("❌ TLS connect failed: %s", err);
+        return false;
+    }
+    LOG_INFO("✅ TLS connected");
+    return true;
+}
+
+const char *MQTTClient::getClientId()
+{
+    if (clientId[0] == '\0')
+    {
+        snprintf(clientId, sizeof(clientId), "esp32-client-%s", WiFi.macAddress().c_str());
+    }
+    return clientId;
+}
+
+// Explains a client state code
+static const char *stateReason(int rc)
+{
+#if MQTT_PROTOCOL_VERSION == 5
+    // MQTT 5 reports the CONNACK or DISCONNECT reason code itself
+    if (rc > 0)
+    {
+        return mqtt5ReasonString(rc);
+    }
+#endif
+    switch (rc)
+    {
+    case -4:
+        return "Connection timeout";
+    case -3:
+        return "Connection lost";
+    case -2:
+        return "Connect failed";
+    case -1:
+        return "Disconnected";
+    case 1:
+        return "Bad protocol";
+    case 2:
+        return "Bad client ID";
+    case 3:
+        return "Unavailable";
+    case 4:
+        return "Bad credentials";
+    case 5:
+        return "Unauthorized";
+    default:
+        return "Unknown error";
+    }
 }
 
 /**
  * Connect to the MQTT broker and subscribe to all registered topics
  */
-void MQTTClient::connectToMQTT()
+bool MQTTClient::connectToMQTT()
 {
     if (mqttClient.connected())
-        return;
+        return true;
 
     if (WiFi.status() != WL_CONNECTED)
     {
-        Serial.println("❌ WiFi not connected, cannot connect to MQTT");
-        return;
+        LOG_ERROR("❌ WiFi not connected, cannot connect to MQTT");
+        return false;
     }
 
-    Serial.print("🔗 Attempting MQTT connection...");
-    String client_id = "esp32-client-" + String(WiFi.macAddress());
-
+    LOG_INFO("🔗 Attempting MQTT connection...");
     const auto &cfg = ConfigLoader::getConfig();
-    if (mqttClient.connect(client_id.c_str(), cfg.mqtt_username.c_str(), cfg.mqtt_password.c_str()))
+    // The client ID is derived from the MAC, so a persistent session is found again after a reboot
+    if (mqttClient.connect(getClientId(), cfg.mqtt_username, cfg.mqtt_password, nullptr, 0, false, nullptr,
+                           !MQTT_PERSISTENT_SESSION))
     {
-        Serial.println(" ✅ connected");
+        LOG_INFO("✅ MQTT connected");
 
-        // Subscribe to all registered topic handlers
-        const auto &handlers = TopicHandlerRegistry::getAllHandlers();
-        Serial.printf("📡 Subscribing to %d topics:\n", handlers.size());
-        for (auto h : handlers)
+        // Subscribe to the topic filters of all registered handlers
+        // Subscribe every time, even to a resumed session, so filters added by a
+        // firmware update take effect; SUBSCRIBE is only written, not waited on.
+        // Under MQTT 5 a repeated subscription does not replay retained messages.
+        const auto &topics = TopicHandlerRegistry::getSubscriptions();
+        LOG_INFO("📡 Subscribing to %d topics:", (int)topics.size());
+        for (const auto &topic : topics)
         {
-            if (mqttClient.subscribe(h->getTopic()))
+            if (mqttClient.subscribe(topic.c_str(), MQTT_SUBSCRIBE_QOS))
             {
-                Serial.printf("  ✅ %s\n", h->getTopic());
+                LOG_INFO("  ✅ %s", topic.c_str());
             }
             else
             {
-                Serial.printf("  ❌ Failed to subscribe to %s\n", h->getTopic());
+                LOG_ERROR("  ❌ Failed to subscribe to %s", topic.c_str());
             }
         }
+        return true;
     }
     else
     {
-        Serial.print(" ❌ failed, rc=");
-        Serial.print(mqttClient.state());
-
-        // explain the error code
-        switch (mqttClient.state())
-        {
-        case -4:
-            Serial.println(" (Connection timeout)");
-            break;
-        case -3:
-            Serial.println(" (Connection lost)");
-            break;
-        case -2:
-            Serial.println(" (Connect failed)");
-            break;
-        case -1:
-            Serial.println(" (Disconnected)");
-            break;
-        case 1:
-            Serial.println(" (Bad protocol)");
-            break;
-        case 2:
-            Serial.println(" (Bad client ID)");
-            break;
-        case 3:
-            Serial.println(" (Unavailable)");
-            break;
-        case 4:
-            Serial.println(" (Bad credentials)");
-            break;
-        case 5:
-            Serial.println(" (Unauthorized)");
-            break;
-        default:
-            Serial.println(" (Unknown error)");
-            break;
-        }
+        int rc = mqttClient.state();
+        LOG_ERROR("❌ MQTT connect failed, rc=%d (%s)", rc, stateReason(rc));
+        return false;
     }
 }
@@ -3,10 +3,84 @@
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <WiFi.h>
-#include <WiFiClientSecure.h>
-#include <PubSubClient.h>
+#include "TlsClient.h"
 #include "ConfigLoader.h"
 #include "TopicHandlerRegistry.h"
+#include "HeapMonitor.h"
+#include "CommandPipeline.h"
+#include "CommandAck.h"
+#include "RecentIds.h"
+#include "JsonStream.h"
+#include "Telemetry.h"
+#include "Logger.h"
+
+// 5 talks MQTT 5 through Mqtt5Client (topic aliases, Receive Maximum, Maximum
+// Packet Size); 3 falls back to PubSubClient and MQTT 3.1.1
+#ifndef MQTT_PROTOCOL_VERSION
+#define MQTT_PROTOCOL_VERSION 5
+#endif
+
+#if MQTT_PROTOCOL_VERSION == 5
+#include "Mqtt5Client.h"
+typedef Mqtt5Client MqttBackend;
+#else
+#include <PubSubClient.h>
+typedef PubSubClient MqttBackend;
+#endif
+
+// Packets larger than the buffer are dropped, except under MQTT 5 a JSON
+// message for a streaming handler (a PLAY_SONG score), which arrives in
+// buffer-sized chunks. MQTT 5 tells the broker the limit, which then never
+// sends a larger packet. emqx.max_packet_size in config.json can raise it.
+#ifndef MQTT_PACKET_BUFFER_SIZE
+#define MQTT_PACKET_BUFFER_SIZE 4096
+#endif
+
+// Bounds on the blocking parts of a connection attempt
+#ifndef MQTT_TLS_HANDSHAKE_TIMEOUT_S
+#define MQTT_TLS_HANDSHAKE_TIMEOUT_S 10
+#endif
+
+#ifndef MQTT_SOCKET_TIMEOUT_S
+#define MQTT_SOCKET_TIMEOUT_S 5
+#endif
+
+// Keep the session on the broker across reconnects (cleanSession=false), so
+// QoS 1 commands published while the device is offline are queued for it
+#ifndef MQTT_PERSISTENT_SESSION
+#define MQTT_PERSISTENT_SESSION 1
+#endif
+
+// QoS of the command subscriptions; the broker only queues QoS 1 and 2 reliably
+#ifndef MQTT_SUBSCRIBE_QOS
+#define MQTT_SUBSCRIBE_QOS 1
+#endif
+
+// Upper bound for the shared message document, whatever the handlers ask for
+#ifndef MQTT_DOCUMENT_CAPACITY_MAX
+#define MQTT_DOCUMENT_CAPACITY_MAX 8192
+#endif
+
+// Packets handled per loop() call when TLS already holds more; bounds one network loop pass
+#ifndef MQTT_LOOP_MAX_PACKETS
+#define MQTT_LOOP_MAX_PACKETS 8
+#endif
+
+// Per-message decode statistics
+struct MQTTMessageStats
+{
+    uint32_t messages;         // messages decoded
+    uint32_t msgpackMessages;  // messages received as MessagePack instead of JSON
+    uint32_t decodeErrors;     // payloads rejected by the parser
+    uint32_t streamedMessages; // JSON messages parsed incrementally (see TopicHandler::getStreamField)
+    uint32_t chunkedMessages;  // of those, larger than the packet buffer and received in chunks
+    uint32_t duplicates;       // messages dropped because their "id" was seen recently
+    uint32_t allocations;      // heap allocations across all messages (see HeapMonitor)
+    uint32_t lastAllocations;  // heap allocations of the last message
+    uint32_t maxAllocations;   // worst single message
+    uint32_t lastHeapBytes;    // bytes allocated by the last message
+    uint32_t maxHeapBytes;     // worst single message
+};
 
 class MQTTClient
 {
@@ -19,29 +93,94 @@ public:
      */
     static void mqttCallback(char *topic, byte *payload, unsigned int length);
 
+    /**
+     * MQTT 5 callback for a message larger than the packet buffer, called for
+     * each chunk in order; only a streaming handler can take one
+     * @param offset Position of the chunk in the payload
+     * @param total Payload length
+     * @return false to skip the rest of the message
+     */
+    static bool mqttStreamCallback(char *topic, const uint8_t *data, size_t length, size_t offset, size_t total);
+
     /**
      * Initialize the MQTT client (set server, callback, etc.)
      * This does not connect yet
      */
     static void init();
 
+    /**
+     * Open the TCP connection and run the TLS handshake with the broker
+     * @return true if the secure transport is up
+     */
+    static bool connectTransport();
+
     /**
      * Connect to the MQTT broker and subscribe to all registered topics
+     * Opens the transport first if connectTransport() was not called
+     * @return true if the MQTT session is up
+     */
+    static bool connectToMQTT();
+
+    /**
+     * MQTT client ID, also the device ID in per-device topics
+     * Read from the factory MAC, so it is valid before WiFi starts
+     * @return "esp32-client-<MAC>"
+     */
+    static const char *getClientId();
+
+    /**
+     * Access the MQTT client instance (Mqtt5Client or PubSubClient) if needed
+     * @return Reference to the client object
+     */
+    static MqttBackend &getMQTTClient() { return mqttClient; }
+
+    /**
+     * Detect a MessagePack payload from its first byte
+     * Command payloads are maps: fixmap (0x80-0x8f), map16 (0xde) or map32 (0xdf),
+     * none of which can start a JSON document
      */
-    static void connectToMQTT();
+    static bool isMsgPack(const byte *payload, unsigned int length)
+    {
+        return length > 0 && ((payload[0] & 0xf0) == 0x80 || payload[0] == 0xde || payload[0] == 0xdf);
+    }
 
     /**
-     * Access the internal PubSubClient instance if needed
-     * @return Reference to the PubSubClient object
+     * Decode statistics; allocations are only counted in heapstats builds
+     * @return Reference to the running statistics
      */
-    static PubSubClient &getMQTTClient() { return mqttClient; }
+    static const MQTTMessageStats &getMessageStats() { return messageStats; }
 
     /**
      * Call this in the main loop to keep MQTT client running
+     * Handles every packet TLS has already buffered, up to MQTT_LOOP_MAX_PACKETS
      */
-    static void loop() { mqttClient.loop(); }
+    static void loop();
+
+    /**
+     * Socket of the broker connection, for NetworkEvents to watch
+     * @return The descriptor, -1 when not connected
+     */
+    static int getSocket() { return tlsClient.fd(); }
+
+    /**
+     * @return true if input is buffered that loop() can handle without waiting on the socket
+     */
+    static bool hasPendingInput() { return tlsClient.hasBufferedInput(); }
 
 private:
-    static WiFiClientSecure wifiClient;  // Secure WiFi client for TLS/SSL
-    static PubSubClient mqttClient;      // MQTT client instance
+    static TopicHandler *_streamHandler(TopicHandler **handlers, size_t count, const byte *payload, size_t length);
+    static bool _streamElement(void *context, size_t index, JsonVariantConst element, JsonObjectConst header);
+    static void _endStream();
+    static void _dispatch(char *topic, TopicHandler **handlers, size_t count, uint32_t rxUs);
+
+    static TlsClient tlsClient;          // TLS client with session resumption
+    static MqttBackend mqttClient;       // MQTT client instance
+
+    static DynamicJsonDocument *messageDoc; // Reusable document arena, allocated once in init()
+    static MQTTMessageStats messageStats;
+    static RecentIds recentIds; // "id"s of recently handled messages
+    static JsonStream jsonStream; // incremental parser for streaming handlers
+    static TopicHandler *streamOwner; // handler of the streamed message until streamEnd()
+    static uint32_t streamRxUs;   // arrival of the chunked message being received
+    static char clientId[32];
 };
@@ -0,0 +1,682 @@
+#include "Mqtt5Client.h"
+
+Mqtt5Client &Mqtt5Client::setServer(const char *domain, uint16_t port)
+{
+    _domain = domain;
+    _port = port;
+    return *this;
+}
+
+Mqtt5Client &Mqtt5Client::setCallback(Mqtt5Callback callback)
+{
+    _callback = callback;
+    return *this;
+}
+
+Mqtt5Client &Mqtt5Client::setStreamCallback(Mqtt5StreamCallback callback)
+{
+    _streamCallback = callback;
+    return *this;
+}
+
+Mqtt5Client &Mqtt5Client::setKeepAlive(uint16_t seconds)
+{
+    _keepAliveMs = seconds * 1000u;
+    return *this;
+}
+
+Mqtt5Client &Mqtt5Client::setSocketTimeout(uint16_t seconds)
+{
+    _socketTimeoutMs = seconds * 1000u;
+    return *this;
+}
+
+bool Mqtt5Client::setBufferSize(size_t size)
+{
+    if (size < 64)
+    {
+        return false;
+    }
+    uint8_t *buffer = (uint8_t *)realloc(_buffer, size);
+    if (!buffer)
+    {
+        return false;
+    }
+    _buffer = buffer;
+    _bufferSize = size;
+    return true;
+}
+
+bool Mqtt5Client::connect(const char *id, const char *user, const char *pass, const char *willTopic,
+                          uint8_t willQos, bool willRetain, const char *willMessage, bool cleanStart)
+{
+    if (!_buffer && !setBufferSize(256))
+    {
+        _state = ConnectFailed;
+        return false;
+    }
+    if (!_client.connected() && !_client.connect(_domain, _port))
+    {
+        _state = ConnectFailed;
+        return false;
+    }
+
+    uint8_t flags = (cleanStart ? 0x02 : 0) | (user ? 0x80 : 0) | (pass ? 0x40 : 0);
+    if (willTopic)
+    {
+        flags |= 0x04 | ((willQos & 3) << 3) | (willRetain ? 0x20 : 0);
+    }
+
+    // Receive Maximum, Topic Alias Maximum, Maximum Packet Size and, to keep
+    // the session after a disconnect, Session Expiry Interval
+    size_t props = 3 + 3 + 5 + (cleanStart ? 0 : 5);
+    size_t remaining = 10 + mqtt5VarintSize(props) + props + 2 + strlen(id);
+    if (willTopic)
+    {
+        remaining += 1 + 2 + strlen(willTopic) + 2 + strlen(willMessage ? willMessage : "");
+    }
+    if (user)
+    {
+        remaining += 2 + strlen(user);
+    }
+    if (pass)
+    {
+        remaining += 2 + strlen(pass);
+    }
+
+    Mqtt5Writer w(_buffer, _bufferSize);
+    w.header(MQTT5_CONNECT << 4, remaining);
+    w.string("MQTT");
+    w.u8(5);
+    w.u8(flags);
+    w.u16(_keepAliveMs / 1000);
+    w.varint(props);
+    w.u8(MQTT5_PROP_RECEIVE_MAXIMUM);
+    w.u16(MQTT5_RECEIVE_MAXIMUM);
+    w.u8(MQTT5_PROP_TOPIC_ALIAS_MAXIMUM);
+    w.u16(MQTT5_TOPIC_ALIASES_IN);
+    w.u8(MQTT5_PROP_MAXIMUM_PACKET_SIZE);
+    w.u32(_streamCallback ? max((uint32_t)_bufferSize, (uint32_t)MQTT5_MAX_STREAM_PACKET) : _bufferSize);
+    if (!cleanStart)
+    {
+        w.u8(MQTT5_PROP_SESSION_EXPIRY);
+        w.u32(MQTT5_SESSION_EXPIRY_S);
+    }
+    w.string(id);
+    if (willTopic)
+    {
+        w.varint(0); // no will properties
+        w.string(willTopic);
+        w.string(willMessage ? willMessage : "");
+    }
+    if (user)
+    {
+        w.string(user);
+    }
+    if (pass)
+    {
+        w.string(pass);
+    }
+    if (!w.ok())
+    {
+        LOG_ERROR("❌ MQTT CONNECT does not fit the %u-byte buffer", (unsigned)_bufferSize);
+        _lost(ConnectFailed);
+        return false;
+    }
+
+    _state = Connected; // lets _write() and the reads run; reset below on failure
+    if (!_write(_buffer, w.size()))
+    {
+        _lost(ConnectFailed);
+        return false;
+    }
+
+    uint8_t header;
+    size_t length;
+    if (!_readPacket(header, length))
+    {
+        if (_state == Connected)
+        {
+            _lost(ConnectFailed);
+        }
+        return false;
+    }
+    if ((header >> 4) != MQTT5_CONNACK || !_parseConnack(length))
+    {
+        _client.stop();
+        if (_state == Connected)
+        {
+            _state = ConnectFailed;
+        }
+        return false;
+    }
+
+    // Aliases only live as long as the network connection
+    _aliasesOutUsed = 0;
+    for (char *topic : _aliasesIn)
+    {
+        topic[0] = '\0';
+    }
+    _pingOutstanding = false;
+    _lastInMs = _lastOutMs = millis();
+    return true;
+}
+
+bool Mqtt5Client::_parseConnack(size_t length)
+{
+    Mqtt5Reader reader(_buffer, length);
+    _sessionPresent = reader.u8() & 1;
+    uint8_t reason = reader.u8();
+
+    _serverMaxPacket = MQTT5_MAX_REMAINING_LENGTH;
+    _serverAliasMax = 0;
+    _sessionKeepAliveMs = _keepAliveMs;
+    const char *reasonText = "";
+    uint16_t reasonLength = 0;
+
+    // An MQTT 3.1.1 broker answers with just two bytes and no properties
+    Mqtt5Reader props = reader.remaining() ? reader.properties() : Mqtt5Reader(nullptr, 0);
+    Mqtt5Property p;
+    while (props.property(p))
+    {
+        switch (p.id)
+        {
+        case MQTT5_PROP_MAXIMUM_PACKET_SIZE:
+            _serverMaxPacket = p.number;
+            break;
+        case MQTT5_PROP_TOPIC_ALIAS_MAXIMUM:
+            _serverAliasMax = p.number;
+            break;
+        case MQTT5_PROP_SERVER_KEEP_ALIVE:
+            _sessionKeepAliveMs = p.number * 1000u;
+            break;
+        case MQTT5_PROP_REASON_STRING:
+            reasonText = p.data;
+            reasonLength = p.length;
+            break;
+        default:
+            break;
+        }
+    }
+
+    if (reader.failed() || props.failed())
+    {
+        LOG_ERROR("❌ Malformed CONNACK");
+        _state = ConnectFailed;
+        return false;
+    }
+    if (reason >= 0x80)
+    {
+        LOG_ERROR("❌ MQTT broker refused the connection: %s %.*s", mqtt5ReasonString(reason), reasonLength,
+                  reasonText);
+        _state = reason;
+        return false;
+    }
+    return true;
+}
+
+void Mqtt5Client::disconnect()
+{
+    if (_state == Connected)
+    {
+        uint8_t packet[2] = {MQTT5_DISCONNECT << 4, 0};
+        _write(packet, sizeof(packet));
+    }
+    _state = Disconnected;
+    _client.stop();
+}
+
+bool Mqtt5Client::connected()
+{
+    if (_state == Connected && !_client.connected())
+    {
+        _lost(ConnectionLost);
+    }
+    return _state == Connected;
+}
+
+bool Mqtt5Client::loop()
+{
+    if (!connected())
+    {
+        return false;
+    }
+
+    uint32_t now = millis();
+    if (_sessionKeepAliveMs &&
+        (now - _lastInMs >= _sessionKeepAliveMs || now - _lastOutMs >= _sessionKeepAliveMs))
+    {
+        if (_pingOutstanding)
+        {
+            _lost(ConnectionTimeout);
+            return false;
+        }
+        uint8_t ping[2] = {MQTT5_PINGREQ << 4, 0};
+        if (!_write(ping, sizeof(ping)))
+        {
+            return false;
+        }
+        _lastInMs = now; // the broker gets one more keep-alive period to answer
+        _pingOutstanding = true;
+    }
+
+    if (_client.available() > 0)
+    {
+        uint8_t header;
+        size_t length;
+        if (_readPacket(header, length))
+        {
+            _handlePacket(header, length);
+        }
+    }
+    return _state == Connected;
+}
+
+bool Mqtt5Client::subscribe(const char *topic, uint8_t qos)
+{
+    if (!connected())
+    {
+        return false;
+    }
+
+    Mqtt5Writer w(_buffer, _bufferSize);
+    w.header((MQTT5_SUBSCRIBE << 4) | 2, 2 + 1 + 2 + strlen(topic) + 1);
+    w.u16(_packetId());
+    w.varint(0);
+    w.string(topic);
+    // Retain Handling 1: retained messages only for a subscription the session did not have yet
+    w.u8((qos & 3) | 0x10);
+    return w.ok() && _write(_buffer, w.size());
+}
+
+bool Mqtt5Client::publish(const char *topic, const char *payload, bool retained)
+{
+    return publish(topic, (const uint8_t *)payload, strlen(payload), retained, nullptr, 0);
+}
+
+bool Mqtt5Client::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained)
+{
+    return publish(topic, payload, length, retained, nullptr, 0);
+}
+
+bool Mqtt5Client::publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained,
+                          const Mqtt5UserProperty *properties, size_t propertyCount)
+{
+    if (!connected())
+    {
+        return false;
+    }
+
+    bool known;
+    uint16_t alias = _outgoingAlias(topic, known);
+    const char *wireTopic = known ? "" : topic;
+    size_t size = mqtt5PublishSize(wireTopic, alias, 0, properties, propertyCount, length);
+    if (size > _bufferSize || size > _serverMaxPacket)
+    {
+        LOG_WARN("⚠️ Publish to %s dropped: %u bytes exceeds the %u-byte limit", topic, (unsigned)size,
+                 (unsigned)min((uint32_t)_bufferSize, _serverMaxPacket));
+        return false;
+    }
+
+    size_t n = mqtt5EncodePublish(_buffer, _bufferSize, wireTopic, alias, 0, retained, 0, properties, propertyCount,
+                                  payload, length);
+    if (n == 0 || !_write(_buffer, n))
+    {
+        return false;
+    }
+
+    // The broker knows an alias once a packet carrying it and the topic went out
+    if (alias && !known)
+    {
+        strcpy(_aliasesOut[alias - 1], topic);
+        _aliasesOutUsed++;
+    }
+    _stats.publishesOut++;
+    if (known)
+    {
+        _stats.aliasedOut++;
+    }
+    return true;
+}
+
+// Alias for a topic: an existing one (known), the next free one, or 0 when
+// the table is full, the broker allows none or the topic is too long
+uint16_t Mqtt5Client::_outgoingAlias(const char *topic, bool &known)
+{
+    known = false;
+    for (uint16_t i = 0; i < _aliasesOutUsed; i++)
+    {
+        if (strcmp(_aliasesOut[i], topic) == 0)
+        {
+            known = true;
+            return i + 1;
+        }
+    }
+    uint16_t limit = min(_serverAliasMax, (uint16_t)MQTT5_TOPIC_ALIASES);
+    if (_aliasesOutUsed < limit && strlen(topic) < MQTT5_ALIAS_TOPIC_SIZE)
+    {
+        return _aliasesOutUsed + 1;
+    }
+    return 0;
+}
+
+void Mqtt5Client::_handlePacket(uint8_t header, size_t length)
+{
+    Mqtt5Reader reader(_buffer, length);
+    switch (header >> 4)
+    {
+    case MQTT5_PUBLISH:
+        _handlePublish(header & 0x0f, length);
+        break;
+    case MQTT5_PUBREL:
+        _writeAck(MQTT5_PUBCOMP, reader.u16());
+        break;
+    case MQTT5_SUBACK:
+    {
+        reader.u16();
+        reader.properties();
+        while (reader.remaining())
+        {
+            uint8_t reason = reader.u8();
+            if (reason >= 0x80)
+            {
+                LOG_WARN("⚠️ MQTT subscription refused: %s", mqtt5ReasonString(reason));
+            }
+        }
+        break;
+    }
+    case MQTT5_PINGRESP:
+        _pingOutstanding = false;
+        break;
+    case MQTT5_DISCONNECT:
+    {
+        uint8_t reason = length ? reader.u8() : 0;
+        LOG_WARN("⚠️ MQTT broker disconnected: %s", mqtt5ReasonString(reason));
+        _lost(reason ? reason : ConnectionLost);
+        break;
+    }
+    default:
+        break; // we never have QoS 1/2 publishes of our own in flight
+    }
+}
+
+void Mqtt5Client::_handlePublish(uint8_t flags, size_t length)
+{
+    Mqtt5Publish msg;
+    if (!mqtt5ParsePublish(flags, _buffer, length, msg))
+    {
+        // Without a packet id there is nothing to acknowledge; the broker redelivers after a reconnect
+        LOG_WARN("⚠️ Malformed MQTT PUBLISH dropped");
+        return;
+    }
+    _stats.publishesIn++;
+    if (msg.payloadLength > _stats.largestPayload)
+    {
+        _stats.largestPayload = msg.payloadLength;
+    }
+
+    char *topic = _topicOf(msg);
+    if (topic && _callback)
+    {
+        _current = &msg;
+        _callback(topic, (uint8_t *)msg.payload, msg.payloadLength);
+        _current = nullptr;
+    }
+
+    // Acknowledge only after dispatch: with Receive Maximum this is what paces the broker
+    _ackPublish(msg.qos, msg.packetId);
+}
+
+// Deliver a PUBLISH larger than the buffer to the stream callback. The topic
+// and properties stay at the start of the buffer; each chunk of the payload
+// is read in behind them, the first one already with the header.
+// @return false if the packet was left untouched, to be skipped as oversize
+bool Mqtt5Client::_streamPublish(uint8_t flags, size_t length, size_t kept)
+{
+    Mqtt5Publish msg;
+    if (!mqtt5ParsePublish(flags, _buffer, kept, msg) || msg.payload == _buffer + _bufferSize)
+    {
+        return false; // no room left for the payload behind the header
+    }
+    size_t headerSize = msg.payload - _buffer;
+    size_t total = length - headerSize;
+    _stats.publishesIn++;
+    _stats.largestPayload = max(_stats.largestPayload, (uint32_t)total);
+
+    char *topic = _topicOf(msg);
+    uint8_t *chunk = _buffer + headerSize;
+    size_t received = kept - headerSize; // payload bytes read so far
+    size_t offset = 0;                   // payload bytes handed on so far
+    bool taken = topic != nullptr;
+    _current = &msg;
+    while (taken)
+    {
+        taken = _streamCallback(topic, chunk, received - offset, offset, total);
+        offset = received;
+        if (!taken || received == total)
+        {
+            break;
+        }
+        size_t n = min(total - received, _bufferSize - headerSize);
+        if (!_readBytes(chunk, n, millis()))
+        {
+            _current = nullptr;
+            return true; // the connection is gone, and with it the need to acknowledge
+        }
+        received += n;
+    }
+    _current = nullptr;
+
+    if (offset == total)
+    {
+        _stats.streamed++;
+    }
+    else
+    {
+        _stats.oversize++;
+    }
+    if (received < total && !_skipBytes(total - received))
+    {
+        return true;
+    }
+    _ackPublish(msg.qos, msg.packetId);
+    return true;
+}
+
+// Topic of an incoming PUBLISH, null-terminated: a topic with an alias
+// (re)defines it, an empty topic is sent by alias only
+char *Mqtt5Client::_topicOf(Mqtt5Publish &msg)
+{
+    if (msg.topicAlias > MQTT5_TOPIC_ALIASES_IN)
+    {
+        LOG_WARN("⚠️ MQTT topic alias %u is above our maximum", msg.topicAlias);
+        return nullptr;
+    }
+    if (msg.topicLength > 0)
+    {
+        // Move the topic over its length prefix to null-terminate it in place
+        char *topic = (char *)msg.topic - 2;
+        memmove(topic, msg.topic, msg.topicLength);
+        topic[msg.topicLength] = '\0';
+        if (msg.topicAlias && msg.topicLength < MQTT5_ALIAS_TOPIC_SIZE)
+        {
+            memcpy(_aliasesIn[msg.topicAlias - 1], topic, msg.topicLength + 1);
+        }
+        return topic;
+    }
+    if (_aliasesIn[msg.topicAlias - 1][0])
+    {
+        return _aliasesIn[msg.topicAlias - 1];
+    }
+    LOG_WARN("⚠️ MQTT PUBLISH with unknown topic alias %u dropped", msg.topicAlias);
+    return nullptr;
+}
+
+void Mqtt5Client::_ackPublish(uint8_t qos, uint16_t packetId)
+{
+    if (qos == 1)
+    {
+        _writeAck(MQTT5_PUBACK, packetId);
+    }
+    else if (qos == 2)
+    {
+        _writeAck(MQTT5_PUBREC, packetId);
+    }
+}
+
+// Read one packet into the buffer; waits up to the socket timeout for the rest of it
+bool Mqtt5Client::_readPacket(uint8_t &header, size_t &length)
+{
+    uint32_t start = millis();
+    if (!_readByte(header, start))
+    {
+        return false;
+    }
+    length = 0;
+    for (int shift = 0;; shift += 7)
+    {
+        uint8_t b;
+        if (!_readByte(b, start))
+        {
+            return false;
+        }
+        if (shift > 21)
+        {
+            LOG_WARN("⚠️ Malformed MQTT packet length");
+            _lost(ConnectionLost);
+            return false;
+        }
+        length |= (size_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            break;
+        }
+    }
+
+    size_t size = 1 + mqtt5VarintSize(length) + length;
+    size_t kept = min(length, _bufferSize);
+    if (!_readBytes(_buffer, kept, start))
+    {
+        return false;
+    }
+    _stats.bytesIn += size;
+    _lastInMs = millis();
+    if (size <= _bufferSize)
+    {
+        return true;
+    }
+
+    // A PUBLISH the stream callback may take goes to it in chunks
+    uint8_t qos = (header >> 1) & 3;
+    if ((header >> 4) == MQTT5_PUBLISH && _streamCallback && size <= MQTT5_MAX_STREAM_PACKET &&
+        _streamPublish(header & 0x0f, length, kept))
+    {
+        return false;
+    }
+
+    // Larger than the Maximum Packet Size we announced, which a broker should
+    // never send: skip it, but acknowledge a PUBLISH so it is not redelivered forever
+    if (!_skipBytes(length - kept))
+    {
+        return false;
+    }
+    _stats.oversize++;
+    LOG_WARN("⚠️ MQTT packet of %u bytes exceeds the %u-byte buffer, dropped", (unsigned)size,
+             (unsigned)_bufferSize);
+
+    if ((header >> 4) == MQTT5_PUBLISH && qos > 0)
+    {
+        Mqtt5Reader reader(_buffer, kept);
+        uint16_t topicLength;
+        reader.string(topicLength);
+        uint16_t packetId = reader.u16();
+        if (!reader.failed())
+        {
+            _ackPublish(qos, packetId);
+        }
+    }
+    return false;
+}
+
+// Read past bytes that are not kept; each call gets the socket timeout
+bool Mqtt5Client::_skipBytes(size_t length)
+{
+    uint32_t start = millis();
+    uint8_t scratch[64];
+    while (length > 0)
+    {
+        size_t n = min(length, sizeof(scratch));
+        if (!_readBytes(scratch, n, start))
+        {
+            return false;
+        }
+        length -= n;
+    }
+    return true;
+}
+
+bool Mqtt5Client::_readByte(uint8_t &out, uint32_t startMs)
+{
+    return _readBytes(&out, 1, startMs);
+}
+
+bool Mqtt5Client::_readBytes(uint8_t *out, size_t length, uint32_t startMs)
+{
+    size_t got = 0;
+    while (got < length)
+    {
+        int n = _client.available() > 0 ? _client.read(out + got, length - got) : 0;
+        if (n > 0)
+        {
+            got += n;
+            continue;
+        }
+        if (!_client.connected())
+        {
+            _lost(ConnectionLost);
+            return false;
+        }
+        if (millis() - startMs >= _socketTimeoutMs)
+        {
+            _lost(ConnectionTimeout);
+            return false;
+        }
+        delay(1);
+    }
+    return true;
+}
+
+// One write per packet, so TLS sends it as one record
+bool Mqtt5Client::_write(const uint8_t *data, size_t length)
+{
+    if (_client.write(data, length) != length)
+    {
+        _lost(ConnectionLost);
+        return false;
+    }
+    _stats.bytesOut += length;
+    _lastOutMs = millis();
+    return true;
+}
+
+bool Mqtt5Client::_writeAck(uint8_t type, uint16_t packetId)
+{
+    uint8_t packet[4] = {(uint8_t)(type << 4), 2, (uint8_t)(packetId >> 8), (uint8_t)packetId};
+    return _write(packet, sizeof(packet));
+}
+
+uint16_t Mqtt5Client::_packetId()
+{
+    uint16_t id = _nextPacketId++;
+    if (_nextPacketId == 0)
+    {
+        _nextPacketId = 1;
+    }
+    return id;
+}
+
+void Mqtt5Client::_lost(int state)
+{
+    _state = state;
+    _client.stop();
+}
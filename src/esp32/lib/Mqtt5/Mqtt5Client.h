@@ -0,0 +1,204 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include "Mqtt5Codec.h"
+#include "Logger.h"
+
+// Topic aliases this client assigns to its own publishes (the broker's Topic
+// Alias Maximum may allow fewer). Repeated publishes to an aliased topic
+// send two bytes instead of the topic string.
+#ifndef MQTT5_TOPIC_ALIASES
+#define MQTT5_TOPIC_ALIASES 8
+#endif
+
+// Topic aliases the broker may assign to the messages it sends us
+#ifndef MQTT5_TOPIC_ALIASES_IN
+#define MQTT5_TOPIC_ALIASES_IN 8
+#endif
+
+// Longest topic that gets an alias, terminator included
+#ifndef MQTT5_ALIAS_TOPIC_SIZE
+#define MQTT5_ALIAS_TOPIC_SIZE 64
+#endif
+
+// QoS 1/2 messages the broker may have unacknowledged in flight to us; a
+// session backlog after a reconnect arrives in windows of this size instead
+// of all at once
+#ifndef MQTT5_RECEIVE_MAXIMUM
+#define MQTT5_RECEIVE_MAXIMUM 8
+#endif
+
+// How long the broker keeps a persistent session after the connection drops
+// (MQTT 5 ends the session on disconnect unless this is set)
+#ifndef MQTT5_SESSION_EXPIRY_S
+#define MQTT5_SESSION_EXPIRY_S 604800
+#endif
+
+// Largest PUBLISH taken through the stream callback, which gets a payload
+// larger than the packet buffer in buffer-sized chunks; announced to the
+// broker as our Maximum Packet Size once a stream callback is set
+#ifndef MQTT5_MAX_STREAM_PACKET
+#define MQTT5_MAX_STREAM_PACKET 32768
+#endif
+
+// MQTT 5 wire counters
+struct Mqtt5Stats
+{
+    uint32_t bytesIn;        // MQTT bytes received (before TLS)
+    uint32_t bytesOut;       // MQTT bytes sent
+    uint32_t publishesIn;
+    uint32_t publishesOut;
+    uint32_t aliasedOut;     // publishes sent with a topic alias instead of the topic
+    uint32_t oversize;       // incoming packets larger than the buffer, skipped
+    uint32_t streamed;       // incoming packets larger than the buffer, delivered in chunks
+    uint32_t largestPayload; // biggest PUBLISH payload received
+};
+
+// Receives every PUBLISH; topic is null-terminated, payload is not
+typedef void (*Mqtt5Callback)(char *topic, uint8_t *payload, unsigned int length);
+
+// Receives a PUBLISH too large for the buffer in chunks, in order; offset is
+// the chunk's position in a payload of total bytes. Return false to skip the
+// rest of the message
+typedef bool (*Mqtt5StreamCallback)(char *topic, const uint8_t *data, size_t length, size_t offset, size_t total);
+
+// MQTT 5 client over any Arduino Client (TlsClient on the device). It keeps
+// the part of the PubSubClient API this firmware uses, so MQTTClient can
+// switch backends, and adds what MQTT 3.1.1 lacks: topic aliases, Receive
+// Maximum, a Maximum Packet Size the broker honours, user properties and
+// reason codes. One buffer serves both directions, so do not publish from
+// inside the callback.
+class Mqtt5Client
+{
+public:
+    // state() values; positive values are CONNACK or DISCONNECT reason codes
+    static constexpr int ConnectionTimeout = -4;
+    static constexpr int ConnectionLost = -3;
+    static constexpr int ConnectFailed = -2;
+    static constexpr int Disconnected = -1;
+    static constexpr int Connected = 0;
+
+    explicit Mqtt5Client(Client &client) : _client(client) {}
+    ~Mqtt5Client() { free(_buffer); }
+    Mqtt5Client(const Mqtt5Client &) = delete;
+    Mqtt5Client &operator=(const Mqtt5Client &) = delete;
+
+    Mqtt5Client &setServer(const char *domain, uint16_t port);
+    Mqtt5Client &setCallback(Mqtt5Callback callback);
+
+    /**
+     * Take PUBLISH packets larger than the buffer, up to MQTT5_MAX_STREAM_PACKET,
+     * in chunks instead of skipping them; applies from the next connect
+     */
+    Mqtt5Client &setStreamCallback(Mqtt5StreamCallback callback);
+    Mqtt5Client &setKeepAlive(uint16_t seconds);
+    Mqtt5Client &setSocketTimeout(uint16_t seconds);
+
+    /**
+     * Allocate the packet buffer; also announced to the broker as our
+     * Maximum Packet Size, so it never sends us anything larger
+     * @return false if the allocation failed (the old buffer is kept)
+     */
+    bool setBufferSize(size_t size);
+    size_t getBufferSize() const { return _bufferSize; }
+
+    /**
+     * Open the session: CONNECT, then wait up to the socket timeout for CONNACK
+     * The will is optional (willTopic nullptr); cleanStart false resumes the
+     * persistent session, kept MQTT5_SESSION_EXPIRY_S after a disconnect
+     */
+    bool connect(const char *id, const char *user, const char *pass, const char *willTopic = nullptr,
+                 uint8_t willQos = 0, bool willRetain = false, const char *willMessage = nullptr,
+                 bool cleanStart = true);
+    void disconnect();
+    bool connected();
+    int state() const { return _state; }
+
+    /**
+     * Handle one incoming packet if one is waiting, and keep the connection alive
+     * @return false once the connection is down
+     */
+    bool loop();
+
+    /**
+     * Subscribe; retained messages are only sent for a new subscription, so
+     * subscribing again after resuming a session does not replay them
+     */
+    bool subscribe(const char *topic, uint8_t qos = 0);
+
+    bool publish(const char *topic, const char *payload, bool retained = false);
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained = false);
+
+    /**
+     * Publish (QoS 0) with user properties
+     * @return false if not connected, or the packet exceeds our buffer or the broker's Maximum Packet Size
+     */
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained,
+                 const Mqtt5UserProperty *properties, size_t propertyCount);
+
+    /**
+     * @return true if the broker still had our session on the last connect
+     */
+    bool sessionPresent() const { return _sessionPresent; }
+
+    /**
+     * The PUBLISH being delivered, for its properties
+     * @return nullptr outside the callback
+     */
+    const Mqtt5Publish *currentMessage() const { return _current; }
+
+    /**
+     * @return Largest packet the broker accepts from us
+     */
+    uint32_t getServerMaxPacket() const { return _serverMaxPacket; }
+
+    const Mqtt5Stats &getStats() const { return _stats; }
+
+private:
+    bool _readByte(uint8_t &out, uint32_t startMs);
+    bool _readBytes(uint8_t *out, size_t length, uint32_t startMs);
+    bool _readPacket(uint8_t &header, size_t &length);
+    bool _write(const uint8_t *data, size_t length);
+    bool _writeAck(uint8_t type, uint16_t packetId);
+    uint16_t _packetId();
+    void _handlePacket(uint8_t header, size_t length);
+    void _handlePublish(uint8_t flags, size_t length);
+    bool _streamPublish(uint8_t flags, size_t length, size_t kept);
+    char *_topicOf(Mqtt5Publish &msg);
+    void _ackPublish(uint8_t qos, uint16_t packetId);
+    bool _skipBytes(size_t length);
+    bool _parseConnack(size_t length);
+    uint16_t _outgoingAlias(const char *topic, bool &known);
+    void _lost(int state);
+
+    Client &_client;
+    const char *_domain = nullptr;
+    uint16_t _port = 0;
+    Mqtt5Callback _callback = nullptr;
+    Mqtt5StreamCallback _streamCallback = nullptr;
+    uint32_t _keepAliveMs = 60000;        // what we ask for
+    uint32_t _sessionKeepAliveMs = 60000; // what the broker granted
+    uint32_t _socketTimeoutMs = 5000;
+
+    uint8_t *_buffer = nullptr;
+    size_t _bufferSize = 0;
+
+    int _state = Disconnected;
+    bool _sessionPresent = false;
+    bool _pingOutstanding = false;
+    uint32_t _lastInMs = 0;
+    uint32_t _lastOutMs = 0;
+    uint16_t _nextPacketId = 1;
+
+    // Limits the broker announced in CONNACK
+    uint32_t _serverMaxPacket = MQTT5_MAX_REMAINING_LENGTH;
+    uint16_t _serverAliasMax = 0;
+
+    char _aliasesOut[MQTT5_TOPIC_ALIASES][MQTT5_ALIAS_TOPIC_SIZE]; // alias n+1 -> topic
+    uint16_t _aliasesOutUsed = 0;
+    char _aliasesIn[MQTT5_TOPIC_ALIASES_IN][MQTT5_ALIAS_TOPIC_SIZE]; // alias n+1 -> topic, "" = unset
+
+    const Mqtt5Publish *_current = nullptr;
+    Mqtt5Stats _stats = {};
+};
@@ -0,0 +1,370 @@
+#include "Mqtt5Codec.h"
+#include <string.h>
+
+size_t mqtt5VarintSize(uint32_t value)
+{
+    return value < 128 ? 1 : value < 16384 ? 2 : value < 2097152 ? 3 : 4;
+}
+
+const char *mqtt5ReasonString(uint8_t reason)
+{
+    switch (reason)
+    {
+    case 0x00:
+        return "Success";
+    case 0x04:
+        return "Disconnect with will";
+    case 0x80:
+        return "Unspecified error";
+    case 0x81:
+        return "Malformed packet";
+    case 0x82:
+        return "Protocol error";
+    case 0x84:
+        return "Unsupported protocol version";
+    case 0x85:
+        return "Client ID not valid";
+    case 0x86:
+        return "Bad user name or password";
+    case 0x87:
+        return "Not authorized";
+    case 0x88:
+        return "Server unavailable";
+    case 0x89:
+        return "Server busy";
+    case 0x8A:
+        return "Banned";
+    case 0x8B:
+        return "Server shutting down";
+    case 0x8D:
+        return "Keep alive timeout";
+    case 0x8E:
+        return "Session taken over";
+    case 0x8F:
+        return "Topic filter invalid";
+    case 0x93:
+        return "Receive maximum exceeded";
+    case 0x94:
+        return "Topic alias invalid";
+    case 0x95:
+        return "Packet too large";
+    case 0x97:
+        return "Quota exceeded";
+    case 0x9C:
+        return "Use another server";
+    case 0x9F:
+        return "Connection rate exceeded";
+    default:
+        return "Unknown reason";
+    }
+}
+
+// --- Mqtt5Writer ---
+
+void Mqtt5Writer::u8(uint8_t value)
+{
+    bytes(&value, 1);
+}
+
+void Mqtt5Writer::u16(uint16_t value)
+{
+    uint8_t b[2] = {(uint8_t)(value >> 8), (uint8_t)value};
+    bytes(b, 2);
+}
+
+void Mqtt5Writer::u32(uint32_t value)
+{
+    uint8_t b[4] = {(uint8_t)(value >> 24), (uint8_t)(value >> 16), (uint8_t)(value >> 8), (uint8_t)value};
+    bytes(b, 4);
+}
+
+void Mqtt5Writer::varint(uint32_t value)
+{
+    do
+    {
+        uint8_t b = value & 0x7f;
+        value >>= 7;
+        u8(value ? b | 0x80 : b);
+    } while (value);
+}
+
+void Mqtt5Writer::bytes(const void *data, size_t length)
+{
+    if (_overflow || length > _capacity - _size)
+    {
+        _overflow = true;
+        return;
+    }
+    memcpy(_buffer + _size, data, length);
+    _size += length;
+}
+
+void Mqtt5Writer::string(const char *text, size_t length)
+{
+    u16(length);
+    bytes(text, length);
+}
+
+void Mqtt5Writer::string(const char *text)
+{
+    string(text, strlen(text));
+}
+
+void Mqtt5Writer::header(uint8_t typeAndFlags, uint32_t remainingLength)
+{
+    u8(typeAndFlags);
+    varint(remainingLength);
+}
+
+// --- Mqtt5Reader ---
+
+bool Mqtt5Reader::_take(size_t n)
+{
+    if (_failed || n > _length - _offset)
+    {
+        _failed = true;
+        return false;
+    }
+    _offset += n;
+    return true;
+}
+
+uint8_t Mqtt5Reader::u8()
+{
+    return _take(1) ? _data[_offset - 1] : 0;
+}
+
+uint16_t Mqtt5Reader::u16()
+{
+    if (!_take(2))
+    {
+        return 0;
+    }
+    const uint8_t *p = _data + _offset - 2;
+    return (p[0] << 8) | p[1];
+}
+
+uint32_t Mqtt5Reader::u32()
+{
+    if (!_take(4))
+    {
+        return 0;
+    }
+    const uint8_t *p = _data + _offset - 4;
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+uint32_t Mqtt5Reader::varint()
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 28; shift += 7)
+    {
+        uint8_t b = u8();
+        value |= (uint32_t)(b & 0x7f) << shift;
+        if (!(b & 0x80))
+        {
+            return value;
+        }
+    }
+    _failed = true; // more than 4 bytes
+    return 0;
+}
+
+const char *Mqtt5Reader::string(uint16_t &length)
+{
+    length = u16();
+    const char *text = (const char *)position();
+    if (!_take(length))
+    {
+        length = 0;
+        return "";
+    }
+    return text;
+}
+
+Mqtt5Reader Mqtt5Reader::properties()
+{
+    uint32_t length = varint();
+    const uint8_t *start = position();
+    if (!_take(length))
+    {
+        Mqtt5Reader empty(start, 0);
+        empty._failed = true;
+        return empty;
+    }
+    return Mqtt5Reader(start, length);
+}
+
+bool Mqtt5Reader::property(Mqtt5Property &out)
+{
+    if (remaining() == 0)
+    {
+        return false;
+    }
+    out = {};
+    out.id = u8();
+    switch (out.id)
+    {
+    case 0x01: // payload format indicator
+    case 0x17: // request problem information
+    case 0x19: // request response information
+    case 0x24: // maximum QoS
+    case 0x25: // retain available
+    case 0x28: // wildcard subscription available
+    case 0x29: // subscription identifiers available
+    case 0x2A: // shared subscription available
+        out.number = u8();
+        break;
+    case 0x13: // server keep alive
+    case 0x21: // receive maximum
+    case 0x22: // topic alias maximum
+    case 0x23: // topic alias
+        out.number = u16();
+        break;
+    case 0x02: // message expiry interval
+    case 0x11: // session expiry interval
+    case 0x18: // will delay interval
+    case 0x27: // maximum packet size
+        out.number = u32();
+        break;
+    case 0x0B: // subscription identifier
+        out.number = varint();
+        break;
+    case 0x03: // content type
+    case 0x08: // response topic
+    case 0x09: // correlation data
+    case 0x12: // assigned client identifier
+    case 0x15: // authentication method
+    case 0x16: // authentication data
+    case 0x1A: // response information
+    case 0x1C: // server reference
+    case 0x1F: // reason string
+        out.data = string(out.length);
+        break;
+    case 0x26: // user property
+        out.data = string(out.length);
+        out.data2 = string(out.length2);
+        break;
+    default:
+        _failed = true; // the length of an unknown property is unknowable
+        return false;
+    }
+    return !_failed;
+}
+
+// --- PUBLISH ---
+
+bool Mqtt5Publish::userProperty(const char *name, const char *&value, uint16_t &length) const
+{
+    Mqtt5Reader reader(properties, propertiesLength);
+    Mqtt5Property p;
+    size_t nameLength = strlen(name);
+    while (reader.property(p))
+    {
+        if (p.id == MQTT5_PROP_USER_PROPERTY && p.length == nameLength && memcmp(p.data, name, nameLength) == 0)
+        {
+            value = p.data2;
+            length = p.length2;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool mqtt5ParsePublish(uint8_t flags, const uint8_t *body, size_t length, Mqtt5Publish &out)
+{
+    out = {};
+    out.qos = (flags >> 1) & 3;
+    out.retain = flags & 1;
+    out.dup = flags & 8;
+    if (out.qos == 3)
+    {
+        return false;
+    }
+
+    Mqtt5Reader reader(body, length);
+    out.topic = reader.string(out.topicLength);
+    if (out.qos > 0)
+    {
+        out.packetId = reader.u16();
+    }
+
+    Mqtt5Reader props = reader.properties();
+    out.properties = props.position();
+    out.propertiesLength = props.remaining();
+    Mqtt5Property p;
+    while (props.property(p))
+    {
+        if (p.id == MQTT5_PROP_TOPIC_ALIAS)
+        {
+            out.topicAlias = p.number;
+        }
+        else if (p.id == MQTT5_PROP_RESPONSE_TOPIC)
+        {
+            out.responseTopic = p.data;
+            out.responseTopicLength = p.length;
+        }
+        else if (p.id == MQTT5_PROP_CORRELATION_DATA)
+        {
+            out.correlationData = p.data;
+            out.correlationDataLength = p.length;
+        }
+    }
+
+    out.payload = reader.position();
+    out.payloadLength = reader.remaining();
+    return !reader.failed() && !props.failed() && (out.topicLength > 0 || out.topicAlias > 0);
+}
+
+// Property section of a PUBLISH, without its length prefix
+static size_t publishPropertiesSize(uint16_t topicAlias, const Mqtt5UserProperty *properties, size_t propertyCount)
+{
+    size_t size = topicAlias ? 3 : 0;
+    for (size_t i = 0; i < propertyCount; i++)
+    {
+        size += 5 + strlen(properties[i].name) + strlen(properties[i].value);
+    }
+    return size;
+}
+
+size_t mqtt5PublishSize(const char *topic, uint16_t topicAlias, uint8_t qos, const Mqtt5UserProperty *properties,
+                        size_t propertyCount, size_t payloadLength)
+{
+    size_t props = publishPropertiesSize(topicAlias, properties, propertyCount);
+    size_t remaining = 2 + strlen(topic) + (qos ? 2 : 0) + mqtt5VarintSize(props) + props + payloadLength;
+    return 1 + mqtt5VarintSize(remaining) + remaining;
+}
+
+size_t mqtt5EncodePublish(uint8_t *buffer, size_t capacity, const char *topic, uint16_t topicAlias, uint8_t qos,
+                          bool retain, uint16_t packetId, const Mqtt5UserProperty *properties, size_t propertyCount,
+                          const uint8_t *payload, size_t payloadLength)
+{
+    size_t props = publishPropertiesSize(topicAlias, properties, propertyCount);
+    size_t remaining = 2 + strlen(topic) + (qos ? 2 : 0) + mqtt5VarintSize(props) + props + payloadLength;
+    if (remaining > MQTT5_MAX_REMAINING_LENGTH)
+    {
+        return 0;
+    }
+
+    Mqtt5Writer w(buffer, capacity);
+    w.header((MQTT5_PUBLISH << 4) | (qos << 1) | (retain ? 1 : 0), remaining);
+    w.string(topic);
+    if (qos)
+    {
+        w.u16(packetId);
+    }
+    w.varint(props);
+    if (topicAlias)
+    {
+        w.u8(MQTT5_PROP_TOPIC_ALIAS);
+        w.u16(topicAlias);
+    }
+    for (size_t i = 0; i < propertyCount; i++)
+    {
+        w.u8(MQTT5_PROP_USER_PROPERTY);
+        w.string(properties[i].name);
+        w.string(properties[i].value);
+    }
+    w.bytes(payload, payloadLength);
+    return w.ok() ? w.size() : 0;
+}
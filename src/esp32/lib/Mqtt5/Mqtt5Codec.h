@@ -0,0 +1,183 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MQTT 5 control packet types (upper nibble of the fixed header)
+enum Mqtt5PacketType : uint8_t
+{
+    MQTT5_CONNECT = 1,
+    MQTT5_CONNACK = 2,
+    MQTT5_PUBLISH = 3,
+    MQTT5_PUBACK = 4,
+    MQTT5_PUBREC = 5,
+    MQTT5_PUBREL = 6,
+    MQTT5_PUBCOMP = 7,
+    MQTT5_SUBSCRIBE = 8,
+    MQTT5_SUBACK = 9,
+    MQTT5_PINGREQ = 12,
+    MQTT5_PINGRESP = 13,
+    MQTT5_DISCONNECT = 14,
+};
+
+// Property identifiers this client reads or writes
+enum Mqtt5PropertyId : uint8_t
+{
+    MQTT5_PROP_RESPONSE_TOPIC = 0x08,
+    MQTT5_PROP_CORRELATION_DATA = 0x09,
+    MQTT5_PROP_SESSION_EXPIRY = 0x11,
+    MQTT5_PROP_SERVER_KEEP_ALIVE = 0x13,
+    MQTT5_PROP_REASON_STRING = 0x1F,
+    MQTT5_PROP_RECEIVE_MAXIMUM = 0x21,
+    MQTT5_PROP_TOPIC_ALIAS_MAXIMUM = 0x22,
+    MQTT5_PROP_TOPIC_ALIAS = 0x23,
+    MQTT5_PROP_USER_PROPERTY = 0x26,
+    MQTT5_PROP_MAXIMUM_PACKET_SIZE = 0x27,
+};
+
+// Fixed header: type byte plus up to 4 bytes of remaining length
+#define MQTT5_MAX_FIXED_HEADER 5
+
+// Largest remaining length the variable byte integer can express
+#define MQTT5_MAX_REMAINING_LENGTH 268435455u
+
+// A user property to send: two UTF-8 strings
+struct Mqtt5UserProperty
+{
+    const char *name;
+    const char *value;
+};
+
+// Bytes a variable byte integer takes
+size_t mqtt5VarintSize(uint32_t value);
+
+/**
+ * Describe a CONNACK, PUBACK, SUBACK or DISCONNECT reason code
+ */
+const char *mqtt5ReasonString(uint8_t reason);
+
+// Appends to a caller-owned buffer. Running out of room is remembered
+// rather than reported per call, so a packet is built first and checked once.
+class Mqtt5Writer
+{
+public:
+    Mqtt5Writer(uint8_t *buffer, size_t capacity) : _buffer(buffer), _capacity(capacity) {}
+
+    void u8(uint8_t value);
+    void u16(uint16_t value);
+    void u32(uint32_t value);
+    void varint(uint32_t value);
+    void bytes(const void *data, size_t length);
+    void string(const char *text, size_t length); // length-prefixed UTF-8 string or binary data
+    void string(const char *text);
+
+    // Fixed header of a packet whose remaining length is known up front
+    void header(uint8_t typeAndFlags, uint32_t remainingLength);
+
+    size_t size() const { return _size; }
+    bool ok() const { return !_overflow; }
+
+private:
+    uint8_t *_buffer;
+    size_t _capacity;
+    size_t _size = 0;
+    bool _overflow = false;
+};
+
+// One property value; which fields are set depends on the property's type
+struct Mqtt5Property
+{
+    uint8_t id;
+    uint32_t number;    // byte, two/four byte and variable byte integers
+    const char *data;   // strings and binary data (not null-terminated)
+    uint16_t length;
+    const char *data2;  // value of a user property
+    uint16_t length2;
+};
+
+// Reads a received packet body. A field past the end marks the reader failed
+// and reads as zero, so a packet is parsed first and checked once.
+class Mqtt5Reader
+{
+public:
+    Mqtt5Reader(const uint8_t *data, size_t length) : _data(data), _length(length) {}
+
+    uint8_t u8();
+    uint16_t u16();
+    uint32_t u32();
+    uint32_t varint();
+    const char *string(uint16_t &length); // length-prefixed; returns a pointer into the packet
+
+    /**
+     * Split off the property section that starts here
+     * @return A reader over just the properties
+     */
+    Mqtt5Reader properties();
+
+    /**
+     * Read the next property (call on a reader returned by properties())
+     * @return false at the end or on an unknown property id
+     */
+    bool property(Mqtt5Property &out);
+
+    const uint8_t *position() const { return _data + _offset; }
+    size_t remaining() const { return _failed ? 0 : _length - _offset; }
+    bool failed() const { return _failed; }
+
+private:
+    bool _take(size_t n);
+
+    const uint8_t *_data;
+    size_t _length;
+    size_t _offset = 0;
+    bool _failed = false;
+};
+
+// A decoded PUBLISH. The pointers refer into the packet buffer; the topic is
+// empty when the sender used only a topic alias.
+struct Mqtt5Publish
+{
+    uint8_t qos;
+    bool retain;
+    bool dup;
+    const char *topic;
+    uint16_t topicLength;
+    uint16_t packetId;
+    uint16_t topicAlias; // 0 = none
+    const char *responseTopic;
+    uint16_t responseTopicLength;
+    const char *correlationData;
+    uint16_t correlationDataLength;
+    const uint8_t *properties; // raw property section, for user properties
+    size_t propertiesLength;
+    const uint8_t *payload;
+    size_t payloadLength;
+
+    /**
+     * Look up a user property by name
+     * @return false if the message does not carry it
+     */
+    bool userProperty(const char *name, const char *&value, uint16_t &length) const;
+};
+
+/**
+ * Decode a PUBLISH packet body
+ * @param flags Lower nibble of the fixed header
+ * @return false if the packet is malformed
+ */
+bool mqtt5ParsePublish(uint8_t flags, const uint8_t *body, size_t length, Mqtt5Publish &out);
+
+/**
+ * Size of the PUBLISH packet encodeMqtt5Publish() would produce
+ * @param topic Topic name, "" when sending by alias only
+ */
+size_t mqtt5PublishSize(const char *topic, uint16_t topicAlias, uint8_t qos, const Mqtt5UserProperty *properties,
+                        size_t propertyCount, size_t payloadLength);
+
+/**
+ * Encode a PUBLISH packet
+ * @return Bytes written, 0 if it does not fit
+ */
+size_t mqtt5EncodePublish(uint8_t *buffer, size_t capacity, const char *topic, uint16_t topicAlias, uint8_t qos,
+                          bool retain, uint16_t packetId, const Mqtt5UserProperty *properties, size_t propertyCount,
+                          const uint8_t *payload, size_t payloadLength);
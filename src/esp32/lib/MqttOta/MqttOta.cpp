@@ -0,0 +1,441 @@
+#include "MqttOta.h"
+#include <esp_ota_ops.h>
+#include <esp_rom_crc.h>
+#include <rom/miniz.h>
+#include <mbedtls/sha256.h>
+#include <Preferences.h>
+#include "ConfigLoader.h"
+
+static constexpr uint32_t OTA_SECTOR_SIZE = 4096;
+static constexpr uint32_t OTA_WINDOW_SIZE = TINFL_LZ_DICT_SIZE;
+
+static const char *progressNamespace = "ota";
+static const char *progressKey = "progress";
+
+OtaState MqttOta::state = OtaState::Idle;
+const esp_partition_t *MqttOta::partition = nullptr;
+uint8_t MqttOta::sha256[32];
+uint32_t MqttOta::size = 0;
+uint32_t MqttOta::offset = 0;
+uint32_t MqttOta::written = 0;
+uint32_t MqttOta::erasedUpTo = 0;
+uint32_t MqttOta::savedOffset = 0;
+bool MqttOta::compressed = false;
+void *MqttOta::inflater = nullptr;
+uint8_t *MqttOta::window = nullptr;
+uint32_t MqttOta::windowPos = 0;
+char MqttOta::error[48] = "";
+uint32_t MqttOta::nonce = 0;
+// Starts dirty, so the first connection reports the running firmware
+bool MqttOta::statusDirty = true;
+bool MqttOta::stateChanged = true;
+uint32_t MqttOta::lastStatus = 0;
+uint32_t MqttOta::doneAt = 0;
+OtaStats MqttOta::stats = {};
+
+static inline uint32_t readLe32(const uint8_t *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static bool parseSha256(const char *hex, uint8_t *out)
+{
+    if (!hex || strlen(hex) != 64)
+    {
+        return false;
+    }
+    for (int i = 0; i < 32; i++)
+    {
+        char byte[3] = {hex[i * 2], hex[i * 2 + 1], '\0'};
+        char *end;
+        out[i] = (uint8_t)strtoul(byte, &end, 16);
+        if (*end != '\0')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+const char *MqttOta::getTopic()
+{
+    // Built on first use: the client ID comes from the MAC and never changes
+    static char topic[CONFIG_STRING_SIZE + 32] = "";
+    if (topic[0] == '\0')
+    {
+        snprintf(topic, sizeof(topic), "%s/%s", ConfigLoader::getConfig().ota_topic, MQTTClient::getClientId());
+    }
+    return topic;
+}
+
+const char *MqttOta::stateName(OtaState s)
+{
+    switch (s)
+    {
+    case OtaState::Idle:
+        return "idle";
+    case OtaState::Receiving:
+        return "receiving";
+    case OtaState::Done:
+        return "done";
+    case OtaState::Failed:
+        return "failed";
+    default:
+        return "unknown";
+    }
+}
+
+bool MqttOta::begin(uint32_t newSize, const char *sha256Hex, bool newCompressed, uint32_t newNonce)
+{
+    uint8_t digest[32];
+    if (newSize == 0 || !parseSha256(sha256Hex, digest))
+    {
+        LOG_WARN("⚠️ OTA: begin needs a size and a 64-digit sha256");
+        return false;
+    }
+    if (state == OtaState::Done)
+    {
+        LOG_WARN("⚠️ OTA: update already finished, rebooting");
+        return false;
+    }
+
+    // The same transfer again: carry on from where it is
+    if (state == OtaState::Receiving && newSize == size && newCompressed == compressed &&
+        memcmp(digest, sha256, sizeof(digest)) == 0)
+    {
+        stats.resumes++;
+        nonce = newNonce;
+        statusDirty = true;
+        stateChanged = true;
+        LOG_INFO("📦 OTA: resuming at %lu/%lu", (unsigned long)offset, (unsigned long)size);
+        return true;
+    }
+
+    _release();
+    nonce = newNonce; // a failure below is this begin's answer too
+    partition = esp_ota_get_next_update_partition(nullptr);
+    if (!partition)
+    {
+        _fail("no update partition");
+        return false;
+    }
+    if (!newCompressed && newSize > partition->size)
+    {
+        _fail("image too large");
+        return false;
+    }
+
+    memcpy(sha256, digest, sizeof(sha256));
+    size = newSize;
+    compressed = newCompressed;
+    offset = written = erasedUpTo = savedOffset = 0;
+    error[0] = '\0';
+
+    // An uncompressed transfer cut by a reboot continues from its last saved offset
+    Progress saved;
+    if (!compressed && _loadProgress(saved) && saved.size == size && saved.offset <= size &&
+        saved.partitionAddress == partition->address && memcmp(saved.sha256, sha256, sizeof(sha256)) == 0)
+    {
+        offset = written = erasedUpTo = savedOffset = saved.offset;
+        stats.resumes++;
+    }
+
+    if (compressed)
+    {
+        inflater = malloc(sizeof(tinfl_decompressor));
+        window = (uint8_t *)malloc(OTA_WINDOW_SIZE);
+        if (!inflater || !window)
+        {
+            _fail("out of memory");
+            return false;
+        }
+        tinfl_init((tinfl_decompressor *)inflater);
+        windowPos = 0;
+    }
+
+    _setState(OtaState::Receiving);
+    LOG_INFO("📦 OTA: %s %lu bytes%s into %s at %lu", offset ? "resuming" : "receiving", (unsigned long)size,
+             compressed ? " (zlib)" : "", partition->label, (unsigned long)offset);
+    return true;
+}
+
+void MqttOta::chunk(const uint8_t *payload, size_t length)
+{
+    if (length <= OTA_CHUNK_HEADER_SIZE || memcmp(payload, OTA_CHUNK_MAGIC, 4) != 0)
+    {
+        LOG_WARN("⚠️ OTA: malformed chunk (%u bytes)", (unsigned)length);
+        return;
+    }
+
+    // Every chunk gets an answer, rate-limited by loop(); a sender that lost
+    // its place learns the expected offset from it
+    statusDirty = true;
+    if (state != OtaState::Receiving)
+    {
+        return;
+    }
+
+    uint32_t chunkOffset = readLe32(payload + 4);
+    uint32_t crc = readLe32(payload + 8);
+    const uint8_t *data = payload + OTA_CHUNK_HEADER_SIZE;
+    size_t dataLength = length - OTA_CHUNK_HEADER_SIZE;
+
+    // Redelivered and out-of-order chunks are dropped; the sender goes back to our offset
+    if (chunkOffset != offset || dataLength > size - offset)
+    {
+        stats.rejected++;
+        return;
+    }
+    if (esp_rom_crc32_le(0, data, dataLength) != crc)
+    {
+        stats.crcErrors++;
+        LOG_WARN("⚠️ OTA: bad checksum at %lu", (unsigned long)chunkOffset);
+        return;
+    }
+
+    bool last = offset + dataLength == size;
+    if (!(compressed ? _inflate(data, dataLength, last) : _write(data, dataLength)))
+    {
+        return;
+    }
+    offset += dataLength;
+    stats.chunks++;
+
+    if (!compressed && written - savedOffset >= OTA_PERSIST_BYTES)
+    {
+        _saveProgress();
+    }
+    if (last)
+    {
+        _finish();
+    }
+}
+
+void MqttOta::abort(const char *reason)
+{
+    if (state != OtaState::Receiving)
+    {
+        return;
+    }
+    _release();
+    strlcpy(error, reason, sizeof(error));
+    LOG_WARN("⚠️ OTA: %s at %lu/%lu", reason, (unsigned long)offset, (unsigned long)size);
+    _setState(OtaState::Idle);
+}
+
+void MqttOta::loop()
+{
+    uint32_t now = millis();
+    if (statusDirty && (stateChanged || now - lastStatus >= OTA_STATUS_INTERVAL_MS))
+    {
+        char payload[288];
+        int length = snprintf(payload, sizeof(payload),
+                              "{\"state\":\"%s\",\"offset\":%lu,\"size\":%lu,\"chunk\":%u,\"error\":\"%s\","
+                              "\"version\":\"%s\",\"nonce\":%lu}",
+                              stateName(state), (unsigned long)offset, (unsigned long)size, (unsigned)OTA_MAX_CHUNK,
+                              error, esp_ota_get_app_description()->version, (unsigned long)nonce);
+
+        char topic[CONFIG_STRING_SIZE + 48];
+        snprintf(topic, sizeof(topic), "%s/status", getTopic());
+        if (MQTTClient::getMQTTClient().publish(topic, (const uint8_t *)payload, length, true))
+        {
+            statusDirty = false;
+            stateChanged = false;
+            lastStatus = now;
+        }
+    }
+
+    // Reboot only once the "done" status is out
+    if (state == OtaState::Done && !statusDirty && now - doneAt >= OTA_REBOOT_DELAY_MS)
+    {
+        LOG_INFO("🔄 OTA: rebooting into the new firmware");
+        delay(100); // let the log task write the line out
+        ESP.restart();
+    }
+}
+
+bool MqttOta::_write(const uint8_t *data, size_t length)
+{
+    uint32_t end = written + length;
+    if (end > partition->size)
+    {
+        _fail("image too large");
+        return false;
+    }
+
+    // Erase sector by sector as the image grows, never the whole partition up front
+    if (end > erasedUpTo)
+    {
+        uint32_t eraseEnd = (end + OTA_SECTOR_SIZE - 1) / OTA_SECTOR_SIZE * OTA_SECTOR_SIZE;
+        if (esp_partition_erase_range(partition, erasedUpTo, eraseEnd - erasedUpTo) != ESP_OK)
+        {
+            _fail("flash erase failed");
+            return false;
+        }
+        erasedUpTo = eraseEnd;
+    }
+
+    if (esp_partition_write(partition, written, data, length) != ESP_OK)
+    {
+        _fail("flash write failed");
+        return false;
+    }
+    written = end;
+    return true;
+}
+
+bool MqttOta::_inflate(const uint8_t *data, size_t length, bool last)
+{
+    uint32_t flags = TINFL_FLAG_PARSE_ZLIB_HEADER | (last ? 0 : TINFL_FLAG_HAS_MORE_INPUT);
+    while (true)
+    {
+        // The window is a ring the inflater also uses as its dictionary
+        size_t inBytes = length;
+        size_t outBytes = OTA_WINDOW_SIZE - windowPos;
+        tinfl_status status = tinfl_decompress((tinfl_decompressor *)inflater, data, &inBytes, window,
+                                               window + windowPos, &outBytes, flags);
+        data += inBytes;
+        length -= inBytes;
+
+        if (outBytes && !_write(window + windowPos, outBytes))
+        {
+            return false;
+        }
+        windowPos = (windowPos + outBytes) & (OTA_WINDOW_SIZE - 1);
+
+        if (status < TINFL_STATUS_DONE)
+        {
+            _fail("inflate failed");
+            return false;
+        }
+        if (status == TINFL_STATUS_DONE)
+        {
+            if (length || !last)
+            {
+                _fail("zlib stream ended early");
+                return false;
+            }
+            return true;
+        }
+        if (status == TINFL_STATUS_NEEDS_MORE_INPUT)
+        {
+            if (last)
+            {
+                _fail("zlib stream truncated");
+                return false;
+            }
+            return true;
+        }
+        // TINFL_STATUS_HAS_MORE_OUTPUT: the window is full, go round again
+    }
+}
+
+void MqttOta::_finish()
+{
+    _release();
+
+    // Hash what is actually in flash, not what was received
+    uint8_t digest[32];
+    uint8_t buffer[1024];
+    mbedtls_sha256_context ctx;
+    mbedtls_sha256_init(&ctx);
+    mbedtls_sha256_starts_ret(&ctx, 0);
+    for (uint32_t pos = 0; pos < written; pos += sizeof(buffer))
+    {
+        size_t n = min((uint32_t)sizeof(buffer), written - pos);
+        if (esp_partition_read(partition, pos, buffer, n) != ESP_OK)
+        {
+            mbedtls_sha256_free(&ctx);
+            _fail("flash read failed");
+            return;
+        }
+        mbedtls_sha256_update_ret(&ctx, buffer, n);
+    }
+    mbedtls_sha256_finish_ret(&ctx, digest);
+    mbedtls_sha256_free(&ctx);
+
+    // A wrong image is not worth resuming
+    if (memcmp(digest, sha256, sizeof(digest)) != 0)
+    {
+        _clearProgress();
+        _fail("sha256 mismatch");
+        return;
+    }
+
+    // Also checks the image header and segments
+    if (esp_ota_set_boot_partition(partition) != ESP_OK)
+    {
+        _clearProgress();
+        _fail("image rejected");
+        return;
+    }
+
+    _clearProgress();
+    doneAt = millis();
+    _setState(OtaState::Done);
+    LOG_INFO("✅ OTA: %lu bytes verified, booting %s next", (unsigned long)written, partition->label);
+}
+
+void MqttOta::_fail(const char *reason)
+{
+    _release();
+    strlcpy(error, reason, sizeof(error));
+    LOG_ERROR("❌ OTA failed: %s", reason);
+    _setState(OtaState::Failed);
+}
+
+void MqttOta::_release()
+{
+    free(inflater);
+    free(window);
+    inflater = nullptr;
+    window = nullptr;
+}
+
+void MqttOta::_setState(OtaState next)
+{
+    state = next;
+    statusDirty = true;
+    stateChanged = true;
+}
+
+void MqttOta::_saveProgress()
+{
+    Progress progress;
+    memcpy(progress.sha256, sha256, sizeof(sha256));
+    progress.size = size;
+    progress.offset = written - written % OTA_SECTOR_SIZE;
+    progress.partitionAddress = partition->address;
+
+    Preferences prefs;
+    if (prefs.begin(progressNamespace, false))
+    {
+        if (prefs.putBytes(progressKey, &progress, sizeof(progress)) == sizeof(progress))
+        {
+            savedOffset = progress.offset;
+        }
+        prefs.end();
+    }
+}
+
+bool MqttOta::_loadProgress(Progress &saved)
+{
+    Preferences prefs;
+    if (!prefs.begin(progressNamespace, true))
+    {
+        return false;
+    }
+    bool ok = prefs.getBytes(progressKey, &saved, sizeof(saved)) == sizeof(saved);
+    prefs.end();
+    return ok && saved.offset % OTA_SECTOR_SIZE == 0;
+}
+
+void MqttOta::_clearProgress()
+{
+    Preferences prefs;
+    if (prefs.begin(progressNamespace, false))
+    {
+        prefs.remove(progressKey);
+        prefs.end();
+    }
+}
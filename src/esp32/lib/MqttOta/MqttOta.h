@@ -0,0 +1,147 @@
+#pragma once
+
+#include <Arduino.h>
+#include <esp_partition.h>
+#include "MQTTClient.h"
+#include "Logger.h"
+
+// Progress is saved to NVS each time the image grows by this much (a multiple
+// of the 4KB flash sector, so a resumed transfer starts on an erased sector)
+#ifndef OTA_PERSIST_BYTES
+#define OTA_PERSIST_BYTES 65536
+#endif
+
+// Minimum spacing of progress status publishes; state changes go out at once
+#ifndef OTA_STATUS_INTERVAL_MS
+#define OTA_STATUS_INTERVAL_MS 1000
+#endif
+
+// Time between a verified image and the reboot, so the final status gets out
+#ifndef OTA_REBOOT_DELAY_MS
+#define OTA_REBOOT_DELAY_MS 2000
+#endif
+
+// Largest chunk the sender should use: the MQTT packet buffer minus topic and header
+#ifndef OTA_MAX_CHUNK
+#define OTA_MAX_CHUNK (MQTT_PACKET_BUFFER_SIZE - 256)
+#endif
+
+// Binary chunk layout: "OTAC", offset (u32 LE), CRC-32 of the data (u32 LE), data
+#define OTA_CHUNK_MAGIC "OTAC"
+#define OTA_CHUNK_HEADER_SIZE 12
+
+enum class OtaState : uint8_t
+{
+    Idle,
+    Receiving,
+    Done,   // verified and selected for boot; reboot pending
+    Failed,
+};
+
+// Transfer counters
+struct OtaStats
+{
+    uint32_t chunks;     // chunks written
+    uint32_t rejected;   // chunks ignored for a wrong offset
+    uint32_t crcErrors;  // chunks ignored for a bad checksum
+    uint32_t resumes;    // begins that continued an earlier transfer
+};
+
+// Firmware update streamed over MQTT, for devices the ArduinoOTA LAN push
+// cannot reach. The sender starts a transfer with a JSON "begin" message on
+// <ota topic>/<client id>, then sends binary chunks in order. Each chunk is
+// checked and written straight into the inactive app partition; nothing is
+// buffered beyond one MQTT packet. A chunk for any offset but the expected
+// one is ignored, so the sender resumes from the offset in the status.
+//
+// Images may be zlib-compressed; they are inflated through the ROM inflater
+// into a 32KB window allocated only while the transfer runs. Uncompressed
+// transfers also survive a reboot, from the last OTA_PERSIST_BYTES boundary;
+// compressed ones only resume within the same boot.
+//
+// Everything runs on the network task, which stalls for the length of a flash
+// sector erase (tens of ms) whenever a chunk starts a new sector.
+class MqttOta
+{
+public:
+    /**
+     * Start or resume a transfer
+     * @param size Bytes the sender will send (the compressed size for zlib)
+     * @param sha256Hex SHA-256 of the uncompressed image, 64 hex digits
+     * @param compressed true when the chunks form a zlib stream
+     * @param nonce Sender's tag for this begin, echoed in the status so a stale
+     *              retained status is not taken for the answer
+     * @return false if the parameters are invalid or no partition is available
+     */
+    static bool begin(uint32_t size, const char *sha256Hex, bool compressed, uint32_t nonce = 0);
+
+    /**
+     * Handle one binary chunk (header included)
+     */
+    static void chunk(const uint8_t *payload, size_t length);
+
+    /**
+     * Abandon the current transfer; progress saved for a resume is kept
+     */
+    static void abort(const char *reason);
+
+    /**
+     * Request a status publish (the sender asks before resuming)
+     */
+    static void requestStatus() { statusDirty = true; }
+
+    /**
+     * Publish the status when due and reboot into a finished image;
+     * call from the network task while MQTT is connected
+     */
+    static void loop();
+
+    /**
+     * @return "<ota topic>/<client id>", the topic chunks and control messages arrive on
+     */
+    static const char *getTopic();
+
+    static OtaState getState() { return state; }
+    static const OtaStats &getStats() { return stats; }
+    static const char *stateName(OtaState s);
+
+private:
+    // What a resume after a reboot must match; saved to NVS
+    struct Progress
+    {
+        uint8_t sha256[32];
+        uint32_t size;
+        uint32_t offset;           // sector-aligned bytes already in flash
+        uint32_t partitionAddress;
+    };
+
+    static bool _write(const uint8_t *data, size_t length);
+    static bool _inflate(const uint8_t *data, size_t length, bool last);
+    static void _finish();
+    static void _fail(const char *reason);
+    static void _release();
+    static void _setState(OtaState next);
+    static void _saveProgress();
+    static bool _loadProgress(Progress &saved);
+    static void _clearProgress();
+
+    static OtaState state;
+    static const esp_partition_t *partition;
+    static uint8_t sha256[32];
+    static uint32_t size;         // bytes the sender sends
+    static uint32_t offset;       // bytes received so far
+    static uint32_t written;      // image bytes in flash
+    static uint32_t erasedUpTo;   // end of the erased part of the partition
+    static uint32_t savedOffset;  // offset last saved to NVS
+    static bool compressed;
+    static void *inflater;        // tinfl_decompressor, compressed transfers only
+    static uint8_t *window;       // inflate dictionary / output window
+    static uint32_t windowPos;
+    static char error[48];
+    static uint32_t nonce;        // of the begin that started the current state, 0 after a reboot
+    static bool statusDirty;
+    static bool stateChanged;
+    static uint32_t lastStatus;
+    static uint32_t doneAt;
+    static OtaStats stats;
+};
@@ -0,0 +1,106 @@
+#include "NetworkEvents.h"
+#include <lwip/sockets.h>
+#include "Telemetry.h"
+#if NET_POWER_SAVE
+#include <esp_pm.h>
+#endif
+
+TaskHandle_t NetworkEvents::networkTask = nullptr;
+TaskHandle_t NetworkEvents::watchTask = nullptr;
+volatile int NetworkEvents::watched = -1;
+volatile uint32_t NetworkEvents::readyUs = 0;
+NetworkEventStats NetworkEvents::stats = {};
+
+void NetworkEvents::begin()
+{
+    xTaskCreatePinnedToCore(_watchTask, "netwatch", 2048, nullptr, NET_WATCH_TASK_PRIORITY, &watchTask, 0);
+
+#if NET_POWER_SAVE
+    // APB stays at 80MHz, so LEDC and timer frequencies do not change with the CPU clock
+    esp_pm_config_esp32s3_t pm = {};
+    pm.max_freq_mhz = getCpuFrequencyMhz();
+    pm.min_freq_mhz = 80;
+    pm.light_sleep_enable = NET_POWER_SAVE >= 2;
+    esp_err_t err = esp_pm_configure(&pm);
+    if (err != ESP_OK)
+    {
+        LOG_WARN("⚠️ Power management not available (%d), running at full speed", err);
+    }
+#endif
+}
+
+void NetworkEvents::wait(uint32_t timeoutMs)
+{
+    // The task that waits is the network task
+    if (!networkTask)
+    {
+        networkTask = xTaskGetCurrentTaskHandle();
+    }
+
+    // Arm the watcher; it reports one readable event per arm, so data the
+    // network task has not read yet cannot make it spin
+    if (watched >= 0 && watchTask)
+    {
+        xTaskNotifyGive(watchTask);
+    }
+
+    uint32_t start = micros();
+    uint32_t notified = ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeoutMs));
+    stats.waitedUs += micros() - start;
+
+    uint32_t ready = readyUs;
+    if (ready)
+    {
+        readyUs = 0;
+        stats.socketWakes++;
+        TELEMETRY_RECORD(Metric::Wake, ready);
+    }
+    else if (notified)
+    {
+        stats.wakes++;
+    }
+    else
+    {
+        stats.timeouts++;
+    }
+}
+
+void NetworkEvents::_watchTask(void *arg)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        // Keep watching until the socket is readable or goes away
+        while (true)
+        {
+            int fd = watched;
+            if (fd < 0)
+            {
+                break;
+            }
+
+            fd_set readable;
+            FD_ZERO(&readable);
+            FD_SET(fd, &readable);
+            // Bounded, so a socket replaced during the wait is picked up
+            timeval timeout = {1, 0};
+            int n = select(fd + 1, &readable, nullptr, nullptr, &timeout);
+            if (n > 0)
+            {
+                // Also wakes on EOF, so a dropped connection is noticed at once
+                readyUs = micros() | 1;
+                if (networkTask)
+                {
+                    xTaskNotifyGive(networkTask);
+                }
+                break;
+            }
+            if (n < 0)
+            {
+                // Closed under us; the network task's timeout takes over until the next arm
+                break;
+            }
+        }
+    }
+}
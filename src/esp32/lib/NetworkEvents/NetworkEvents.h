@@ -0,0 +1,85 @@
+#pragma once
+
+#include <Arduino.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include "Logger.h"
+
+// Longest the network task sleeps without an event. Work that is only due by
+// time (MQTT keepalive, telemetry, state polls, ArduinoOTA, reconnect backoff)
+// runs at most this late.
+#ifndef NET_IDLE_WAIT_MS
+#define NET_IDLE_WAIT_MS 100
+#endif
+
+// Power management while the network task waits:
+// 0 = off, 1 = scale the CPU down to 80MHz when idle,
+// 2 = also light sleep automatically between events (needs tickless idle in
+//     the core's sdkconfig; LEDC fades and buzzer tones pause while asleep)
+#ifndef NET_POWER_SAVE
+#define NET_POWER_SAVE 1
+#endif
+
+// The socket watcher task; above the network task so a readable socket is noticed at once
+#ifndef NET_WATCH_TASK_PRIORITY
+#define NET_WATCH_TASK_PRIORITY 3
+#endif
+
+// What woke the network task
+struct NetworkEventStats
+{
+    uint32_t socketWakes; // the watched socket became readable
+    uint32_t wakes;       // wake() from another task
+    uint32_t timeouts;    // nothing happened within the wait
+    uint64_t waitedUs;    // total time spent waiting
+};
+
+// Lets the network task sleep until there is work instead of polling. A
+// watcher task blocks in lwIP select() on the broker socket and turns
+// readability into a task notification; other tasks call wake() when they
+// leave work for the network task. wait() returns on whichever comes first,
+// or after its timeout, so a command is read as soon as its bytes arrive and
+// an idle device wakes only every NET_IDLE_WAIT_MS.
+class NetworkEvents
+{
+public:
+    /**
+     * Start the socket watcher and apply NET_POWER_SAVE
+     */
+    static void begin();
+
+    /**
+     * Set the socket to watch; network task only
+     * @param fd Socket descriptor, -1 for none
+     */
+    static void watch(int fd) { watched = fd; }
+
+    /**
+     * Block the network task until the watched socket is readable, wake() is
+     * called or the timeout passes
+     * @param timeoutMs 0 returns at once
+     */
+    static void wait(uint32_t timeoutMs);
+
+    /**
+     * Wake the network task; callable from any task
+     */
+    static void wake()
+    {
+        if (networkTask)
+        {
+            xTaskNotifyGive(networkTask);
+        }
+    }
+
+    static const NetworkEventStats &getStats() { return stats; }
+
+private:
+    static void _watchTask(void *arg);
+
+    static TaskHandle_t networkTask;
+    static TaskHandle_t watchTask;
+    static volatile int watched;
+    static volatile uint32_t readyUs; // when the watcher saw the socket readable, 0 if not
+    static NetworkEventStats stats;   // network task only
+};
@@ -8,29 +8,23 @@ void OTAHandler::init()
     // Set up OTA event handlers for progress and error feedback
     ArduinoOTA
         .onStart([]()
-                 {
-            String type;
-            if (ArduinoOTA.getCommand() == U_FLASH) {
-                type = "sketch";
-            } else { // U_FS
-                type = "filesystem";
-            }
-            Serial.println("Start updating " + type); })
+                 { LOG_INFO("Start updating %s", ArduinoOTA.getCommand() == U_FLASH ? "sketch" : "filesystem"); })
         .onEnd([]()
-               { Serial.println("\nEnd"); })
+               { LOG_INFO("OTA update finished"); })
         .onProgress([](unsigned int progress, unsigned int total)
-                    { Serial.printf("Progress: %u%%\r", (progress / (total / 100))); })
+                    { LOG_DEBUG("Progress: %u%%", (progress / (total / 100))); })
         .onError([](ota_error_t error)
                  {
-            Serial.printf("Error[%u]: ", error);
-            if (error == OTA_AUTH_ERROR) Serial.println("Auth Failed");
-            else if (error == OTA_BEGIN_ERROR) Serial.println("Begin Failed");
-            else if (error == OTA_CONNECT_ERROR) Serial.println("Connect Failed");
-            else if (error == OTA_RECEIVE_ERROR) Serial.println("Receive Failed");
-            else if (error == OTA_END_ERROR) Serial.println("End Failed"); });
+            const char *reason = "Unknown";
+            if (error == OTA_AUTH_ERROR) reason = "Auth Failed";
+            else if (error == OTA_BEGIN_ERROR) reason = "Begin Failed";
+            else if (error == OTA_CONNECT_ERROR) reason = "Connect Failed";
+            else if (error == OTA_RECEIVE_ERROR) reason = "Receive Failed";
+            else if (error == OTA_END_ERROR) reason = "End Failed";
+            LOG_ERROR("❌ OTA Error[%u]: %s", error, reason); });
 
     ArduinoOTA.begin();
-    Serial.println("✅ OTA Ready");
+    LOG_INFO("✅ OTA Ready");
 }
 
 void OTAHandler::handle()
@@ -0,0 +1,450 @@
+#include "RuleBytecode.h"
+#include <ctype.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ====== RuleCompiler ======
+
+bool RuleCompiler::compile(const char *expression, uint8_t &start)
+{
+    if (!expression)
+    {
+        return _fail("missing expression");
+    }
+    if (_length > UINT8_MAX)
+    {
+        return _fail("rule code too long");
+    }
+
+    start = (uint8_t)_length;
+    _p = expression;
+    _depth = 0;
+    _nesting = 0;
+    if (!_or())
+    {
+        return false;
+    }
+    _skipSpace();
+    if (*_p)
+    {
+        return _fail("unexpected character");
+    }
+    return _emit((uint8_t)RuleOp::End);
+}
+
+bool RuleCompiler::_or()
+{
+    if (!_and())
+    {
+        return false;
+    }
+    while (_match("||"))
+    {
+        if (!_and() || !_binary(RuleOp::Or))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RuleCompiler::_and()
+{
+    if (!_equality())
+    {
+        return false;
+    }
+    while (_match("&&"))
+    {
+        if (!_equality() || !_binary(RuleOp::And))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool RuleCompiler::_equality()
+{
+    if (!_relational())
+    {
+        return false;
+    }
+    while (true)
+    {
+        RuleOp op;
+        if (_match("=="))
+        {
+            op = RuleOp::Eq;
+        }
+        else if (_match("!="))
+        {
+            op = RuleOp::Ne;
+        }
+        else
+        {
+            return true;
+        }
+        if (!_relational() || !_binary(op))
+        {
+            return false;
+        }
+    }
+}
+
+bool RuleCompiler::_relational()
+{
+    if (!_additive())
+    {
+        return false;
+    }
+    while (true)
+    {
+        // Two-character operators first, so "<=" is not read as "<"
+        RuleOp op;
+        if (_match("<="))
+        {
+            op = RuleOp::Le;
+        }
+        else if (_match(">="))
+        {
+            op = RuleOp::Ge;
+        }
+        else if (_match("<"))
+        {
+            op = RuleOp::Lt;
+        }
+        else if (_match(">"))
+        {
+            op = RuleOp::Gt;
+        }
+        else
+        {
+            return true;
+        }
+        if (!_additive() || !_binary(op))
+        {
+            return false;
+        }
+    }
+}
+
+bool RuleCompiler::_additive()
+{
+    if (!_multiplicative())
+    {
+        return false;
+    }
+    while (true)
+    {
+        RuleOp op;
+        if (_match("+"))
+        {
+            op = RuleOp::Add;
+        }
+        else if (_match("-"))
+        {
+            op = RuleOp::Sub;
+        }
+        else
+        {
+            return true;
+        }
+        if (!_multiplicative() || !_binary(op))
+        {
+            return false;
+        }
+    }
+}
+
+bool RuleCompiler::_multiplicative()
+{
+    if (!_unary())
+    {
+        return false;
+    }
+    while (true)
+    {
+        RuleOp op;
+        if (_match("*"))
+        {
+            op = RuleOp::Mul;
+        }
+        else if (_match("/"))
+        {
+            op = RuleOp::Div;
+        }
+        else if (_match("%"))
+        {
+            op = RuleOp::Mod;
+        }
+        else
+        {
+            return true;
+        }
+        if (!_unary() || !_binary(op))
+        {
+            return false;
+        }
+    }
+}
+
+bool RuleCompiler::_unary()
+{
+    _skipSpace();
+    if (*_p != '!' && *_p != '-')
+    {
+        return _primary();
+    }
+
+    RuleOp op = *_p == '!' ? RuleOp::Not : RuleOp::Neg;
+    _p++;
+    if (++_nesting > RULES_MAX_NESTING)
+    {
+        return _fail("expression nested too deeply");
+    }
+    if (!_unary())
+    {
+        return false;
+    }
+    _nesting--;
+    return _emit((uint8_t)op);
+}
+
+bool RuleCompiler::_primary()
+{
+    _skipSpace();
+
+    if (*_p == '(')
+    {
+        _p++;
+        if (++_nesting > RULES_MAX_NESTING)
+        {
+            return _fail("expression nested too deeply");
+        }
+        if (!_or())
+        {
+            return false;
+        }
+        if (!_match(")"))
+        {
+            return _fail("missing ')'");
+        }
+        _nesting--;
+        return true;
+    }
+
+    if (isdigit((unsigned char)*_p))
+    {
+        char *end;
+        errno = 0;
+        long long value = strtoll(_p, &end, 10);
+        if (errno == ERANGE || value > INT32_MAX)
+        {
+            return _fail("number out of range");
+        }
+        _p = end;
+        return _push((int32_t)value);
+    }
+
+    if (isalpha((unsigned char)*_p) || *_p == '_')
+    {
+        const char *name = _p;
+        while (isalnum((unsigned char)*_p) || *_p == '_')
+        {
+            _p++;
+        }
+        size_t length = _p - name;
+
+        if (length == 4 && strncmp(name, "true", 4) == 0)
+        {
+            return _push(1);
+        }
+        if (length == 5 && strncmp(name, "false", 5) == 0)
+        {
+            return _push(0);
+        }
+        for (uint8_t i = 0; _fields && i < _fields->fieldCount && i < COMMAND_MAX_FIELDS; i++)
+        {
+            const char *field = _fields->fields[i].name;
+            if (strlen(field) == length && strncmp(field, name, length) == 0)
+            {
+                return _emit((uint8_t)RuleOp::Field) && _emit(i) && _slot();
+            }
+        }
+        return _fail(_fields ? "unknown field" : "fields need a trigger command");
+    }
+
+    return _fail("expected a value");
+}
+
+bool RuleCompiler::_binary(RuleOp op)
+{
+    _depth--;
+    return _emit((uint8_t)op);
+}
+
+bool RuleCompiler::_push(int32_t value)
+{
+    if (value >= INT8_MIN && value <= INT8_MAX)
+    {
+        return _emit((uint8_t)RuleOp::Push8) && _emit((uint8_t)value) && _slot();
+    }
+    uint32_t v = (uint32_t)value;
+    return _emit((uint8_t)RuleOp::Push32) && _emit(v) && _emit(v >> 8) && _emit(v >> 16) && _emit(v >> 24) &&
+           _slot();
+}
+
+bool RuleCompiler::_slot()
+{
+    if (++_depth > RULES_STACK_DEPTH)
+    {
+        return _fail("expression too complex");
+    }
+    return true;
+}
+
+bool RuleCompiler::_emit(uint8_t byte)
+{
+    if (_length >= _capacity)
+    {
+        return _fail("rule code too long");
+    }
+    _code[_length++] = byte;
+    return true;
+}
+
+bool RuleCompiler::_fail(const char *error)
+{
+    if (!_error)
+    {
+        _error = error;
+    }
+    return false;
+}
+
+bool RuleCompiler::_match(const char *token)
+{
+    _skipSpace();
+    size_t length = strlen(token);
+    if (strncmp(_p, token, length) != 0)
+    {
+        return false;
+    }
+    _p += length;
+    return true;
+}
+
+void RuleCompiler::_skipSpace()
+{
+    while (isspace((unsigned char)*_p))
+    {
+        _p++;
+    }
+}
+
+// ====== Evaluation ======
+
+// Arithmetic wraps like the unsigned types instead of overflowing
+static int32_t applyBinary(RuleOp op, int32_t a, int32_t b)
+{
+    switch (op)
+    {
+    case RuleOp::Add:
+        return (int32_t)((uint32_t)a + (uint32_t)b);
+    case RuleOp::Sub:
+        return (int32_t)((uint32_t)a - (uint32_t)b);
+    case RuleOp::Mul:
+        return (int32_t)((uint32_t)a * (uint32_t)b);
+    case RuleOp::Div:
+        return b == 0 ? 0 : b == -1 ? (int32_t)(0u - (uint32_t)a) : a / b;
+    case RuleOp::Mod:
+        return b == 0 || b == -1 ? 0 : a % b;
+    case RuleOp::Eq:
+        return a == b;
+    case RuleOp::Ne:
+        return a != b;
+    case RuleOp::Lt:
+        return a < b;
+    case RuleOp::Le:
+        return a <= b;
+    case RuleOp::Gt:
+        return a > b;
+    case RuleOp::Ge:
+        return a >= b;
+    case RuleOp::And:
+        return a && b;
+    case RuleOp::Or:
+        return a || b;
+    default:
+        return 0;
+    }
+}
+
+bool ruleEvaluate(const uint8_t *code, size_t size, const Command &cmd, int32_t &result)
+{
+    int32_t stack[RULES_STACK_DEPTH];
+    uint8_t sp = 0;
+    size_t pc = 0;
+
+    while (pc < size)
+    {
+        RuleOp op = (RuleOp)code[pc++];
+        switch (op)
+        {
+        case RuleOp::End:
+            if (sp != 1)
+            {
+                return false;
+            }
+            result = stack[0];
+            return true;
+
+        case RuleOp::Push8:
+            if (pc >= size || sp == RULES_STACK_DEPTH)
+            {
+                return false;
+            }
+            stack[sp++] = (int8_t)code[pc++];
+            break;
+
+        case RuleOp::Push32:
+            if (pc + 4 > size || sp == RULES_STACK_DEPTH)
+            {
+                return false;
+            }
+            stack[sp++] = (int32_t)((uint32_t)code[pc] | ((uint32_t)code[pc + 1] << 8) |
+                                    ((uint32_t)code[pc + 2] << 16) | ((uint32_t)code[pc + 3] << 24));
+            pc += 4;
+            break;
+
+        case RuleOp::Field:
+            if (pc >= size || sp == RULES_STACK_DEPTH || code[pc] >= COMMAND_MAX_FIELDS)
+            {
+                return false;
+            }
+            stack[sp++] = cmd.values[code[pc++]];
+            break;
+
+        case RuleOp::Not:
+        case RuleOp::Neg:
+            if (sp < 1)
+            {
+                return false;
+            }
+            stack[sp - 1] = op == RuleOp::Not ? !stack[sp - 1] : (int32_t)(0u - (uint32_t)stack[sp - 1]);
+            break;
+
+        default:
+            if (sp < 2 || op > RuleOp::Or)
+            {
+                return false;
+            }
+            sp--;
+            stack[sp - 1] = applyBinary(op, stack[sp - 1], stack[sp]);
+            break;
+        }
+    }
+    return false;
+}
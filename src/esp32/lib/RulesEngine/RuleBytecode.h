@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "CommandSchema.h"
+
+// Evaluation stack slots; the compiler rejects expressions that need more
+#ifndef RULES_STACK_DEPTH
+#define RULES_STACK_DEPTH 8
+#endif
+
+// Deepest parenthesis / unary nesting the compiler accepts
+#ifndef RULES_MAX_NESTING
+#define RULES_MAX_NESTING 8
+#endif
+
+// Instructions of the rule stack machine. There are no jumps, so evaluation
+// takes at most one step per byte of code.
+enum class RuleOp : uint8_t
+{
+    End,    // result is the top of the stack
+    Push8,  // int8 operand
+    Push32, // int32 operand, little-endian
+    Field,  // field index operand: value of the triggering command's field
+    Not,
+    Neg,
+    Add,
+    Sub,
+    Mul,
+    Div, // x / 0 == 0
+    Mod, // x % 0 == 0
+    Eq,
+    Ne,
+    Lt,
+    Le,
+    Gt,
+    Ge,
+    And,
+    Or,
+};
+
+// Compiles integer expressions such as "brightness > 200 && channel == 0"
+// into RuleOp code. Operators, by increasing precedence: || && == != < <= > >=
+// + - * / % and unary ! -. Operands are integer literals, true/false and the
+// fields of one command spec, read from the triggering command.
+class RuleCompiler
+{
+public:
+    /**
+     * @param code Buffer expressions are appended to
+     * @param capacity Size of the buffer
+     * @param fields Command whose fields may be named, or nullptr for none
+     */
+    RuleCompiler(uint8_t *code, size_t capacity, const CommandSpec *fields)
+        : _code(code), _capacity(capacity), _fields(fields) {}
+
+    /**
+     * Append one expression, terminated by RuleOp::End
+     * @param start Receives the offset of its first instruction
+     * @return false on a syntax error or when the buffer is full; see error()
+     */
+    bool compile(const char *expression, uint8_t &start);
+
+    size_t length() const { return _length; }
+    const char *error() const { return _error; }
+
+private:
+    bool _or();
+    bool _and();
+    bool _equality();
+    bool _relational();
+    bool _additive();
+    bool _multiplicative();
+    bool _unary();
+    bool _primary();
+
+    bool _binary(RuleOp op);
+    bool _push(int32_t value);
+    bool _slot();
+    bool _emit(uint8_t byte);
+    bool _fail(const char *error);
+    bool _match(const char *token);
+    void _skipSpace();
+
+    uint8_t *_code;
+    size_t _capacity;
+    size_t _length = 0;
+    const CommandSpec *_fields;
+    const char *_p = nullptr;
+    uint8_t _depth = 0;   // stack slots in use at this point of the expression
+    uint8_t _nesting = 0;
+    const char *_error = nullptr;
+};
+
+/**
+ * Run one compiled expression
+ * @param code Compiled code; evaluation starts at code[0]
+ * @param size Bytes of code available from there
+ * @param cmd Command whose fields the expression reads
+ * @param result Receives the value
+ * @return false if the code is malformed
+ */
+bool ruleEvaluate(const uint8_t *code, size_t size, const Command &cmd, int32_t &result);
@@ -0,0 +1,375 @@
+#include "RulesEngine.h"
+#include <Preferences.h>
+
+static const char *rulesNamespace = "rules";
+static const char *namesKey = "names";
+
+RuleSet RulesEngine::rules = {};
+TripleBuffer<RuleSet> RulesEngine::active;
+uint8_t RulesEngine::depth = 0;
+volatile uint32_t RulesEngine::evaluations = 0;
+volatile uint32_t RulesEngine::fired = 0;
+volatile uint32_t RulesEngine::suppressed = 0;
+
+// NVS key of a saved rule
+static void sourceKey(char (&key)[RULES_NAME_SIZE + 2], const char *name)
+{
+    snprintf(key, sizeof(key), "r:%s", name);
+}
+
+static bool reject(const char *name, const char *error, const char *detail = nullptr)
+{
+    LOG_ERROR("❌ Rule %s: %s%s%s", name ? name : "?", error, detail ? " " : "", detail ? detail : "");
+    return false;
+}
+
+void RulesEngine::begin()
+{
+    Preferences prefs;
+    if (!prefs.begin(rulesNamespace, true))
+    {
+        return;
+    }
+
+    char names[RULES_MAX][RULES_NAME_SIZE];
+    size_t count = prefs.getBytes(namesKey, names, sizeof(names)) / RULES_NAME_SIZE;
+    DynamicJsonDocument doc(RULES_DOCUMENT_SIZE);
+    char source[RULES_SOURCE_SIZE];
+    for (size_t i = 0; i < count; i++)
+    {
+        char key[RULES_NAME_SIZE + 2];
+        names[i][RULES_NAME_SIZE - 1] = '\0';
+        sourceKey(key, names[i]);
+        size_t length = prefs.getBytes(key, source, sizeof(source));
+        if (length == 0 || deserializeJson(doc, source, length) || !_install(doc.as<JsonObjectConst>()))
+        {
+            LOG_WARN("⚠️ Saved rule %s could not be loaded", names[i]);
+        }
+    }
+    prefs.end();
+
+    if (rules.count)
+    {
+        LOG_INFO("🧩 %u rules loaded", (unsigned)rules.count);
+    }
+}
+
+bool RulesEngine::add(JsonObjectConst source)
+{
+    if (!_install(source))
+    {
+        return false;
+    }
+    _save(source, source["name"]);
+    return true;
+}
+
+bool RulesEngine::_install(JsonObjectConst source)
+{
+    Rule rule;
+    if (!_compile(source, rule))
+    {
+        return false;
+    }
+
+    // A rule with the same name is replaced in place
+    uint8_t index = 0;
+    while (index < rules.count && strcmp(rules.rules[index].name, rule.name) != 0)
+    {
+        index++;
+    }
+    if (index == RULES_MAX)
+    {
+        return reject(rule.name, "rule table full");
+    }
+
+    rules.rules[index] = rule;
+    if (index == rules.count)
+    {
+        rules.count++;
+    }
+    _publish();
+    LOG_INFO("🧩 Rule %s installed", rule.name);
+    return true;
+}
+
+bool RulesEngine::remove(const char *name)
+{
+    uint8_t index = 0;
+    while (index < rules.count && (!name || strcmp(rules.rules[index].name, name) != 0))
+    {
+        index++;
+    }
+    if (index == rules.count)
+    {
+        return reject(name, "no such rule");
+    }
+
+    for (uint8_t i = index; i + 1 < rules.count; i++)
+    {
+        rules.rules[i] = rules.rules[i + 1];
+    }
+    rules.count--;
+    _publish();
+
+    Preferences prefs;
+    if (prefs.begin(rulesNamespace, false))
+    {
+        char key[RULES_NAME_SIZE + 2];
+        sourceKey(key, name);
+        prefs.remove(key);
+        prefs.end();
+    }
+    _saveNames();
+    LOG_INFO("🧩 Rule %s removed", name);
+    return true;
+}
+
+void RulesEngine::clear()
+{
+    rules.count = 0;
+    _publish();
+
+    Preferences prefs;
+    if (prefs.begin(rulesNamespace, false))
+    {
+        prefs.clear();
+        prefs.end();
+    }
+    LOG_INFO("🧩 Rules cleared");
+}
+
+void RulesEngine::onCommand(TopicHandler *handler, const Command &cmd)
+{
+    // Take new rules only between commands, never while a rule's actions run
+    if (depth == 0)
+    {
+        active.update();
+    }
+    const RuleSet &set = active.readBuffer();
+    if (set.count == 0)
+    {
+        return;
+    }
+    if (depth >= RULES_MAX_DEPTH)
+    {
+        suppressed = suppressed + 1;
+        return;
+    }
+
+    depth++;
+    for (uint8_t r = 0; r < set.count; r++)
+    {
+        const Rule &rule = set.rules[r];
+        if (rule.trigger != handler || (rule.triggerCommand >= 0 && rule.triggerCommand != cmd.id))
+        {
+            continue;
+        }
+
+        int32_t result = 1;
+        if (rule.hasCondition)
+        {
+            evaluations = evaluations + 1;
+            if (!ruleEvaluate(rule.code, RULES_CODE_SIZE, cmd, result) || !result)
+            {
+                continue;
+            }
+        }
+        fired = fired + 1;
+        LOG_DEBUG("🧩 Rule %s fired", rule.name);
+
+        for (uint8_t a = 0; a < rule.actionCount; a++)
+        {
+            const RuleAction &action = rule.actions[a];
+            Command out = action.cmd;
+            const CommandSpec &spec = action.handler->getCommandSchema()->commands[out.id];
+            for (uint8_t i = 0; i < spec.fieldCount && i < COMMAND_MAX_FIELDS; i++)
+            {
+                uint8_t start = action.valueCode[i];
+                int32_t value;
+                if (start == RULES_CONSTANT || !ruleEvaluate(rule.code + start, RULES_CODE_SIZE - start, cmd, value))
+                {
+                    continue;
+                }
+                // Computed values are clamped like decoded ones
+                const FieldSpec &field = spec.fields[i];
+                out.values[i] = field.type == FieldType::Bool ? value != 0 : constrain(value, field.min, field.max);
+            }
+
+            action.handler->handleCommand(out);
+            onCommand(action.handler, out);
+        }
+    }
+    depth--;
+}
+
+bool RulesEngine::_compile(JsonObjectConst source, Rule &rule)
+{
+    const char *name = source["name"];
+    if (!name || !*name || strlen(name) >= RULES_NAME_SIZE)
+    {
+        return reject(name, "needs a 'name' of 1 to 13 characters");
+    }
+    memset(&rule, 0, sizeof(rule));
+    strlcpy(rule.name, name, sizeof(rule.name));
+
+    // Trigger: commands executed for one handler, optionally one command only
+    JsonObjectConst when = source["when"];
+    rule.trigger = TopicHandlerRegistry::getHandlerForTopic(when["topic"]);
+    const CommandSchema *schema = rule.trigger ? rule.trigger->getCommandSchema() : nullptr;
+    if (!schema)
+    {
+        return reject(name, "'when.topic' must be a command topic");
+    }
+
+    const CommandSpec *fields = nullptr;
+    rule.triggerCommand = -1;
+    const char *command = when["command"];
+    if (command)
+    {
+        int id = schema->find(command);
+        if (id < 0)
+        {
+            return reject(name, "unknown trigger command", command);
+        }
+        rule.triggerCommand = id;
+        fields = &schema->commands[id];
+    }
+
+    // The condition comes first in the code, so it always starts at offset 0
+    RuleCompiler compiler(rule.code, sizeof(rule.code), fields);
+    const char *condition = source["if"];
+    if (condition)
+    {
+        uint8_t start;
+        if (!compiler.compile(condition, start))
+        {
+            return reject(name, compiler.error(), "in 'if'");
+        }
+        rule.hasCondition = true;
+    }
+
+    JsonArrayConst actions = source["then"];
+    if (actions.size() == 0 || actions.size() > RULES_MAX_ACTIONS)
+    {
+        LOG_ERROR("❌ Rule %s: 'then' needs 1 to %d actions", name, RULES_MAX_ACTIONS);
+        return false;
+    }
+    for (JsonObjectConst action : actions)
+    {
+        if (!_compileAction(action, compiler, name, rule.actions[rule.actionCount]))
+        {
+            return false;
+        }
+        rule.actionCount++;
+    }
+    return true;
+}
+
+bool RulesEngine::_compileAction(JsonObjectConst source, RuleCompiler &compiler, const char *name,
+                                 RuleAction &action)
+{
+    action.handler = TopicHandlerRegistry::getHandlerForTopic(source["topic"]);
+    const CommandSchema *schema = action.handler ? action.handler->getCommandSchema() : nullptr;
+    if (!schema)
+    {
+        return reject(name, "action topic must be a command topic");
+    }
+    int id = schema->find(source["command"]);
+    if (id < 0)
+    {
+        return reject(name, "unknown action command", source["command"]);
+    }
+    const CommandSpec &spec = schema->commands[id];
+
+    // Constant fields are decoded by the handler's schema like any message;
+    // expressions stand in as 0 there and are computed when the rule fires
+    StaticJsonDocument<JSON_OBJECT_SIZE(COMMAND_MAX_FIELDS + 1)> constants;
+    constants["command"] = spec.name;
+    memset(action.valueCode, RULES_CONSTANT, sizeof(action.valueCode));
+    for (uint8_t i = 0; i < spec.fieldCount && i < COMMAND_MAX_FIELDS; i++)
+    {
+        const FieldSpec &field = spec.fields[i];
+        JsonVariantConst value = source[field.name];
+        if (field.type == FieldType::Array)
+        {
+            // Array fields are staged by prepareCommand(), which needs the message
+            return reject(name, "commands with array fields cannot be actions:", spec.name);
+        }
+        if (value.is<const char *>())
+        {
+            if (!compiler.compile(value, action.valueCode[i]))
+            {
+                return reject(name, compiler.error(), field.name);
+            }
+            constants[field.name] = 0;
+        }
+        else if (value.is<float>() || value.is<bool>())
+        {
+            constants[field.name] = value;
+        }
+        else if (!value.isNull())
+        {
+            return reject(name, "must be a number or an expression:", field.name);
+        }
+    }
+
+    const char *detail = nullptr;
+    CommandError error = schema->decode(constants.as<JsonObjectConst>(), action.cmd, detail);
+    if (error != CommandError::None)
+    {
+        return reject(name, CommandSchema::errorString(error), detail);
+    }
+    return true;
+}
+
+void RulesEngine::_publish()
+{
+    active.writeBuffer() = rules;
+    active.publish();
+}
+
+void RulesEngine::_save(JsonObjectConst source, const char *name)
+{
+    char buffer[RULES_SOURCE_SIZE];
+    size_t length = serializeJson(source, buffer, sizeof(buffer));
+    if (length == 0 || length >= sizeof(buffer) - 1)
+    {
+        LOG_WARN("⚠️ Rule %s is too large to save, it will not survive a reboot", name);
+        return;
+    }
+
+    Preferences prefs;
+    if (prefs.begin(rulesNamespace, false))
+    {
+        char key[RULES_NAME_SIZE + 2];
+        sourceKey(key, name);
+        prefs.putBytes(key, buffer, length);
+        prefs.end();
+    }
+    _saveNames();
+}
+
+void RulesEngine::_saveNames()
+{
+    char names[RULES_MAX][RULES_NAME_SIZE] = {};
+    for (uint8_t i = 0; i < rules.count; i++)
+    {
+        strlcpy(names[i], rules.rules[i].name, RULES_NAME_SIZE);
+    }
+
+    Preferences prefs;
+    if (prefs.begin(rulesNamespace, false))
+    {
+        // putBytes() writes nothing for an empty list, so the last name would stay
+        if (rules.count == 0)
+        {
+            prefs.remove(namesKey);
+        }
+        else
+        {
+            prefs.putBytes(namesKey, names, rules.count * RULES_NAME_SIZE);
+        }
+        prefs.end();
+    }
+}
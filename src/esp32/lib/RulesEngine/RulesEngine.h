@@ -0,0 +1,151 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include "TopicHandlerRegistry.h"
+#include "TripleBuffer.h"
+#include "RuleBytecode.h"
+#include "Logger.h"
+
+// Most rules installed at once
+#ifndef RULES_MAX
+#define RULES_MAX 8
+#endif
+
+// Most actions per rule
+#ifndef RULES_MAX_ACTIONS
+#define RULES_MAX_ACTIONS 3
+#endif
+
+// Bytecode per rule: the condition and every computed action field together
+#ifndef RULES_CODE_SIZE
+#define RULES_CODE_SIZE 48
+#endif
+
+// Rules are saved under "r:<name>", and NVS keys are at most 15 characters
+#define RULES_NAME_SIZE 14
+
+// How deep rules may trigger rules: an action's command is itself checked
+// against the rules up to this depth, which also stops rules feeding each other forever
+#ifndef RULES_MAX_DEPTH
+#define RULES_MAX_DEPTH 2
+#endif
+
+// Largest rule, as JSON, that is saved to NVS
+#ifndef RULES_SOURCE_SIZE
+#define RULES_SOURCE_SIZE 512
+#endif
+
+// Document capacity for one rule, strings excluded (they are parsed in place)
+#define RULES_DOCUMENT_SIZE                                                             \
+    (JSON_OBJECT_SIZE(5) + JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(RULES_MAX_ACTIONS) + \
+     RULES_MAX_ACTIONS * JSON_OBJECT_SIZE(COMMAND_MAX_FIELDS + 2))
+
+// Marks an action field that holds a constant rather than an expression
+#define RULES_CONSTANT 0xFF
+
+// Command run when a rule fires
+struct RuleAction
+{
+    TopicHandler *handler;
+    Command cmd;                           // constant fields, decoded when the rule was added
+    uint8_t valueCode[COMMAND_MAX_FIELDS]; // code offset of each computed field, RULES_CONSTANT otherwise
+};
+
+// One compiled rule
+struct Rule
+{
+    char name[RULES_NAME_SIZE];
+    TopicHandler *trigger;
+    int8_t triggerCommand; // command id in the trigger's schema, -1 for any command
+    bool hasCondition;     // the condition is the code at offset 0
+    uint8_t actionCount;
+    RuleAction actions[RULES_MAX_ACTIONS];
+    uint8_t code[RULES_CODE_SIZE];
+};
+
+struct RuleSet
+{
+    Rule rules[RULES_MAX];
+    uint8_t count;
+};
+
+// Rule counters
+struct RulesStats
+{
+    uint32_t evaluations; // conditions checked
+    uint32_t fired;       // rules whose actions ran
+    uint32_t suppressed;  // checks skipped at RULES_MAX_DEPTH
+};
+
+// Runs local reactions to commands without a round trip through the cloud:
+//
+//   {"name": "bright_beep",
+//    "when": {"topic": "esp32-mcp/control/led", "command": "set_brightness"},
+//    "if": "brightness > 200",
+//    "then": [{"topic": "esp32-mcp/control/buzzer", "command": "BEEP", "duration": "brightness - 100"}]}
+//
+// Every command the actuator executes is checked against the rules; a rule
+// fires when its trigger matches and its condition (optional) is non-zero.
+// Conditions and string-valued action fields are expressions over the
+// triggering command's fields, compiled to RuleOp bytecode when the rule is
+// added. Actions run at once, on the actuator task, by calling the target
+// handler directly. Rules and their code live in fixed-size tables, and
+// expressions have no loops, so a check costs at most RULES_CODE_SIZE steps.
+//
+// Rules are added and removed on the network task and handed to the actuator
+// through a triple buffer; they are saved to NVS and reloaded by begin().
+class RulesEngine
+{
+public:
+    /**
+     * Load the saved rules (call once after TopicHandlerRegistry::initAllHandlers())
+     */
+    static void begin();
+
+    /**
+     * Compile and install a rule, replacing one with the same name; network task only
+     * @return false if the rule is invalid or the table is full
+     */
+    static bool add(JsonObjectConst rule);
+
+    /**
+     * Remove a rule by name; network task only
+     * @return false if there is no such rule
+     */
+    static bool remove(const char *name);
+
+    /**
+     * Remove every rule; network task only
+     */
+    static void clear();
+
+    /**
+     * Check a command that just ran against the rules and run the actions of
+     * those that fire; call on the task that executes commands
+     */
+    static void onCommand(TopicHandler *handler, const Command &cmd);
+
+    /**
+     * @return The installed rules, as last set on the network task
+     */
+    static const RuleSet &getRules() { return rules; }
+
+    static RulesStats getStats() { return RulesStats{evaluations, fired, suppressed}; }
+
+private:
+    static bool _install(JsonObjectConst source);
+    static bool _compile(JsonObjectConst source, Rule &rule);
+    static bool _compileAction(JsonObjectConst source, RuleCompiler &compiler, const char *name,
+                               RuleAction &action);
+    static void _publish();
+    static void _save(JsonObjectConst source, const char *name);
+    static void _saveNames();
+
+    static RuleSet rules;                // network task copy
+    static TripleBuffer<RuleSet> active; // what the actuator runs
+    static uint8_t depth;                // actuator task only
+    static volatile uint32_t evaluations;
+    static volatile uint32_t fired;
+    static volatile uint32_t suppressed;
+};
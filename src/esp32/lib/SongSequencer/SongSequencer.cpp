@@ -0,0 +1,324 @@
+#include "SongSequencer.h"
+
+// ====== SongScore ======
+
+bool SongScore::compile(JsonArrayConst score, int tempo)
+{
+    if (tempo <= 0)
+    {
+        count = 0;
+        totalMs = 0;
+        LOG_WARN("⚠️ SongScore: invalid tempo");
+        return false;
+    }
+
+    begin(tempo);
+    for (JsonVariantConst item : score)
+    {
+        if (!add(item))
+        {
+            LOG_WARN("⚠️ SongScore: score truncated to %d notes", SONG_MAX_NOTES);
+            break;
+        }
+    }
+    return end(tempo);
+}
+
+void SongScore::begin(int tempo)
+{
+    count = 0;
+    totalMs = 0;
+    tempoBpm = tempo;
+    beats = 0.0f;
+    cutMs = 0;
+}
+
+bool SongScore::add(JsonVariantConst item)
+{
+    if (count >= SONG_MAX_NOTES)
+    {
+        return false;
+    }
+
+    float noteBeats = item["beats"] | 1.0f;
+    if (noteBeats <= 0.0f)
+    {
+        return true;
+    }
+
+    // Note start times are rounded from the cumulative beat count
+    const float beatMs = 60000.0f / tempoBpm;
+    beats += noteBeats;
+    uint32_t endMs = (uint32_t)(beats * beatMs + 0.5f) - cutMs;
+    uint32_t duration = endMs - totalMs;
+    if (duration == 0)
+    {
+        return true;
+    }
+    if (duration > UINT16_MAX)
+    {
+        // The notes after it start when it ends, not when it should have
+        cutMs += duration - UINT16_MAX;
+        duration = UINT16_MAX;
+    }
+
+    int freq = item["freq"] | 0;
+    int freqStart = item["freq_start"] | freq;
+    int freqEnd = item["freq_end"] | freqStart;
+    bool tie = item["tie"] | false;
+
+    SongNote &note = notes[count++];
+    note.freqStart = constrain(freqStart, 0, 20000);
+    note.freqEnd = note.freqStart ? constrain(freqEnd, 1, 20000) : 0;
+    note.amp = constrain(item["amp"] | 255, 0, 255);
+    note.durationMs = duration;
+
+    uint32_t gap = tie ? 0 : min((uint32_t)SONG_ARTICULATION_GAP_MS, duration / 4);
+    note.soundMs = duration - gap;
+
+    totalMs += duration;
+    return true;
+}
+
+bool SongScore::end(int tempo)
+{
+    if (tempo <= 0)
+    {
+        count = 0;
+        totalMs = 0;
+        LOG_WARN("⚠️ SongScore: invalid tempo");
+        return false;
+    }
+
+    // The tempo came after the notes: scale each note's end time, so
+    // rounding still does not accumulate over the song
+    if (tempo != tempoBpm && count > 0)
+    {
+        uint32_t oldEndMs = 0;
+        uint32_t startMs = 0;
+        cutMs = 0;
+        for (uint16_t i = 0; i < count; i++)
+        {
+            SongNote &note = notes[i];
+            bool tie = note.soundMs == note.durationMs;
+            oldEndMs += note.durationMs;
+            uint32_t endMs = ((uint64_t)oldEndMs * tempoBpm + tempo / 2) / tempo - cutMs;
+            uint32_t duration = endMs - startMs;
+            if (duration > UINT16_MAX)
+            {
+                cutMs += duration - UINT16_MAX;
+                duration = UINT16_MAX;
+            }
+
+            note.durationMs = duration;
+            note.soundMs = duration - (tie ? 0 : min((uint32_t)SONG_ARTICULATION_GAP_MS, duration / 4));
+            startMs += duration;
+        }
+        totalMs = startMs;
+        tempoBpm = tempo;
+    }
+
+    if (count == 0)
+    {
+        LOG_WARN("⚠️ SongScore: no playable notes");
+        return false;
+    }
+    return true;
+}
+
+// ====== SongCursor ======
+
+void SongCursor::reset(const SongScore *s)
+{
+    score = s;
+    index = 0;
+    noteStartMs = 0;
+}
+
+bool SongCursor::step(uint32_t elapsedMs, uint16_t &freq, uint8_t &amp)
+{
+    freq = 0;
+    amp = 0;
+    if (!score)
+    {
+        return false;
+    }
+
+    // Skip every note that already ended (several may pass within one tick)
+    while (index < score->size() && elapsedMs >= noteStartMs + (*score)[index].durationMs)
+    {
+        noteStartMs += (*score)[index].durationMs;
+        index++;
+    }
+    if (index >= score->size())
+    {
+        return false;
+    }
+
+    const SongNote &note = (*score)[index];
+    uint32_t t = elapsedMs - noteStartMs;
+    if (note.freqStart == 0 || t >= note.soundMs)
+    {
+        return true; // rest or articulation gap
+    }
+
+    int32_t delta = (int32_t)note.freqEnd - (int32_t)note.freqStart;
+    freq = note.freqStart + delta * (int32_t)t / (int32_t)note.soundMs;
+    amp = note.amp;
+    return true;
+}
+
+// ====== SongPlayer ======
+
+void SongPlayer::begin(int pin, uint8_t channel)
+{
+    _pin = pin;
+    _channel = channel;
+    if (!_outputLock)
+    {
+        _outputLock = xSemaphoreCreateMutex();
+    }
+    if (_pin < 0)
+    {
+        return;
+    }
+
+    // The player owns the pin: every buzzer output goes through this channel
+    ledcSetup(_channel, 1000, 10);
+    ledcAttachPin(_pin, _channel);
+    ledcWrite(_channel, 0);
+
+    if (!_timer)
+    {
+        esp_timer_create_args_t args = {};
+        args.callback = &SongPlayer::_onTick;
+        args.arg = this;
+        args.dispatch_method = ESP_TIMER_TASK;
+        args.name = "song";
+        esp_timer_create(&args, &_timer);
+    }
+}
+
+bool SongPlayer::play(const SongScore &score)
+{
+    if (_pin < 0 || !_timer)
+    {
+        return false;
+    }
+    _start(&score);
+    _tick(); // first note starts now, not one tick late
+    esp_timer_start_periodic(_timer, SONG_TICK_US);
+    return true;
+}
+
+bool SongPlayer::playTone(uint16_t freq, uint8_t amp)
+{
+    if (_pin < 0 || !_timer)
+    {
+        return false;
+    }
+    // No score and no ticks: the tone holds until stop()
+    _start(nullptr);
+    _output(freq, amp);
+    return true;
+}
+
+void SongPlayer::stop()
+{
+    portENTER_CRITICAL(&_lock);
+    _playing = false;
+    portEXIT_CRITICAL(&_lock);
+
+    if (_timer)
+    {
+        esp_timer_stop(_timer);
+    }
+    if (_pin >= 0)
+    {
+        _output(0, 0);
+    }
+}
+
+void SongPlayer::_start(const SongScore *score)
+{
+    stop();
+
+    portENTER_CRITICAL(&_lock);
+    _cursor.reset(score);
+    _startUs = esp_timer_get_time();
+    _playing = true;
+    portEXIT_CRITICAL(&_lock);
+}
+
+void SongPlayer::_onTick(void *arg)
+{
+    static_cast<SongPlayer *>(arg)->_tick();
+}
+
+void SongPlayer::_tick()
+{
+    uint16_t freq;
+    uint8_t amp;
+    bool running;
+
+    // Holding the output lock from the check to the write keeps a tick that
+    // raced stop() from sounding the note again after stop() silenced it
+    xSemaphoreTake(_outputLock, portMAX_DELAY);
+
+    // Time is taken from the start of the song, so timer jitter never accumulates
+    portENTER_CRITICAL(&_lock);
+    if (!_playing)
+    {
+        portEXIT_CRITICAL(&_lock);
+        xSemaphoreGive(_outputLock);
+        return;
+    }
+    uint32_t elapsedMs = (uint32_t)((esp_timer_get_time() - _startUs) / 1000);
+    running = _cursor.step(elapsedMs, freq, amp);
+    portEXIT_CRITICAL(&_lock);
+
+    if (running)
+    {
+        _write(freq, amp);
+    }
+    xSemaphoreGive(_outputLock);
+
+    if (!running)
+    {
+        stop();
+    }
+}
+
+// The timer task and the handler task both drive the channel; LEDC calls may
+// block, so they are serialized by a mutex rather than the critical section
+void SongPlayer::_output(uint16_t freq, uint8_t amp)
+{
+    xSemaphoreTake(_outputLock, portMAX_DELAY);
+    _write(freq, amp);
+    xSemaphoreGive(_outputLock);
+}
+
+void SongPlayer::_write(uint16_t freq, uint8_t amp)
+{
+    if (freq == _lastFreq && amp == _lastAmp)
+    {
+        return;
+    }
+
+    if (freq == 0 || amp == 0)
+    {
+        ledcWrite(_channel, 0);
+    }
+    else
+    {
+        if (freq != _lastFreq || _lastAmp == 0)
+        {
+            ledcWriteTone(_channel, freq);
+        }
+        // A square wave is loudest at 50% duty (512 of 1024)
+        ledcWrite(_channel, (uint32_t)amp * 512 / 255);
+    }
+
+    _lastFreq = freq;
+    _lastAmp = amp;
+}
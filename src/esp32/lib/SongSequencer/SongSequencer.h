@@ -0,0 +1,143 @@
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include <freertos/semphr.h>
+#include "Logger.h"
+
+// Maximum number of notes a compiled score can hold
+#ifndef SONG_MAX_NOTES
+#define SONG_MAX_NOTES 128
+#endif
+
+// Playback tick of the sequencer timer (also the glissando step)
+#ifndef SONG_TICK_US
+#define SONG_TICK_US 5000
+#endif
+
+// LEDC channel used for playback
+#ifndef SONG_LEDC_CHANNEL
+#define SONG_LEDC_CHANNEL 2
+#endif
+
+// Silence inserted at the end of untied notes so repeated notes stay distinct
+#ifndef SONG_ARTICULATION_GAP_MS
+#define SONG_ARTICULATION_GAP_MS 15
+#endif
+
+// One compiled note of a score
+struct SongNote
+{
+    uint16_t freqStart;  // Hz at the start of the note, 0 = rest
+    uint16_t freqEnd;    // Hz at the end of the sounding part (glissando)
+    uint16_t durationMs; // Time until the next note starts
+    uint16_t soundMs;    // Sounding part of the note, the rest is silence
+    uint8_t amp;         // Volume (PWM duty 0-255)
+};
+
+// A PLAY_SONG score compiled into a fixed-size note array
+class SongScore
+{
+public:
+    /**
+     * Compile a PLAY_SONG "score" array into notes.
+     * Note start times are rounded from the cumulative beat count, so
+     * rounding errors never accumulate over the length of the song. A note
+     * longer than UINT16_MAX ms is cut short and the notes after it move up.
+     * @param score The "score" array of a PLAY_SONG command
+     * @param tempo Beats per minute
+     * @return false if the score contains no playable note
+     */
+    bool compile(JsonArrayConst score, int tempo);
+
+    /**
+     * Start compiling a score note by note, for scores that are streamed
+     * @param tempo Beats per minute, if known yet (see end())
+     */
+    void begin(int tempo);
+
+    /**
+     * Compile the next note of the score
+     * @param item One element of a PLAY_SONG "score" array
+     * @return false if the score is full and the note was left out
+     */
+    bool add(JsonVariantConst item);
+
+    /**
+     * Finish a score compiled with add(); a tempo other than the one given to
+     * begin() rescales the notes, again from their cumulative start times
+     * @return false if the score contains no playable note
+     */
+    bool end(int tempo);
+
+    uint16_t size() const { return count; }
+    uint32_t lengthMs() const { return totalMs; }
+    const SongNote &operator[](uint16_t i) const { return notes[i]; }
+
+private:
+    SongNote notes[SONG_MAX_NOTES];
+    uint16_t count = 0;
+    uint32_t totalMs = 0;
+    int tempoBpm = 0;     // tempo the note times were computed for
+    float beats = 0.0f;   // cumulative beats at the start of the next note
+    uint32_t cutMs = 0;   // time cut from notes longer than UINT16_MAX ms
+};
+
+// Walks a compiled score in time; has no hardware dependency
+class SongCursor
+{
+public:
+    void reset(const SongScore *score);
+
+    /**
+     * Compute the output at a point in time since the start of the song
+     * @param elapsedMs Time since playback started, must not go backwards
+     * @param freq Output frequency in Hz (0 = silent)
+     * @param amp Output volume 0-255
+     * @return false once the song has ended
+     */
+    bool step(uint32_t elapsedMs, uint16_t &freq, uint8_t &amp);
+
+private:
+    const SongScore *score = nullptr;
+    uint16_t index = 0;
+    uint32_t noteStartMs = 0;
+};
+
+// Plays a compiled score on an LEDC channel from a hardware-backed esp_timer,
+// so the main loop keeps running during playback
+class SongPlayer
+{
+public:
+    void begin(int pin, uint8_t channel = SONG_LEDC_CHANNEL);
+
+    // Start playing the score from the beginning; the score must stay alive until stopped
+    bool play(const SongScore &score);
+
+    // Play a fixed tone until stop()
+    bool playTone(uint16_t freq, uint8_t amp);
+
+    // Stop playback and silence the output (safe to call when idle)
+    void stop();
+
+    bool isPlaying() const { return _playing; }
+
+private:
+    static void _onTick(void *arg);
+    void _tick();
+    void _start(const SongScore *score);
+    void _output(uint16_t freq, uint8_t amp);
+    void _write(uint16_t freq, uint8_t amp);
+
+    int _pin = -1;
+    uint8_t _channel = SONG_LEDC_CHANNEL;
+    esp_timer_handle_t _timer = nullptr;
+    portMUX_TYPE _lock = portMUX_INITIALIZER_UNLOCKED;
+    SemaphoreHandle_t _outputLock = nullptr; // LEDC and _last*: timer task vs handler task
+    SongCursor _cursor;
+    int64_t _startUs = 0;
+    uint16_t _lastFreq = 0;
+    uint8_t _lastAmp = 0;
+    volatile bool _playing = false;
+};
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <type_traits>
+
+// What push() does when the ring is full
+enum class RingOverflow : uint8_t
+{
+    DropNewest, // reject the new item
+    DropOldest, // discard the oldest queued item to make room
+};
+
+// Lock-free single-producer/single-consumer ring buffer.
+// Plain C++ (std::atomic only), so it runs the same on the ESP32 and on a host.
+//
+// The consumer claims a slot before copying it and releases it after, and the
+// producer only writes released slots. With DropOldest the producer takes the
+// oldest item only if the consumer has not claimed it; if the consumer is
+// copying it, the new item is dropped instead. No slot is ever written while
+// it is being read.
+template <typename T, size_t N>
+class SpscRing
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscRing size must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "SpscRing items must be trivially copyable");
+
+public:
+    explicit SpscRing(RingOverflow policy = RingOverflow::DropNewest) : policy(policy) {}
+
+    // Producer side; returns false if the item was dropped
+    bool push(const T &item)
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        uint32_t r = released.load(std::memory_order_acquire);
+        if (h - r >= N)
+        {
+            // Slot h holds the oldest item, unread or being copied; it can only
+            // be taken if the consumer has not claimed it
+            uint32_t t = r;
+            dropCount.fetch_add(1, std::memory_order_relaxed);
+            if (policy == RingOverflow::DropNewest ||
+                !tail.compare_exchange_strong(t, t + 1, std::memory_order_acq_rel))
+            {
+                return false;
+            }
+            // Unless the consumer has already released a later slot
+            released.compare_exchange_strong(r, r + 1, std::memory_order_release, std::memory_order_relaxed);
+        }
+
+        slots[h & (N - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+
+        uint32_t depth = h + 1 - tail.load(std::memory_order_relaxed);
+        if (depth > highWater.load(std::memory_order_relaxed))
+        {
+            highWater.store(depth, std::memory_order_relaxed);
+        }
+        return true;
+    }
+
+    // Consumer side; returns false if the ring is empty
+    bool pop(T &out)
+    {
+        // Claim the oldest slot; only DropOldest's producer competes for it
+        uint32_t t = tail.load(std::memory_order_acquire);
+        do
+        {
+            if (t == head.load(std::memory_order_acquire))
+            {
+                return false;
+            }
+        } while (!tail.compare_exchange_weak(t, t + 1, std::memory_order_acq_rel, std::memory_order_acquire));
+
+        out = slots[t & (N - 1)];
+        released.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Number of queued items (approximate while the other side is running)
+    size_t size() const
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    static constexpr size_t capacity() { return N; }
+
+    // Deepest the ring has been since construction
+    size_t highWaterMark() const { return highWater.load(std::memory_order_relaxed); }
+
+    // Items lost to the overflow policy
+    uint32_t dropped() const { return dropCount.load(std::memory_order_relaxed); }
+
+private:
+    T slots[N];
+    const RingOverflow policy;
+    std::atomic<uint32_t> head{0};     // next slot to write, only advanced by the producer
+    std::atomic<uint32_t> tail{0};     // next slot to read
+    std::atomic<uint32_t> released{0}; // slots before this one are free to write
+    std::atomic<uint32_t> highWater{0};
+    std::atomic<uint32_t> dropCount{0};
+};
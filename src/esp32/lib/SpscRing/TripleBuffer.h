@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+
+// Lock-free hand-over of large values from one writer to one reader.
+// The writer fills writeBuffer() and publish()es it; the reader calls update()
+// to take the latest published value. Neither side ever waits or copies.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Writer side: buffer to fill, owned by the writer until publish()
+    T &writeBuffer() { return buffers[back]; }
+
+    // Writer side: hand the filled buffer to the reader
+    void publish()
+    {
+        uint8_t previous = middle.exchange(back | FRESH, std::memory_order_acq_rel);
+        back = previous & INDEX;
+    }
+
+    // Reader side: switch to the latest published buffer
+    // Returns false if nothing new was published since the last update
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_acquire) & FRESH))
+        {
+            return false;
+        }
+        uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX;
+        return true;
+    }
+
+    // Reader side: buffer taken by the last update(), owned by the reader
+    const T &readBuffer() const { return buffers[front]; }
+
+private:
+    static constexpr uint8_t INDEX = 0x03;
+    static constexpr uint8_t FRESH = 0x04;
+
+    T buffers[3];
+    uint8_t back = 0;
+    std::atomic<uint8_t> middle{1};
+    uint8_t front = 2;
+};
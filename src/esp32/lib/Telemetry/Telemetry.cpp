@@ -0,0 +1,165 @@
+#include "Telemetry.h"
+#include <ArduinoJson.h>
+#include <esp_timer.h>
+#include "ConfigLoader.h"
+#include "MQTTClient.h"
+#include "ConnectionManager.h"
+#include "CommandPipeline.h"
+#include "NetworkEvents.h"
+#include "AudioPlayer.h"
+#include "CommandAck.h"
+
+Histogram Telemetry::histograms[(uint8_t)Metric::Count] = {};
+volatile uint32_t Telemetry::loopOverruns = 0;
+uint32_t Telemetry::lastPublish = 0;
+
+// Report keys, in Metric order
+static const char *const metricNames[] = {"dispatch", "queue", "command", "loop", "wake"};
+
+// Root fields and counter arrays, plus one object with a bucket array per metric
+static constexpr size_t reportCapacity =
+    JSON_OBJECT_SIZE(11) + 6 * JSON_ARRAY_SIZE(4) + JSON_ARRAY_SIZE(5) + JSON_ARRAY_SIZE(6) + JSON_OBJECT_SIZE((uint8_t)Metric::Count) +
+    (uint8_t)Metric::Count * (JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(TELEMETRY_BUCKETS));
+
+void Telemetry::record(Metric metric, uint32_t us)
+{
+    Histogram &h = histograms[(uint8_t)metric];
+    uint8_t bucket = us == 0 ? 0 : 32 - __builtin_clz(us);
+    h.buckets[bucket < TELEMETRY_BUCKETS ? bucket : TELEMETRY_BUCKETS - 1]++;
+    h.count++;
+    h.totalUs += us;
+    if (us > h.maxUs)
+    {
+        h.maxUs = us;
+    }
+
+    if (metric == Metric::Loop && us > TELEMETRY_LOOP_BUDGET_US)
+    {
+        loopOverruns = loopOverruns + 1;
+    }
+}
+
+void Telemetry::loop()
+{
+#if TELEMETRY_ENABLED
+    const auto &cfg = ConfigLoader::getConfig();
+    uint32_t intervalMs = cfg.telemetry_interval_s * 1000;
+    uint32_t now = millis();
+    if (intervalMs == 0 || now - lastPublish < intervalMs)
+    {
+        return;
+    }
+    lastPublish = now;
+
+    char payload[TELEMETRY_PAYLOAD_SIZE];
+    size_t length = serialize(payload, sizeof(payload));
+    if (length == 0 ||
+        !MQTTClient::getMQTTClient().publish(cfg.telemetry_topic, (const uint8_t *)payload, length))
+    {
+        LOG_WARN("⚠️ Telemetry publish failed");
+    }
+#endif
+}
+
+size_t Telemetry::serialize(char *buffer, size_t size)
+{
+    StaticJsonDocument<reportCapacity> doc;
+    doc["up"] = millis() / 1000;
+
+    // free, low-water mark, largest free block
+    JsonArray heap = doc.createNestedArray("heap");
+    heap.add(ESP.getFreeHeap());
+    heap.add(ESP.getMinFreeHeap());
+    heap.add(ESP.getMaxAllocHeap());
+
+    // reconnects, failed attempts, last and worst reconnect time (ms)
+    const ConnectionStats &conn = ConnectionManager::getStats();
+    JsonArray link = doc.createNestedArray("conn");
+    link.add(conn.reconnects);
+    link.add(conn.failedAttempts);
+    link.add(conn.lastReconnectMs);
+    link.add(conn.maxReconnectMs);
+
+    // full handshakes and their average ms, resumed handshakes and their average ms
+    const TlsStats &tls = TlsClient::getStats();
+    JsonArray handshakes = doc.createNestedArray("tls");
+    handshakes.add(tls.fullHandshakes);
+    handshakes.add(tls.fullHandshakes ? tls.fullHandshakeMs / tls.fullHandshakes : 0);
+    handshakes.add(tls.resumedHandshakes);
+    handshakes.add(tls.resumedHandshakes ? tls.resumedHandshakeMs / tls.resumedHandshakes : 0);
+
+    // executed, dropped, queue high-water mark, scheduled, coalesced, duplicates
+    PipelineStats pipe = CommandPipeline::getStats();
+    JsonArray cmd = doc.createNestedArray("cmd");
+    cmd.add(pipe.executed);
+    cmd.add(pipe.dropped);
+    cmd.add(pipe.highWaterMark);
+    cmd.add(pipe.scheduled);
+    cmd.add(pipe.coalesced);
+    cmd.add(MQTTClient::getMessageStats().duplicates);
+
+    // acked messages, acked as dropped after the timeout, with an "id" but not acked
+    const CommandAckStats &acks = CommandAck::getStats();
+    JsonArray ack = doc.createNestedArray("ack");
+    ack.add(acks.acked);
+    ack.add(acks.expired);
+    ack.add(acks.untracked);
+
+    doc["overruns"] = loopOverruns;
+
+    // network task wakeups by socket, by wake() and by timeout, and the share of time it slept (%)
+    const NetworkEventStats &events = NetworkEvents::getStats();
+    JsonArray net = doc.createNestedArray("net");
+    net.add(events.socketWakes);
+    net.add(events.wakes);
+    net.add(events.timeouts);
+    uint64_t upUs = esp_timer_get_time();
+    net.add(upUs ? (uint32_t)(events.waitedUs * 100 / upUs) : 0);
+
+    // streamed audio: chunks, underruns, overruns, lost chunks, rejected chunks
+    AudioStats audioStats = AudioPlayer::getStats();
+    JsonArray audio = doc.createNestedArray("audio");
+    audio.add(audioStats.chunks);
+    audio.add(audioStats.underruns);
+    audio.add(audioStats.overruns);
+    audio.add(audioStats.lost);
+    audio.add(audioStats.invalid);
+
+#if MQTT_PROTOCOL_VERSION == 5
+    // MQTT bytes in and out, largest payload received, oversize packets dropped
+    const Mqtt5Stats &mqttStats = MQTTClient::getMQTTClient().getStats();
+    JsonArray mqtt = doc.createNestedArray("mqtt");
+    mqtt.add(mqttStats.bytesIn);
+    mqtt.add(mqttStats.bytesOut);
+    mqtt.add(mqttStats.largestPayload);
+    mqtt.add(mqttStats.oversize);
+#endif
+
+    // Buckets are trimmed after the last non-empty one
+    JsonObject hist = doc.createNestedObject("hist");
+    for (uint8_t i = 0; i < (uint8_t)Metric::Count; i++)
+    {
+        const Histogram &h = histograms[i];
+        JsonObject entry = hist.createNestedObject(metricNames[i]);
+        entry["n"] = h.count;
+        entry["max"] = h.maxUs;
+        entry["avg"] = h.count ? (uint32_t)(h.totalUs / h.count) : 0;
+
+        int last = TELEMETRY_BUCKETS - 1;
+        while (last >= 0 && h.buckets[last] == 0)
+        {
+            last--;
+        }
+        JsonArray buckets = entry.createNestedArray("b");
+        for (int b = 0; b <= last; b++)
+        {
+            buckets.add(h.buckets[b]);
+        }
+    }
+
+    if (doc.overflowed() || measureJson(doc) >= size)
+    {
+        return 0;
+    }
+    return serializeJson(doc, buffer, size);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <Arduino.h>
+#include "Logger.h"
+
+// Set to 0 to compile the hot-path instrumentation out entirely
+#ifndef TELEMETRY_ENABLED
+#define TELEMETRY_ENABLED 1
+#endif
+
+// Log2 latency buckets: bucket 0 counts 0us, bucket b counts [2^(b-1), 2^b) us,
+// and the last bucket is open-ended (>= 16ms)
+#define TELEMETRY_BUCKETS 16
+
+// A network loop pass that works longer than this counts as an overrun
+#ifndef TELEMETRY_LOOP_BUDGET_US
+#define TELEMETRY_LOOP_BUDGET_US 10000
+#endif
+
+// Size of the published payload buffer
+#ifndef TELEMETRY_PAYLOAD_SIZE
+#define TELEMETRY_PAYLOAD_SIZE 1280
+#endif
+
+// Instrumented spans. Each metric is recorded from a single task only, so
+// recording needs no locking; a reader may see a histogram mid-update.
+enum class Metric : uint8_t
+{
+    Dispatch, // mqttCallback: parse, decode and submit (network task)
+    Queue,    // submit -> actuator pickup, unscheduled commands only (actuator task)
+    Command,  // handleCommand, up to the GPIO/LEDC change (actuator task)
+    Loop,     // one network loop pass, without its idle wait (network task)
+    Wake,     // broker socket readable -> network task running (network task)
+    Count
+};
+
+// Fixed-bucket latency histogram; counts are cumulative since boot
+struct Histogram
+{
+    uint32_t buckets[TELEMETRY_BUCKETS];
+    uint32_t count;
+    uint32_t maxUs;
+    uint64_t totalUs;
+};
+
+// Aggregates hot-path latencies in fixed memory and publishes them, with heap,
+// connection and pipeline counters, to the telemetry topic
+class Telemetry
+{
+public:
+    /**
+     * Add one sample to a metric's histogram
+     * @param metric Span that was measured
+     * @param us Duration in microseconds
+     */
+    static void record(Metric metric, uint32_t us);
+
+    /**
+     * Publish a report when the interval has elapsed
+     * Call from the network task while MQTT is connected
+     */
+    static void loop();
+
+    /**
+     * Write a compact JSON report
+     * @return Bytes written, 0 if the buffer is too small
+     */
+    static size_t serialize(char *buffer, size_t size);
+
+    static const Histogram &getHistogram(Metric metric) { return histograms[(uint8_t)metric]; }
+
+private:
+    static Histogram histograms[(uint8_t)Metric::Count];
+    static volatile uint32_t loopOverruns;
+    static uint32_t lastPublish;
+};
+
+#if TELEMETRY_ENABLED
+// Start a span: declares `var` holding the current micros()
+#define TELEMETRY_START(var) uint32_t var = micros()
+// End a span started with TELEMETRY_START(var)
+#define TELEMETRY_RECORD(metric, var) Telemetry::record(metric, micros() - (var))
+#else
+#define TELEMETRY_START(var)
+#define TELEMETRY_RECORD(metric, var)
+#endif
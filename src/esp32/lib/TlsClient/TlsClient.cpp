@@ -0,0 +1,395 @@
+#include "TlsClient.h"
+#include <esp_attr.h>
+#include <lwip/sockets.h>
+#include <mbedtls/error.h>
+#include <mbedtls/net_sockets.h>
+
+// Serialized session; RTC_NOINIT survives deep sleep and soft resets, and the
+// checksum rejects the garbage it holds after a power cycle
+struct TlsSessionCache
+{
+    uint32_t magic;
+    uint32_t hostHash;
+    uint32_t length;
+    uint32_t checksum;
+    uint8_t data[TLS_SESSION_CACHE_SIZE];
+};
+
+RTC_NOINIT_ATTR static TlsSessionCache sessionCache;
+static const uint32_t sessionMagic = 0x544c5331; // "TLS1"
+
+TlsStats TlsClient::stats = {};
+
+static uint32_t fnv1a(const uint8_t *data, size_t length)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static bool wouldBlock(int ret)
+{
+    return ret == MBEDTLS_ERR_SSL_WANT_READ || ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+}
+
+TlsClient::TlsClient()
+{
+    mbedtls_ssl_init(&ssl);
+    mbedtls_ssl_config_init(&conf);
+    mbedtls_ctr_drbg_init(&drbg);
+    mbedtls_entropy_init(&entropy);
+    mbedtls_x509_crt_init(&caCert);
+}
+
+TlsClient::~TlsClient()
+{
+    stop();
+    mbedtls_ssl_free(&ssl);
+    mbedtls_ssl_config_free(&conf);
+    mbedtls_ctr_drbg_free(&drbg);
+    mbedtls_entropy_free(&entropy);
+    mbedtls_x509_crt_free(&caCert);
+}
+
+void TlsClient::setCACert(const char *pem)
+{
+    mbedtls_x509_crt_free(&caCert);
+    mbedtls_x509_crt_init(&caCert);
+    lastErr = mbedtls_x509_crt_parse(&caCert, (const unsigned char *)pem, strlen(pem) + 1);
+    caLoaded = lastErr == 0;
+    if (!caLoaded)
+    {
+        LOG_ERROR("❌ Invalid CA certificate (-0x%04x)", -lastErr);
+    }
+}
+
+// One-time setup shared by every connection
+bool TlsClient::_configure()
+{
+    static const char *personalization = "esp32-mcp";
+    int ret = mbedtls_ctr_drbg_seed(&drbg, mbedtls_entropy_func, &entropy,
+                                    (const unsigned char *)personalization, strlen(personalization));
+    if (ret == 0)
+    {
+        ret = mbedtls_ssl_config_defaults(&conf, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                          MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+    if (ret != 0)
+    {
+        lastErr = ret;
+        return false;
+    }
+
+    mbedtls_ssl_conf_authmode(&conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+    mbedtls_ssl_conf_ca_chain(&conf, &caCert, nullptr);
+    mbedtls_ssl_conf_rng(&conf, mbedtls_ctr_drbg_random, &drbg);
+    mbedtls_ssl_conf_verify(&conf, _verify, this);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&conf, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    configured = true;
+    return true;
+}
+
+int TlsClient::connect(IPAddress ip, uint16_t port)
+{
+    return connect(ip.toString().c_str(), port);
+}
+
+int TlsClient::connect(const char *host, uint16_t port)
+{
+    stop();
+    if (!caLoaded || (!configured && !_configure()))
+    {
+        return 0;
+    }
+
+    if (!tcp.connect(host, port, handshakeTimeoutMs))
+    {
+        lastErr = MBEDTLS_ERR_NET_CONNECT_FAILED;
+        return 0;
+    }
+
+    int ret = mbedtls_ssl_setup(&ssl, &conf);
+    if (ret == 0)
+    {
+        ret = mbedtls_ssl_set_hostname(&ssl, host);
+    }
+    if (ret != 0)
+    {
+        lastErr = ret;
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_init(&ssl);
+        tcp.stop();
+        return 0;
+    }
+    mbedtls_ssl_set_bio(&ssl, this, _send, _recv, nullptr);
+    open = true;
+
+    bool offered = _restoreSession(host);
+    certificateSeen = false;
+
+    uint32_t start = millis();
+    while ((ret = mbedtls_ssl_handshake(&ssl)) != 0)
+    {
+        if (!wouldBlock(ret))
+        {
+            break;
+        }
+        if (millis() - start > handshakeTimeoutMs)
+        {
+            ret = MBEDTLS_ERR_SSL_TIMEOUT;
+            break;
+        }
+        delay(1);
+    }
+    uint32_t elapsed = millis() - start;
+
+    if (ret != 0)
+    {
+        lastErr = ret;
+        stop();
+        if (offered)
+        {
+            // The cached session may be what the server choked on
+            forgetSession();
+        }
+        return 0;
+    }
+
+    // Only a full handshake carries the server certificate
+    bool resumed = offered && !certificateSeen;
+    if (resumed)
+    {
+        stats.resumedHandshakes++;
+        stats.resumedHandshakeMs += elapsed;
+    }
+    else
+    {
+        stats.fullHandshakes++;
+        stats.fullHandshakeMs += elapsed;
+        if (offered)
+        {
+            stats.resumptionsRejected++;
+        }
+    }
+    stats.lastHandshakeMs = elapsed;
+    LOG_INFO("%s TLS handshake %lums", resumed ? "⚡ Resumed" : "🤝 Full", (unsigned long)elapsed);
+
+    // Servers may issue a fresh ticket on every handshake
+    _saveSession(host);
+    lastErr = 0;
+    return 1;
+}
+
+bool TlsClient::_restoreSession(const char *host)
+{
+    if (sessionCache.magic != sessionMagic || sessionCache.length > TLS_SESSION_CACHE_SIZE ||
+        sessionCache.hostHash != fnv1a((const uint8_t *)host, strlen(host)) ||
+        sessionCache.checksum != fnv1a(sessionCache.data, sessionCache.length))
+    {
+        return false;
+    }
+
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+    bool ok = mbedtls_ssl_session_load(&session, sessionCache.data, sessionCache.length) == 0 &&
+              mbedtls_ssl_set_session(&ssl, &session) == 0;
+    mbedtls_ssl_session_free(&session);
+    return ok;
+}
+
+void TlsClient::_saveSession(const char *host)
+{
+    mbedtls_ssl_session session;
+    mbedtls_ssl_session_init(&session);
+
+    size_t length = 0;
+    bool ok = mbedtls_ssl_get_session(&ssl, &session) == 0 &&
+              mbedtls_ssl_session_save(&session, sessionCache.data, sizeof(sessionCache.data), &length) == 0;
+    mbedtls_ssl_session_free(&session);
+
+    if (!ok)
+    {
+        forgetSession();
+        return;
+    }
+    sessionCache.hostHash = fnv1a((const uint8_t *)host, strlen(host));
+    sessionCache.length = length;
+    sessionCache.checksum = fnv1a(sessionCache.data, length);
+    sessionCache.magic = sessionMagic;
+}
+
+void TlsClient::forgetSession()
+{
+    sessionCache.magic = 0;
+}
+
+size_t TlsClient::write(const uint8_t *buf, size_t size)
+{
+    size_t sent = 0;
+    uint32_t start = millis();
+    while (open && sent < size)
+    {
+        int ret = mbedtls_ssl_write(&ssl, buf + sent, size - sent);
+        if (ret > 0)
+        {
+            sent += ret;
+        }
+        else if (!wouldBlock(ret))
+        {
+            lastErr = ret;
+            stop();
+        }
+        else if (millis() - start > TLS_WRITE_TIMEOUT_MS)
+        {
+            break;
+        }
+        else
+        {
+            delay(1);
+        }
+    }
+    return sent;
+}
+
+// Reads decrypted bytes; 0 if none are ready, -1 once the connection is gone
+int TlsClient::_readRecord(uint8_t *buf, size_t size)
+{
+    if (!open)
+    {
+        return -1;
+    }
+    int ret = mbedtls_ssl_read(&ssl, buf, size);
+    if (ret >= 0 || wouldBlock(ret))
+    {
+        return ret > 0 ? ret : 0;
+    }
+    // Close-notify, connection reset or a hard error
+    lastErr = ret;
+    stop();
+    return -1;
+}
+
+int TlsClient::available()
+{
+    if (!open)
+    {
+        return 0;
+    }
+    // A zero-length read pulls in a pending record without consuming data
+    if (mbedtls_ssl_get_bytes_avail(&ssl) == 0 && _readRecord(nullptr, 0) < 0)
+    {
+        return peeked >= 0 ? 1 : 0;
+    }
+    return mbedtls_ssl_get_bytes_avail(&ssl) + (peeked >= 0 ? 1 : 0);
+}
+
+int TlsClient::read(uint8_t *buf, size_t size)
+{
+    if (size == 0)
+    {
+        return 0;
+    }
+
+    size_t n = 0;
+    if (peeked >= 0)
+    {
+        buf[n++] = peeked;
+        peeked = -1;
+    }
+    if (n < size && (n == 0 || (open && mbedtls_ssl_get_bytes_avail(&ssl) > 0)))
+    {
+        int ret = _readRecord(buf + n, size - n);
+        if (ret > 0)
+        {
+            n += ret;
+        }
+    }
+    return n > 0 ? n : -1;
+}
+
+int TlsClient::read()
+{
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+}
+
+int TlsClient::peek()
+{
+    if (peeked < 0)
+    {
+        uint8_t b;
+        if (read(&b, 1) == 1)
+        {
+            peeked = b;
+        }
+    }
+    return peeked;
+}
+
+void TlsClient::stop()
+{
+    if (open)
+    {
+        // Frees the record buffers too, so an idle client holds no TLS heap
+        mbedtls_ssl_close_notify(&ssl);
+        mbedtls_ssl_free(&ssl);
+        mbedtls_ssl_init(&ssl);
+        open = false;
+    }
+    tcp.stop();
+    peeked = -1;
+}
+
+uint8_t TlsClient::connected()
+{
+    if (open && !tcp.connected())
+    {
+        stop();
+    }
+    return open || peeked >= 0;
+}
+
+int TlsClient::lastError(char *buf, const size_t size)
+{
+    if (lastErr == 0)
+    {
+        snprintf(buf, size, "none");
+    }
+    else
+    {
+        mbedtls_strerror(lastErr, buf, size);
+    }
+    return lastErr;
+}
+
+// Called for each certificate in the server's chain; verification itself is left to mbedTLS
+int TlsClient::_verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags)
+{
+    static_cast<TlsClient *>(ctx)->certificateSeen = true;
+    return 0;
+}
+
+int TlsClient::_send(void *ctx, const unsigned char *buf, size_t len)
+{
+    int n = send(static_cast<TlsClient *>(ctx)->tcp.fd(), buf, len, MSG_DONTWAIT);
+    if (n < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+    return n;
+}
+
+int TlsClient::_recv(void *ctx, unsigned char *buf, size_t len)
+{
+    int n = recv(static_cast<TlsClient *>(ctx)->tcp.fd(), buf, len, MSG_DONTWAIT);
+    if (n < 0)
+    {
+        return (errno == EAGAIN || errno == EWOULDBLOCK) ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+    return n == 0 ? MBEDTLS_ERR_NET_CONN_RESET : n;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <Arduino.h>
+#include <Client.h>
+#include <WiFi.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/x509_crt.h>
+#include "Logger.h"
+
+// Room for one serialized TLS session (ticket plus the peer certificate)
+// in RTC memory; larger sessions are simply not cached
+#ifndef TLS_SESSION_CACHE_SIZE
+#define TLS_SESSION_CACHE_SIZE 2560
+#endif
+
+// Bound on a single blocking write
+#ifndef TLS_WRITE_TIMEOUT_MS
+#define TLS_WRITE_TIMEOUT_MS 5000
+#endif
+
+// Handshake metrics, split by whether the cached session was accepted
+struct TlsStats
+{
+    uint32_t fullHandshakes;
+    uint32_t fullHandshakeMs;    // total time spent in full handshakes
+    uint32_t resumedHandshakes;
+    uint32_t resumedHandshakeMs; // total time spent in resumed handshakes
+    uint32_t lastHandshakeMs;
+    uint32_t resumptionsRejected; // cached session offered but a full handshake happened
+};
+
+// TLS client (mbedTLS over a WiFiClient socket) that caches its session.
+// WiFiClientSecure starts every connection from scratch: it re-parses the
+// CA certificate and always runs a full handshake. This client parses the CA
+// once, keeps the mbedTLS configuration across reconnects, and saves the
+// session (ticket or ID) in RTC memory, so a reconnect - even after deep
+// sleep - can resume with an abbreviated handshake.
+class TlsClient : public Client
+{
+public:
+    TlsClient();
+    ~TlsClient();
+
+    /**
+     * Set the trusted root certificate (PEM); parsed once and kept
+     */
+    void setCACert(const char *pem);
+
+    void setHandshakeTimeout(unsigned long seconds) { handshakeTimeoutMs = seconds * 1000; }
+
+    int connect(IPAddress ip, uint16_t port) override;
+    int connect(const char *host, uint16_t port) override;
+    size_t write(uint8_t b) override { return write(&b, 1); }
+    size_t write(const uint8_t *buf, size_t size) override;
+    int available() override;
+    int read() override;
+    int read(uint8_t *buf, size_t size) override;
+    int peek() override;
+    void flush() override {}
+    void stop() override;
+    uint8_t connected() override;
+    operator bool() override { return connected(); }
+
+    /**
+     * @return The socket while a session is open, -1 otherwise
+     */
+    int fd() const { return open ? tcp.fd() : -1; }
+
+    /**
+     * Whether data can be read without touching the socket: decrypted bytes
+     * or complete records already pulled in by mbedTLS
+     */
+    bool hasBufferedInput() const
+    {
+        return peeked >= 0 || (open && (mbedtls_ssl_get_bytes_avail(&ssl) > 0 || mbedtls_ssl_check_pending(&ssl)));
+    }
+
+    /**
+     * Describe the last mbedTLS error
+     * @return The error code, 0 if none
+     */
+    int lastError(char *buf, const size_t size);
+
+    /**
+     * Drop the cached session, forcing a full handshake next time
+     */
+    static void forgetSession();
+
+    static const TlsStats &getStats() { return stats; }
+
+private:
+    bool _configure();
+    bool _restoreSession(const char *host);
+    void _saveSession(const char *host);
+    int _readRecord(uint8_t *buf, size_t size);
+    static int _verify(void *ctx, mbedtls_x509_crt *crt, int depth, uint32_t *flags);
+    static int _send(void *ctx, const unsigned char *buf, size_t len);
+    static int _recv(void *ctx, unsigned char *buf, size_t len);
+
+    WiFiClient tcp;
+    mbedtls_ssl_context ssl;
+    mbedtls_ssl_config conf;
+    mbedtls_ctr_drbg_context drbg;
+    mbedtls_entropy_context entropy;
+    mbedtls_x509_crt caCert;
+
+    bool caLoaded = false;
+    bool configured = false;
+    bool open = false;
+    bool certificateSeen = false; // set by _verify(); a resumed handshake skips it
+    int peeked = -1;
+    int lastErr = 0;
+    uint32_t handshakeTimeoutMs = 10000;
+
+    static TlsStats stats;
+};
@@ -0,0 +1,105 @@
+#include "CommandSchema.h"
+#include <strings.h>
+
+int CommandSchema::find(const char *name) const
+{
+    if (!name)
+    {
+        return -1;
+    }
+    uint8_t slot = slots[commandHash(name, seed) & mask];
+    if (slot == 0 || strcasecmp(name, commands[slot - 1].name) != 0)
+    {
+        return -1;
+    }
+    return slot - 1;
+}
+
+CommandError CommandSchema::decode(JsonObjectConst doc, Command &cmd, const char *&detail) const
+{
+    detail = nullptr;
+
+    JsonVariantConst name = doc["command"];
+    if (!name.is<const char *>())
+    {
+        return CommandError::MissingCommand;
+    }
+
+    detail = name.as<const char *>();
+    int id = find(detail);
+    if (id < 0)
+    {
+        return CommandError::UnknownCommand;
+    }
+
+    const CommandSpec &spec = commands[id];
+    cmd.id = id;
+    cmd.present = 0;
+
+    for (uint8_t i = 0; i < spec.fieldCount && i < COMMAND_MAX_FIELDS; i++)
+    {
+        const FieldSpec &field = spec.fields[i];
+        JsonVariantConst v = doc[field.name];
+        detail = field.name;
+        cmd.values[i] = field.defaultValue;
+
+        if (v.isNull())
+        {
+            if (field.required)
+            {
+                return CommandError::MissingField;
+            }
+            continue;
+        }
+
+        int32_t value = 0;
+        switch (field.type)
+        {
+        case FieldType::Int:
+            if (!v.is<float>()) // true for every JSON number
+            {
+                return CommandError::WrongType;
+            }
+            value = v.as<int32_t>();
+            break;
+        case FieldType::Bool:
+            if (!v.is<bool>())
+            {
+                return CommandError::WrongType;
+            }
+            value = v.as<bool>() ? 1 : 0;
+            break;
+        case FieldType::Array:
+            if (!v.is<JsonArrayConst>())
+            {
+                return CommandError::WrongType;
+            }
+            value = v.size();
+            break;
+        }
+
+        cmd.values[i] = value < field.min ? field.min : value > field.max ? field.max : value;
+        cmd.present |= 1u << i;
+    }
+
+    detail = nullptr;
+    return CommandError::None;
+}
+
+const char *CommandSchema::errorString(CommandError error)
+{
+    switch (error)
+    {
+    case CommandError::None:
+        return "ok";
+    case CommandError::MissingCommand:
+        return "missing 'command'";
+    case CommandError::UnknownCommand:
+        return "unknown command";
+    case CommandError::MissingField:
+        return "missing field";
+    case CommandError::WrongType:
+        return "invalid field type";
+    }
+    return "unknown error";
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <ArduinoJson.h>
+
+// Maximum number of fields a command can declare
+#ifndef COMMAND_MAX_FIELDS
+#define COMMAND_MAX_FIELDS 6
+#endif
+
+// Field types a command can declare
+enum class FieldType : uint8_t
+{
+    Int,   // any JSON number, stored truncated to int32_t
+    Bool,  // JSON true/false, stored as 0/1
+    Array, // JSON array, only checked for presence; read from the document
+};
+
+// One field of a command: numeric values outside [min, max] are clamped
+struct FieldSpec
+{
+    const char *name;
+    FieldType type;
+    int32_t min;
+    int32_t max;
+    int32_t defaultValue; // used when an optional field is absent
+    bool required;
+};
+
+// One command of a handler; its index in the handler's table is Command::id
+struct CommandSpec
+{
+    const char *name; // matched case-insensitively
+    const FieldSpec *fields;
+    uint8_t fieldCount;
+};
+
+// A decoded and validated command, passed to TopicHandler::handleCommand()
+struct Command
+{
+    uint8_t id;                          // index of the command in the schema
+    uint8_t present;                     // bit i is set when field i was in the message
+    int32_t values[COMMAND_MAX_FIELDS];  // field values in declaration order
+
+    bool has(uint8_t field) const { return present & (1u << field); }
+};
+
+enum class CommandError : uint8_t
+{
+    None,
+    MissingCommand, // no string 'command' field
+    UnknownCommand,
+    MissingField,
+    WrongType,
+};
+
+// Case-insensitive FNV-1a, usable at compile time
+constexpr uint32_t commandHash(const char *s, uint32_t seed)
+{
+    uint32_t h = 2166136261u ^ seed;
+    for (; *s; ++s)
+    {
+        char c = (*s >= 'A' && *s <= 'Z') ? (char)(*s - 'A' + 'a') : *s;
+        h = (h ^ (uint8_t)c) * 16777619u;
+    }
+    return h;
+}
+
+// Runtime view of a handler's command table
+struct CommandSchema
+{
+    const CommandSpec *commands;
+    uint8_t count;
+    uint32_t seed;
+    const uint8_t *slots; // command index + 1 per hash slot, 0 = empty
+    uint8_t mask;         // slot count - 1
+
+    /**
+     * Find a command by name
+     * @return Index of the command, or -1 if unknown
+     */
+    int find(const char *name) const;
+
+    /**
+     * Decode and validate a message against this schema
+     * @param doc The message
+     * @param cmd Receives the command id and field values
+     * @param detail Receives the offending command or field name on error
+     */
+    CommandError decode(JsonObjectConst doc, Command &cmd, const char *&detail) const;
+
+    static const char *errorString(CommandError error);
+};
+
+// Compile-time command table: picks a hash seed so every command name lands in
+// its own slot, giving one hash and one string compare per lookup
+template <size_t N>
+class CommandTable
+{
+public:
+    static constexpr size_t SLOTS = N * 2 <= 4 ? 4 : N * 2 <= 8 ? 8 : N * 2 <= 16 ? 16 : 32;
+    static_assert(N > 0 && N <= 16, "CommandTable supports 1 to 16 commands");
+
+    constexpr CommandTable(const CommandSpec (&specs)[N]) : commands(specs), seed(0), slots{}
+    {
+        for (uint32_t s = 0;; ++s)
+        {
+            bool collision = false;
+            for (size_t i = 0; i < SLOTS; ++i)
+            {
+                slots[i] = 0;
+            }
+            for (size_t i = 0; i < N && !collision; ++i)
+            {
+                uint8_t &slot = slots[commandHash(specs[i].name, s) & (SLOTS - 1)];
+                collision = slot != 0;
+                slot = i + 1;
+            }
+            if (!collision)
+            {
+                seed = s;
+                break;
+            }
+        }
+    }
+
+    constexpr CommandSchema schema() const
+    {
+        return CommandSchema{commands, (uint8_t)N, seed, slots, (uint8_t)(SLOTS - 1)};
+    }
+
+private:
+    const CommandSpec *commands;
+    uint32_t seed;
+    uint8_t slots[SLOTS];
+};
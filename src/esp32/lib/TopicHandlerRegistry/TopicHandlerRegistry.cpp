@@ -1,7 +1,9 @@
 #include "TopicHandlerRegistry.h"
-#include <cstring>
+#include <algorithm>
 
 std::vector<std::unique_ptr<TopicHandler>> TopicHandlerRegistry::handlers;
+TopicTrie TopicHandlerRegistry::topicIndex;
+std::vector<std::string> TopicHandlerRegistry::subscriptions;
 
 void TopicHandlerRegistry::registerHandler(std::unique_ptr<TopicHandler> handler)
 {
@@ -10,19 +12,46 @@ void TopicHandlerRegistry::registerHandler(std::unique_ptr<TopicHandler> handler
 
 TopicHandler *TopicHandlerRegistry::getHandlerForTopic(const char *topic)
 {
-    if (!topic)
+    TopicHandler *handler = nullptr;
+    return getHandlersForTopic(topic, &handler, 1) ? handler : nullptr;
+}
+
+size_t TopicHandlerRegistry::getHandlersForTopic(const char *topic, TopicHandler **out, size_t maxHandlers)
+{
+    if (!topic || !out)
     {
-        return nullptr;
+        return 0;
     }
+    return topicIndex.match(topic, out, maxHandlers);
+}
+
+const std::vector<std::string> &TopicHandlerRegistry::getSubscriptions()
+{
+    return subscriptions;
+}
+
+bool TopicHandlerRegistry::decode(TopicHandler *handler, JsonObjectConst doc, Command &cmd)
+{
+    return validate(handler, doc, cmd) && handler->prepareCommand(cmd, doc);
+}
 
-    for (auto &handler : handlers)
+bool TopicHandlerRegistry::validate(TopicHandler *handler, JsonObjectConst doc, Command &cmd)
+{
+    const CommandSchema *schema = handler->getCommandSchema();
+    if (!schema)
     {
-        if (strcmp(topic, handler->getTopic()) == 0)
-        {
-            return handler.get();
-        }
+        return false;
     }
-    return nullptr;
+
+    const char *detail = nullptr;
+    CommandError error = schema->decode(doc, cmd, detail);
+    if (error != CommandError::None)
+    {
+        LOG_ERROR("❌ %s: %s%s%s", handler->getTopic(), CommandSchema::errorString(error),
+                      detail ? " " : "", detail ? detail : "");
+        return false;
+    }
+    return true;
 }
 
 std::vector<TopicHandler *> TopicHandlerRegistry::getAllHandlers()
@@ -37,10 +66,52 @@ std::vector<TopicHandler *> TopicHandlerRegistry::getAllHandlers()
 
 void TopicHandlerRegistry::initAllHandlers()
 {
-    Serial.printf("📊 Number of registered handlers: %d\n", handlers.size());
+    LOG_INFO("📊 Number of registered handlers: %d", (int)handlers.size());
     for (auto &h : handlers)
     {
-        Serial.printf("  - Handler for topic: %s\n", h->getTopic());
+        LOG_INFO("  - Handler for topic: %s", h->getTopic());
         h->init();
     }
+
+    // Topics come from the loaded config, so the index is built after init
+    buildIndex();
+}
+
+void TopicHandlerRegistry::buildIndex()
+{
+    topicIndex.clear();
+    subscriptions.clear();
+
+    for (auto &h : handlers)
+    {
+        const char *topic = h->getTopic();
+        if (!topic || !*topic)
+        {
+            continue;
+        }
+        topicIndex.insert(topic, h.get());
+        if (std::find(subscriptions.begin(), subscriptions.end(), topic) == subscriptions.end())
+        {
+            subscriptions.push_back(topic);
+        }
+    }
+
+    // Drop filters covered by another one: overlapping subscriptions make the
+    // broker deliver the same message twice
+    for (size_t i = 0; i < subscriptions.size();)
+    {
+        bool covered = false;
+        for (size_t j = 0; j < subscriptions.size() && !covered; j++)
+        {
+            covered = j != i && TopicTrie::covers(subscriptions[j].c_str(), subscriptions[i].c_str());
+        }
+        if (covered)
+        {
+            subscriptions.erase(subscriptions.begin() + i);
+        }
+        else
+        {
+            i++;
+        }
+    }
 }
\ No newline at end of file
@@ -5,6 +5,13 @@
 #include <memory>
 #include <vector>
 #include "TopicHandler.h"
+#include "TopicTrie.h"
+#include "Logger.h"
+
+// Maximum number of handlers a single message can fan out to
+#ifndef TOPIC_MAX_HANDLERS_PER_MESSAGE
+#define TOPIC_MAX_HANDLERS_PER_MESSAGE 8
+#endif
 
 class TopicHandlerRegistry
 {
@@ -16,16 +23,38 @@ public:
     // If no handler is found for the topic, it returns nullptr
     static TopicHandler *getHandlerForTopic(const char *topic);
 
+    // Retrieves every handler whose topic filter (exact, '+' or '#') matches the topic
+    // Returns the number of handlers written to out
+    static size_t getHandlersForTopic(const char *topic, TopicHandler **out, size_t maxHandlers);
+
+    // Returns the topic filters to subscribe to, without filters already covered by a wildcard
+    static const std::vector<std::string> &getSubscriptions();
+
+    // Decodes a message through the handler's command schema and runs its prepareCommand() hook
+    // Validation errors are reported here rather than in each handler; returns false on error
+    static bool decode(TopicHandler *handler, JsonObjectConst doc, Command &cmd);
+
+    // decode() without the prepareCommand() hook, for callers that must check
+    // several commands before any of them has side effects
+    static bool validate(TopicHandler *handler, JsonObjectConst doc, Command &cmd);
+
     // Returns all the registered handlers
     static std::vector<TopicHandler *> getAllHandlers();
 
-    // Initializes all registered handlers
+    // Initializes all registered handlers and builds the topic index
     // Typically called during startup to set up the handlers
     static void initAllHandlers();
 
 private:
+    // Builds the topic trie and subscription list from the handlers' topics
+    static void buildIndex();
+
     // List of all registered topic handlers
     static std::vector<std::unique_ptr<TopicHandler>> handlers;
+
+    // Topic index, built once by initAllHandlers()
+    static TopicTrie topicIndex;
+    static std::vector<std::string> subscriptions;
 };
 
 // Automatically registers a handler class using this macro
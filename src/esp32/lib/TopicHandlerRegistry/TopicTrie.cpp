@@ -0,0 +1,222 @@
+#include "TopicTrie.h"
+#include <algorithm>
+#include <cstring>
+
+void TopicTrie::clear()
+{
+    nodes.clear();
+}
+
+void TopicTrie::insert(const char *filter, TopicHandler *handler)
+{
+    if (!filter || !handler)
+    {
+        return;
+    }
+    if (nodes.empty())
+    {
+        nodes.emplace_back(); // root
+    }
+
+    uint16_t node = 0;
+    const char *level = filter;
+    while (true)
+    {
+        const char *end = strchr(level, '/');
+        size_t len = end ? (size_t)(end - level) : strlen(level);
+        node = _child(node, level, len);
+        if (!end)
+        {
+            break;
+        }
+        level = end + 1;
+    }
+
+    auto &handlers = nodes[node].handlers;
+    if (std::find(handlers.begin(), handlers.end(), handler) == handlers.end())
+    {
+        handlers.push_back(handler);
+    }
+}
+
+size_t TopicTrie::match(const char *topic, TopicHandler **out, size_t maxHandlers) const
+{
+    if (!topic || nodes.empty())
+    {
+        return 0;
+    }
+
+    size_t count = 0;
+    auto collect = [&](const Node &node)
+    {
+        for (TopicHandler *h : node.handlers)
+        {
+            if (count >= maxHandlers)
+            {
+                return;
+            }
+            bool seen = false;
+            for (size_t i = 0; i < count && !seen; i++)
+            {
+                seen = out[i] == h;
+            }
+            if (!seen)
+            {
+                out[count++] = h;
+            }
+        }
+    };
+
+    // Depth-first walk; each level pushes at most a literal and a '+' branch
+    struct Frame
+    {
+        uint16_t node;
+        const char *level; // start of the next level, nullptr once the topic is consumed
+    };
+    Frame stack[TOPIC_TRIE_MAX_DEPTH * 2 + 2];
+    size_t top = 0;
+    stack[top++] = {0, topic};
+
+    while (top > 0)
+    {
+        Frame f = stack[--top];
+        const Node &node = nodes[f.node];
+
+        if (!f.level)
+        {
+            collect(node);
+            // "a/#" also matches "a"
+            if (node.hashChild >= 0)
+            {
+                collect(nodes[node.hashChild]);
+            }
+            continue;
+        }
+
+        // Wildcards never match the first level of a $-prefixed topic ($SYS etc.)
+        bool wildcards = !(f.node == 0 && f.level[0] == '$');
+        if (wildcards && node.hashChild >= 0)
+        {
+            collect(nodes[node.hashChild]);
+        }
+
+        if (top + 2 > sizeof(stack) / sizeof(stack[0]))
+        {
+            continue; // deeper than TOPIC_TRIE_MAX_DEPTH
+        }
+
+        const char *end = strchr(f.level, '/');
+        size_t len = end ? (size_t)(end - f.level) : strlen(f.level);
+        const char *next = end ? end + 1 : nullptr;
+
+        int literal = _findChild(node, f.level, len);
+        if (literal >= 0)
+        {
+            stack[top++] = {(uint16_t)literal, next};
+        }
+        if (wildcards && node.plusChild >= 0)
+        {
+            stack[top++] = {(uint16_t)node.plusChild, next};
+        }
+    }
+    return count;
+}
+
+bool TopicTrie::covers(const char *outer, const char *inner)
+{
+    // A leading wildcard does not match $-prefixed topics, so "#" does not cover "$SYS/#"
+    bool outerWildcard = (outer[0] == '#' || outer[0] == '+') && (outer[1] == '\0' || outer[1] == '/');
+    if (outerWildcard && inner[0] == '$')
+    {
+        return false;
+    }
+
+    while (true)
+    {
+        const char *outerEnd = strchr(outer, '/');
+        const char *innerEnd = strchr(inner, '/');
+        size_t outerLen = outerEnd ? (size_t)(outerEnd - outer) : strlen(outer);
+        size_t innerLen = innerEnd ? (size_t)(innerEnd - inner) : strlen(inner);
+
+        if (outerLen == 1 && outer[0] == '#')
+        {
+            return true;
+        }
+        if (innerLen == 1 && inner[0] == '#')
+        {
+            return false; // only '#' covers '#'
+        }
+        bool plus = outerLen == 1 && outer[0] == '+';
+        if (!plus && (outerLen != innerLen || strncmp(outer, inner, outerLen) != 0))
+        {
+            return false;
+        }
+
+        if (!outerEnd || !innerEnd)
+        {
+            // "a/#" covers "a" as well
+            return !outerEnd == !innerEnd || (outerEnd && strcmp(outerEnd + 1, "#") == 0);
+        }
+        outer = outerEnd + 1;
+        inner = innerEnd + 1;
+    }
+}
+
+uint16_t TopicTrie::_child(uint16_t parent, const char *segment, size_t len)
+{
+    if (len == 1 && (segment[0] == '+' || segment[0] == '#'))
+    {
+        int16_t existing = segment[0] == '+' ? nodes[parent].plusChild : nodes[parent].hashChild;
+        if (existing >= 0)
+        {
+            return existing;
+        }
+        nodes.emplace_back();
+        nodes.back().segment.assign(segment, len);
+        int16_t created = nodes.size() - 1;
+        (segment[0] == '+' ? nodes[parent].plusChild : nodes[parent].hashChild) = created;
+        return created;
+    }
+
+    int existing = _findChild(nodes[parent], segment, len);
+    if (existing >= 0)
+    {
+        return existing;
+    }
+
+    nodes.emplace_back();
+    nodes.back().segment.assign(segment, len);
+    uint16_t created = nodes.size() - 1;
+
+    // Keep children sorted so lookups can binary search
+    auto &children = nodes[parent].children;
+    auto pos = std::lower_bound(children.begin(), children.end(), created,
+                                [this](uint16_t a, uint16_t b)
+                                { return nodes[a].segment < nodes[b].segment; });
+    children.insert(pos, created);
+    return created;
+}
+
+int TopicTrie::_findChild(const Node &node, const char *segment, size_t len) const
+{
+    size_t lo = 0;
+    size_t hi = node.children.size();
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+        int cmp = nodes[node.children[mid]].segment.compare(0, std::string::npos, segment, len);
+        if (cmp == 0)
+        {
+            return node.children[mid];
+        }
+        if (cmp < 0)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class TopicHandler;
+
+// Maximum number of topic levels followed during a lookup
+#ifndef TOPIC_TRIE_MAX_DEPTH
+#define TOPIC_TRIE_MAX_DEPTH 16
+#endif
+
+// Level-segmented index of MQTT topic filters (exact, '+' and '#')
+// Built once at startup; lookups walk one node per topic level and never allocate
+class TopicTrie
+{
+public:
+    // Removes every filter
+    void clear();
+
+    // Adds a topic filter for a handler; a filter may have several handlers
+    void insert(const char *filter, TopicHandler *handler);
+
+    /**
+     * Collect the handlers whose filter matches a concrete topic
+     * @param topic Topic of an incoming message (no wildcards)
+     * @param out Array receiving the matching handlers, each one at most once
+     * @param maxHandlers Size of out
+     * @return Number of handlers written to out
+     */
+    size_t match(const char *topic, TopicHandler **out, size_t maxHandlers) const;
+
+    /**
+     * Check whether every topic matched by inner is also matched by outer
+     * Used to avoid overlapping subscriptions, which make the broker deliver twice;
+     * like match(), a leading wildcard never covers a $-prefixed filter
+     */
+    static bool covers(const char *outer, const char *inner);
+
+private:
+    struct Node
+    {
+        std::string segment;
+        std::vector<uint16_t> children; // literal children, sorted by segment
+        int16_t plusChild = -1;         // '+' child
+        int16_t hashChild = -1;         // '#' child
+        std::vector<TopicHandler *> handlers;
+    };
+
+    uint16_t _child(uint16_t parent, const char *segment, size_t len);
+    int _findChild(const Node &node, const char *segment, size_t len) const;
+
+    std::vector<Node> nodes;
+};
@@ -1,41 +1,19 @@
 #include "WiFiManager.h"
 
-bool WiFiManager::connected = false;
-
-void WiFiManager::begin()
+bool WiFiManager::begin()
 {
     auto &cfg = ConfigLoader::getConfig();
 
-    if (cfg.wifi_ssid.isEmpty())
+    if (cfg.wifi_ssid[0] == '\0')
     {
-        Serial.println("❌ WiFi SSID is empty!");
-        return;
+        LOG_ERROR("❌ WiFi SSID is empty!");
+        return false;
     }
 
-    WiFi.begin(cfg.wifi_ssid.c_str(), cfg.wifi_password.c_str());
-    Serial.print("Connecting to WiFi");
-
-    int attempts = 0;
-    const int maxAttempts = 30; // timeout
-
-    while (WiFi.status() != WL_CONNECTED && attempts < maxAttempts)
-    {
-        delay(500);
-        Serial.print(".");
-        attempts++;
-    }
-
-    if (WiFi.status() == WL_CONNECTED)
-    {
-        connected = true;
-        Serial.println("\n✅ WiFi connected!");
-        Serial.printf("IP address: %s\n", WiFi.localIP().toString().c_str());
-    }
-    else
-    {
-        Serial.println("\n❌ WiFi connection failed!");
-        connected = false;
-    }
+    WiFi.mode(WIFI_STA);
+    WiFi.begin(cfg.wifi_ssid, cfg.wifi_password);
+    LOG_INFO("Connecting to WiFi %s...", cfg.wifi_ssid);
+    return true;
 }
 
 bool WiFiManager::isConnected()
@@ -43,14 +21,9 @@ bool WiFiManager::isConnected()
     return WiFi.status() == WL_CONNECTED;
 }
 
-void WiFiManager::reconnectIfNeeded()
+bool WiFiManager::reconnect()
 {
-    if (WiFi.status() != WL_CONNECTED)
-    {
-        Serial.println("🔄 WiFi disconnected, attempting to reconnect...");
-        connected = false;
-        WiFi.disconnect();
-        delay(1000);
-        begin();
-    }
-}
\ No newline at end of file
+    LOG_WARN("🔄 WiFi disconnected, attempting to reconnect...");
+    WiFi.disconnect();
+    return begin();
+}
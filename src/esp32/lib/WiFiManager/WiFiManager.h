@@ -2,13 +2,14 @@
 
 #include <WiFi.h>
 #include "ConfigLoader.h"
+#include "Logger.h"
 
 class WiFiManager {
 public:
-    static void begin();
+    // Starts connecting to the configured network; does not wait for the result
+    static bool begin();
     static bool isConnected();
-    static void reconnectIfNeeded();
 
-private:
-    static bool connected;
-};
\ No newline at end of file
+    // Drops the current association and starts connecting again; does not wait
+    static bool reconnect();
+};
@@ -0,0 +1,50 @@
+#include "AudioStreamController.h"
+
+// Audio stream topic
+const char *AudioStreamController::getTopic() const
+{
+    return ConfigLoader::getConfig().audio_topic;
+}
+
+void AudioStreamController::handleBinary(const uint8_t *payload, size_t length)
+{
+    // Chunks start with the "AU" magic, so a '{' can only be a control message
+    if (length > 0 && payload[0] == '{')
+    {
+        _handleControl(payload, length);
+    }
+    else
+    {
+        AudioPlayer::feed(payload, length);
+    }
+}
+
+void AudioStreamController::_handleControl(const uint8_t *payload, size_t length)
+{
+    StaticJsonDocument<AUDIO_CONTROL_CAPACITY> doc;
+    if (deserializeJson(doc, payload, length))
+    {
+        LOG_ERROR("❌ Audio: invalid control message");
+        return;
+    }
+
+    const char *command = doc["command"] | "";
+    if (strcmp(command, "start") == 0)
+    {
+        AudioPlayer::start(doc["rate"] | 8000u, doc["prefill_ms"] | (uint32_t)AUDIO_DEFAULT_PREFILL_MS);
+    }
+    else if (strcmp(command, "end") == 0)
+    {
+        AudioPlayer::finish();
+    }
+    else if (strcmp(command, "stop") == 0)
+    {
+        AudioPlayer::stop();
+    }
+    else
+    {
+        LOG_ERROR("❌ Audio: unknown command '%s'", command);
+    }
+}
+
+AUTO_REGISTER_HANDLER(AudioStreamController);
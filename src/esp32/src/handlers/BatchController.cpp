@@ -0,0 +1,130 @@
+#include "BatchController.h"
+
+static_assert(BATCH_MAX_COMMANDS <= PIPELINE_SCHEDULE_DEPTH - PIPELINE_SCHEDULE_RESERVE,
+              "A full batch must fit in the schedule outside the reserve");
+
+// BatchController topic
+const char *BatchController::getTopic() const
+{
+    return ConfigLoader::getConfig().batch_control_topic;
+}
+
+// Top-level fields plus one small object per command
+size_t BatchController::getDocumentCapacity() const
+{
+    return JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(BATCH_MAX_COMMANDS) + BATCH_MAX_COMMANDS * JSON_OBJECT_SIZE(6);
+}
+
+CommandStatus BatchController::handleMessage(DynamicJsonDocument &doc)
+{
+    JsonObjectConst root = doc.as<JsonObjectConst>();
+    JsonArrayConst commands = root["commands"].as<JsonArrayConst>();
+    if (commands.isNull() || commands.size() == 0)
+    {
+        LOG_ERROR("❌ Batch: 'commands' must be a non-empty array");
+        return CommandStatus::Invalid;
+    }
+
+    // Start time, as a millis() deadline
+    uint32_t startMs = millis();
+    JsonVariantConst at = root["at"];
+    if (!at.isNull())
+    {
+        int64_t deltaMs;
+        if (!DeviceClock::msUntil(at.as<uint64_t>(), deltaMs))
+        {
+            LOG_ERROR("❌ Batch: 'at' needs the SNTP clock, which is not synced yet");
+            return CommandStatus::Failed;
+        }
+        if (deltaMs > (int64_t)BATCH_MAX_AHEAD_MS)
+        {
+            LOG_ERROR("❌ Batch: 'at' is too far in the future");
+            return CommandStatus::Invalid;
+        }
+        // A late batch still runs, immediately and together
+        startMs += deltaMs > 0 ? (uint32_t)deltaMs : 0;
+    }
+
+    PendingCommand batch[BATCH_MAX_COMMANDS];
+    JsonObjectConst items[BATCH_MAX_COMMANDS];
+    size_t count = 0;
+    uint32_t lastDueMs = startMs;
+
+    for (JsonObjectConst item : commands)
+    {
+        const char *topic = item["topic"];
+        int32_t delayMs = item["delay"] | 0;
+        if (!topic || delayMs < 0 || delayMs > (int32_t)BATCH_MAX_AHEAD_MS)
+        {
+            LOG_ERROR("❌ Batch: every command needs a 'topic' and a delay within range");
+            return CommandStatus::Invalid;
+        }
+
+        TopicHandler *handlers[TOPIC_MAX_HANDLERS_PER_MESSAGE];
+        size_t matched = TopicHandlerRegistry::getHandlersForTopic(topic, handlers, TOPIC_MAX_HANDLERS_PER_MESSAGE);
+        if (matched == 0)
+        {
+            LOG_ERROR("❌ Batch: no handler for %s", topic);
+            return CommandStatus::NoHandler;
+        }
+
+        for (size_t i = 0; i < matched; i++)
+        {
+            // Raw handlers (including this one) need the document at execution time
+            if (!handlers[i]->getCommandSchema())
+            {
+                LOG_ERROR("❌ Batch: %s cannot be batched", topic);
+                return CommandStatus::Invalid;
+            }
+            if (count == BATCH_MAX_COMMANDS)
+            {
+                LOG_ERROR("❌ Batch: more than %d commands", BATCH_MAX_COMMANDS);
+                return CommandStatus::Invalid;
+            }
+
+            PendingCommand &pending = batch[count];
+            if (!TopicHandlerRegistry::validate(handlers[i], item, pending.cmd))
+            {
+                return CommandStatus::Invalid;
+            }
+            items[count] = item;
+            pending.handler = handlers[i];
+            pending.dueMs = startMs + delayMs;
+            pending.more = false;
+            pending.coalesceKey = 0; // a batch runs exactly as scripted
+            if ((int32_t)(pending.dueMs - lastDueMs) > 0)
+            {
+                lastDueMs = pending.dueMs;
+            }
+            count++;
+        }
+    }
+
+    // Only a batch that decoded in full gets to stage data (e.g. compile a
+    // PLAY_SONG score over the buzzer's next score)
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!batch[i].handler->prepareCommand(batch[i].cmd, items[i]))
+        {
+            return CommandStatus::Invalid;
+        }
+    }
+
+    // The message is acked once every command has run, unless they run too far ahead
+    int32_t aheadMs = (int32_t)(lastDueMs - millis());
+    uint16_t ack = CommandAck::adopt(aheadMs > 0 ? aheadMs : 0);
+    for (size_t i = 0; i < count; i++)
+    {
+        batch[i].ack = ack;
+    }
+
+    if (!CommandPipeline::submitBatch(batch, count))
+    {
+        return CommandStatus::Dropped;
+    }
+    LOG_INFO("📦 Batch: %u commands queued", (unsigned)count);
+    return ack ? CommandStatus::Ok : CommandStatus::Queued;
+}
+
+// Automatically register the BatchController
+AUTO_REGISTER_HANDLER(BatchController);
\ No newline at end of file
@@ -3,47 +3,149 @@
 // BuzzerController topic
 const char *BuzzerController::getTopic() const
 {
-    return ConfigLoader::getConfig().buzzer_control_topic.c_str();
+    return ConfigLoader::getConfig().buzzer_control_topic;
+}
+
+// JSON scores are streamed past the document, so it only needs the top-level
+// fields (copied, hence the extra bytes) or a short MessagePack score
+size_t BuzzerController::getDocumentCapacity() const
+{
+    return JSON_OBJECT_SIZE(4) + 64 + JSON_ARRAY_SIZE(BUZZER_MSGPACK_NOTES) +
+           BUZZER_MSGPACK_NOTES * JSON_OBJECT_SIZE(6);
 }
 
 // buzzer initialization
 void BuzzerController::init()
 {
     pinMode(ConfigLoader::getConfig().buzzer_pin, OUTPUT);
+    _player.begin(ConfigLoader::getConfig().buzzer_pin);
+    AudioPlayer::begin(ConfigLoader::getConfig().buzzer_pin);
+}
+
+// Buzzer commands; the order of buzzerCommands matches BuzzerCommand
+enum BuzzerCommand : uint8_t
+{
+    BUZZER_ON,
+    BUZZER_OFF,
+    BUZZER_BEEP,
+    BUZZER_PLAY_SONG,
+};
+
+static constexpr FieldSpec beepFields[] = {
+    {"duration", FieldType::Int, 10, 10000, 100, false}, // 10ms - 10s
+};
+
+static constexpr FieldSpec songFields[] = {
+    {"tempo", FieldType::Int, 20, 400, 120, false},
+    {"score", FieldType::Array, 1, INT32_MAX, 0, true},
+};
+
+static constexpr CommandSpec buzzerCommands[] = {
+    {"ON", nullptr, 0},
+    {"OFF", nullptr, 0},
+    {"BEEP", beepFields, 1},
+    {"PLAY_SONG", songFields, 2},
+};
+
+static constexpr CommandTable<4> buzzerTable(buzzerCommands);
+static constexpr CommandSchema buzzerSchema = buzzerTable.schema();
+
+const CommandSchema *BuzzerController::getCommandSchema() const
+{
+    return &buzzerSchema;
 }
 
-// handleMessage
-void BuzzerController::handleMessage(DynamicJsonDocument &doc)
+// ON, OFF and PLAY_SONG each set what the buzzer does next, so a newer one
+// supersedes any still queued; BEEPs are events and all run
+uint32_t BuzzerController::getCoalesceKey(const Command &cmd) const
 {
-    if (!doc.containsKey("command") || !doc["command"].is<const char *>())
+    return cmd.id == BUZZER_BEEP ? 0 : 1;
+}
+
+// Notes of a streamed score go straight into the next score buffer
+bool BuzzerController::streamElement(size_t index, JsonVariantConst element, JsonObjectConst header)
+{
+    SongScore &score = _scores.writeBuffer();
+    if (index == 0)
     {
-        Serial.println("BuzzerController: missing 'command' field");
-        return;
+        // "tempo" usually comes before "score"; if not, prepareCommand() rescales
+        score.begin(constrain(header["tempo"] | 120, 20, 400));
+        _streamed = true;
     }
-    const char *command = doc["command"].as<const char *>();
-    if (!command)
+    if (!score.add(element) && index == SONG_MAX_NOTES)
     {
-        Serial.println("BuzzerController: 'command' is null");
-        return;
+        LOG_WARN("⚠️ SongScore: score truncated to %d notes", SONG_MAX_NOTES);
     }
+    return true;
+}
 
-    if (strcasecmp(command, "ON") == 0)
+// Compile PLAY_SONG scores while the message document is still valid
+bool BuzzerController::prepareCommand(Command &cmd, JsonObjectConst doc)
+{
+    if (cmd.id != BUZZER_PLAY_SONG)
     {
-        _turnOnBuzzer();
+        return true;
     }
-    else if (strcasecmp(command, "OFF") == 0)
+
+    // A streamed score leaves an empty array in the document
+    JsonArrayConst notes = doc["score"];
+    SongScore &score = _scores.writeBuffer();
+    if (_streamed && notes.size() == 0 ? !score.end(cmd.values[0]) : !score.compile(notes, cmd.values[0]))
     {
+        LOG_WARN("⚠️ BuzzerController: invalid PLAY_SONG score");
+        return false;
+    }
+    _scores.publish();
+    return true;
+}
+
+// handleCommand
+CommandStatus BuzzerController::handleCommand(const Command &cmd)
+{
+    // Every buzzer command ends an audio stream and takes the pin back for LEDC,
+    // without waiting for the player to close I2S
+    if (AudioPlayer::release())
+    {
+        _player.begin(ConfigLoader::getConfig().buzzer_pin);
+    }
+    // A new command replaces the current sound at once, however long it had left
+    CommandPipeline::stopTimer(_endTimer);
+
+    switch (cmd.id)
+    {
+    case BUZZER_ON:
+        _turnOnBuzzer();
+        break;
+    case BUZZER_OFF:
         _turnOffBuzzer();
+        break;
+    case BUZZER_BEEP:
+        _beep(cmd.values[0]);
+        break;
+    case BUZZER_PLAY_SONG:
+        _playSong();
+        break;
     }
-    else if (strcasecmp(command, "BEEP") == 0)
+    _mode = cmd.id;
+    DeviceState::notify();
+    return CommandStatus::Ok;
+}
+
+// The end timer announces the end of a beep or song, the player the end of a stream
+void BuzzerController::reportState(JsonObject state) const
+{
+    static const char *const modeNames[] = {"tone", "off", "beep", "song"};
+    if (AudioPlayer::isActive())
     {
-        int duration = doc["duration"].is<int>() ? doc["duration"].as<int>() : 100;
-        duration = constrain(duration, 10, 10000); // 10ms - 10s
-        _beep(duration);
+        state["state"] = "on";
+        state["mode"] = "stream";
+        return;
     }
-    else
+    bool playing = _player.isPlaying();
+    state["state"] = playing ? "on" : "off";
+    if (playing)
     {
-        Serial.printf("BuzzerController: unknown command '%s'\n", command);
+        state["mode"] = modeNames[_mode];
     }
 }
 
@@ -51,20 +153,47 @@ void BuzzerController::handleMessage(DynamicJsonDocument &doc)
 
 void BuzzerController::_turnOnBuzzer()
 {
-    Serial.println("Buzzer ON");
-    tone(ConfigLoader::getConfig().buzzer_pin, 1000); // Play a 1kHz tone
+    LOG_DEBUG("Buzzer ON");
+    _player.playTone(1000, 255); // Play a 1kHz tone
 }
 
 void BuzzerController::_turnOffBuzzer()
 {
-    Serial.println("Buzzer OFF");
-    noTone(ConfigLoader::getConfig().buzzer_pin);
+    LOG_DEBUG("Buzzer OFF");
+    _player.stop();
 }
 
 void BuzzerController::_beep(int duration)
 {
-    Serial.printf("Buzzer BEEP for %dms\n", duration);
-    tone(ConfigLoader::getConfig().buzzer_pin, 1000, duration); // Beep for specified duration
+    LOG_DEBUG("Buzzer BEEP for %dms", duration);
+    _player.playTone(1000, 255);
+    CommandPipeline::startTimer(_endTimer, duration);
+}
+
+void BuzzerController::_playSong()
+{
+    // Stop first: the player reads the buffer that update() may swap out
+    _player.stop();
+
+    // Plays the most recently compiled score, even if newer than this command
+    _scores.update();
+    const SongScore &score = _scores.readBuffer();
+    if (score.size() == 0)
+    {
+        return;
+    }
+
+    LOG_DEBUG("Buzzer PLAY_SONG: %d notes, %lums", score.size(), (unsigned long)score.lengthMs());
+    _player.play(score);
+    CommandPipeline::startTimer(_endTimer, score.lengthMs());
+}
+
+// Runs on the actuator task once a beep or song is over; the player would stop
+// a song by itself, but only the timer tells DeviceState without waiting for its poll
+void BuzzerController::_onSoundEnd(void *arg)
+{
+    static_cast<BuzzerController *>(arg)->_player.stop();
+    DeviceState::notify();
 }
 
 // Automatically register the BuzzerController
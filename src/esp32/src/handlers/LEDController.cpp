@@ -3,72 +3,168 @@
 // LED controller topic
 const char *LEDController::getTopic() const
 {
-    return ConfigLoader::getConfig().led_control_topic.c_str();
+    return ConfigLoader::getConfig().led_control_topic;
 }
 
 // LED initialization
 void LEDController::init()
 {
-    pinMode(ConfigLoader::getConfig().led_pin, OUTPUT);
-    digitalWrite(ConfigLoader::getConfig().led_pin, LOW);
+    const Config &config = ConfigLoader::getConfig();
+    for (uint8_t i = 0; i < config.led_count && i < LED_MAX_CHANNELS; i++)
+    {
+        _faders[i].begin(config.led_pins[i], LED_LEDC_FIRST_CHANNEL + i);
+    }
 }
 
-// handleMessage
-void LEDController::handleMessage(DynamicJsonDocument &doc)
+// LED commands; the order of ledCommands matches LedCommand
+enum LedCommand : uint8_t
 {
-    if (!doc.containsKey("command"))
-    {
-        Serial.println(F("LEDController: missing 'command'"));
-        return;
-    }
-    String command = doc["command"].as<String>();
-    command.toLowerCase();
+    LED_ON,
+    LED_OFF,
+    LED_SET_BRIGHTNESS,
+    LED_FADE,
+    LED_BREATHE,
+    LED_BLINK,
+};
 
-    if (command == "on")
-    {
-        _turnOnLED();
-    }
-    else if (command == "off")
+// Every command takes an optional "channel" as its last field; -1 = all LEDs
+#define LED_CHANNEL_FIELD {"channel", FieldType::Int, -1, LED_MAX_CHANNELS - 1, -1, false}
+
+static constexpr FieldSpec channelFields[] = {
+    LED_CHANNEL_FIELD,
+};
+
+static constexpr FieldSpec brightnessFields[] = {
+    {"brightness", FieldType::Int, 0, 255, 0, true},
+    LED_CHANNEL_FIELD,
+};
+
+static constexpr FieldSpec fadeFields[] = {
+    {"brightness", FieldType::Int, 0, 255, 0, true},
+    {"duration", FieldType::Int, 0, 60000, 500, false}, // ms
+    LED_CHANNEL_FIELD,
+};
+
+static constexpr FieldSpec breatheFields[] = {
+    {"min", FieldType::Int, 0, 255, 0, false},
+    {"max", FieldType::Int, 0, 255, 255, false},
+    {"period", FieldType::Int, 200, 60000, 2000, false}, // ms per full cycle
+    {"cycles", FieldType::Int, 0, 10000, 0, false},      // 0 = until replaced
+    LED_CHANNEL_FIELD,
+};
+
+static constexpr FieldSpec blinkFields[] = {
+    {"on_ms", FieldType::Int, 10, 60000, 500, false},
+    {"off_ms", FieldType::Int, 10, 60000, 500, false},
+    {"count", FieldType::Int, 0, 10000, 0, false}, // 0 = until replaced
+    {"brightness", FieldType::Int, 0, 255, 255, false},
+    LED_CHANNEL_FIELD,
+};
+
+static constexpr CommandSpec ledCommands[] = {
+    {"on", channelFields, 1},
+    {"off", channelFields, 1},
+    {"set_brightness", brightnessFields, 2},
+    {"fade", fadeFields, 3},
+    {"breathe", breatheFields, 5},
+    {"blink", blinkFields, 5},
+};
+
+static constexpr CommandTable<6> ledTable(ledCommands);
+static constexpr CommandSchema ledSchema = ledTable.schema();
+
+const CommandSchema *LEDController::getCommandSchema() const
+{
+    return &ledSchema;
+}
+
+// Every LED command replaces the effect on its channel(s), so only the latest
+// queued command per channel value matters
+uint32_t LEDController::getCoalesceKey(const Command &cmd) const
+{
+    int32_t channel = cmd.values[ledCommands[cmd.id].fieldCount - 1];
+    return channel + 2; // -1 (all) -> 1
+}
+
+// handleCommand
+CommandStatus LEDController::handleCommand(const Command &cmd)
+{
+    const int32_t *v = cmd.values;
+    bool started = false;
+    switch (cmd.id)
     {
-        _turnOffLED();
+    case LED_ON:
+        started = _start(v[0], LedEffect{LedEffectType::Solid, 255, 0, 0, 0, 0});
+        LOG_DEBUG("turn on LED");
+        break;
+    case LED_OFF:
+        started = _start(v[0], LedEffect{LedEffectType::Solid, 0, 0, 0, 0, 0});
+        LOG_DEBUG("turn off LED");
+        break;
+    case LED_SET_BRIGHTNESS:
+        started = _start(v[1], LedEffect{LedEffectType::Solid, (uint8_t)v[0], 0, 0, 0, 0});
+        LOG_DEBUG("set LED brightness to: %d", (int)v[0]);
+        break;
+    case LED_FADE:
+        started = _start(v[2], LedEffect{LedEffectType::Fade, (uint8_t)v[0], 0, (uint32_t)v[1], 0, 0});
+        LOG_DEBUG("fade LED to %d over %dms", (int)v[0], (int)v[1]);
+        break;
+    case LED_BREATHE:
+        started = _start(v[4], LedEffect{LedEffectType::Breathe, (uint8_t)v[1], (uint8_t)v[0], (uint32_t)v[2], 0, (uint16_t)v[3]});
+        LOG_DEBUG("breathe LED %d-%d, period %dms", (int)v[0], (int)v[1], (int)v[2]);
+        break;
+    case LED_BLINK:
+        started = _start(v[4], LedEffect{LedEffectType::Blink, (uint8_t)v[3], 0, (uint32_t)v[0], (uint32_t)v[1], (uint16_t)v[2]});
+        LOG_DEBUG("blink LED %d/%dms", (int)v[0], (int)v[1]);
+        break;
     }
-    else if (command == "set_brightness")
+    // A channel index with no LED behind it
+    return started ? CommandStatus::Ok : CommandStatus::Failed;
+}
+
+// Hand the effect to the fade engine; returns without waiting for it
+// Returns false if no attached LED matches the channel
+bool LEDController::_start(int channel, const LedEffect &effect)
+{
+    bool started = false;
+    for (int i = 0; i < LED_MAX_CHANNELS; i++)
     {
-        if (!doc.containsKey("brightness") || !doc["brightness"].is<int>())
+        if ((channel < 0 || channel == i) && _faders[i].isAttached())
         {
-            Serial.println(F("LEDController: invalid or missing 'brightness'"));
-            return;
+            _reported[i].store((uint32_t)effect.type << 8 | effect.level, std::memory_order_relaxed);
+            _faders[i].start(effect);
+            started = true;
         }
-        int brightness = doc["brightness"].as<int>();
-        brightness = constrain(brightness, 0, 255);
-        _setBrightness(brightness);
-    }
-    else
-    {
-        Serial.print(F("LEDController: unknown command: "));
-        Serial.println(command);
     }
+    DeviceState::notify();
+    return started;
 }
 
-// LED control methods
-void LEDController::_turnOnLED()
-{
-    digitalWrite(ConfigLoader::getConfig().led_pin, HIGH);
-    Serial.println("turn on LED");
-}
+static const char *const effectNames[] = {"solid", "fade", "breathe", "blink"};
 
-void LEDController::_turnOffLED()
+// Reports each LED's commanded effect; brightness is its target (the peak for
+// breathe and blink), so a running effect does not republish on every step
+void LEDController::reportState(JsonObject state) const
 {
-    digitalWrite(ConfigLoader::getConfig().led_pin, LOW);
-    Serial.println("turn off LED");
-}
+    JsonArray channels = state.createNestedArray("channels");
+    for (int i = 0; i < LED_MAX_CHANNELS; i++)
+    {
+        if (!_faders[i].isAttached())
+        {
+            continue;
+        }
+        uint32_t reported = _reported[i].load(std::memory_order_relaxed);
+        LedEffectType type = (LedEffectType)(reported >> 8);
+        uint8_t level = reported & 0xff;
+        bool repeating = type == LedEffectType::Breathe || type == LedEffectType::Blink;
+        bool on = repeating ? _faders[i].isRunning() : level > 0;
 
-void LEDController::_setBrightness(int brightness)
-{
-    analogWrite(ConfigLoader::getConfig().led_pin, brightness);
-    Serial.print(F("set LED brightness to: "));
-    Serial.println(brightness);
+        JsonObject channel = channels.createNestedObject();
+        channel["state"] = on ? "on" : "off";
+        channel["effect"] = effectNames[(uint8_t)type];
+        channel["brightness"] = level;
+    }
 }
 
 // automatically register the LEDController
-AUTO_REGISTER_HANDLER(LEDController);
\ No newline at end of file
+AUTO_REGISTER_HANDLER(LEDController);
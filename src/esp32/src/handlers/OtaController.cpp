@@ -0,0 +1,56 @@
+#include "OtaController.h"
+
+// OtaController topic, per device
+const char *OtaController::getTopic() const
+{
+    return MqttOta::getTopic();
+}
+
+void OtaController::handleBinary(const uint8_t *payload, size_t length)
+{
+    // Chunks start with the "OTAC" magic, so a '{' can only be a control message
+    if (length > 0 && payload[0] == '{')
+    {
+        _handleControl(payload, length);
+    }
+    else
+    {
+        MqttOta::chunk(payload, length);
+    }
+}
+
+void OtaController::_handleControl(const uint8_t *payload, size_t length)
+{
+    StaticJsonDocument<OTA_CONTROL_CAPACITY> doc;
+    if (deserializeJson(doc, payload, length))
+    {
+        LOG_ERROR("❌ OTA: invalid control message");
+        return;
+    }
+
+    const char *command = doc["command"] | "";
+    if (strcmp(command, "begin") == 0)
+    {
+        const char *compression = doc["compression"] | "none";
+        if (strcmp(compression, "none") != 0 && strcmp(compression, "zlib") != 0)
+        {
+            LOG_ERROR("❌ OTA: unknown compression '%s'", compression);
+            return;
+        }
+        MqttOta::begin(doc["size"] | 0u, doc["sha256"] | "", strcmp(compression, "zlib") == 0, doc["nonce"] | 0u);
+    }
+    else if (strcmp(command, "abort") == 0)
+    {
+        MqttOta::abort("aborted by sender");
+    }
+    else if (strcmp(command, "status") == 0)
+    {
+        MqttOta::requestStatus();
+    }
+    else
+    {
+        LOG_ERROR("❌ OTA: unknown command '%s'", command);
+    }
+}
+
+AUTO_REGISTER_HANDLER(OtaController);
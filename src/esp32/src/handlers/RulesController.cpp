@@ -0,0 +1,60 @@
+#include "RulesController.h"
+
+// RulesController topic
+const char *RulesController::getTopic() const
+{
+    return ConfigLoader::getConfig().rules_control_topic;
+}
+
+// One rule with the largest action list
+size_t RulesController::getDocumentCapacity() const
+{
+    return RULES_DOCUMENT_SIZE;
+}
+
+CommandStatus RulesController::handleMessage(DynamicJsonDocument &doc)
+{
+    JsonObjectConst root = doc.as<JsonObjectConst>();
+    const char *command = root["command"] | "";
+
+    // An invalid rule or a full table, or a rule name that does not exist
+    CommandStatus status;
+    if (strcasecmp(command, "add") == 0)
+    {
+        status = RulesEngine::add(root) ? CommandStatus::Ok : CommandStatus::Invalid;
+    }
+    else if (strcasecmp(command, "remove") == 0)
+    {
+        status = RulesEngine::remove(root["name"]) ? CommandStatus::Ok : CommandStatus::Failed;
+    }
+    else if (strcasecmp(command, "clear") == 0)
+    {
+        RulesEngine::clear();
+        status = CommandStatus::Ok;
+    }
+    else
+    {
+        LOG_ERROR("❌ Rules: unknown command '%s'", command);
+        return CommandStatus::Invalid;
+    }
+
+    if (status == CommandStatus::Ok)
+    {
+        DeviceState::notify();
+    }
+    return status;
+}
+
+// Runs on the network task, like every rule change
+void RulesController::reportState(JsonObject state) const
+{
+    const RuleSet &rules = RulesEngine::getRules();
+    JsonArray names = state.createNestedArray("names");
+    for (uint8_t i = 0; i < rules.count; i++)
+    {
+        names.add(rules.rules[i].name);
+    }
+}
+
+// Automatically register the RulesController
+AUTO_REGISTER_HANDLER(RulesController);
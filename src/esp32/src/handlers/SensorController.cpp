@@ -0,0 +1,133 @@
+#include "SensorController.h"
+
+// Sensor control topic
+const char *SensorController::getTopic() const
+{
+    return ConfigLoader::getConfig().sensor_control_topic;
+}
+
+// Sampling starts right away when pins are configured
+void SensorController::init()
+{
+    const Config &config = ConfigLoader::getConfig();
+    if (config.sensor_count == 0)
+    {
+        return;
+    }
+    _ready = AdcSampler::begin(config.sensor_pins, config.sensor_count, config.sensor_sample_hz,
+                               config.sensor_window_ms);
+    if (!_ready)
+    {
+        LOG_WARN("⚠️ No usable sensor pin, sampling disabled");
+    }
+}
+
+// Sensor commands; the order of sensorCommands matches SensorCommand
+enum SensorCommand : uint8_t
+{
+    SENSOR_START,
+    SENSOR_STOP,
+    SENSOR_SET_RATE,
+    SENSOR_SET_THRESHOLD,
+    SENSOR_CLEAR_THRESHOLD,
+};
+
+static constexpr FieldSpec rateFields[] = {
+    {"sample_hz", FieldType::Int, SENSOR_MIN_SAMPLE_HZ, SENSOR_MAX_SAMPLE_HZ, 1000, true}, // per channel
+    {"window_ms", FieldType::Int, SENSOR_MIN_WINDOW_MS, SENSOR_MAX_WINDOW_MS, 1000, false},
+};
+
+static constexpr FieldSpec thresholdFields[] = {
+    {"channel", FieldType::Int, 0, SENSOR_MAX_CHANNELS - 1, 0, true},
+    {"high", FieldType::Int, 0, 4095, 0, true},
+    {"low", FieldType::Int, -1, 4095, -1, false}, // -1 = same as high, no hysteresis
+};
+
+static constexpr FieldSpec channelFields[] = {
+    {"channel", FieldType::Int, 0, SENSOR_MAX_CHANNELS - 1, 0, true},
+};
+
+static constexpr CommandSpec sensorCommands[] = {
+    {"start", nullptr, 0},
+    {"stop", nullptr, 0},
+    {"set_rate", rateFields, 2},
+    {"set_threshold", thresholdFields, 3},
+    {"clear_threshold", channelFields, 1},
+};
+
+static constexpr CommandTable<5> sensorTable(sensorCommands);
+static constexpr CommandSchema sensorSchema = sensorTable.schema();
+
+const CommandSchema *SensorController::getCommandSchema() const
+{
+    return &sensorSchema;
+}
+
+// start/stop and set_rate each replace a queued one of their kind; thresholds
+// replace those queued for the same channel
+uint32_t SensorController::getCoalesceKey(const Command &cmd) const
+{
+    switch (cmd.id)
+    {
+    case SENSOR_START:
+    case SENSOR_STOP:
+        return 1;
+    case SENSOR_SET_RATE:
+        return 2;
+    default:
+        return 3 + cmd.values[0];
+    }
+}
+
+// handleCommand
+CommandStatus SensorController::handleCommand(const Command &cmd)
+{
+    if (!_ready)
+    {
+        LOG_WARN("⚠️ SensorController: no sensor pins configured");
+        return CommandStatus::Failed;
+    }
+
+    const int32_t *v = cmd.values;
+    if (cmd.id >= SENSOR_SET_THRESHOLD && v[0] >= AdcSampler::getChannelCount())
+    {
+        LOG_WARN("⚠️ SensorController: no sensor channel %d", (int)v[0]);
+        return CommandStatus::Invalid;
+    }
+
+    switch (cmd.id)
+    {
+    case SENSOR_START:
+        AdcSampler::start();
+        break;
+    case SENSOR_STOP:
+        AdcSampler::stop();
+        break;
+    case SENSOR_SET_RATE:
+        AdcSampler::setRate(v[0], v[1]);
+        break;
+    case SENSOR_SET_THRESHOLD:
+        AdcSampler::setThreshold(v[0], v[1], v[2] < 0 ? v[1] : v[2]);
+        break;
+    case SENSOR_CLEAR_THRESHOLD:
+        AdcSampler::clearThreshold(v[0]);
+        break;
+    }
+    DeviceState::notify();
+    return CommandStatus::Ok;
+}
+
+void SensorController::reportState(JsonObject state) const
+{
+    if (!_ready)
+    {
+        state["state"] = "unavailable";
+        return;
+    }
+    state["state"] = AdcSampler::isRunning() ? "on" : "off";
+    state["sample_hz"] = AdcSampler::getSampleHz();
+    state["window_ms"] = AdcSampler::getWindowMs();
+}
+
+// Automatically register the SensorController
+AUTO_REGISTER_HANDLER(SensorController);
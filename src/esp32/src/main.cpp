@@ -4,64 +4,105 @@
 #include "TopicHandlerRegistry.h"
 #include "MQTTClient.h"
 #include "OTAHandler.h"
-#include "WiFiManager.h"
+#include "MqttOta.h"
+#include "ConnectionManager.h"
+#include "CommandPipeline.h"
+#include "Telemetry.h"
+#include "DeviceState.h"
+#include "CommandAck.h"
+#include "Logger.h"
+#include "RulesEngine.h"
+#include "AdcSampler.h"
+#include "NetworkEvents.h"
+
+// One pass of network work; runs forever on the network task
+static void networkLoop()
+{
+    TELEMETRY_START(loopStart);
+
+    // Handle OTA update requests
+    OTAHandler::handle();
+
+    // Advance WiFi/TLS/MQTT connection management; never waits on a retry
+    ConnectionManager::loop();
+
+    // Keep MQTT client running; decoded commands go to the actuator task
+    if (ConnectionManager::isConnected())
+    {
+        MQTTClient::loop();
+
+        // Publish the telemetry report when due
+        Telemetry::loop();
+
+        // Publish the retained device state when it changed
+        DeviceState::loop();
+
+        // Publish acks for commands that finished
+        CommandAck::loop();
+
+        // Mirror warnings and errors to the log topic
+        Logger::loop();
+
+        // Report firmware update progress; reboots once an update is verified
+        MqttOta::loop();
+
+        // Publish finished sensor windows
+        AdcSampler::loop();
+    }
+    TELEMETRY_RECORD(Metric::Loop, loopStart);
+
+    // Sleep until the broker sends something, another task has work for us or
+    // NET_IDLE_WAIT_MS passes; buffered input is handled without sleeping
+    bool connected = ConnectionManager::isConnected();
+    NetworkEvents::watch(connected ? MQTTClient::getSocket() : -1);
+    NetworkEvents::wait(connected && MQTTClient::hasPendingInput() ? 0 : NET_IDLE_WAIT_MS);
+}
 
 void setup()
 {
     Serial.begin(115200);
 
+    // Log lines are written to Serial by a background task from here on
+    Logger::begin();
+
     // Initialize LittleFS
     if (!LittleFS.begin())
     {
-        Serial.println("⚠️ Failed to initialize LittleFS");
+        LOG_WARN("⚠️ Failed to initialize LittleFS");
     }
 
     // Wait until config.json is uploaded and loaded
     while (!ConfigLoader::loadConfig())
     {
-        Serial.println("⚠️ No valid config.json, please upload via LittleFS...");
+        LOG_WARN("⚠️ No valid config.json, please upload via LittleFS...");
         delay(3000);
     }
-    Serial.println("✅ Config loaded!");
+    LOG_INFO("✅ Config loaded!");
 
     // Initialize all topic handlers (LED, Buzzer, etc.)
     TopicHandlerRegistry::initAllHandlers();
 
-    // Connect to WiFi
-    WiFiManager::begin();
+    // Reinstall the local rules saved before the reboot
+    RulesEngine::begin();
 
     // Initialize MQTT client
     MQTTClient::init();
-    MQTTClient::connectToMQTT();
+
+    // Start connecting to WiFi and the broker; progress is made by the network loop
+    ConnectionManager::begin();
 
     // Initialize OTA update handling
     OTAHandler::init();
+
+    // Event-driven network loop: socket watcher and power management
+    NetworkEvents::begin();
+
+    // Network I/O on one core, command execution on the other
+    CommandPipeline::begin(networkLoop);
 }
 
 void loop()
 {
-    // Handle OTA update requests
-    OTAHandler::handle();
-
-    // Check WiFi connection first
-    if (WiFi.status() != WL_CONNECTED)
-    {
-        WiFiManager::reconnectIfNeeded();
-        delay(1000);
-        return;
-    }
-
-    // Ensure MQTT connection
-    if (!MQTTClient::getMQTTClient().connected())
-    {
-        MQTTClient::connectToMQTT();
-        delay(5000); // Wait before retry
-        return;
-    }
-
-    // Keep MQTT client running
-    MQTTClient::loop();
-
-    // Small delay to prevent watchdog reset
-    delay(10);
+    // All work happens on the pipeline tasks
+    vTaskDelete(NULL);
 }
@@ -0,0 +1,1802 @@
+// Replays a recorded command stream through the MQTT message path on the host
+// and reports parse+dispatch latency percentiles and heap use per message.
+//
+//   pio run -e native
+//   .pio/build/native/program [stream file] [iterations]
+//
+// Stream file: one message per line, "<topic> <payload>"; '#' starts a comment.
+// The stream is replayed again re-encoded as MessagePack, and both encodings
+// are compared on payload bytes, parse time alone and parse+dispatch time.
+//
+//   .pio/build/native/program --audio [trace file] [rate] [prefill ms]
+//
+// replays chunk arrival times through the audio path instead: each chunk is
+// encoded as 8-bit PCM, 16-bit PCM and IMA ADPCM, parsed and decoded as on
+// the device into the jitter buffer, and played by a simulated DMA clock.
+// Checks every played sample against what was sent and the underruns and
+// overruns against the trace's "# expect" line; reports buffer depth and gaps.
+// Also checks that the stream's JSON control messages fit their document.
+// Trace file: one chunk per line, "<arrival ms> <samples>".
+//
+//   .pio/build/native/program --timers [timers]
+//
+// drives the actuator's timer wheel from a virtual clock: schedules, moves
+// and cancels timers over ten simulated minutes, checks each one fired
+// exactly on time and reports the cost per operation.
+//
+//   .pio/build/native/program --mqtt5 [stream file]
+//
+// runs the stream through the MQTT 5 client against an in-memory broker
+// stand-in: commands arrive as QoS 1 publishes with topic aliases, paced by
+// the client's Receive Maximum, and telemetry goes back the other way. Reports
+// bytes per command against MQTT 3.1.1, the largest payload that fits and
+// what happens to one that does not.
+//
+//   .pio/build/native/program --json-stream [payloads]
+//
+// checks the streaming parser against the DOM on generated PLAY_SONG scores:
+// each one is fed byte by byte and in random chunks into a SongScore and must
+// compile to the same notes, truncated and corrupted copies must be rejected,
+// and a score larger than the packet buffer is delivered in chunks over MQTT 5.
+// Reports throughput and memory of both parsers.
+//
+//   .pio/build/native/program --topics [filters]
+//
+// indexes hundreds of topic filters (exact, '+' and '#', and $SYS ones) in a
+// TopicTrie and checks every lookup against a linear scan of the filters,
+// including that wildcards never match or cover $-prefixed topics. Reports
+// lookup time of the trie against the linear scan and the old strcmp loop.
+//
+//   .pio/build/native/program --events [messages]
+//
+// compares the network loop's event-driven wait with the delay(10) polling
+// loop it replaced: another thread writes timestamped messages into a socket
+// pair at random 2-40ms intervals, and each loop reads them as the device
+// reads the broker socket. Reports arrival-to-read latency and wakeups per
+// second, while messages arrive and while idle.
+//
+//   .pio/build/native/program --leds
+//
+// runs fade, blink, breathe and solid effects through the LedEffectGenerator
+// and checks every keyframe (gamma-corrected duty, fade and hold times), also
+// for an effect that replaces another one halfway.
+//
+//   .pio/build/native/program --songs
+//
+// compiles known PLAY_SONG scores (rounding-prone tempos, ties, rests, a note
+// longer than a note can hold, a tempo that arrives after the notes) and
+// checks every note's start and end time, then walks each score with the
+// SongCursor one millisecond at a time and checks when it sounds.
+//
+//   .pio/build/native/program --spsc [items]
+//
+// runs a producer and a consumer thread through a small SpscRing with each
+// overflow policy and checks that items arrive whole, in order, and that
+// every item sent was either received or counted as dropped.
+
+#include <Arduino.h>
+#include <LittleFS.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "ConfigLoader.h"
+#include "TopicHandlerRegistry.h"
+#include "MQTTClient.h"
+#include "AudioPlayer.h"
+#include "AudioStreamController.h"
+#include "TimerWheel.h"
+#include "Telemetry.h"
+#include "JsonStream.h"
+#include "SongSequencer.h"
+#include "SpscRing.h"
+#include "LedEffects.h"
+#include "NetworkEvents.h"
+#include "TopicTrie.h"
+
+struct RecordedMessage
+{
+    std::string topic;
+    std::string payload;
+};
+
+struct Samples
+{
+    std::vector<uint32_t> latencyNs;
+    uint64_t allocations = 0;
+    uint32_t maxAllocations = 0;
+    uint32_t maxHeapBytes = 0;
+};
+
+static bool loadStream(const char *path, std::vector<RecordedMessage> &out)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return false;
+    }
+
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        size_t space = line.find(' ');
+        if (space == std::string::npos)
+        {
+            continue;
+        }
+        out.push_back({line.substr(0, space), line.substr(space + 1)});
+    }
+    return !out.empty();
+}
+
+static uint32_t percentile(std::vector<uint32_t> &sorted, double p)
+{
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[i];
+}
+
+static void report(const char *name, Samples &s)
+{
+    std::sort(s.latencyNs.begin(), s.latencyNs.end());
+    size_t n = s.latencyNs.size();
+    printf("%-28s %8zu %8.2f %8.2f %8.2f %8.2f %10.2f %8u %10u\n", name, n,
+           percentile(s.latencyNs, 0.50) / 1000.0, percentile(s.latencyNs, 0.90) / 1000.0,
+           percentile(s.latencyNs, 0.99) / 1000.0, s.latencyNs.back() / 1000.0,
+           (double)s.allocations / n, s.maxAllocations, s.maxHeapBytes);
+}
+
+// The recorded messages re-encoded as MessagePack, as a client that sends it would
+static std::vector<RecordedMessage> toMsgPack(const std::vector<RecordedMessage> &stream)
+{
+    std::vector<RecordedMessage> out;
+    DynamicJsonDocument doc(MQTT_DOCUMENT_CAPACITY_MAX);
+    for (const RecordedMessage &msg : stream)
+    {
+        if (deserializeJson(doc, msg.payload))
+        {
+            out.push_back(msg); // left as it is, to be rejected the same way
+            continue;
+        }
+        std::vector<char> packed(measureMsgPack(doc) + 1);
+        size_t length = serializeMsgPack(doc, packed.data(), packed.size());
+        out.push_back({msg.topic, std::string(packed.data(), length)});
+    }
+    return out;
+}
+
+// Every message through the full MQTT message path
+static void replayStream(const std::vector<RecordedMessage> &stream, int iterations,
+                         std::map<std::string, Samples> &byTopic, Samples &total)
+{
+    std::vector<uint8_t> buffer(MQTT_PACKET_BUFFER_SIZE);
+    for (int it = 0; it < iterations; it++)
+    {
+        for (const RecordedMessage &msg : stream)
+        {
+            // PubSubClient hands the callback its own packet buffer, which the
+            // JSON parser may modify; refill it outside the timed section
+            size_t length = std::min(msg.payload.size(), buffer.size());
+            memcpy(buffer.data(), msg.payload.data(), length);
+            std::string topic = msg.topic;
+
+            auto start = std::chrono::steady_clock::now();
+            MQTTClient::mqttCallback(&topic[0], buffer.data(), length);
+            auto end = std::chrono::steady_clock::now();
+
+            const MQTTMessageStats &stats = MQTTClient::getMessageStats();
+            uint32_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+            for (Samples *s : {&byTopic[msg.topic], &total})
+            {
+                s->latencyNs.push_back(ns);
+                s->allocations += stats.lastAllocations;
+                s->maxAllocations = std::max(s->maxAllocations, stats.lastAllocations);
+                s->maxHeapBytes = std::max(s->maxHeapBytes, stats.lastHeapBytes);
+            }
+        }
+    }
+}
+
+// Every message through the parser alone, into a document as MQTTClient uses
+static std::vector<uint32_t> parseStream(const std::vector<RecordedMessage> &stream, int iterations, bool msgpack)
+{
+    std::vector<uint32_t> ns;
+    std::vector<uint8_t> buffer(MQTT_PACKET_BUFFER_SIZE);
+    DynamicJsonDocument doc(MQTT_DOCUMENT_CAPACITY_MAX);
+    for (int it = 0; it < iterations; it++)
+    {
+        for (const RecordedMessage &msg : stream)
+        {
+            size_t length = std::min(msg.payload.size(), buffer.size());
+            memcpy(buffer.data(), msg.payload.data(), length);
+
+            auto start = std::chrono::steady_clock::now();
+            if (msgpack)
+            {
+                deserializeMsgPack(doc, buffer.data(), length);
+            }
+            else
+            {
+                deserializeJson(doc, buffer.data(), length);
+            }
+            auto end = std::chrono::steady_clock::now();
+            ns.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+        }
+    }
+    std::sort(ns.begin(), ns.end());
+    return ns;
+}
+
+static void printEncoding(const char *name, const std::vector<RecordedMessage> &stream,
+                          std::vector<uint32_t> &parseNs, Samples &messages)
+{
+    size_t bytes = 0;
+    for (const RecordedMessage &msg : stream)
+    {
+        bytes += msg.payload.size();
+    }
+    std::sort(messages.latencyNs.begin(), messages.latencyNs.end());
+    printf("%-12s %10zu %12.2f %12.2f %12.2f %12.2f\n", name, bytes, percentile(parseNs, 0.5) / 1000.0,
+           percentile(parseNs, 0.99) / 1000.0, percentile(messages.latencyNs, 0.5) / 1000.0,
+           percentile(messages.latencyNs, 0.99) / 1000.0);
+}
+
+struct ChunkArrival
+{
+    uint32_t atMs;
+    uint32_t samples;
+};
+
+static const int16_t imaSteps[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,    19,    21,    23,    25,    28,
+    31,    34,    37,    41,    45,    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,   337,   371,   408,   449,   494,
+    544,   598,   658,   724,   796,   876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,  5894,  6484,  7132,  7845,  8630,
+    9493,  10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+static const int8_t imaIndex[8] = {-1, -1, -1, -1, 2, 4, 6, 8};
+
+// An audio chunk as the MCP server's play_audio sends it, plus the samples
+// the device must decode from it
+static std::vector<uint8_t> encodeChunk(AudioFormat format, uint16_t seq, const int16_t *signal, size_t count,
+                                        int32_t &predictor, int &index, std::vector<int16_t> &decoded)
+{
+    std::vector<uint8_t> chunk = {'A', 'U', (uint8_t)format, (uint8_t)index, (uint8_t)seq, (uint8_t)(seq >> 8),
+                                  (uint8_t)predictor, (uint8_t)(predictor >> 8)};
+    for (size_t i = 0; i < count; i++)
+    {
+        int16_t s = signal[i];
+        switch (format)
+        {
+        case AudioFormat::Pcm8:
+            chunk.push_back((uint8_t)((s >> 8) + 128));
+            decoded.push_back((int16_t)((s >> 8) * 256));
+            break;
+        case AudioFormat::Pcm16:
+            chunk.push_back((uint8_t)s);
+            chunk.push_back((uint8_t)(s >> 8));
+            decoded.push_back(s);
+            break;
+        default:
+        {
+            // Same encoder as the MCP server: it tracks the decoder, so the output is exact
+            int32_t step = imaSteps[index];
+            int32_t diff = s - predictor;
+            uint8_t nibble = diff < 0 ? 8 : 0;
+            diff = abs(diff);
+            int32_t delta = step >> 3;
+            if (diff >= step)
+            {
+                nibble |= 4;
+                diff -= step;
+                delta += step;
+            }
+            if (diff >= step >> 1)
+            {
+                nibble |= 2;
+                diff -= step >> 1;
+                delta += step >> 1;
+            }
+            if (diff >= step >> 2)
+            {
+                nibble |= 1;
+                delta += step >> 2;
+            }
+            predictor = std::max(-32768, std::min(32767, nibble & 8 ? predictor - delta : predictor + delta));
+            index = std::max(0, std::min(88, index + imaIndex[nibble & 7]));
+            if (i & 1)
+            {
+                chunk.back() |= nibble << 4;
+            }
+            else
+            {
+                chunk.push_back(nibble);
+            }
+            decoded.push_back((int16_t)predictor);
+            break;
+        }
+        }
+    }
+    return chunk;
+}
+
+struct AudioRun
+{
+    uint64_t firstSound = 0;
+    uint64_t played = 0;
+    uint64_t silent = 0;
+    size_t maxDepth = 0;
+    uint32_t underruns = 0;
+    uint32_t overruns = 0;
+    uint32_t wrong = 0; // samples played that differ from what was sent, or never played
+};
+
+// Replay the trace in one format: chunks go through audioParseChunk() and
+// AudioDecoder into the jitter buffer as in AudioPlayer::feed(), and a
+// simulated DMA clock reads one frame every AUDIO_FRAME_SAMPLES samples
+static AudioRun replayAudioFormat(const std::vector<ChunkArrival> &trace, uint32_t rate, uint32_t prefillMs,
+                                  AudioFormat format)
+{
+    std::unique_ptr<JitterBuffer<AUDIO_BUFFER_SAMPLES>> buffer(new JitterBuffer<AUDIO_BUFFER_SAMPLES>());
+    buffer->setPrefill((uint64_t)rate * prefillMs / 1000);
+    AudioDecoder decoder;
+    AudioRun run;
+
+    // A 440Hz tone under a slow sweep, loud enough to exercise the whole ADPCM step range
+    uint32_t total = 0;
+    for (const ChunkArrival &arrival : trace)
+    {
+        total += arrival.samples;
+    }
+    std::vector<int16_t> signal(total);
+    for (uint32_t i = 0; i < total; i++)
+    {
+        double t = (double)i / rate;
+        signal[i] = (int16_t)(12000 * sin(2 * M_PI * 440 * t) + 8000 * sin(2 * M_PI * (50 + 200 * t) * t));
+    }
+
+    std::deque<int16_t> expected; // samples of the accepted chunks, in play order
+    std::vector<int16_t> decoded;
+    int16_t block[128];
+    int16_t frame[AUDIO_FRAME_SAMPLES];
+    int32_t predictor = 0;
+    int index = 0;
+    uint32_t sent = 0;
+
+    uint64_t now = 0;
+    size_t next = 0;
+    while (next < trace.size() || buffer->size() > 0)
+    {
+        while (next < trace.size() && (uint64_t)trace[next].atMs * rate / 1000 <= now)
+        {
+            decoded.clear();
+            std::vector<uint8_t> payload = encodeChunk(format, next, &signal[sent], trace[next].samples, predictor,
+                                                       index, decoded);
+            sent += trace[next].samples;
+
+            AudioChunk chunk;
+            if (!audioParseChunk(payload.data(), payload.size(), chunk) || chunk.seq != (uint16_t)next ||
+                audioSampleCount(chunk) != decoded.size())
+            {
+                run.wrong += decoded.size();
+            }
+            else if (buffer->reserve(audioSampleCount(chunk)))
+            {
+                decoder.begin(chunk);
+                size_t n;
+                while ((n = decoder.decode(block, sizeof(block) / sizeof(block[0]))) > 0)
+                {
+                    buffer->write(block, n);
+                }
+                expected.insert(expected.end(), decoded.begin(), decoded.end());
+            }
+            if (++next == trace.size())
+            {
+                buffer->finish();
+            }
+        }
+        run.maxDepth = std::max(run.maxDepth, buffer->size());
+
+        size_t n = buffer->read(frame, AUDIO_FRAME_SAMPLES);
+        if (n > 0 && run.played == 0)
+        {
+            run.firstSound = now;
+        }
+        for (size_t i = 0; i < n; i++)
+        {
+            if (expected.empty() || frame[i] != expected.front())
+            {
+                run.wrong++;
+            }
+            if (!expected.empty())
+            {
+                expected.pop_front();
+            }
+        }
+        run.played += n;
+        run.silent += run.played > 0 ? AUDIO_FRAME_SAMPLES - n : 0;
+        now += AUDIO_FRAME_SAMPLES;
+    }
+    run.wrong += expected.size();
+    run.underruns = buffer->underruns();
+    run.overruns = buffer->overruns();
+    return run;
+}
+
+// Chunks the parser must turn away
+static int malformedChunks()
+{
+    const std::vector<std::vector<uint8_t>> bad = {
+        {'A', 'U', 0, 0, 0, 0, 0},                // short header
+        {'A', 'X', 0, 0, 0, 0, 0, 0, 1},          // magic
+        {'A', 'U', 3, 0, 0, 0, 0, 0, 1},          // format
+        {'A', 'U', 2, 89, 0, 0, 0, 0, 1},         // step index
+        {'A', 'U', 1, 0, 0, 0, 0, 0, 1, 2, 3},    // odd 16-bit PCM
+    };
+    int accepted = 0;
+    AudioChunk chunk;
+    for (const std::vector<uint8_t> &payload : bad)
+    {
+        accepted += audioParseChunk(payload.data(), payload.size(), chunk);
+    }
+    return accepted;
+}
+
+// Control messages as play_audio sends them (json.dumps spacing), parsed from
+// const bytes like the handler does, so every string is copied
+static int rejectedControls()
+{
+    const char *messages[] = {
+        "{\"command\": \"start\", \"rate\": 8000, \"prefill_ms\": 200}",
+        "{\"command\": \"start\", \"rate\": 4294967295, \"prefill_ms\": 4294967295}",
+        "{\"command\": \"end\"}",
+        "{\"command\": \"stop\"}",
+    };
+    int rejected = 0;
+    for (const char *message : messages)
+    {
+        StaticJsonDocument<AUDIO_CONTROL_CAPACITY> doc;
+        DeserializationError error = deserializeJson(doc, (const uint8_t *)message, strlen(message));
+        if (error || !doc["command"].is<const char *>())
+        {
+            printf("control message rejected (%s): %s\n", error.c_str(), message);
+            rejected++;
+        }
+    }
+    return rejected;
+}
+
+static int replayAudio(const char *path, uint32_t rate, uint32_t prefillMs)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        fprintf(stderr, "cannot open %s\n", path);
+        return 1;
+    }
+    std::vector<ChunkArrival> trace;
+    std::string line;
+    int expectUnderruns = -1;
+    int expectOverruns = -1;
+    while (std::getline(in, line))
+    {
+        ChunkArrival arrival;
+        if (sscanf(line.c_str(), "# expect %d underruns %d overruns", &expectUnderruns, &expectOverruns) == 2)
+        {
+            continue;
+        }
+        if (!line.empty() && line[0] != '#' && sscanf(line.c_str(), "%u %u", &arrival.atMs, &arrival.samples) == 2)
+        {
+            trace.push_back(arrival);
+        }
+    }
+    if (trace.empty())
+    {
+        return 1;
+    }
+    // The expectations hold for the trace's own settings
+    if (rate != 8000 || prefillMs != AUDIO_DEFAULT_PREFILL_MS)
+    {
+        expectUnderruns = expectOverruns = -1;
+    }
+
+    printf("%zu chunks at %uHz, %ums prefill, %d-sample buffer\n\n", trace.size(), rate, prefillMs,
+           AUDIO_BUFFER_SAMPLES);
+    printf("%-8s %10s %10s %10s %10s %9s %9s %8s\n", "format", "first ms", "played ms", "gaps ms", "depth ms",
+           "underruns", "overruns", "wrong");
+
+    static const char *names[] = {"pcm8", "pcm16", "adpcm"};
+    bool ok = true;
+    for (uint8_t f = 0; f < (uint8_t)AudioFormat::Count; f++)
+    {
+        AudioRun run = replayAudioFormat(trace, rate, prefillMs, (AudioFormat)f);
+        printf("%-8s %10.1f %10.1f %10.1f %10.1f %9u %9u %8u\n", names[f], run.firstSound * 1000.0 / rate,
+               run.played * 1000.0 / rate, run.silent * 1000.0 / rate, run.maxDepth * 1000.0 / rate, run.underruns,
+               run.overruns, run.wrong);
+        ok &= run.wrong == 0;
+        ok &= expectUnderruns < 0 || run.underruns == (uint32_t)expectUnderruns;
+        ok &= expectOverruns < 0 || run.overruns == (uint32_t)expectOverruns;
+    }
+
+    int accepted = malformedChunks();
+    printf("\nmalformed chunks accepted: %d of 5\n", accepted);
+    int rejected = rejectedControls();
+    printf("control messages rejected: %d of 4\n", rejected);
+    if (expectUnderruns >= 0)
+    {
+        printf("expected: %d underruns, %d overruns\n", expectUnderruns, expectOverruns);
+    }
+    return ok && accepted == 0 && rejected == 0 ? 0 : 1;
+}
+
+struct BenchTimer
+{
+    WheelTimer timer{&BenchTimer::fire, this};
+    uint32_t dueMs = 0;
+    uint32_t firedMs = 0;
+    int fired = 0;
+
+    static uint32_t nowMs;
+    static void fire(void *arg)
+    {
+        BenchTimer *t = static_cast<BenchTimer *>(arg);
+        t->firedMs = nowMs;
+        t->fired++;
+    }
+};
+uint32_t BenchTimer::nowMs = 0;
+
+static int benchTimers(size_t count)
+{
+    typedef std::chrono::steady_clock Clock;
+    static TimerWheel wheel;
+    std::vector<BenchTimer> timers(count);
+    std::vector<bool> cancelled(count);
+    srand(1);
+
+    // Mostly short delays, like beeps and blinks, with a tail of long timeouts
+    BenchTimer::nowMs = 1000;
+    auto start = Clock::now();
+    for (BenchTimer &t : timers)
+    {
+        uint32_t delay = rand() % 4 ? rand() % 10000 : rand() % 600000;
+        t.dueMs = BenchTimer::nowMs + delay;
+        wheel.schedule(t.timer, BenchTimer::nowMs, delay);
+    }
+    double scheduleNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / count;
+
+    // Move a quarter and cancel a quarter, like commands replacing what runs
+    start = Clock::now();
+    for (size_t i = 0; i < count; i += 2)
+    {
+        if (i % 4 == 0)
+        {
+            wheel.cancel(timers[i].timer);
+            cancelled[i] = true;
+        }
+        else
+        {
+            uint32_t delay = rand() % 10000;
+            timers[i].dueMs = BenchTimer::nowMs + delay;
+            wheel.schedule(timers[i].timer, BenchTimer::nowMs, delay);
+        }
+    }
+    double changeNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ((count + 1) / 2);
+
+    // Sleep from one due time to the next, as the actuator task does
+    size_t wakeups = 0;
+    uint32_t waitMs;
+    start = Clock::now();
+    while (wheel.nextDue(BenchTimer::nowMs, waitMs))
+    {
+        BenchTimer::nowMs += waitMs;
+        wheel.advance(BenchTimer::nowMs);
+        wakeups++;
+    }
+    double advanceNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    size_t fired = 0;
+    size_t wrong = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const BenchTimer &t = timers[i];
+        fired += t.fired;
+        wrong += cancelled[i] ? t.fired != 0 : t.fired != 1 || t.firedMs != t.dueMs;
+    }
+
+    printf("%zu timers over %.0f simulated s\n\n", count, (BenchTimer::nowMs - 1000) / 1000.0);
+    printf("schedule      %8.1f ns\n", scheduleNs);
+    printf("move/cancel   %8.1f ns\n", changeNs);
+    printf("advance       %8.1f ns per timer fired (%zu wakeups)\n", fired ? advanceNs / fired : 0.0, wakeups);
+    printf("fired         %8zu\n", fired);
+    printf("wrong         %8zu\n", wrong);
+    return wrong ? 1 : 0;
+}
+
+// Wire size of the same PUBLISH under MQTT 3.1.1 (no property section, no aliases)
+static size_t mqtt3PublishSize(const std::string &topic, size_t payloadLength, uint8_t qos)
+{
+    size_t remaining = 2 + topic.size() + (qos ? 2 : 0) + payloadLength;
+    return 1 + mqtt5VarintSize(remaining) + remaining;
+}
+
+// In-memory broker for --mqtt5. It answers CONNECT and SUBSCRIBE, queues QoS 1
+// publishes for the client to read (aliasing topics as far as the client
+// allows) and records what the client sends back. Mqtt5Client writes one
+// packet per write(), so each call is parsed as a whole packet.
+class BrokerStub : public Client
+{
+public:
+    int connect(const char *host, uint16_t port) override
+    {
+        up = true;
+        return 1;
+    }
+    uint8_t connected() override { return up; }
+    void stop() override { up = false; }
+    int available() override { return toClient.size() - readPos; }
+    int read(uint8_t *buf, size_t size) override
+    {
+        size_t n = std::min(size, toClient.size() - readPos);
+        memcpy(buf, toClient.data() + readPos, n);
+        readPos += n;
+        if (readPos == toClient.size())
+        {
+            toClient.clear();
+            readPos = 0;
+        }
+        return n ? n : -1;
+    }
+
+    size_t write(const uint8_t *buf, size_t size) override
+    {
+        Mqtt5Reader packet(buf + 1, size - 1);
+        uint32_t length = packet.varint();
+        Mqtt5Reader body(packet.position(), length);
+        switch (buf[0] >> 4)
+        {
+        case MQTT5_CONNECT:
+            _connect(body);
+            break;
+        case MQTT5_SUBSCRIBE:
+        {
+            uint8_t suback[] = {MQTT5_SUBACK << 4, 4, buf[2], buf[3], 0, 1};
+            toClient.insert(toClient.end(), suback, suback + sizeof(suback));
+            break;
+        }
+        case MQTT5_PUBACK:
+            acked++;
+            inFlight--;
+            break;
+        case MQTT5_PUBLISH:
+        {
+            Mqtt5Publish msg;
+            if (mqtt5ParsePublish(buf[0] & 0x0f, body.position(), length, msg))
+            {
+                received++;
+                receivedBytes += size;
+                const char *value;
+                uint16_t valueLength;
+                userProperties += msg.userProperty("bench", value, valueLength);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        return size;
+    }
+
+    // Queue a QoS 1 PUBLISH to the client, by alias once its topic has one
+    size_t send(const std::string &topic, const std::string &payload)
+    {
+        auto known = aliases.find(topic);
+        uint16_t alias = known != aliases.end() ? known->second : 0;
+        const char *wireTopic = alias ? "" : topic.c_str();
+        if (!alias && aliases.size() < clientAliasMax)
+        {
+            alias = aliases.size() + 1;
+            aliases[topic] = alias;
+        }
+
+        std::vector<uint8_t> packet(mqtt5PublishSize(wireTopic, alias, 1, nullptr, 0, payload.size()));
+        size_t n = mqtt5EncodePublish(packet.data(), packet.size(), wireTopic, alias, 1, false, nextId++, nullptr, 0,
+                                      (const uint8_t *)payload.data(), payload.size());
+        toClient.insert(toClient.end(), packet.begin(), packet.begin() + n);
+        inFlight++;
+        maxInFlight = std::max(maxInFlight, inFlight);
+        return n;
+    }
+
+    // What the client announced in CONNECT
+    uint16_t receiveMaximum = 0;
+    uint16_t clientAliasMax = 0;
+    uint32_t clientMaxPacket = 0;
+
+    size_t inFlight = 0;
+    size_t maxInFlight = 0;
+    size_t acked = 0;
+    size_t received = 0;
+    size_t receivedBytes = 0;
+    size_t userProperties = 0;
+
+private:
+    void _connect(Mqtt5Reader &body)
+    {
+        uint16_t length;
+        body.string(length); // "MQTT"
+        body.u8();           // protocol level
+        body.u8();           // flags
+        body.u16();          // keep alive
+        Mqtt5Reader props = body.properties();
+        Mqtt5Property p;
+        while (props.property(p))
+        {
+            if (p.id == MQTT5_PROP_RECEIVE_MAXIMUM)
+                receiveMaximum = p.number;
+            else if (p.id == MQTT5_PROP_TOPIC_ALIAS_MAXIMUM)
+                clientAliasMax = p.number;
+            else if (p.id == MQTT5_PROP_MAXIMUM_PACKET_SIZE)
+                clientMaxPacket = p.number;
+        }
+
+        // Session not present, success, and the broker's own limits
+        uint8_t connack[] = {MQTT5_CONNACK << 4, 11, 0, 0, 8,
+                             MQTT5_PROP_TOPIC_ALIAS_MAXIMUM, 0, 16,
+                             MQTT5_PROP_MAXIMUM_PACKET_SIZE, 0, 1, 0, 0};
+        toClient.insert(toClient.end(), connack, connack + sizeof(connack));
+    }
+
+    bool up = false;
+    std::vector<uint8_t> toClient;
+    size_t readPos = 0;
+    std::map<std::string, uint16_t> aliases;
+    uint16_t nextId = 1;
+};
+
+static int benchMqtt5(const char *path)
+{
+    std::vector<RecordedMessage> stream;
+    if (!loadStream(path, stream))
+    {
+        return 1;
+    }
+    LittleFS.setRoot("data");
+    if (!ConfigLoader::loadConfig())
+    {
+        return 1;
+    }
+    TopicHandlerRegistry::initAllHandlers();
+    MQTTClient::init();
+
+    BrokerStub broker;
+    Mqtt5Client client(broker);
+    client.setBufferSize(MQTT_PACKET_BUFFER_SIZE);
+    client.setCallback(MQTTClient::mqttCallback);
+    if (!client.connect("bench", nullptr, nullptr) || !client.subscribe("esp32-mcp/control/#", 1))
+    {
+        printf("connect failed, state %d\n", client.state());
+        return 1;
+    }
+
+    Serial.mute(true);
+
+    // Commands: the broker keeps at most Receive Maximum of them unacknowledged
+    size_t v5Bytes = 0;
+    size_t v3Bytes = 0;
+    size_t next = 0;
+    while (broker.acked < stream.size() && client.connected())
+    {
+        while (next < stream.size() && broker.inFlight < broker.receiveMaximum)
+        {
+            v5Bytes += broker.send(stream[next].topic, stream[next].payload);
+            v3Bytes += mqtt3PublishSize(stream[next].topic, stream[next].payload.size(), 1);
+            next++;
+        }
+        client.loop();
+    }
+    // The PUBACKs sent so far are also traffic per command
+    size_t acksBytes = broker.acked * 4;
+
+    // Device to cloud: telemetry reports, by alias after the first; the last one carries a user property
+    const char *telemetryTopic = ConfigLoader::getConfig().telemetry_topic;
+    char report[TELEMETRY_PAYLOAD_SIZE];
+    size_t reportLength = Telemetry::serialize(report, sizeof(report));
+    const size_t reports = 100;
+    size_t v3Out = 0;
+    for (size_t i = 0; i < reports; i++)
+    {
+        client.publish(telemetryTopic, (const uint8_t *)report, reportLength);
+        v3Out += mqtt3PublishSize(telemetryTopic, reportLength, 0);
+    }
+    Mqtt5UserProperty property = {"bench", "1"};
+    client.publish(telemetryTopic, (const uint8_t *)report, reportLength, false, &property, 1);
+
+    // Largest command within the Maximum Packet Size the client announced, then one byte more
+    const std::string songTopic = stream.back().topic;
+    size_t maxPayload = broker.clientMaxPacket - mqtt5PublishSize("", 1, 1, nullptr, 0, 0);
+    while (mqtt5PublishSize("", 1, 1, nullptr, 0, maxPayload) > broker.clientMaxPacket)
+    {
+        maxPayload--;
+    }
+    std::string fits(maxPayload, ' ');
+    std::string tooBig(fits.size() + 1, ' ');
+    size_t ackedBefore = broker.acked;
+    broker.send(songTopic, fits);
+    broker.send(songTopic, tooBig);
+    while (broker.inFlight > 0 && client.connected())
+    {
+        client.loop();
+    }
+
+    Serial.mute(false);
+
+    const Mqtt5Stats &stats = client.getStats();
+    printf("client limits: receive maximum %u, topic aliases %u, maximum packet %u\n\n", broker.receiveMaximum,
+           broker.clientAliasMax, (unsigned)broker.clientMaxPacket);
+    printf("%zu commands, at most %zu in flight\n", stream.size(), broker.maxInFlight);
+    printf("bytes/command  MQTT 5 %6.1f  MQTT 3.1.1 %6.1f  (+%.0f PUBACK)\n", (double)v5Bytes / stream.size(),
+           (double)v3Bytes / stream.size(), (double)acksBytes / broker.acked);
+    printf("bytes/report   MQTT 5 %6.1f  MQTT 3.1.1 %6.1f  (%u of %zu by alias)\n",
+           (double)(broker.receivedBytes) / broker.received, (double)v3Out / reports, stats.aliasedOut,
+           broker.received);
+    printf("user properties received: %zu\n", broker.userProperties);
+    printf("max payload    %zu bytes (%u-byte buffer)\n", fits.size(), (unsigned)client.getBufferSize());
+    printf("oversize       %u dropped, %zu of 2 acknowledged, largest delivered %u bytes\n", stats.oversize,
+           broker.acked - ackedBefore, stats.largestPayload);
+
+    bool ok = client.connected() && broker.acked == stream.size() + 2 && stats.oversize == 1 &&
+              broker.maxInFlight <= broker.receiveMaximum && broker.userProperties == 1;
+    return ok ? 0 : 1;
+}
+
+// A PLAY_SONG command with a random score; the tempo may come after it
+static std::string songPayload(size_t notes, int tempo, bool tempoFirst)
+{
+    static const char *beats[] = {"0.25", "0.5", "1", "1.5", "2", "0"};
+    std::string s = "{\"command\":\"PLAY_SONG\",\"id\":\"bench-" + std::to_string(rand()) + "\",";
+    if (tempoFirst)
+    {
+        s += "\"tempo\":" + std::to_string(tempo) + ",";
+    }
+    s += "\"score\":[";
+    for (size_t i = 0; i < notes; i++)
+    {
+        char note[128];
+        int freq = rand() % 5 ? 110 + rand() % 1900 : 0;
+        int n = snprintf(note, sizeof(note), "%s{\"freq\":%d,\"beats\":%s", i ? "," : "", freq, beats[rand() % 6]);
+        if (rand() % 3 == 0)
+            n += snprintf(note + n, sizeof(note) - n, ",\"amp\":%d", rand() % 256);
+        if (rand() % 4 == 0)
+            n += snprintf(note + n, sizeof(note) - n, ",\"tie\":%s", rand() % 2 ? "true" : "false");
+        if (rand() % 6 == 0)
+            n += snprintf(note + n, sizeof(note) - n, ",\"freq_start\":%d,\"freq_end\":%d", freq, 110 + rand() % 1900);
+        snprintf(note + n, sizeof(note) - n, "}");
+        s += note;
+    }
+    s += "]";
+    if (!tempoFirst)
+    {
+        s += ",\"tempo\":" + std::to_string(tempo);
+    }
+    return s + "}";
+}
+
+static bool onScoreElement(void *context, size_t index, JsonVariantConst element, JsonObjectConst header)
+{
+    SongScore *score = static_cast<SongScore *>(context);
+    if (index == 0)
+    {
+        score->begin(header["tempo"] | 120);
+    }
+    score->add(element);
+    return true;
+}
+
+// Stream a payload in chunks of at most maxChunk bytes (1 = byte by byte, 0 = random)
+static bool streamScore(JsonStream &stream, JsonDocument &doc, const std::string &payload, size_t maxChunk,
+                        SongScore &score)
+{
+    score.begin(120);
+    stream.begin(doc, "score", onScoreElement, &score);
+    const uint8_t *data = (const uint8_t *)payload.data();
+    for (size_t offset = 0; offset < payload.size();)
+    {
+        size_t n = std::min(maxChunk ? maxChunk : 1 + rand() % 512, payload.size() - offset);
+        if (!stream.feed(data + offset, n))
+        {
+            return false;
+        }
+        offset += n;
+    }
+    return stream.end() && score.end(doc["tempo"] | 120);
+}
+
+// Largest difference in note start times; non-zero only where end() rescaled the score
+static int scoreDifference(const SongScore &a, const SongScore &b)
+{
+    if (a.size() != b.size())
+    {
+        return INT32_MAX;
+    }
+    int worst = abs((int)a.lengthMs() - (int)b.lengthMs());
+    uint32_t startA = 0;
+    uint32_t startB = 0;
+    for (uint16_t i = 0; i < a.size(); i++)
+    {
+        if (a[i].freqStart != b[i].freqStart || a[i].freqEnd != b[i].freqEnd || a[i].amp != b[i].amp ||
+            (a[i].soundMs == a[i].durationMs) != (b[i].soundMs == b[i].durationMs))
+        {
+            return INT32_MAX;
+        }
+        worst = std::max(worst, abs((int)startA - (int)startB));
+        startA += a[i].durationMs;
+        startB += b[i].durationMs;
+    }
+    return worst;
+}
+
+static int benchJsonStream(size_t count)
+{
+    typedef std::chrono::steady_clock Clock;
+    static JsonStream stream;
+    static SongScore domScore;
+    static SongScore streamedScore;
+    StaticJsonDocument<256> header;
+    DynamicJsonDocument dom(JSON_OBJECT_SIZE(4) + JSON_ARRAY_SIZE(SONG_MAX_NOTES) +
+                            SONG_MAX_NOTES * JSON_OBJECT_SIZE(6) + 64);
+    srand(1);
+    Serial.mute(true);
+
+    size_t mismatches = 0;
+    size_t accepted = 0;
+    size_t rescaled = 0;
+    int worstRescale = 0;
+    size_t payloadBytes = 0;
+    size_t maxPayload = 0;
+    size_t maxDomBytes = 0;
+    double domNs = 0;
+    double streamNs = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        int tempo = 20 + rand() % 381;
+        bool tempoFirst = rand() % 2;
+        std::string payload = songPayload(1 + rand() % SONG_MAX_NOTES, tempo, tempoFirst);
+        payloadBytes += payload.size();
+        maxPayload = std::max(maxPayload, payload.size());
+
+        // The firmware parses the packet buffer in place
+        std::vector<char> buffer(payload.begin(), payload.end());
+        auto start = Clock::now();
+        bool domOk = !deserializeJson(dom, buffer.data(), buffer.size()) &&
+                     domScore.compile(dom["score"].as<JsonArrayConst>(), dom["tempo"] | 120);
+        domNs += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+        maxDomBytes = std::max(maxDomBytes, dom.memoryUsage());
+
+        start = Clock::now();
+        bool ok = streamScore(stream, header, payload, payload.size(), streamedScore);
+        streamNs += std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+        // Rescaling rounds each end time twice: allow half a beat-millisecond at 120 bpm
+        int tolerance = tempoFirst ? 0 : (60 + tempo - 1) / tempo + 1;
+        for (size_t chunk : {payload.size(), (size_t)1, (size_t)0})
+        {
+            bool chunkOk = chunk == payload.size() ? ok : streamScore(stream, header, payload, chunk, streamedScore);
+            int diff = chunkOk ? scoreDifference(domScore, streamedScore) : 0;
+            if (chunkOk != domOk || diff > tolerance)
+            {
+                if (mismatches++ < 5)
+                {
+                    printf("mismatch on payload %zu (%zu-byte chunks): %s, %d ms off\n", i, chunk,
+                           JsonTokenizer::errorString(stream.error()), diff);
+                }
+                break;
+            }
+            worstRescale = std::max(worstRescale, diff);
+        }
+        accepted += ok;
+        rescaled += ok && !tempoFirst && tempo != 120;
+    }
+
+    // Cut short or corrupted payloads must never parse
+    size_t malformed = 0;
+    size_t wronglyAccepted = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        std::string payload = songPayload(1 + rand() % 16, 120, rand() % 2);
+        if (i % 2)
+        {
+            payload.resize(rand() % payload.size());
+        }
+        else
+        {
+            static const char garbage[] = "{}[],:\"x-.";
+            payload[rand() % payload.size()] = garbage[rand() % (sizeof(garbage) - 1)];
+            std::vector<char> buffer(payload.begin(), payload.end());
+            if (!deserializeJson(dom, buffer.data(), buffer.size()) && dom.is<JsonObject>())
+            {
+                continue; // still valid JSON, e.g. a digit swapped for another
+            }
+        }
+        malformed++;
+        if (streamScore(stream, header, payload, 0, streamedScore))
+        {
+            wronglyAccepted++;
+        }
+    }
+
+    // A score larger than the packet buffer, delivered in chunks over MQTT 5
+    LittleFS.setRoot("data");
+    if (!ConfigLoader::loadConfig())
+    {
+        return 1;
+    }
+    TopicHandlerRegistry::initAllHandlers();
+    MQTTClient::init();
+
+    BrokerStub broker;
+    Mqtt5Client client(broker);
+    client.setBufferSize(MQTT_PACKET_BUFFER_SIZE);
+    client.setCallback(MQTTClient::mqttCallback);
+    client.setStreamCallback(MQTTClient::mqttStreamCallback);
+    if (!client.connect("bench", nullptr, nullptr) || !client.subscribe("esp32-mcp/control/#", 1))
+    {
+        Serial.mute(false);
+        printf("connect failed, state %d\n", client.state());
+        return 1;
+    }
+    std::string big;
+    while (big.size() <= MQTT_PACKET_BUFFER_SIZE)
+    {
+        big = songPayload(SONG_MAX_NOTES, 100, false);
+    }
+    broker.send("esp32-mcp/control/buzzer", big);
+    while (broker.inFlight > 0 && client.connected())
+    {
+        client.loop();
+    }
+    const MQTTMessageStats &mqttStats = MQTTClient::getMessageStats();
+
+    Serial.mute(false);
+
+    printf("%zu scores, %.0f bytes on average, largest %zu\n\n", count, (double)payloadBytes / count, maxPayload);
+    printf("%-12s %10s %12s\n", "parser", "MB/s", "memory");
+    printf("%-12s %10.1f %12zu  (document, largest score)\n", "DOM", payloadBytes / domNs * 1000,
+           maxDomBytes);
+    printf("%-12s %10.1f %12zu  (parser and element, any score)\n", "JsonStream", payloadBytes / streamNs * 1000,
+           sizeof(JsonStream) + header.capacity());
+    printf("\naccepted     %8zu (%zu rescaled to a late tempo, off by at most %d ms)\n", accepted, rescaled,
+           worstRescale);
+    printf("mismatches   %8zu\n", mismatches);
+    printf("malformed    %8zu (%zu accepted)\n", malformed, wronglyAccepted);
+    printf("chunked      %8u of 1 (%zu bytes, %u-byte buffer), %zu acknowledged\n", mqttStats.chunkedMessages,
+           big.size(), (unsigned)client.getBufferSize(), broker.acked);
+
+    bool ok = mismatches == 0 && wronglyAccepted == 0 && mqttStats.chunkedMessages == 1 && broker.acked == 1;
+    return ok ? 0 : 1;
+}
+
+// Large enough that a copy racing a write would show up as mismatched words
+struct StressItem
+{
+    uint32_t seq;
+    uint32_t words[15];
+};
+
+static int stressRing(RingOverflow policy, uint32_t count)
+{
+    std::unique_ptr<SpscRing<StressItem, 8>> ring(new SpscRing<StressItem, 8>(policy));
+    std::atomic<bool> ready{false};
+    std::atomic<bool> done{false};
+    uint32_t received = 0;
+    uint32_t torn = 0;
+    uint32_t reordered = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    std::thread consumer([&]()
+                         {
+                             StressItem item;
+                             int64_t last = -1;
+                             ready.store(true);
+                             while (true)
+                             {
+                                 bool finished = done.load(std::memory_order_acquire);
+                                 if (!ring->pop(item))
+                                 {
+                                     if (finished)
+                                     {
+                                         break;
+                                     }
+                                     std::this_thread::yield();
+                                     continue;
+                                 }
+                                 received++;
+                                 reordered += (int64_t)item.seq <= last;
+                                 last = item.seq;
+                                 for (uint32_t i = 0; i < 15; i++)
+                                 {
+                                     torn += item.words[i] != item.seq * (i + 1) * 2654435761u;
+                                 }
+                             } });
+
+    while (!ready.load())
+    {
+        std::this_thread::yield();
+    }
+    // Random pauses let the ring run empty as well as overflow
+    StressItem item;
+    uint32_t random = 1;
+    for (uint32_t seq = 0; seq < count; seq++)
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        for (volatile uint32_t spin = random % 256; spin > 0; spin--)
+        {
+        }
+        if (random % 8 == 0)
+        {
+            std::this_thread::yield(); // on a single core the consumer only runs when we yield
+        }
+        item.seq = seq;
+        for (uint32_t i = 0; i < 15; i++)
+        {
+            item.words[i] = seq * (i + 1) * 2654435761u;
+        }
+        ring->push(item);
+    }
+    done.store(true, std::memory_order_release);
+    consumer.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    uint32_t lost = count - received - ring->dropped();
+    printf("%-12s %10u %10u %10u %8u %8u %8u %8.1f\n", policy == RingOverflow::DropNewest ? "drop newest" : "drop oldest",
+           count, received, ring->dropped(), lost, torn, reordered, count / seconds / 1e6);
+    return lost || torn || reordered ? 1 : 0;
+}
+
+static int benchSpsc(uint32_t count)
+{
+    printf("%-12s %10s %10s %10s %8s %8s %8s %8s\n", "policy", "sent", "received", "dropped", "lost", "torn",
+           "reorder", "M/s");
+    int wrong = stressRing(RingOverflow::DropNewest, count);
+    wrong |= stressRing(RingOverflow::DropOldest, count);
+    return wrong;
+}
+
+// MQTT filter matching one filter at a time, as a reference for the trie
+static bool filterMatches(const char *filter, const char *topic)
+{
+    if (topic[0] == '$' && (filter[0] == '+' || filter[0] == '#'))
+    {
+        return false;
+    }
+    while (true)
+    {
+        if (filter[0] == '#' && filter[1] == '\0')
+        {
+            return true;
+        }
+        const char *filterEnd = strchr(filter, '/');
+        const char *topicEnd = strchr(topic, '/');
+        size_t filterLen = filterEnd ? (size_t)(filterEnd - filter) : strlen(filter);
+        size_t topicLen = topicEnd ? (size_t)(topicEnd - topic) : strlen(topic);
+        if (!(filterLen == 1 && filter[0] == '+') && (filterLen != topicLen || strncmp(filter, topic, topicLen) != 0))
+        {
+            return false;
+        }
+        if (!topicEnd)
+        {
+            // "a/#" also matches "a"
+            return !filterEnd || strcmp(filterEnd + 1, "#") == 0;
+        }
+        if (!filterEnd)
+        {
+            return false;
+        }
+        filter = filterEnd + 1;
+        topic = topicEnd + 1;
+    }
+}
+
+static int benchTopics(size_t count)
+{
+    // Handlers are only compared, never called: any distinct addresses will do
+    std::vector<char> handlerIds(count);
+    auto handlerAt = [&](size_t i)
+    { return reinterpret_cast<TopicHandler *>(&handlerIds[i]); };
+
+    // Mostly exact device topics, with room- and device-level wildcards and $SYS
+    std::vector<std::string> filters;
+    static const char *kinds[] = {"led", "buzzer", "sensor", "config"};
+    for (size_t i = 0; filters.size() < count; i++)
+    {
+        char filter[64];
+        size_t room = i % 16;
+        size_t device = i / 4;
+        switch (i % 32)
+        {
+        case 7:
+            snprintf(filter, sizeof(filter), "home/room%zu/+/led", room);
+            break;
+        case 15:
+            snprintf(filter, sizeof(filter), "home/+/dev%zu/#", device);
+            break;
+        case 23:
+            snprintf(filter, sizeof(filter), "$SYS/broker/client%zu/#", device);
+            break;
+        case 31:
+            snprintf(filter, sizeof(filter), "+/room%zu/+/sensor", room);
+            break;
+        default:
+            snprintf(filter, sizeof(filter), "home/room%zu/dev%zu/%s", room, device, kinds[i % 4]);
+            break;
+        }
+        filters.push_back(filter);
+    }
+    filters.back() = "#"; // one catch-all, which $SYS topics must still escape
+
+    TopicTrie trie;
+    for (size_t i = 0; i < filters.size(); i++)
+    {
+        trie.insert(filters[i].c_str(), handlerAt(i));
+    }
+
+    // Topics that hit exact filters, wildcards only, $SYS, and nothing but "#"
+    std::vector<std::string> topics;
+    uint32_t random = 1;
+    for (size_t i = 0; i < 4096; i++)
+    {
+        random ^= random << 13;
+        random ^= random >> 17;
+        random ^= random << 5;
+        char topic[64];
+        size_t room = random % 16;
+        size_t device = (random >> 8) % (count / 4 + 1);
+        switch (i % 4)
+        {
+        case 0:
+        case 1:
+            snprintf(topic, sizeof(topic), "home/room%zu/dev%zu/%s", room, device, kinds[(random >> 4) % 4]);
+            break;
+        case 2:
+            snprintf(topic, sizeof(topic), "$SYS/broker/client%zu/%s", device, kinds[(random >> 4) % 4]);
+            break;
+        default:
+            snprintf(topic, sizeof(topic), "office/room%zu/dev%zu/sensor", room, device);
+            break;
+        }
+        topics.push_back(topic);
+    }
+
+    // Every lookup must find exactly the filters a linear scan finds
+    const size_t maxHandlers = 16;
+    TopicHandler *found[maxHandlers];
+    size_t wrong = 0;
+    size_t matched = 0;
+    for (const std::string &topic : topics)
+    {
+        std::vector<TopicHandler *> expected;
+        for (size_t i = 0; i < filters.size(); i++)
+        {
+            if (filterMatches(filters[i].c_str(), topic.c_str()))
+            {
+                expected.push_back(handlerAt(i));
+            }
+        }
+        size_t n = trie.match(topic.c_str(), found, maxHandlers);
+        std::vector<TopicHandler *> actual(found, found + n);
+        std::sort(expected.begin(), expected.end());
+        std::sort(actual.begin(), actual.end());
+        if (expected.size() <= maxHandlers && actual != expected)
+        {
+            if (wrong++ < 5)
+            {
+                printf("  %s: %zu handlers, expected %zu\n", topic.c_str(), actual.size(), expected.size());
+            }
+        }
+        matched += n;
+    }
+
+    // covers() follows the same $ rule as matching
+    static const struct
+    {
+        const char *outer;
+        const char *inner;
+        bool covers;
+    } coverCases[] = {
+        {"#", "home/led", true},         {"#", "$SYS/#", false},        {"+/led", "$SYS/led", false},
+        {"+/led", "home/led", true},      {"$SYS/#", "$SYS/broker", true}, {"home/#", "home", true},
+        {"home/+", "home/+/led", false}, {"$SYS/+", "$SYS/x", true},     {"+", "$SYS", false},
+    };
+    for (const auto &c : coverCases)
+    {
+        if (TopicTrie::covers(c.outer, c.inner) != c.covers)
+        {
+            printf("  covers(%s, %s) should be %s\n", c.outer, c.inner, c.covers ? "true" : "false");
+            wrong++;
+        }
+    }
+
+    using Clock = std::chrono::steady_clock;
+    const int rounds = 20;
+    volatile size_t sink = 0; // keeps the timed loops from being optimized away
+    auto start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (const std::string &topic : topics)
+        {
+            sink = sink + trie.match(topic.c_str(), found, maxHandlers);
+        }
+    }
+    double trieNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (const std::string &topic : topics)
+        {
+            for (const std::string &filter : filters)
+            {
+                sink = sink + filterMatches(filter.c_str(), topic.c_str());
+            }
+        }
+    }
+    double linearNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    // The registry before the trie: first handler whose topic equals the message's
+    start = Clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (const std::string &topic : topics)
+        {
+            for (const std::string &filter : filters)
+            {
+                if (strcmp(filter.c_str(), topic.c_str()) == 0)
+                {
+                    sink = sink + 1;
+                    break;
+                }
+            }
+        }
+    }
+    double strcmpNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+    double lookups = (double)rounds * topics.size();
+    printf("%zu filters, %zu topics, %.2f handlers per topic\n\n", filters.size(), topics.size(),
+           (double)matched / topics.size());
+    printf("trie            %8.1f ns per lookup\n", trieNs / lookups);
+    printf("linear match    %8.1f ns per lookup\n", linearNs / lookups);
+    printf("linear strcmp   %8.1f ns per lookup (exact filters only, first match)\n", strcmpNs / lookups);
+    printf("wrong           %8zu\n", wrong);
+    return wrong ? 1 : 0;
+}
+
+struct LoopRun
+{
+    std::vector<uint32_t> latencyUs;
+    uint32_t wakeups = 0;
+    double seconds = 0;
+    uint32_t idleWakeups = 0;
+};
+
+// One pass of the network loop: read everything the "broker" sent
+static void readMessages(int fd, std::vector<uint32_t> &latencyUs)
+{
+    uint32_t sentUs;
+    while (recv(fd, &sentUs, sizeof(sentUs), MSG_DONTWAIT) == sizeof(sentUs))
+    {
+        latencyUs.push_back(micros() - sentUs);
+    }
+}
+
+static LoopRun runNetworkLoop(bool events, size_t count)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+    {
+        return {};
+    }
+    LoopRun run;
+
+    // Idle first: nothing arrives for a second
+    uint32_t start = millis();
+    while (millis() - start < 1000)
+    {
+        if (events)
+        {
+            NetworkEvents::watch(fds[1]);
+            NetworkEvents::wait(NET_IDLE_WAIT_MS);
+        }
+        else
+        {
+            delay(10);
+        }
+        run.idleWakeups++;
+    }
+
+    std::thread broker([&]()
+                       {
+                           uint32_t random = 1;
+                           for (size_t i = 0; i < count; i++)
+                           {
+                               random ^= random << 13;
+                               random ^= random >> 17;
+                               random ^= random << 5;
+                               delay(2 + random % 39);
+                               uint32_t nowUs = micros();
+                               send(fds[0], &nowUs, sizeof(nowUs), 0);
+                           } });
+
+    start = millis();
+    while (run.latencyUs.size() < count)
+    {
+        readMessages(fds[1], run.latencyUs);
+        if (events)
+        {
+            NetworkEvents::watch(fds[1]);
+            NetworkEvents::wait(NET_IDLE_WAIT_MS);
+        }
+        else
+        {
+            delay(10);
+        }
+        run.wakeups++;
+    }
+    run.seconds = (millis() - start) / 1000.0;
+    broker.join();
+
+    NetworkEvents::watch(-1);
+    close(fds[0]);
+    close(fds[1]);
+    std::sort(run.latencyUs.begin(), run.latencyUs.end());
+    return run;
+}
+
+static int benchEvents(size_t count)
+{
+    NetworkEvents::begin();
+    LoopRun polling = runNetworkLoop(false, count);
+    LoopRun events = runNetworkLoop(true, count);
+    if (polling.latencyUs.empty() || events.latencyUs.empty())
+    {
+        fprintf(stderr, "no socket pair\n");
+        return 1;
+    }
+
+    printf("%zu messages, 2-40ms apart\n\n", count);
+    printf("%-14s %10s %10s %10s %10s %10s %10s\n", "loop", "p50 us", "p90 us", "p99 us", "max us", "wakeups/s",
+           "idle/s");
+    for (auto &entry : {std::make_pair("delay(10)", &polling), std::make_pair("events", &events)})
+    {
+        LoopRun &run = *entry.second;
+        printf("%-14s %10u %10u %10u %10u %10.1f %10u\n", entry.first, percentile(run.latencyUs, 0.5),
+               percentile(run.latencyUs, 0.9), percentile(run.latencyUs, 0.99), run.latencyUs.back(),
+               run.wakeups / run.seconds, run.idleWakeups);
+    }
+    return 0;
+}
+
+struct LedCase
+{
+    const char *name;
+    LedEffect effect;
+    float fromLevel;
+    std::vector<LedKeyframe> keyframes;
+};
+
+// Duties are round((level / 255)^2.2 * 8191); ramps are 8 segments or 200ms ones
+static const LedCase ledCases[] = {
+    {"fade up",
+     {LedEffectType::Fade, 255, 0, 1000, 0, 0},
+     0,
+     {{84, 125, 0}, {388, 125, 0}, {947, 125, 0}, {1783, 125, 0}, {2913, 125, 0}, {4350, 125, 0}, {6106, 125, 0},
+      {8191, 125, 0}}},
+    // 37.5ms segments: the times alternate instead of drifting
+    {"fade down",
+     {LedEffectType::Fade, 0, 0, 300, 0, 0},
+     255,
+     {{6106, 37, 0}, {4350, 38, 0}, {2913, 37, 0}, {1783, 38, 0}, {947, 37, 0}, {388, 38, 0}, {84, 37, 0}, {0, 38, 0}}},
+    {"blink",
+     {LedEffectType::Blink, 255, 0, 100, 50, 2},
+     0,
+     {{8191, 0, 100}, {0, 0, 50}, {8191, 0, 100}, {0, 0, 50}}},
+    {"breathe",
+     {LedEffectType::Breathe, 255, 0, 2000, 0, 1},
+     0,
+     {{84, 125, 0}, {388, 125, 0}, {947, 125, 0}, {1783, 125, 0}, {2913, 125, 0}, {4350, 125, 0}, {6106, 125, 0},
+      {8191, 125, 0}, {6106, 125, 0}, {4350, 125, 0}, {2913, 125, 0}, {1783, 125, 0}, {947, 125, 0}, {388, 125, 0},
+      {84, 125, 0}, {0, 125, 0}}},
+    // 2s ramps are split into ten 200ms segments
+    {"slow breathe",
+     {LedEffectType::Breathe, 200, 20, 4000, 0, 1},
+     20,
+     {{124, 200, 0}, {292, 200, 0}, {539, 200, 0}, {870, 200, 0}, {1288, 200, 0}, {1798, 200, 0}, {2402, 200, 0},
+      {3102, 200, 0}, {3900, 200, 0}, {4800, 200, 0}, {3900, 200, 0}, {3102, 200, 0}, {2402, 200, 0}, {1798, 200, 0},
+      {1288, 200, 0}, {870, 200, 0}, {539, 200, 0}, {292, 200, 0}, {124, 200, 0}, {30, 200, 0}}},
+    {"solid",
+     {LedEffectType::Solid, 100, 0, 0, 0, 0},
+     255,
+     {{1045, 0, 0}}},
+};
+
+static size_t checkKeyframes(const char *name, LedEffectGenerator &generator, const std::vector<LedKeyframe> &expected,
+                             bool toEnd)
+{
+    size_t wrong = 0;
+    LedKeyframe k;
+    for (size_t i = 0; i < expected.size(); i++)
+    {
+        const LedKeyframe &e = expected[i];
+        if (!generator.next(k))
+        {
+            printf("  %s: ended after %zu keyframes, expected %zu\n", name, i, expected.size());
+            return wrong + 1;
+        }
+        if (k.duty != e.duty || k.fadeMs != e.fadeMs || k.holdMs != e.holdMs)
+        {
+            printf("  %s keyframe %zu: {%u, %u, %u}, expected {%u, %u, %u}\n", name, i, k.duty, k.fadeMs, k.holdMs,
+                   e.duty, e.fadeMs, e.holdMs);
+            wrong++;
+        }
+    }
+    if (toEnd && generator.next(k))
+    {
+        printf("  %s: more than %zu keyframes\n", name, expected.size());
+        wrong++;
+    }
+    return wrong;
+}
+
+static int benchLeds()
+{
+    LedEffectGenerator generator;
+    size_t wrong = 0;
+    for (const LedCase &test : ledCases)
+    {
+        generator.reset(test.effect, test.fromLevel);
+        size_t errors = checkKeyframes(test.name, generator, test.keyframes, true);
+        printf("%-24s %3zu keyframes  %s\n", test.name, test.keyframes.size(), errors ? "WRONG" : "ok");
+        wrong += errors;
+    }
+
+    // An endless breathe replaced three segments in: the fade starts where the breathe got to
+    LedCase breathe = ledCases[3];
+    breathe.effect.cycles = 0;
+    breathe.keyframes.resize(3);
+    generator.reset(breathe.effect, 0);
+    size_t errors = checkKeyframes("breathe, then fade out", generator, breathe.keyframes, false);
+    generator.reset({LedEffectType::Fade, 0, 0, 400, 0, 0}, generator.level());
+    errors += checkKeyframes("breathe, then fade out", generator,
+                             {{706, 50, 0}, {503, 50, 0}, {337, 50, 0}, {206, 50, 0}, {109, 50, 0}, {45, 50, 0},
+                              {10, 50, 0}, {0, 50, 0}},
+                             true);
+    printf("%-24s %3u keyframes  %s\n", "breathe, then fade out", 11, errors ? "WRONG" : "ok");
+    wrong += errors;
+    return wrong ? 1 : 0;
+}
+
+struct SongCase
+{
+    const char *name;
+    const char *payload;
+    int endTempo; // 0: compiled whole, else streamed and finished at this tempo
+    std::vector<uint32_t> startMs;
+    std::vector<uint32_t> soundEndMs; // equal to the start for a rest
+    uint32_t totalMs;
+};
+
+static const SongCase songCases[] = {
+    {"quarters",
+     R"({"tempo":120,"score":[{"freq":440},{"freq":494},{"freq":523,"beats":2}]})",
+     0,
+     {0, 500, 1000},
+     {485, 985, 1985},
+     2000},
+    // 222.2ms triplets: start times stay on the beat instead of drifting 0.2ms a note
+    {"triplets",
+     R"({"tempo":90,"score":[{"freq":440,"beats":0.3333333},{"freq":494,"beats":0.3333333},{"freq":523,"beats":0.3333333},)"
+     R"({"freq":440,"beats":0.3333333},{"freq":494,"beats":0.3333333},{"freq":523,"beats":0.3333333}]})",
+     0,
+     {0, 222, 444, 667, 889, 1111},
+     {207, 429, 652, 874, 1096, 1318},
+     1333},
+    {"tie, rest, glissando",
+     R"({"tempo":120,"score":[{"freq":440,"tie":true},{"freq":0},{"freq_start":200,"freq_end":400,"beats":2}]})",
+     0,
+     {0, 500, 1000},
+     {500, 500, 1985},
+     2000},
+    // 100s does not fit in a note: it is cut to 65.535s and the next note follows it
+    {"long note",
+     R"({"tempo":60,"score":[{"freq":440,"beats":100},{"freq":494}]})",
+     0,
+     {0, 65535},
+     {65520, 66520},
+     66535},
+    {"tempo last",
+     R"({"tempo":120,"score":[{"freq":440},{"freq":494},{"freq":523,"beats":2}]})",
+     60,
+     {0, 1000, 2000},
+     {985, 1985, 3985},
+     4000},
+    {"long note, tempo last",
+     R"({"tempo":120,"score":[{"freq":440,"beats":200},{"freq":494}]})",
+     60,
+     {0, 65535},
+     {65520, 66520},
+     66535},
+};
+
+static int benchSongs()
+{
+    static SongScore score;
+    size_t wrong = 0;
+    for (const SongCase &test : songCases)
+    {
+        DynamicJsonDocument doc(2048);
+        deserializeJson(doc, test.payload);
+        bool compiled;
+        if (test.endTempo == 0)
+        {
+            compiled = score.compile(doc["score"], doc["tempo"]);
+        }
+        else
+        {
+            score.begin(doc["tempo"]);
+            for (JsonVariantConst item : doc["score"].as<JsonArrayConst>())
+            {
+                score.add(item);
+            }
+            compiled = score.end(test.endTempo);
+        }
+
+        // Note times as compiled
+        size_t errors = compiled && score.size() == test.startMs.size() ? 0 : 1;
+        uint32_t startMs = 0;
+        for (uint16_t i = 0; errors == 0 && i < score.size(); i++)
+        {
+            uint32_t soundEndMs = startMs + (score[i].freqStart ? score[i].soundMs : 0);
+            if (startMs != test.startMs[i] || soundEndMs != test.soundEndMs[i])
+            {
+                printf("  note %u: %lu-%lums, expected %lu-%lums\n", i, (unsigned long)startMs,
+                       (unsigned long)soundEndMs, (unsigned long)test.startMs[i], (unsigned long)test.soundEndMs[i]);
+                errors++;
+            }
+            startMs += score[i].durationMs;
+        }
+        errors += score.lengthMs() != test.totalMs;
+
+        // Note times as played: the cursor sounds exactly inside each note's sounding part
+        SongCursor cursor;
+        cursor.reset(&score);
+        uint16_t freq;
+        uint8_t amp;
+        size_t note = 0;
+        for (uint32_t t = 0; errors == 0 && t <= test.totalMs; t++)
+        {
+            while (note + 1 < test.startMs.size() && t >= test.startMs[note + 1])
+            {
+                note++;
+            }
+            bool running = cursor.step(t, freq, amp);
+            bool sounding = t < test.soundEndMs[note] && t >= test.startMs[note];
+            if (running != (t < test.totalMs) || (freq != 0) != (sounding && running))
+            {
+                printf("  at %lums: %s, %uHz\n", (unsigned long)t, running ? "playing" : "ended", freq);
+                errors++;
+            }
+        }
+
+        printf("%-24s %3u notes %8lums  %s\n", test.name, score.size(), (unsigned long)score.lengthMs(),
+               errors ? "WRONG" : "ok");
+        wrong += errors;
+    }
+    return wrong ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "--audio") == 0)
+    {
+        return replayAudio(argc > 2 ? argv[2] : "src/native/bench/audio_trace.txt", argc > 3 ? atoi(argv[3]) : 8000,
+                           argc > 4 ? atoi(argv[4]) : AUDIO_DEFAULT_PREFILL_MS);
+    }
+    if (argc > 1 && strcmp(argv[1], "--timers") == 0)
+    {
+        return benchTimers(argc > 2 ? atoi(argv[2]) : 10000);
+    }
+    if (argc > 1 && strcmp(argv[1], "--mqtt5") == 0)
+    {
+        return benchMqtt5(argc > 2 ? argv[2] : "src/native/bench/commands.txt");
+    }
+    if (argc > 1 && strcmp(argv[1], "--spsc") == 0)
+    {
+        return benchSpsc(argc > 2 ? atoi(argv[2]) : 1000000);
+    }
+    if (argc > 1 && strcmp(argv[1], "--topics") == 0)
+    {
+        return benchTopics(argc > 2 ? atoi(argv[2]) : 500);
+    }
+    if (argc > 1 && strcmp(argv[1], "--events") == 0)
+    {
+        return benchEvents(argc > 2 ? atoi(argv[2]) : 200);
+    }
+    if (argc > 1 && strcmp(argv[1], "--leds") == 0)
+    {
+        return benchLeds();
+    }
+    if (argc > 1 && strcmp(argv[1], "--songs") == 0)
+    {
+        return benchSongs();
+    }
+    if (argc > 1 && strcmp(argv[1], "--json-stream") == 0)
+    {
+        return benchJsonStream(argc > 2 ? atoi(argv[2]) : 1000);
+    }
+
+    const char *streamPath = argc > 1 ? argv[1] : "src/native/bench/commands.txt";
+    int iterations = argc > 2 ? atoi(argv[2]) : 2000;
+
+    std::vector<RecordedMessage> stream;
+    if (!loadStream(streamPath, stream))
+    {
+        return 1;
+    }
+    std::vector<RecordedMessage> msgpackStream = toMsgPack(stream);
+
+    // Same start-up path as the firmware, minus the network
+    LittleFS.setRoot("data");
+    if (!ConfigLoader::loadConfig())
+    {
+        return 1;
+    }
+    TopicHandlerRegistry::initAllHandlers();
+    MQTTClient::init();
+
+    Serial.mute(true);
+
+    std::map<std::string, Samples> byTopic;
+    std::map<std::string, Samples> msgpackByTopic;
+    Samples total;
+    Samples msgpackTotal;
+    replayStream(stream, iterations, byTopic, total);
+    replayStream(msgpackStream, iterations, msgpackByTopic, msgpackTotal);
+    std::vector<uint32_t> jsonParseNs = parseStream(stream, iterations, false);
+    std::vector<uint32_t> msgpackParseNs = parseStream(msgpackStream, iterations, true);
+
+    Serial.mute(false);
+
+    printf("%zu messages x %d iterations, heap counting %s\n\n", stream.size(), iterations,
+           HeapMonitor::isEnabled() ? "on" : "off");
+    printf("%-28s %8s %8s %8s %8s %8s %10s %8s %10s\n", "topic", "msgs", "p50 us", "p90 us", "p99 us",
+           "max us", "allocs/msg", "max allocs", "max bytes");
+    for (auto &entry : byTopic)
+    {
+        report(entry.first.c_str(), entry.second);
+    }
+    report("all", total);
+    report("all, MessagePack", msgpackTotal);
+
+    // The same messages in both encodings: parse alone, and parse plus dispatch
+    printf("\n%-12s %10s %12s %12s %12s %12s\n", "encoding", "bytes", "parse p50 us", "parse p99 us", "msg p50 us",
+           "msg p99 us");
+    printEncoding("JSON", stream, jsonParseNs, total);
+    printEncoding("MessagePack", msgpackStream, msgpackParseNs, msgpackTotal);
+
+    const MQTTMessageStats &stats = MQTTClient::getMessageStats();
+    printf("\ndecode errors: %u, MessagePack messages: %u\n", stats.decodeErrors, stats.msgpackMessages);
+    return 0;
+}
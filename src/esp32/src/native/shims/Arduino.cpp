@@ -0,0 +1,117 @@
+#include "Arduino.h"
+#include <stdarg.h>
+#include <chrono>
+#include <random>
+#include <thread>
+
+HardwareSerial Serial;
+EspClass ESP;
+
+int shimPinMode[64];
+int shimPinValue[64];
+uint32_t shimLedcDuty[16];
+uint32_t shimLedcFreq[16];
+
+static const auto startTime = std::chrono::steady_clock::now();
+static std::minstd_rand rng;
+
+size_t HardwareSerial::printf(const char *fmt, ...)
+{
+    if (muted)
+    {
+        return 0;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vprintf(fmt, args);
+    va_end(args);
+    return n < 0 ? 0 : n;
+}
+
+unsigned long millis()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+unsigned long micros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void delay(unsigned long ms)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    shimPinMode[pin & 63] = mode;
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+    shimPinValue[pin & 63] = val;
+}
+
+int digitalRead(uint8_t pin)
+{
+    return shimPinValue[pin & 63];
+}
+
+void analogWrite(uint8_t pin, int value)
+{
+    shimPinValue[pin & 63] = value;
+}
+
+uint16_t analogRead(uint8_t pin)
+{
+    return shimPinValue[pin & 63];
+}
+
+uint32_t ledcSetup(uint8_t chan, uint32_t freq, uint8_t bit_num)
+{
+    shimLedcFreq[chan & 15] = freq;
+    return freq;
+}
+
+void ledcAttachPin(uint8_t pin, uint8_t chan) {}
+
+void ledcDetachPin(uint8_t pin) {}
+
+void ledcWrite(uint8_t chan, uint32_t duty)
+{
+    shimLedcDuty[chan & 15] = duty;
+}
+
+uint32_t ledcWriteTone(uint8_t chan, uint32_t freq)
+{
+    shimLedcFreq[chan & 15] = freq;
+    shimLedcDuty[chan & 15] = freq ? 512 : 0;
+    return freq;
+}
+
+uint32_t ledcChangeFrequency(uint8_t chan, uint32_t freq, uint8_t bit_num)
+{
+    shimLedcFreq[chan & 15] = freq;
+    return freq;
+}
+
+long random(long howbig)
+{
+    return howbig > 0 ? (long)(rng() % howbig) : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+    return howsmall >= howbig ? howsmall : howsmall + random(howbig - howsmall);
+}
+
+void randomSeed(unsigned long seed)
+{
+    rng.seed(seed);
+}
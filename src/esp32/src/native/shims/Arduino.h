@@ -0,0 +1,172 @@
+#pragma once
+
+// Minimal Arduino core for the native (host) build
+// Only what the message path uses; hardware calls are recorded, not executed
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <math.h>
+#include <algorithm>
+#include <string>
+#include "freertos/FreeRTOS.h"
+
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+#define F(s) (s)
+
+#define LOW 0x0
+#define HIGH 0x1
+#define INPUT 0x01
+#define OUTPUT 0x03
+
+class String
+{
+public:
+    String() {}
+    String(const char *s) : str(s ? s : "") {}
+    String(const std::string &s) : str(s) {}
+    explicit String(char c) : str(1, c) {}
+    explicit String(int v) : str(std::to_string(v)) {}
+    explicit String(unsigned int v) : str(std::to_string(v)) {}
+    explicit String(long v) : str(std::to_string(v)) {}
+    explicit String(unsigned long v) : str(std::to_string(v)) {}
+
+    const char *c_str() const { return str.c_str(); }
+    unsigned int length() const { return str.size(); }
+    bool isEmpty() const { return str.empty(); }
+    void reserve(unsigned int size) { str.reserve(size); }
+    void toLowerCase()
+    {
+        for (auto &c : str)
+            c = tolower((unsigned char)c);
+    }
+
+    char operator[](unsigned int i) const { return str[i]; }
+    String &operator+=(const String &o)
+    {
+        str += o.str;
+        return *this;
+    }
+    String &operator+=(const char *o)
+    {
+        str += o ? o : "";
+        return *this;
+    }
+    String &operator+=(char c)
+    {
+        str += c;
+        return *this;
+    }
+    friend String operator+(const String &a, const String &b) { return String(a.str + b.str); }
+    friend String operator+(const String &a, const char *b) { return String(a.str + (b ? b : "")); }
+    friend String operator+(const char *a, const String &b) { return String((a ? a : "") + b.str); }
+    bool operator==(const String &o) const { return str == o.str; }
+    bool operator==(const char *o) const { return o && str == o; }
+    bool operator!=(const String &o) const { return str != o.str; }
+    bool operator!=(const char *o) const { return !(*this == o); }
+
+private:
+    std::string str;
+};
+
+// Serial writes to stdout; mute() silences it for benchmarks
+class HardwareSerial
+{
+public:
+    void begin(unsigned long) {}
+    void mute(bool on) { muted = on; }
+
+    size_t write(uint8_t c) { return muted ? 1 : fwrite(&c, 1, 1, stdout); }
+    size_t write(const uint8_t *buf, size_t len) { return muted ? len : fwrite(buf, 1, len, stdout); }
+    int availableForWrite() { return 128; }
+    void flush() { fflush(stdout); }
+
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+    size_t print(const char *s) { return muted ? 0 : fputs(s, stdout); }
+    size_t print(const String &s) { return print(s.c_str()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(int v) { return printf("%d", v); }
+    size_t print(unsigned int v) { return printf("%u", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(double v, int digits = 2) { return printf("%.*f", digits, v); }
+    template <typename T>
+    size_t println(const T &v)
+    {
+        return print(v) + println();
+    }
+    size_t println() { return print("\n"); }
+
+private:
+    bool muted = false;
+};
+
+extern HardwareSerial Serial;
+
+// newlib has strlcpy; older glibc does not
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t len = strlen(src);
+    if (size)
+    {
+        size_t n = len < size - 1 ? len : size - 1;
+        memcpy(dst, src, n);
+        dst[n] = '\0';
+    }
+    return len;
+}
+#endif
+
+// Time (monotonic, since program start)
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+// SNTP is not started on the host; the system clock is already set
+inline void configTime(long gmtOffset_sec, int daylightOffset_sec, const char *server1,
+                       const char *server2 = nullptr, const char *server3 = nullptr) {}
+
+// GPIO and LEDC calls are recorded in these arrays for inspection
+extern int shimPinMode[64];
+extern int shimPinValue[64];
+extern uint32_t shimLedcDuty[16];
+extern uint32_t shimLedcFreq[16];
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void analogWrite(uint8_t pin, int value);
+uint16_t analogRead(uint8_t pin);
+
+uint32_t ledcSetup(uint8_t chan, uint32_t freq, uint8_t bit_num);
+void ledcAttachPin(uint8_t pin, uint8_t chan);
+void ledcDetachPin(uint8_t pin);
+void ledcWrite(uint8_t chan, uint32_t duty);
+uint32_t ledcWriteTone(uint8_t chan, uint32_t freq);
+uint32_t ledcChangeFrequency(uint8_t chan, uint32_t freq, uint8_t bit_num);
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+class EspClass
+{
+public:
+    uint32_t getFreeHeap() { return 320 * 1024; }
+    uint32_t getMinFreeHeap() { return 300 * 1024; }
+    uint32_t getMaxAllocHeap() { return 110 * 1024; }
+    uint32_t getCpuFreqMHz() { return 240; }
+    void restart() { exit(0); }
+};
+
+extern EspClass ESP;
@@ -0,0 +1,85 @@
+#include "FS.h"
+#include "LittleFS.h"
+
+fs::FS LittleFS("data");
+
+size_t File::size()
+{
+    if (!fp)
+    {
+        return 0;
+    }
+    long pos = ftell(fp);
+    fseek(fp, 0, SEEK_END);
+    long end = ftell(fp);
+    fseek(fp, pos, SEEK_SET);
+    return end;
+}
+
+int File::available()
+{
+    if (!fp)
+    {
+        return 0;
+    }
+    return size() - ftell(fp);
+}
+
+int File::read()
+{
+    return fp ? fgetc(fp) : -1;
+}
+
+size_t File::readBytes(char *buffer, size_t length)
+{
+    return fp ? fread(buffer, 1, length, fp) : 0;
+}
+
+size_t File::write(const uint8_t *buffer, size_t length)
+{
+    return fp ? fwrite(buffer, 1, length, fp) : 0;
+}
+
+bool File::seek(uint32_t pos)
+{
+    return fp && fseek(fp, pos, SEEK_SET) == 0;
+}
+
+void File::close()
+{
+    if (fp)
+    {
+        fclose(fp);
+        fp = nullptr;
+    }
+}
+
+File fs::FS::open(const char *path, const char *mode)
+{
+    std::string m = mode;
+    if (m.find('b') == std::string::npos)
+    {
+        m += 'b';
+    }
+    return File(fopen(resolve(path).c_str(), m.c_str()));
+}
+
+bool fs::FS::exists(const char *path)
+{
+    FILE *f = fopen(resolve(path).c_str(), "rb");
+    if (f)
+    {
+        fclose(f);
+    }
+    return f != nullptr;
+}
+
+bool fs::FS::remove(const char *path)
+{
+    return ::remove(resolve(path).c_str()) == 0;
+}
+
+bool fs::FS::rename(const char *from, const char *to)
+{
+    return ::rename(resolve(from).c_str(), resolve(to).c_str()) == 0;
+}
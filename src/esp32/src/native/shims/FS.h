@@ -0,0 +1,50 @@
+#pragma once
+
+// File system for the native build, backed by a host directory
+
+#include "Arduino.h"
+
+class File
+{
+public:
+    File(FILE *f = nullptr) : fp(f) {}
+
+    explicit operator bool() const { return fp != nullptr; }
+    size_t size();
+    int available();
+    int read();
+    size_t readBytes(char *buffer, size_t length);
+    size_t read(uint8_t *buffer, size_t length) { return readBytes((char *)buffer, length); }
+    size_t write(const uint8_t *buffer, size_t length);
+    size_t write(uint8_t c) { return write(&c, 1); }
+    bool seek(uint32_t pos);
+    void close();
+
+private:
+    FILE *fp;
+};
+
+namespace fs
+{
+    class FS
+    {
+    public:
+        explicit FS(const char *root) : root(root) {}
+
+        // The root directory can be changed before use (defaults to "data")
+        void setRoot(const char *dir) { root = dir; }
+
+        bool begin(bool formatOnFail = false) { return true; }
+        void end() {}
+        File open(const char *path, const char *mode = "r");
+        bool exists(const char *path);
+        bool remove(const char *path);
+        bool rename(const char *from, const char *to);
+
+    private:
+        std::string resolve(const char *path) const { return root + path; }
+        std::string root;
+    };
+}
+
+using fs::FS;
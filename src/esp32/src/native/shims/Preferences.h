@@ -0,0 +1,68 @@
+#pragma once
+
+// NVS key/value storage for the native build, kept in memory for the process
+
+#include "Arduino.h"
+#include <map>
+#include <string>
+#include <vector>
+
+class Preferences
+{
+public:
+    bool begin(const char *name, bool readOnly = false)
+    {
+        ns = name;
+        return !readOnly || store().count(ns);
+    }
+    void end() {}
+
+    size_t getBytesLength(const char *key) { return find(key) ? find(key)->size() : 0; }
+
+    size_t getBytes(const char *key, void *buf, size_t maxLen)
+    {
+        std::vector<uint8_t> *value = find(key);
+        if (!value || value->size() > maxLen)
+        {
+            return 0;
+        }
+        memcpy(buf, value->data(), value->size());
+        return value->size();
+    }
+
+    size_t putBytes(const char *key, const void *value, size_t len)
+    {
+        const uint8_t *bytes = (const uint8_t *)value;
+        store()[ns][key].assign(bytes, bytes + len);
+        return len;
+    }
+
+    bool remove(const char *key) { return store()[ns].erase(key) > 0; }
+    bool clear()
+    {
+        store()[ns].clear();
+        return true;
+    }
+
+private:
+    typedef std::map<std::string, std::map<std::string, std::vector<uint8_t>>> Store;
+
+    static Store &store()
+    {
+        static Store s;
+        return s;
+    }
+
+    std::vector<uint8_t> *find(const char *key)
+    {
+        auto n = store().find(ns);
+        if (n == store().end())
+        {
+            return nullptr;
+        }
+        auto k = n->second.find(key);
+        return k == n->second.end() ? nullptr : &k->second;
+    }
+
+    std::string ns;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+// PubSubClient for the native build: no network; connect() succeeds,
+// subscriptions and publishes are recorded, and deliver() injects a message
+// into the callback as if it came from the broker
+
+#include <functional>
+#include <vector>
+#include "WiFi.h"
+
+#define MQTT_CALLBACK_SIGNATURE std::function<void(char *, uint8_t *, unsigned int)> callback
+
+struct ShimPublish
+{
+    std::string topic;
+    std::vector<uint8_t> payload;
+    bool retained;
+};
+
+class PubSubClient
+{
+public:
+    explicit PubSubClient(Client &client) : client(&client) {}
+
+    PubSubClient &setServer(const char *domain, uint16_t port) { return *this; }
+    PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE)
+    {
+        this->callback = callback;
+        return *this;
+    }
+    PubSubClient &setKeepAlive(uint16_t keepAlive) { return *this; }
+    PubSubClient &setSocketTimeout(uint16_t timeout) { return *this; }
+    bool setBufferSize(uint16_t size)
+    {
+        bufferSize = size;
+        return true;
+    }
+    uint16_t getBufferSize() { return bufferSize; }
+
+    bool connect(const char *id, const char *user, const char *pass)
+    {
+        up = true;
+        return true;
+    }
+    bool connect(const char *id, const char *user, const char *pass, const char *willTopic, uint8_t willQos,
+                 bool willRetain, const char *willMessage, bool cleanSession = true)
+    {
+        up = true;
+        return true;
+    }
+    void disconnect() { up = false; }
+    bool connected() { return up; }
+    int state() { return up ? 0 : -1; }
+    bool loop() { return up; }
+
+    bool subscribe(const char *topic, uint8_t qos = 0)
+    {
+        subscriptions.push_back(topic);
+        return true;
+    }
+    bool unsubscribe(const char *topic) { return true; }
+
+    bool publish(const char *topic, const char *payload, bool retained = false)
+    {
+        return publish(topic, (const uint8_t *)payload, strlen(payload), retained);
+    }
+    bool publish(const char *topic, const uint8_t *payload, unsigned int length, bool retained = false)
+    {
+        published.push_back({topic, std::vector<uint8_t>(payload, payload + length), retained});
+        return up;
+    }
+
+    // Deliver a message to the callback (payload is copied, as PubSubClient does into its buffer)
+    void deliver(const char *topic, const uint8_t *payload, unsigned int length)
+    {
+        if (length > bufferSize)
+        {
+            return; // dropped, like the real client
+        }
+        std::string t = topic;
+        std::vector<uint8_t> p(payload, payload + length);
+        callback(&t[0], p.data(), length);
+    }
+
+    std::vector<std::string> subscriptions;
+    std::vector<ShimPublish> published;
+
+private:
+    Client *client;
+    std::function<void(char *, uint8_t *, unsigned int)> callback;
+    uint16_t bufferSize = 256;
+    bool up = false;
+};
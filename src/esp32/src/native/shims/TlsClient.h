@@ -0,0 +1,34 @@
+#pragma once
+
+// TlsClient for the native build: a plain always-up client with the same API
+
+#include "WiFi.h"
+
+struct TlsStats
+{
+    uint32_t fullHandshakes;
+    uint32_t fullHandshakeMs;
+    uint32_t resumedHandshakes;
+    uint32_t resumedHandshakeMs;
+    uint32_t lastHandshakeMs;
+    uint32_t resumptionsRejected;
+};
+
+class TlsClient : public WiFiClient
+{
+public:
+    void setCACert(const char *pem) {}
+    void setHandshakeTimeout(unsigned long seconds) {}
+    int lastError(char *buf, const size_t size)
+    {
+        snprintf(buf, size, "none");
+        return 0;
+    }
+    bool hasBufferedInput() const { return false; }
+    static void forgetSession() {}
+    static const TlsStats &getStats()
+    {
+        static TlsStats stats = {};
+        return stats;
+    }
+};
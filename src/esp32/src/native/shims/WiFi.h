@@ -0,0 +1,57 @@
+#pragma once
+
+// WiFi for the native build: always associated
+
+#include "Arduino.h"
+#include "Client.h"
+
+typedef enum
+{
+    WL_IDLE_STATUS = 0,
+    WL_NO_SSID_AVAIL = 1,
+    WL_CONNECTED = 3,
+    WL_CONNECT_FAILED = 4,
+    WL_DISCONNECTED = 6,
+} wl_status_t;
+
+#define WIFI_STA 1
+
+class IPAddress
+{
+public:
+    String toString() const { return String("127.0.0.1"); }
+};
+
+class WiFiClass
+{
+public:
+    wl_status_t status() { return WL_CONNECTED; }
+    void mode(int) {}
+    void begin(const char *ssid, const char *password) {}
+    void disconnect(bool wifiOff = false) {}
+    void setSleep(bool) {}
+    IPAddress localIP() { return IPAddress(); }
+    String macAddress() { return String("00:00:00:00:00:00"); }
+    int RSSI() { return -50; }
+};
+
+extern WiFiClass WiFi;
+
+class WiFiClient : public Client
+{
+public:
+    int connect(const char *host, uint16_t port) override
+    {
+        up = true;
+        return 1;
+    }
+    uint8_t connected() override { return up; }
+    void stop() override { up = false; }
+    int available() override { return 0; }
+    int read(uint8_t *buf, size_t size) override { return -1; }
+    size_t write(const uint8_t *buf, size_t size) override { return up ? size : 0; }
+    int fd() const { return -1; }
+
+protected:
+    bool up = false;
+};
@@ -0,0 +1,87 @@
+#pragma once
+
+// I2S driver subset for the native build: output is accepted and discarded
+
+#include <stddef.h>
+#include <stdint.h>
+#include <freertos/FreeRTOS.h>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#endif
+#define ESP_FAIL -1
+
+#define I2S_PIN_NO_CHANGE (-1)
+
+typedef enum
+{
+    I2S_NUM_0,
+    I2S_NUM_1,
+} i2s_port_t;
+
+typedef enum
+{
+    I2S_MODE_MASTER = 1,
+    I2S_MODE_TX = 4,
+    I2S_MODE_PDM = 64,
+} i2s_mode_t;
+
+typedef enum
+{
+    I2S_BITS_PER_SAMPLE_16BIT = 16,
+} i2s_bits_per_sample_t;
+
+typedef enum
+{
+    I2S_CHANNEL_FMT_ONLY_LEFT = 4,
+} i2s_channel_fmt_t;
+
+typedef enum
+{
+    I2S_COMM_FORMAT_STAND_I2S = 1,
+} i2s_comm_format_t;
+
+typedef struct
+{
+    i2s_mode_t mode;
+    uint32_t sample_rate;
+    i2s_bits_per_sample_t bits_per_sample;
+    i2s_channel_fmt_t channel_format;
+    i2s_comm_format_t communication_format;
+    int intr_alloc_flags;
+    int dma_buf_count;
+    int dma_buf_len;
+    bool use_apll;
+    bool tx_desc_auto_clear;
+} i2s_config_t;
+
+typedef struct
+{
+    int mck_io_num;
+    int bck_io_num;
+    int ws_io_num;
+    int data_out_num;
+    int data_in_num;
+} i2s_pin_config_t;
+
+inline esp_err_t i2s_driver_install(i2s_port_t port, const i2s_config_t *config, int queue_size, void *queue)
+{
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_driver_uninstall(i2s_port_t port)
+{
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_set_pin(i2s_port_t port, const i2s_pin_config_t *pins)
+{
+    return ESP_OK;
+}
+
+inline esp_err_t i2s_write(i2s_port_t port, const void *src, size_t size, size_t *bytes_written, TickType_t ticks_to_wait)
+{
+    *bytes_written = size;
+    return ESP_OK;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+// LEDC driver subset for the native build: fades complete instantly and every
+// duty lands in shimLedcDuty, indexed like Arduino's ledc channels
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#ifndef ESP_OK
+#define ESP_OK 0
+#endif
+
+typedef enum
+{
+    LEDC_HIGH_SPEED_MODE,
+    LEDC_LOW_SPEED_MODE,
+} ledc_mode_t;
+
+typedef int ledc_channel_t;
+
+typedef enum
+{
+    LEDC_FADE_NO_WAIT,
+    LEDC_FADE_WAIT_DONE,
+} ledc_fade_mode_t;
+
+extern uint32_t shimLedcDuty[16];
+
+inline esp_err_t ledc_fade_func_install(int intr_alloc_flags)
+{
+    return ESP_OK;
+}
+
+inline esp_err_t ledc_set_duty(ledc_mode_t mode, ledc_channel_t channel, uint32_t duty)
+{
+    shimLedcDuty[(mode * 8 + channel) & 15] = duty;
+    return ESP_OK;
+}
+
+inline esp_err_t ledc_update_duty(ledc_mode_t mode, ledc_channel_t channel)
+{
+    return ESP_OK;
+}
+
+inline esp_err_t ledc_set_fade_with_time(ledc_mode_t mode, ledc_channel_t channel, uint32_t target_duty, int max_fade_time_ms)
+{
+    return ledc_set_duty(mode, channel, target_duty);
+}
+
+inline esp_err_t ledc_fade_start(ledc_mode_t mode, ledc_channel_t channel, ledc_fade_mode_t fade_mode)
+{
+    return ESP_OK;
+}
@@ -0,0 +1,48 @@
+#include "esp_timer.h"
+#include <chrono>
+
+struct ShimTimer
+{
+    esp_timer_create_args_t args;
+    uint64_t period;
+    bool running;
+};
+
+static const auto startTime = std::chrono::steady_clock::now();
+
+int esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    *out = new ShimTimer{*args, 0, false};
+    return 0;
+}
+
+int esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    timer->period = 0;
+    timer->running = true;
+    return 0;
+}
+
+int esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    timer->period = period_us;
+    timer->running = true;
+    return 0;
+}
+
+int esp_timer_stop(esp_timer_handle_t timer)
+{
+    timer->running = false;
+    return 0;
+}
+
+int esp_timer_delete(esp_timer_handle_t timer)
+{
+    delete timer;
+    return 0;
+}
+
+int64_t esp_timer_get_time()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
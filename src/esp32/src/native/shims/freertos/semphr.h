@@ -0,0 +1,10 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+// Mutexes only: a semaphore is a std::timed_mutex
+typedef struct ShimSemaphore *SemaphoreHandle_t;
+
+SemaphoreHandle_t xSemaphoreCreateMutex();
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore);
@@ -0,0 +1,154 @@
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct ShimTask
+{
+    std::mutex lock;
+    std::condition_variable wake;
+    uint32_t notifications = 0;
+};
+
+// Set for threads started by xTaskCreate, lazily for every other thread
+static thread_local ShimTask *currentTask = nullptr;
+static const auto startTime = std::chrono::steady_clock::now();
+
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+    while (mux->flag.test_and_set(std::memory_order_acquire))
+    {
+        std::this_thread::yield();
+    }
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+    mux->flag.clear(std::memory_order_release);
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                                   UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    ShimTask *task = new ShimTask();
+    if (handle)
+    {
+        *handle = task;
+    }
+    std::thread([fn, arg, task]()
+                {
+                    currentTask = task;
+                    fn(arg); })
+        .detach();
+    return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, uint32_t stackDepth, void *arg,
+                       UBaseType_t priority, TaskHandle_t *handle)
+{
+    return xTaskCreatePinnedToCore(fn, name, stackDepth, arg, priority, handle, tskNO_AFFINITY);
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    // Only self-deletion is supported: park the thread forever
+    if (!task || task == xTaskGetCurrentTaskHandle())
+    {
+        while (true)
+        {
+            std::this_thread::sleep_for(std::chrono::hours(1));
+        }
+    }
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+void taskYIELD()
+{
+    std::this_thread::yield();
+}
+
+TickType_t xTaskGetTickCount()
+{
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle()
+{
+    // Threads not created through xTaskCreate get a thread-local handle; no
+    // allocation here, since HeapMonitor calls this from inside malloc
+    static thread_local ShimTask threadTask;
+    if (!currentTask)
+    {
+        currentTask = &threadTask;
+    }
+    return currentTask;
+}
+
+void xTaskNotifyGive(TaskHandle_t task)
+{
+    {
+        std::lock_guard<std::mutex> guard(task->lock);
+        task->notifications++;
+    }
+    task->wake.notify_one();
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *higherPriorityTaskWoken)
+{
+    xTaskNotifyGive(task);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticksToWait)
+{
+    ShimTask *task = xTaskGetCurrentTaskHandle();
+    std::unique_lock<std::mutex> guard(task->lock);
+    auto ready = [task]()
+    { return task->notifications > 0; };
+    if (ticksToWait == portMAX_DELAY)
+    {
+        task->wake.wait(guard, ready);
+    }
+    else
+    {
+        task->wake.wait_for(guard, std::chrono::milliseconds(ticksToWait), ready);
+    }
+
+    uint32_t value = task->notifications;
+    if (value > 0)
+    {
+        task->notifications = clearOnExit ? 0 : value - 1;
+    }
+    return value;
+}
+
+struct ShimSemaphore
+{
+    std::timed_mutex lock;
+};
+
+SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+    return new ShimSemaphore();
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t semaphore, TickType_t ticksToWait)
+{
+    if (ticksToWait == portMAX_DELAY)
+    {
+        semaphore->lock.lock();
+        return pdTRUE;
+    }
+    return semaphore->lock.try_lock_for(std::chrono::milliseconds(ticksToWait)) ? pdTRUE : pdFALSE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t semaphore)
+{
+    semaphore->lock.unlock();
+    return pdTRUE;
+}
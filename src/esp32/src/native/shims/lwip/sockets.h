@@ -0,0 +1,7 @@
+#pragma once
+
+// lwIP's BSD socket API for the native build: the host's own
+
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <errno.h>
@@ -5,19 +5,43 @@ This module provides tools for MCP clients to connect with EMQX brokers.
 It registers these tools with the MCP server, making them available for clients to use through the MCP protocol.
 """
 
+import asyncio
+import hashlib
+import time
+import uuid
 import logging
 import httpx
 import base64
 import json
-from typing import Any, Optional, Dict
+import msgpack
+import struct
+import wave
+import zlib
+from pathlib import Path
+from urllib.parse import quote
+from typing import Any, Optional, Dict, Literal
 from pydantic import BaseModel, Field, field_validator
 from .utils.config_loader import load_emqx_config
 
 class MQTTMessagePublishRequest(BaseModel):
     topic: str = Field(..., description="The MQTT topic to publish to")
     payload: str = Field(..., description="The JSON message content to publish")
-    qos: Optional[int] = Field(0, ge=0, le=2, description="Quality of Service level (0, 1, or 2)")
+    qos: Optional[int] = Field(
+        1, ge=0, le=2, description="Quality of Service level (0, 1, or 2); QoS 1 is queued for an offline device"
+    )
     retain: Optional[bool] = Field(False, description="Whether to retain the message")
+    encoding: Optional[Literal["json", "msgpack"]] = Field(
+        "json",
+        description="Wire encoding: 'json' sends the payload text as is, 'msgpack' sends it as MessagePack "
+                    "(smaller on the wire and faster to parse on the device; use for high-rate control)",
+    )
+    wait_ack: Optional[bool] = Field(
+        False,
+        description="Wait for the device to acknowledge the command and return its status and latency breakdown",
+    )
+    ack_timeout_s: Optional[float] = Field(
+        5.0, gt=0, le=60, description="Seconds to wait for the acknowledgement when wait_ack is set"
+    )
 
     @field_validator("payload")
     def validate_payload_json(cls, v):
@@ -27,6 +51,91 @@ class MQTTMessagePublishRequest(BaseModel):
             raise ValueError("payload must be a valid JSON string")
         return v
 
+# Device ack status codes, by value
+ACK_STATUS = ["ok", "invalid", "dropped", "no_handler", "duplicate", "failed", "superseded", "queued"]
+# Seconds between reads of the ack documents while waiting for an ack
+ACK_POLL_S = 0.1
+
+# Firmware chunks in flight before the sender waits for the device to catch up
+OTA_WINDOW_CHUNKS = 32
+# Seconds without progress before the sender resends from the device's offset
+OTA_STALL_S = 15
+# Seconds to wait for the device to acknowledge a begin, and to come back after the reboot
+OTA_BEGIN_TIMEOUT_S = 30
+OTA_REBOOT_TIMEOUT_S = 90
+
+# Streamed audio: chunk length and how far the sender runs ahead of playback
+AUDIO_CHUNK_MS = 250
+AUDIO_LEAD_MS = 500
+
+IMA_STEPS = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97,
+    107, 118, 130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871,
+    5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623,
+    27086, 29794, 32767,
+]
+IMA_INDEX = [-1, -1, -1, -1, 2, 4, 6, 8]
+
+
+def _read_wav_mono(path: str, rate: int) -> list:
+    """Read a PCM WAV file as mono 16-bit samples at the given rate"""
+
+    with wave.open(str(Path(path).expanduser()), "rb") as wav:
+        channels, width, source_rate = wav.getnchannels(), wav.getsampwidth(), wav.getframerate()
+        frames = wav.readframes(wav.getnframes())
+    if width not in (1, 2):
+        raise ValueError(f"{width * 8}-bit WAV is not supported, use 8 or 16-bit PCM")
+
+    if width == 1:
+        raw = [(b - 128) << 8 for b in frames]
+    else:
+        raw = list(struct.unpack(f"<{len(frames) // 2}h", frames))
+    mono = [sum(raw[i:i + channels]) // channels for i in range(0, len(raw), channels)]
+
+    # Linear interpolation is enough for a buzzer
+    if source_rate == rate or not mono:
+        return mono
+    count = len(mono) * rate // source_rate
+    out = []
+    for i in range(count):
+        pos = i * source_rate / rate
+        j = int(pos)
+        nxt = mono[min(j + 1, len(mono) - 1)]
+        out.append(int(mono[j] + (nxt - mono[j]) * (pos - j)))
+    return out
+
+
+def _ima_encode(samples: list, state: list) -> bytes:
+    """IMA ADPCM encode, low nibble first; state is [predictor, step index] and is updated"""
+
+    predictor, index = state
+    out = bytearray((len(samples) + 1) // 2)
+    for i, sample in enumerate(samples):
+        step = IMA_STEPS[index]
+        diff = sample - predictor
+        nibble = 8 if diff < 0 else 0
+        diff = abs(diff)
+        # Mirror the decoder exactly so both sides stay in step
+        delta = step >> 3
+        if diff >= step:
+            nibble |= 4
+            diff -= step
+            delta += step
+        if diff >= step >> 1:
+            nibble |= 2
+            diff -= step >> 1
+            delta += step >> 1
+        if diff >= step >> 2:
+            nibble |= 1
+            delta += step >> 2
+        predictor = max(-32768, min(32767, predictor - delta if nibble & 8 else predictor + delta))
+        index = max(0, min(88, index + IMA_INDEX[nibble & 7]))
+        out[i // 2] |= nibble << 4 if i & 1 else nibble
+    state[0], state[1] = predictor, index
+    return bytes(out)
+
+
 class EMQXMCPTools:
 
     def __init__(self, logger: logging.Logger):
@@ -38,6 +147,10 @@ class EMQXMCPTools:
         self.app_id = conf["app_id"]
         self.app_secret = conf["app_secret"]
         self.timeout = conf["timeout"]
+        self.state_topic = conf["state_topic"]
+        self.ota_topic = conf["ota_topic"]
+        self.audio_topic = conf["audio_topic"]
+        self.ack_topic = conf["ack_topic"]
         self._client = httpx.AsyncClient(timeout=self.timeout)
 
     def _get_auth_header(self):
@@ -81,9 +194,27 @@ class EMQXMCPTools:
 
             Supported Topics:
                 esp32-mcp/control/led
-                    Controls LED state (e.g., turn on or off).
+                    Controls LED state: "on", "off", "set_brightness" (brightness 0-255),
+                    "fade" (brightness, duration ms), "breathe" (min, max, period ms, cycles; 0 = forever)
+                    and "blink" (on_ms, off_ms, count, brightness). Every LED command accepts an optional
+                    "channel" (LED index); without it all LEDs are driven. Brightness is perceived (gamma-corrected).
                 esp32-mcp/control/buzzer
                     Controls buzzer state (e.g., turn on or off).
+                esp32-mcp/control/rules
+                    Installs local rules that react to commands on the device itself, without a cloud round trip:
+                    {"command": "add", "name": "bright_beep",
+                     "when": {"topic": "esp32-mcp/control/led", "command": "set_brightness"},
+                     "if": "brightness > 200",
+                     "then": [{"topic": "esp32-mcp/control/buzzer", "command": "BEEP", "duration": 100}]}
+                    "if" and string field values are integer expressions over the triggering command's fields.
+                    {"command": "remove", "name": "..."} and {"command": "clear"} delete rules.
+                esp32-mcp/control/sensor
+                    Controls analog sampling: "start", "stop", "set_rate" (sample_hz per pin, window_ms),
+                    "set_threshold" (channel, high 0-4095, optional low for hysteresis) and "clear_threshold"
+                    (channel). Per-window min/max/mean/rms and threshold crossings are published to
+                    esp32-mcp/status/sensor once per window.
+                esp32-mcp/control/buzzer/audio
+                    Streamed audio for the buzzer; use the play_audio tool rather than publishing to it directly.
 
             Payload Format (JSON):
                 {
@@ -92,6 +223,10 @@ class EMQXMCPTools:
                 command (string, required):
                     Action to perform on the device.
                     Allowed values: "on", "off" (case-insensitive; custom actions may be supported).
+                id (string or integer, optional):
+                    Message ID. The device drops a message whose id it handled recently, so reuse the
+                    same id when retrying a publish and a fresh one for every new command. The id is also
+                    the correlation ID of the device's acknowledgement; wait_ack adds one when it is missing.
 
             Example Payload:
                 {
@@ -102,11 +237,30 @@ class EMQXMCPTools:
                 request (MQTTMessagePublishRequest): Request object containing:
                     topic (str): MQTT topic to publish to. Must match one of the supported topics.
                     payload (str): JSON-formatted message content, following the Payload Format.
-                    qos (int, optional): MQTT Quality of Service level (0, 1, or 2). Default is 0.
+                    qos (int, optional): MQTT Quality of Service level (0, 1, or 2). Default is 1, so the broker
+                        queues the command while the device is reconnecting.
                     retain (bool, optional): Whether to retain the message on the broker. Default is False.
+                    encoding (str, optional): "json" (default) or "msgpack". With "msgpack" the JSON payload is
+                        converted to MessagePack before publishing; the device detects the format itself.
+                    wait_ack (bool, optional): Wait until the device acknowledges the command. Default is False.
+                        The device keeps only its last 32 acks in a retained document, polled every 100 ms; if
+                        more than 32 messages with an id finish within one poll, this ack can be pushed out
+                        unseen and is reported as a timeout although the command ran.
+                    ack_timeout_s (float, optional): How long to wait for the acknowledgement. Default is 5.
 
             Returns:
-                dict: Result of the publish operation.
+                dict: Result of the publish operation. With wait_ack it also holds:
+                    "id": the correlation ID,
+                    "status": "ok", "invalid", "dropped", "no_handler", "duplicate", "failed", "superseded" or
+                        "queued" (a batch scheduled more than 5 minutes ahead: accepted, but acked before it runs,
+                        so it has no "queue"/"run" latency),
+                    "ack": the device's ack entry,
+                    "latency_ms": {"publish": HTTP publish call, "to_device": publish start to device receive,
+                                   "queue": receive to handler start, "run": handler run time,
+                                   "round_trip": publish start to ack seen}.
+                    "to_device" is only present when the device clock is synced and is as accurate as the
+                    two clocks agree; "queue" and "run" only when a handler ran. "round_trip" includes up to
+                    0.1 s of polling. On timeout: {"error": "<message>", "id": "<id>"}.
 
             Notes:
                 - Ensure the MQTT broker connection is established before publishing.
@@ -238,22 +392,370 @@ class EMQXMCPTools:
                 self.logger.error(err)
                 return {"error": err}
 
+            payload = request.payload
+            ack_id = None
+            if request.wait_ack:
+                message = json.loads(payload)
+                if not isinstance(message, dict):
+                    return {"error": "wait_ack needs a JSON object payload"}
+                if "id" not in message:
+                    message["id"] = f"mcp-{uuid.uuid4().hex[:12]}"
+                    payload = json.dumps(message)
+                ack_id = message["id"]
+
+            sent_at = time.time()
             result = await self._publish_message(
                 topic=request.topic,
-                payload=request.payload,
-                qos=request.qos if request.qos is not None else 0,
+                payload=payload,
+                qos=request.qos if request.qos is not None else 1,
                 retain=request.retain if request.retain is not None else False,
+                encoding=request.encoding or "json",
             )
+            published_at = time.time()
 
             if "error" not in result:
                 self.logger.info(f"Message published successfully to topic: {request.topic}")
             else:
                 self.logger.error(f"Failed to publish message to topic: {request.topic}, error: {result['error']}")
+                return result
+
+            if ack_id is None:
+                return result
+
+            ack = await self._wait_ack(ack_id, request.ack_timeout_s or 5.0)
+            if ack is None:
+                return {"error": f"No acknowledgement within {request.ack_timeout_s} s", "id": ack_id}
+            seen_at = time.time()
+
+            latency = {
+                "publish": round((published_at - sent_at) * 1000, 1),
+                "round_trip": round((seen_at - sent_at) * 1000, 1),
+            }
+            if "rx" in ack:
+                latency["to_device"] = round(ack["rx"] - sent_at * 1000, 1)
+            if "queue_us" in ack:
+                latency["queue"] = ack["queue_us"] / 1000
+                latency["run"] = ack["run_us"] / 1000
+            status = ack.get("status", 0)
+            return {
+                **result,
+                "id": ack_id,
+                "status": ACK_STATUS[status] if status < len(ACK_STATUS) else status,
+                "ack": ack,
+                "latency_ms": latency,
+            }
+
+        @mcp.tool()
+        async def get_device_state(device_id: Optional[str] = None) -> dict:
+            """
+            Read the current state of ESP32-MCP devices.
+
+            Each device publishes a retained JSON document on esp32-mcp/status/state/<device_id> whenever
+            its state changes (rapid changes are merged, at most 4 publishes per second). Read it before
+            sending a command instead of re-sending commands to be safe.
+
+            Args:
+                device_id (str, optional): MQTT client ID of the device, e.g. "esp32-client-24:6F:28:AA:BB:CC".
+                    Omit it to get the state of every device that has published one.
+
+            Returns:
+                dict: {"devices": {"<device_id>": <state>}}, where a state looks like
+                    {
+                        "led": {"channels": [{"state": "on", "effect": "breathe", "brightness": 255}]},
+                        "buzzer": {"state": "on", "mode": "song"}
+                    }
+                    "led.channels" is indexed like the "channel" field of LED commands; "brightness" is the
+                    target (the peak for breathe and blink). "buzzer.mode" is only present while it sounds.
+                    On failure: {"error": "<message>"}.
+            """
+
+            self.logger.info("Handling device state request")
+
+            if device_id:
+                topics = [f"{self.state_topic}/{device_id}"]
+            else:
+                listing = await self._get("/mqtt/retainer/messages", params={"limit": 1000})
+                if "error" in listing:
+                    return listing
+                prefix = f"{self.state_topic}/"
+                topics = [m["topic"] for m in listing.get("data", []) if m.get("topic", "").startswith(prefix)]
+
+            devices = {}
+            for topic in topics:
+                message = await self._get(f"/mqtt/retainer/message/{quote(topic, safe='')}")
+                if "error" in message:
+                    if device_id:
+                        return message
+                    continue
+                try:
+                    devices[topic[len(self.state_topic) + 1:]] = json.loads(base64.b64decode(message["payload"]))
+                except Exception as e:
+                    self.logger.error(f"Invalid state document on {topic}: {e}")
+
+            return {"devices": devices}
+
+        @mcp.tool()
+        async def update_firmware(
+            device_id: str, firmware_path: str, compress: bool = True, chunk_size: Optional[int] = None
+        ) -> dict:
+            """
+            Update the firmware of an ESP32-MCP device over MQTT.
+
+            The image is streamed in checksummed chunks to esp32-mcp/ota/<device_id> and written straight
+            into the device's spare app partition; this works through NAT, unlike the LAN OTA upload.
+            Calling the tool again with the same image resumes an interrupted transfer where the device
+            left off (after a device reboot, only uncompressed transfers resume). Once the image is
+            verified the device reboots into it.
+
+            Args:
+                device_id (str): MQTT client ID of the device, e.g. "esp32-client-24:6F:28:AA:BB:CC".
+                firmware_path (str): Path of the firmware .bin on this machine
+                    (e.g. .pio/build/esp32-s3-devkitc-1/firmware.bin).
+                compress (bool, optional): Send the image zlib-compressed. Default True; usually halves the transfer.
+                chunk_size (int, optional): Bytes per chunk; defaults to the largest the device accepts.
+
+            Returns:
+                dict: {"state": "updated", "version": "<new firmware version>", "bytes_sent": <n>} once the device
+                    has verified the image and rebooted, or {"error": "<message>", "status": <last device status>}
+                    on failure, including a device that restarted before the transfer was complete.
+            """
+
+            try:
+                image = Path(firmware_path).expanduser().read_bytes()
+            except OSError as e:
+                return {"error": f"Cannot read firmware: {e}"}
+
+            data = zlib.compress(image, 9) if compress else image
+            topic = f"{self.ota_topic}/{device_id}"
+            self.logger.info(f"Firmware update of {device_id}: {len(image)} bytes, {len(data)} on the wire")
+
+            # The device echoes the nonce, so an old retained status cannot pass for its answer
+            nonce = uuid.uuid4().int & 0xFFFFFFFF or 1
+            begin = {
+                "command": "begin",
+                "size": len(data),
+                "sha256": hashlib.sha256(image).hexdigest(),
+                "compression": "zlib" if compress else "none",
+                "nonce": nonce,
+            }
+            result = await self._publish_message(topic, json.dumps(begin))
+            if "error" in result:
+                return result
+
+            status = await self._wait_ota_status(device_id, lambda s: s.get("nonce") == nonce, OTA_BEGIN_TIMEOUT_S)
+            if status is None or status.get("state") != "receiving":
+                return {"error": "Device did not start the update", "status": status}
+            start_version = status.get("version")
+
+            chunk = min(chunk_size or status["chunk"], status["chunk"])
+            acked = sent = status["offset"]
+            stalled = 0.0
+            while True:
+                # Keep a window of chunks queued at the broker; QoS 1 keeps them in order
+                while sent < len(data) and sent - acked < OTA_WINDOW_CHUNKS * chunk:
+                    piece = data[sent:sent + chunk]
+                    packet = b"OTAC" + struct.pack("<II", sent, zlib.crc32(piece)) + piece
+                    result = await self._publish_bytes(topic, packet)
+                    if "error" in result:
+                        return result
+                    sent += len(piece)
+
+                await asyncio.sleep(1)
+                status = await self._get_ota_status(device_id)
+                if status is None:
+                    continue
+                if status.get("state") == "failed":
+                    return {"error": f"Device rejected the update: {status.get('error')}", "status": status}
+                if status.get("state") == "done" and status.get("nonce") == nonce:
+                    break
+                # The "done" status was missed if the device already runs another version;
+                # otherwise it restarted or gave up before the image was complete
+                rebooted = status.get("state") == "idle" and status.get("nonce") != nonce
+                if rebooted and status.get("version") != start_version:
+                    break
+                if status.get("state") != "receiving" or status.get("nonce") != nonce:
+                    return {"error": "Update interrupted, the device still runs the old firmware", "status": status}
+
+                # No progress: chunks were lost (e.g. a reconnect), go back to the device's offset
+                if status["offset"] > acked:
+                    acked = status["offset"]
+                    stalled = 0.0
+                else:
+                    stalled += 1
+                    if stalled >= OTA_STALL_S:
+                        self.logger.warning(f"Firmware update stalled at {acked}, resending")
+                        sent = acked
+                        stalled = 0.0
+
+            # The device clears the nonce when it reboots into the new image
+            if status.get("state") == "done":
+                status = await self._wait_ota_status(
+                    device_id, lambda s: s.get("state") == "idle" and s.get("nonce") != nonce, OTA_REBOOT_TIMEOUT_S
+                )
+            if status is None:
+                return {"error": "Image accepted, but the device did not come back after the reboot"}
+            self.logger.info(f"Firmware update of {device_id} finished: {start_version} -> {status.get('version')}")
+            return {"state": "updated", "version": status.get("version"), "bytes_sent": len(data)}
+
+        @mcp.tool()
+        async def play_audio(wav_path: str, rate: int = 8000, prefill_ms: int = 200) -> dict:
+            """
+            Play a WAV file on the ESP32-MCP buzzer.
+
+            The audio is converted to mono, resampled, IMA ADPCM encoded (4 bits per sample) and streamed in
+            250 ms chunks to esp32-mcp/control/buzzer/audio, paced in real time. The device buffers prefill_ms
+            before it starts playing to ride out network jitter; a buzzer command stops the stream.
+
+            Args:
+                wav_path (str): Path of an 8 or 16-bit PCM .wav file on this machine.
+                rate (int, optional): Playback sample rate in Hz, 4000-16000. Default 8000.
+                prefill_ms (int, optional): Audio the device buffers before playing. Default 200;
+                    raise it on a slow or jittery link.
+
+            Returns:
+                dict: {"state": "played", "duration_ms": <n>, "chunks": <n>, "bytes_sent": <n>}
+                    or {"error": "<message>"} on failure.
+            """
+
+            if not 4000 <= rate <= 16000:
+                return {"error": "rate must be 4000-16000 Hz"}
+            try:
+                samples = _read_wav_mono(wav_path, rate)
+            except (OSError, EOFError, wave.Error, ValueError) as e:
+                return {"error": f"Cannot read audio: {e}"}
+
+            topic = self.audio_topic
+            result = await self._publish_message(topic, json.dumps({"command": "start", "rate": rate, "prefill_ms": prefill_ms}))
+            if "error" in result:
+                return result
+
+            per_chunk = rate * AUDIO_CHUNK_MS // 1000
+            state = [0, 0]
+            sent = 0
+            loop = asyncio.get_running_loop()
+            started = loop.time()
+            chunks = (len(samples) + per_chunk - 1) // per_chunk
+            for seq in range(chunks):
+                # Stay a little ahead of playback so the device buffer never runs dry
+                ahead = seq * AUDIO_CHUNK_MS / 1000 - (loop.time() - started)
+                if ahead > AUDIO_LEAD_MS / 1000:
+                    await asyncio.sleep(ahead - AUDIO_LEAD_MS / 1000)
+
+                header = b"AU" + struct.pack("<BBHh", 2, state[1], seq & 0xFFFF, state[0])
+                packet = header + _ima_encode(samples[seq * per_chunk:(seq + 1) * per_chunk], state)
+                result = await self._publish_bytes(topic, packet)
+                if "error" in result:
+                    await self._publish_message(topic, json.dumps({"command": "stop"}))
+                    return result
+                sent += len(packet)
+
+            result = await self._publish_message(topic, json.dumps({"command": "end"}))
+            if "error" in result:
+                return result
+            duration_ms = len(samples) * 1000 // rate
+            self.logger.info(f"Streamed {duration_ms} ms of audio in {chunks} chunks, {sent} bytes")
+            return {"state": "played", "duration_ms": duration_ms, "chunks": chunks, "bytes_sent": sent}
+
+    async def _get_ota_status(self, device_id: str) -> Optional[Dict[str, Any]]:
+        """Read a device's retained firmware update status, or None if there is none"""
+
+        topic = f"{self.ota_topic}/{device_id}/status"
+        message = await self._get(f"/mqtt/retainer/message/{quote(topic, safe='')}")
+        if "error" in message:
+            return None
+        try:
+            return json.loads(base64.b64decode(message["payload"]))
+        except Exception as e:
+            self.logger.error(f"Invalid firmware update status on {topic}: {e}")
+            return None
+
+    async def _wait_ota_status(self, device_id: str, done, timeout_s: float) -> Optional[Dict[str, Any]]:
+        """Poll the firmware update status until done(status) holds; None on timeout"""
+
+        status = None
+        for _ in range(int(timeout_s)):
+            await asyncio.sleep(1)
+            status = await self._get_ota_status(device_id) or status
+            if status is not None and done(status):
+                return status
+        return None
+
+    async def _wait_ack(self, ack_id: Any, timeout_s: float) -> Optional[Dict[str, Any]]:
+        """Poll every device's ack document for the given correlation ID; None on timeout"""
+
+        prefix = f"{self.ack_topic}/"
+        topics = []
+        deadline = time.monotonic() + timeout_s
+        while time.monotonic() < deadline:
+            await asyncio.sleep(ACK_POLL_S)
+            # The device is not named in the command, so look in every ack document
+            if not topics:
+                listing = await self._get("/mqtt/retainer/messages", params={"limit": 1000})
+                topics = [m["topic"] for m in listing.get("data", []) if m.get("topic", "").startswith(prefix)]
+            for topic in topics:
+                message = await self._get(f"/mqtt/retainer/message/{quote(topic, safe='')}")
+                if "error" in message:
+                    continue
+                try:
+                    document = json.loads(base64.b64decode(message["payload"]))
+                except Exception as e:
+                    self.logger.error(f"Invalid ack document on {topic}: {e}")
+                    continue
+                for ack in document.get("acks", []):
+                    if ack.get("id") == ack_id:
+                        return ack
+        return None
+
+    async def _get(self, path: str, params: Optional[Dict[str, Any]] = None) -> Dict[str, Any]:
+        """
+        GET an EMQX HTTP API resource.
+
+        Args:
+            path (str): Path below the API endpoint, starting with "/"
+            params (dict, optional): Query parameters
+
+        Returns:
+            dict: Decoded response, or error information
+        """
+
+        try:
+            response = await self._client.get(f"{self.api_endpoint}{path}", headers=self._get_auth_header(), params=params)
+            return self._handle_response(response)
+        except httpx.RequestError as e:
+            err = f"Network error while reading {path}: {e}"
+            self.logger.error(err)
+            return {"error": err}
+
+    async def _publish_bytes(self, topic: str, payload: bytes, qos: int = 1) -> Dict[str, Any]:
+        """
+        Publish a binary payload to an MQTT topic through the EMQX HTTP API.
+
+        Args:
+            topic (str): The MQTT topic to publish to
+            payload (bytes): The raw message payload
+            qos (int, optional): Quality of Service level. Defaults to 1.
+
+        Returns:
+            dict: Response from the EMQX API or error information
+        """
+
+        data = {
+            "topic": topic,
+            "payload": base64.b64encode(payload).decode(),
+            "payload_encoding": "base64",
+            "qos": qos,
+            "retain": False,
+        }
+        try:
+            response = await self._client.post(f"{self.api_endpoint}/publish", headers=self._get_auth_header(), json=data)
+            return self._handle_response(response)
+        except httpx.RequestError as e:
+            err = f"Network error while publishing to {topic}: {e}"
+            self.logger.error(err)
+            return {"error": err}
 
-            return result
-    
     async def _publish_message(
-        self, topic: str, payload: str, qos: int = 0, retain: bool = False
+        self, topic: str, payload: str, qos: int = 1, retain: bool = False, encoding: str = "json"
     ) -> Dict[str, Any]:
         """
         Publish a message to an MQTT topic.
@@ -263,8 +765,9 @@ class EMQXMCPTools:
         Args:
             topic (str): The MQTT topic to publish to
             payload (str): The message payload to publish
-            qos (int, optional): Quality of Service level (0, 1, or 2). Defaults to 0.
+            qos (int, optional): Quality of Service level (0, 1, or 2). Defaults to 1.
             retain (bool, optional): Whether to retain the message. Defaults to False.
+            encoding (str, optional): "json" or "msgpack". Defaults to "json".
 
         Returns:
             dict: Response from the EMQX API or error information
@@ -272,6 +775,12 @@ class EMQXMCPTools:
 
         url = f"{self.api_endpoint}/publish"
         data = {"topic": topic, "payload": payload, "qos": qos, "retain": retain}
+        if encoding == "msgpack":
+            # Binary payloads go through the HTTP API base64-encoded
+            packed = msgpack.packb(json.loads(payload), use_single_float=True)
+            data["payload"] = base64.b64encode(packed).decode()
+            data["payload_encoding"] = "base64"
+            self.logger.debug(f"MessagePack payload: {len(packed)} bytes (JSON: {len(payload.encode())} bytes)")
         self.logger.debug(f"Publishing message to topic {topic} with payload {payload}")
         try:
             response = await self._client.post(url, headers=self._get_auth_header(), json=data)
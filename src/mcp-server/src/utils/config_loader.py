@@ -68,4 +68,25 @@ def load_emqx_config(config_filename="config.json") -> Dict[str, Any]:
     # allow timeout，default 60s
     timeout = config.get("emqx", {}).get("api", {}).get("timeout", 60)
 
-    return {"api_endpoint": api_endpoint, "app_id": app_id, "app_secret": app_secret, "timeout": timeout}
\ No newline at end of file
+    # devices publish their retained state on <state topic>/<client id>
+    state_topic = config.get("emqx", {}).get("topic", {}).get("state", "esp32-mcp/status/state")
+
+    # firmware updates go to <ota topic>/<client id>
+    ota_topic = config.get("emqx", {}).get("topic", {}).get("ota", "esp32-mcp/ota")
+
+    # devices ack commands carrying an "id" in a retained document on <ack topic>/<client id>
+    ack_topic = config.get("emqx", {}).get("topic", {}).get("ack", "esp32-mcp/status/ack")
+
+    # streamed audio chunks for the buzzer
+    audio_topic = config.get("emqx", {}).get("topic", {}).get("audio", "esp32-mcp/control/buzzer/audio")
+
+    return {
+        "api_endpoint": api_endpoint,
+        "app_id": app_id,
+        "app_secret": app_secret,
+        "timeout": timeout,
+        "state_topic": state_topic,
+        "ota_topic": ota_topic,
+        "audio_topic": audio_topic,
+        "ack_topic": ack_topic,
+    }
\ No newline at end of file